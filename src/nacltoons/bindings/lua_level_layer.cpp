@@ -18,6 +18,7 @@ TOLUA_API int  tolua_level_layer_open (lua_State* tolua_S);
 
 #include "lua_level_layer.h"
 #include "level_layer.h"
+#include "behaviours.h"
 #include "game_manager.h"
 #include "tolua_fix.h"
 
@@ -30,6 +31,7 @@ static void tolua_reg_types (lua_State* tolua_S)
  tolua_usertype(tolua_S,"GameManager");
  tolua_usertype(tolua_S,"b2World");
  tolua_usertype(tolua_S,"LevelLayer");
+ tolua_usertype(tolua_S,"BehaviourManager");
 }
 
 /* method: GetWorld of class  LevelLayer */
@@ -161,6 +163,332 @@ static int tolua_level_layer_LevelLayer_FindBodiesAt00(lua_State* tolua_S)
 }
 #endif //#ifndef TOLUA_DISABLE
 
+/* method: GetBehaviours of class  LevelLayer */
+#ifndef TOLUA_DISABLE_tolua_level_layer_LevelLayer_GetBehaviours00
+static int tolua_level_layer_LevelLayer_GetBehaviours00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"LevelLayer",0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,2,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  LevelLayer* self = (LevelLayer*)  tolua_tousertype(tolua_S,1,0);
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'GetBehaviours'", NULL);
+#endif
+  {
+   BehaviourManager* tolua_ret = (BehaviourManager*)  self->GetBehaviours();
+    tolua_pushusertype(tolua_S,(void*)tolua_ret,"BehaviourManager");
+  }
+ }
+ return 1;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'GetBehaviours'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
+/* method: AddCollectible of class  BehaviourManager */
+#ifndef TOLUA_DISABLE_tolua_level_layer_BehaviourManager_AddCollectible00
+static int tolua_level_layer_BehaviourManager_AddCollectible00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"BehaviourManager",0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,2,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,3,0,&tolua_err) ||
+     !tolua_isstring(tolua_S,4,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,5,0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,6,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  BehaviourManager* self = (BehaviourManager*)  tolua_tousertype(tolua_S,1,0);
+  int tag = ((int)  tolua_tonumber(tolua_S,2,0));
+  int collector = ((int)  tolua_tonumber(tolua_S,3,0));
+  const char* group = ((const char*)  tolua_tostring(tolua_S,4,0));
+  float fade_time = ((float)  tolua_tonumber(tolua_S,5,0));
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'AddCollectible'", NULL);
+#endif
+  {
+   self->AddCollectible(tag,collector,group,fade_time);
+  }
+ }
+ return 0;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'AddCollectible'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
+/* method: AddGoal of class  BehaviourManager */
+#ifndef TOLUA_DISABLE_tolua_level_layer_BehaviourManager_AddGoal00
+static int tolua_level_layer_BehaviourManager_AddGoal00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"BehaviourManager",0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,2,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,3,0,&tolua_err) ||
+     !tolua_isstring(tolua_S,4,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,5,0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,6,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  BehaviourManager* self = (BehaviourManager*)  tolua_tousertype(tolua_S,1,0);
+  int tag = ((int)  tolua_tonumber(tolua_S,2,0));
+  int collector = ((int)  tolua_tonumber(tolua_S,3,0));
+  const char* required_group = ((const char*)  tolua_tostring(tolua_S,4,0));
+  float fade_time = ((float)  tolua_tonumber(tolua_S,5,0));
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'AddGoal'", NULL);
+#endif
+  {
+   self->AddGoal(tag,collector,required_group,fade_time);
+  }
+ }
+ return 0;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'AddGoal'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
+/* method: AddRotator of class  BehaviourManager */
+#ifndef TOLUA_DISABLE_tolua_level_layer_BehaviourManager_AddRotator00
+static int tolua_level_layer_BehaviourManager_AddRotator00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"BehaviourManager",0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,2,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,3,0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,4,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  BehaviourManager* self = (BehaviourManager*)  tolua_tousertype(tolua_S,1,0);
+  int tag = ((int)  tolua_tonumber(tolua_S,2,0));
+  float degrees_per_second = ((float)  tolua_tonumber(tolua_S,3,0));
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'AddRotator'", NULL);
+#endif
+  {
+   self->AddRotator(tag,degrees_per_second);
+  }
+ }
+ return 0;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'AddRotator'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
+/* method: AddMover of class  BehaviourManager */
+#ifndef TOLUA_DISABLE_tolua_level_layer_BehaviourManager_AddMover00
+static int tolua_level_layer_BehaviourManager_AddMover00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"BehaviourManager",0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,2,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,3,0,&tolua_err) ||
+     !tolua_isstring(tolua_S,4,0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,5,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  BehaviourManager* self = (BehaviourManager*)  tolua_tousertype(tolua_S,1,0);
+  int tag = ((int)  tolua_tonumber(tolua_S,2,0));
+  float speed = ((float)  tolua_tonumber(tolua_S,3,0));
+  const char* mode = ((const char*)  tolua_tostring(tolua_S,4,0));
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'AddMover'", NULL);
+#endif
+  {
+   self->AddMover(tag,speed,mode);
+  }
+ }
+ return 0;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'AddMover'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
+/* method: AddMoverPoint of class  BehaviourManager */
+#ifndef TOLUA_DISABLE_tolua_level_layer_BehaviourManager_AddMoverPoint00
+static int tolua_level_layer_BehaviourManager_AddMoverPoint00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"BehaviourManager",0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,2,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,3,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,4,0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,5,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  BehaviourManager* self = (BehaviourManager*)  tolua_tousertype(tolua_S,1,0);
+  int tag = ((int)  tolua_tonumber(tolua_S,2,0));
+  float x = ((float)  tolua_tonumber(tolua_S,3,0));
+  float y = ((float)  tolua_tonumber(tolua_S,4,0));
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'AddMoverPoint'", NULL);
+#endif
+  {
+   self->AddMoverPoint(tag,x,y);
+  }
+ }
+ return 0;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'AddMoverPoint'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
+/* method: AddSpawner of class  BehaviourManager */
+#ifndef TOLUA_DISABLE_tolua_level_layer_BehaviourManager_AddSpawner00
+static int tolua_level_layer_BehaviourManager_AddSpawner00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"BehaviourManager",0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,2,0,&tolua_err) ||
+     !tolua_isstring(tolua_S,3,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,4,0,&tolua_err) ||
+     !tolua_isnumber(tolua_S,5,0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,6,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  BehaviourManager* self = (BehaviourManager*)  tolua_tousertype(tolua_S,1,0);
+  int tag = ((int)  tolua_tonumber(tolua_S,2,0));
+  const char* image = ((const char*)  tolua_tostring(tolua_S,3,0));
+  float interval = ((float)  tolua_tonumber(tolua_S,4,0));
+  int max_alive = ((int)  tolua_tonumber(tolua_S,5,0));
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'AddSpawner'", NULL);
+#endif
+  {
+   self->AddSpawner(tag,image,interval,max_alive);
+  }
+ }
+ return 0;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'AddSpawner'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
+/* method: GetCollected of class  BehaviourManager */
+#ifndef TOLUA_DISABLE_tolua_level_layer_BehaviourManager_GetCollected00
+static int tolua_level_layer_BehaviourManager_GetCollected00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"BehaviourManager",0,&tolua_err) ||
+     !tolua_isstring(tolua_S,2,0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,3,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  BehaviourManager* self = (BehaviourManager*)  tolua_tousertype(tolua_S,1,0);
+  const char* group = ((const char*)  tolua_tostring(tolua_S,2,0));
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'GetCollected'", NULL);
+#endif
+  {
+   int tolua_ret = (int)  self->GetCollected(group);
+   tolua_pushnumber(tolua_S,(lua_Number)tolua_ret);
+  }
+ }
+ return 1;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'GetCollected'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
+/* method: GetCollectibles of class  BehaviourManager */
+#ifndef TOLUA_DISABLE_tolua_level_layer_BehaviourManager_GetCollectibles00
+static int tolua_level_layer_BehaviourManager_GetCollectibles00(lua_State* tolua_S)
+{
+#ifndef TOLUA_RELEASE
+ tolua_Error tolua_err;
+ if (
+     !tolua_isusertype(tolua_S,1,"BehaviourManager",0,&tolua_err) ||
+     !tolua_isstring(tolua_S,2,0,&tolua_err) ||
+     !tolua_isnoobj(tolua_S,3,&tolua_err)
+ )
+  goto tolua_lerror;
+ else
+#endif
+ {
+  BehaviourManager* self = (BehaviourManager*)  tolua_tousertype(tolua_S,1,0);
+  const char* group = ((const char*)  tolua_tostring(tolua_S,2,0));
+#ifndef TOLUA_RELEASE
+  if (!self) tolua_error(tolua_S,"invalid 'self' in function 'GetCollectibles'", NULL);
+#endif
+  {
+   int tolua_ret = (int)  self->GetCollectibles(group);
+   tolua_pushnumber(tolua_S,(lua_Number)tolua_ret);
+  }
+ }
+ return 1;
+#ifndef TOLUA_RELEASE
+ tolua_lerror:
+ tolua_error(tolua_S,"#ferror in function 'GetCollectibles'.",&tolua_err);
+ return 0;
+#endif
+}
+#endif //#ifndef TOLUA_DISABLE
+
 /* method: sharedManager of class  GameManager */
 #ifndef TOLUA_DISABLE_tolua_level_layer_GameManager_sharedManager00
 static int tolua_level_layer_GameManager_sharedManager00(lua_State* tolua_S)
@@ -299,6 +627,18 @@ TOLUA_API int tolua_level_layer_open (lua_State* tolua_S)
    tolua_function(tolua_S,"LevelComplete",tolua_level_layer_LevelLayer_LevelComplete00);
    tolua_function(tolua_S,"ToggleDebug",tolua_level_layer_LevelLayer_ToggleDebug00);
    tolua_function(tolua_S,"FindBodiesAt",tolua_level_layer_LevelLayer_FindBodiesAt00);
+   tolua_function(tolua_S,"GetBehaviours",tolua_level_layer_LevelLayer_GetBehaviours00);
+  tolua_endmodule(tolua_S);
+  tolua_cclass(tolua_S,"BehaviourManager","BehaviourManager","",NULL);
+  tolua_beginmodule(tolua_S,"BehaviourManager");
+   tolua_function(tolua_S,"AddCollectible",tolua_level_layer_BehaviourManager_AddCollectible00);
+   tolua_function(tolua_S,"AddGoal",tolua_level_layer_BehaviourManager_AddGoal00);
+   tolua_function(tolua_S,"AddRotator",tolua_level_layer_BehaviourManager_AddRotator00);
+   tolua_function(tolua_S,"AddMover",tolua_level_layer_BehaviourManager_AddMover00);
+   tolua_function(tolua_S,"AddMoverPoint",tolua_level_layer_BehaviourManager_AddMoverPoint00);
+   tolua_function(tolua_S,"AddSpawner",tolua_level_layer_BehaviourManager_AddSpawner00);
+   tolua_function(tolua_S,"GetCollected",tolua_level_layer_BehaviourManager_GetCollected00);
+   tolua_function(tolua_S,"GetCollectibles",tolua_level_layer_BehaviourManager_GetCollectibles00);
   tolua_endmodule(tolua_S);
   tolua_cclass(tolua_S,"GameManager","GameManager","",NULL);
   tolua_beginmodule(tolua_S,"GameManager");
@@ -0,0 +1,123 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+-- Native behaviour components.  Any shape or prefab instance in level.def
+-- can list behaviours that then run in C++ (see behaviours.h) with no
+-- per-frame Lua:
+--
+--   - { type: image, pos: [ 200, 480 ], image: star_image,
+--       behaviours: [ { type: collectible, collector: BALL, group: stars } ] }
+--
+-- The available types and their parameters are:
+--   collectible  collector, group ('default'), fade (0.5)
+--   goal         collector, requires (a collectible group), fade (0.5)
+--   rotator      speed (degrees per second, clockwise)
+--   mover        path (list of points), speed (points per second),
+--                mode ('loop', 'pingpong' or 'once')
+--   spawner      image (asset name), interval (seconds), max (0 = no limit)
+--                spawned objects are put on the spawner's collision layer
+--
+-- 'collector' is the tag of the only object that triggers the behaviour;
+-- without it any tagged object does.  Behaviours report what they do
+-- through OnBehaviourEvent(object, event, value) handlers in object,
+-- level and game scripts.  The events are 'collected' (value: number
+-- collected in the group so far), 'goal' (the level is completed after
+-- the handlers run), 'arrived' (end of a 'once' path) and 'spawned'
+-- (value: number spawned so far).
+
+local util = require 'util'
+
+local behaviours = {}
+
+-- Parameters of each behaviour type.
+behaviours.TYPES = {
+    collectible = { params = { 'collector', 'group', 'fade' }, required = {} },
+    goal = { params = { 'collector', 'requires', 'fade' }, required = {} },
+    rotator = { params = { 'speed' }, required = { 'speed' } },
+    mover = { params = { 'path', 'speed', 'mode' }, required = { 'path', 'speed' } },
+    spawner = { params = { 'image', 'interval', 'max' }, required = { 'image', 'interval' } },
+}
+
+behaviours.MOVER_MODES = { 'loop', 'pingpong', 'once' }
+
+local DEFAULT_GROUP = 'default'
+local DEFAULT_FADE = 0.5
+
+--- Return an error message if a behaviour definition is invalid, or nil.
+function behaviours.Check(def)
+    local spec = behaviours.TYPES[def.type]
+    if not spec then
+        return 'invalid behaviour type: ' .. tostring(def.type)
+    end
+    for key, _ in pairs(def) do
+        if key ~= 'type' then
+            local known = false
+            for _, param in ipairs(spec.params) do
+                known = known or param == key
+            end
+            if not known then
+                return 'invalid key in ' .. def.type .. ' behaviour: ' .. key
+            end
+        end
+    end
+    for _, key in ipairs(spec.required) do
+        if def[key] == nil then
+            return 'missing required key in ' .. def.type .. ' behaviour: ' .. key
+        end
+    end
+    if def.mode then
+        local known = false
+        for _, mode in ipairs(behaviours.MOVER_MODES) do
+            known = known or mode == def.mode
+        end
+        if not known then
+            return 'invalid mover mode: ' .. tostring(def.mode)
+        end
+    end
+end
+
+--- Attach the behaviours listed in an object definition.  Must be called
+-- once all the level's objects are registered so that 'collector' tags
+-- can be resolved.
+-- @param manager the level's BehaviourManager (layer:GetBehaviours())
+-- @param object the object definition, with its numeric tag
+-- @param tag_map the level's string -> numeric tag mapping
+-- @param assets the game's asset table
+function behaviours.Attach(manager, object, tag_map, assets)
+    local function Collector(def)
+        if not def.collector then
+            return 0
+        end
+        local tag = tag_map[def.collector]
+        assert(tag, 'unknown collector tag: ' .. def.collector)
+        return tag
+    end
+
+    for _, def in ipairs(object.behaviours) do
+        local tag = object.tag
+        if def.type == 'collectible' then
+            manager:AddCollectible(tag, Collector(def), def.group or DEFAULT_GROUP,
+                                   def.fade or DEFAULT_FADE)
+        elseif def.type == 'goal' then
+            manager:AddGoal(tag, Collector(def), def.requires or '',
+                            def.fade or DEFAULT_FADE)
+        elseif def.type == 'rotator' then
+            manager:AddRotator(tag, def.speed)
+        elseif def.type == 'mover' then
+            manager:AddMover(tag, def.speed, def.mode or 'loop')
+            for _, point in ipairs(def.path) do
+                local pos = util.PointFromLua(point)
+                manager:AddMoverPoint(tag, pos.x, pos.y)
+            end
+        elseif def.type == 'spawner' then
+            local image = assets[def.image]
+            assert(image, 'unknown image: ' .. def.image)
+            manager:AddSpawner(tag, image, def.interval, def.max or 0)
+        else
+            error('invalid behaviour type: ' .. tostring(def.type))
+        end
+    end
+end
+
+return behaviours
@@ -0,0 +1,175 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+-- Collision layers.  game.def and level.def can name the kinds of object
+-- in a game and say which of them collide:
+--
+--   collision_layers:
+--     ball: [ terrain, stroke, collectible ]
+--     terrain: [ stroke ]
+--     collectible: []
+--
+-- Two layers collide when either of them lists the other.  Shapes,
+-- prefabs, prefab instances and the children of compound shapes and
+-- prefabs choose a layer with a 'layer' key.  Children default to the
+-- layer of their shape, and instances to the layer of their prefab.  A
+-- level's layers are added to the game's; an entry in level.def replaces
+-- the game.def entry of the same name.
+--
+-- The engine always defines three layers, which may also be replaced:
+--   default  shapes without a 'layer'; collides with default and stroke
+--   stroke   finished strokes; collides with default and stroke
+--   drawing  strokes still being drawn; collides with drawing only
+-- With no declarations this is how collisions have always been filtered.
+--
+-- The layers are compiled into Box2D category and mask bits which
+-- drawing.lua puts on every fixture, so Box2D never pairs up fixtures
+-- whose layers don't collide.  There are 16 category bits, hence at most
+-- 16 layers.
+
+local collision = {}
+
+collision.MAX_LAYERS = 16
+
+-- Built-in layers, in the order they get their bits.
+local BUILTIN_NAMES = { 'default', 'drawing', 'stroke' }
+local BUILTIN_LAYERS = {
+    default = { 'default', 'stroke' },
+    drawing = { 'drawing' },
+    stroke = { 'default', 'stroke' },
+}
+
+--- Return the layers in effect for a level: the built-in layers, then
+-- game.def's, then level.def's.
+-- @param game_layers the 'collision_layers' table of game.def (may be nil)
+-- @param level_layers the 'collision_layers' table of level.def (may be nil)
+function collision.Merge(game_layers, level_layers)
+    local layers = {}
+    for name, list in pairs(BUILTIN_LAYERS) do
+        layers[name] = list
+    end
+    for name, list in pairs(game_layers or {}) do
+        layers[name] = list
+    end
+    for name, list in pairs(level_layers or {}) do
+        layers[name] = list
+    end
+    return layers
+end
+
+--- Return an error message if a 'collision_layers' table from a .def file
+-- is malformed, or nil.  Names are checked by CheckNames.
+function collision.Check(layers)
+    if type(layers) ~= 'table' then
+        return 'collision_layers must be a table'
+    end
+    for name, list in pairs(layers) do
+        if type(name) ~= 'string' then
+            return 'invalid collision layer name: ' .. tostring(name)
+        end
+        if type(list) ~= 'table' then
+            return 'collision layer ' .. name .. ' must list the layers it collides with'
+        end
+        for _, other in ipairs(list) do
+            if type(other) ~= 'string' then
+                return 'invalid layer in collision layer ' .. name .. ': ' .. tostring(other)
+            end
+        end
+    end
+end
+
+--- Return an error message if merged layers (see Merge) refer to unknown
+-- layers or are too many, or nil.
+function collision.CheckNames(layers)
+    local count = 0
+    for name, list in pairs(layers) do
+        count = count + 1
+        for _, other in ipairs(list) do
+            if not layers[other] then
+                return 'unknown layer in collision layer ' .. name .. ': ' .. other
+            end
+        end
+    end
+    if count > collision.MAX_LAYERS then
+        return 'too many collision layers: ' .. count .. ' (at most ' ..
+               collision.MAX_LAYERS .. ')'
+    end
+end
+
+local Matrix = {}
+Matrix.__index = Matrix
+
+--- Compile the layers of a level into category and mask bits.
+-- Arguments are as for Merge.
+function collision.NewMatrix(game_layers, level_layers)
+    local layers = collision.Merge(game_layers, level_layers)
+    local message = collision.CheckNames(layers)
+    assert(not message, message)
+
+    -- Built-in layers first so that their bits don't depend on the game.
+    local names = {}
+    for _, name in ipairs(BUILTIN_NAMES) do
+        table.insert(names, name)
+    end
+    local declared = {}
+    for name, _ in pairs(layers) do
+        if not BUILTIN_LAYERS[name] then
+            table.insert(declared, name)
+        end
+    end
+    table.sort(declared)
+    for _, name in ipairs(declared) do
+        table.insert(names, name)
+    end
+
+    local categories = {}
+    for i, name in ipairs(names) do
+        categories[name] = 2 ^ (i - 1)
+    end
+
+    -- Masks are the union of both directions of every listed pair.
+    local pairs_set = {}
+    for name, list in pairs(layers) do
+        pairs_set[name] = pairs_set[name] or {}
+        for _, other in ipairs(list) do
+            pairs_set[other] = pairs_set[other] or {}
+            pairs_set[name][other] = true
+            pairs_set[other][name] = true
+        end
+    end
+    local masks = {}
+    for _, name in ipairs(names) do
+        local mask = 0
+        for other, _ in pairs(pairs_set[name]) do
+            mask = mask + categories[other]
+        end
+        masks[name] = mask
+    end
+
+    local matrix = { names = names, categories = categories, masks = masks }
+    return setmetatable(matrix, Matrix)
+end
+
+--- Return the category and mask bits for fixtures on |layer|, or on the
+-- default layer if |layer| is nil.
+function Matrix:Filter(layer)
+    layer = layer or 'default'
+    local category = self.categories[layer]
+    assert(category, 'unknown collision layer: ' .. tostring(layer))
+    return category, self.masks[layer]
+end
+
+--- Return true if fixtures on |layer1| and |layer2| collide, as Box2D's
+-- default contact filter decides from the bits.
+function Matrix:ShouldCollide(layer1, layer2)
+    local category1, mask1 = self:Filter(layer1)
+    local category2, mask2 = self:Filter(layer2)
+    -- Lua 5.1 has no bit operators.
+    local function HasBit(mask, bit)
+        return math.floor(mask / bit) % 2 == 1
+    end
+    return HasBit(mask1, category2) and HasBit(mask2, category1)
+end
+
+return collision
@@ -12,6 +12,9 @@ local editor = require 'editor'
 
 local handlers = {}
 
+-- Set by StartGame
+local background_color
+
 
 -- Horizontally center a node within a layer at a given height.
 local function Center(node, height)
@@ -128,7 +131,13 @@ function handlers.StartGame()
     local menu = gui.CreateMenu(menu_def)
     layer:addChild(menu)
 
-    director:runWithScene(scene)
+    if director:getRunningScene() then
+        -- Another game was running: replace all of its scenes.
+        director:popToRootScene()
+        director:replaceScene(scene)
+    else
+        director:runWithScene(scene)
+    end
 end
 
 return handlers
@@ -7,14 +7,17 @@
 -- functions:
 --   - SetBrush
 --   - CreateShape
+--   - CreatePrefabInstance
 --   - CreateSprite
 --   - DrawStartPoint
 --   - DrawEndPoint
 --   - AddLineToShape
+--   - SetPrediction
 --   - OnTouchBegan
 --   - OnTouchMoved
 --   - OnTouchEnded
 
+local stroke_predictor = require 'stroke_predictor'
 local util = require 'util'
 
 local drawing = {
@@ -31,10 +34,6 @@ drawing.mode = drawing.MODE_FREEHAND
 local brush_tex
 local brush_thickness
 
--- Constant for grouping physics bodies
-local MAIN_CATEGORY = 0x1
-local DRAWING_CATEGORY = 0x2
-
 -- Constants for tagging cocos nodes
 local TAG_BATCH_NODE = 0x1
 
@@ -50,6 +49,11 @@ local start_pos = nil
 local last_pos = nil
 local brush_color = ccc3(255, 100, 100)
 
+-- Predicted tail of the freehand stroke being drawn (see UpdateTail)
+local predictor = stroke_predictor.New()
+local tail_node = nil
+local tail_sprites = {}
+
 -- Callbacks that are registered for drawn objects.  The game
 -- can register its own callbacks here to add behavior for
 -- drawn objects.
@@ -86,14 +90,26 @@ local function CreatePivot(anchor, body)
     local joint = level_obj.world:CreateJoint(joint_def)
 end
 
-local function AddShapeToBody(body, shape, sensor)
+local function MakeFixtureDef(shape, sensor)
     local fixture_def = b2FixtureDef:new_local()
     fixture_def.shape = shape
     fixture_def.density = 1.0
     fixture_def.friction = 0.5
     fixture_def.restitution = 0.3
     fixture_def.isSensor = sensor
-    return body:CreateFixture(fixture_def)
+    return fixture_def
+end
+
+--- Put a fixture on the given collision layer of the current level
+-- (see collision.lua); nil means the default layer.
+local function SetLayer(fixture, layer)
+    local filter = fixture:GetFilterData()
+    filter.categoryBits, filter.maskBits = level_obj.collision:Filter(layer)
+    fixture:SetFilterData(filter)
+end
+
+local function AddShapeToBody(body, shape, sensor)
+    return body:CreateFixture(MakeFixtureDef(shape, sensor))
 end
 
 local function InitPhysicsNode(node, location, dynamic, tag)
@@ -175,20 +191,12 @@ local function AddLineToShape(node, from, to, color, absolute)
     return fixture
 end
 
--- Set the collision group for a fixture
-local function SetCategory(fixture, category)
-    local filter = fixture:GetFilterData()
-    filter.categoryBits = category
-    filter.maskBits = category
-    fixture:SetFilterData(filter)
-end
-
---- Make the a body dynamic and put it in the default collision group
+--- Make the a body dynamic and move it to the layer of finished strokes
 local function MakeBodyDynamic(body)
     body:SetType(b2_dynamicBody)
     local fixture = body:GetFixtureList()
     while fixture do
-        SetCategory(fixture, MAIN_CATEGORY)
+        SetLayer(fixture, 'stroke')
         fixture = fixture:GetNext()
     end
 end
@@ -202,6 +210,11 @@ function drawing.SetBrush(brush)
     brush_step = brush_thickness * 1.5
 end
 
+--- Distance between the brush sprites that make up a line.
+function drawing.GetBrushStep()
+    return brush_step
+end
+
 --- Create a physics sprite at a given location with a given image
 local function AddSpriteToShape(node, sprite_def, absolute)
     local pos = util.PointFromLua(sprite_def.pos, absolute)
@@ -220,26 +233,29 @@ local function AddSpriteToShape(node, sprite_def, absolute)
     end
     sprite:setPosition(rel_pos)
     node:addChild(sprite)
-    AddSphereToBody(node:getB2Body(), world_pos, sprite:boundingBox().size.height/2, sprite_def.sensor)
-    return sprite
+    return AddSphereToBody(node:getB2Body(), world_pos, sprite:boundingBox().size.height/2, sprite_def.sensor)
 end
 
-local function AddChildShape(shape, child_def, absolute)
+--- Add a line or image to a shape.  Its fixture goes on the child's own
+-- collision layer or, failing that, on |layer|.
+local function AddChildShape(shape, child_def, absolute, layer)
     if child_def.color then
         color = ccc3(child_def.color[1], child_def.color[2], child_def.color[3])
     else
         color = ccc3(255, 255, 255)
     end
 
+    local fixture
     if child_def.type == 'line' then
         local start = util.PointFromLua(child_def.start, absolute)
         local finish = util.PointFromLua(child_def.finish, absolute)
-        AddLineToShape(shape, start, finish, color, absolute)
+        fixture = AddLineToShape(shape, start, finish, color, absolute)
     elseif child_def.type == 'image' then
-        AddSpriteToShape(shape, child_def, absolute)
+        fixture = AddSpriteToShape(shape, child_def, absolute)
     else
         assert(false, 'invalid shape type: ' .. shape_def.type)
     end
+    SetLayer(fixture, child_def.layer or layer)
 end
 
 --- Draw a shape described by a given shape def.
@@ -255,7 +271,7 @@ function drawing.CreateShape(shape_def)
         if shape_def.children then
             for _, child_def in ipairs(shape_def.children) do
                 child_def.tag = shape_def.tag
-                child = AddChildShape(shape, child_def, false)
+                AddChildShape(shape, child_def, false, shape_def.layer)
             end
         end
     elseif shape_def.type == 'line' then
@@ -271,7 +287,7 @@ function drawing.CreateShape(shape_def)
         local finish = b2VecFromLua(shape_def.finish)
         util.Log('Create edge from: ' .. util.VecToString(start) .. ' to: ' .. util.VecToString(finish))
         b2shape:Set(start, finish)
-        body:CreateFixture(b2shape, 0)
+        SetLayer(body:CreateFixture(b2shape, 0), shape_def.layer)
         return
     elseif shape_def.type == 'image' then
         local pos = util.PointFromLua(shape_def.pos)
@@ -290,6 +306,87 @@ function drawing.CreateShape(shape_def)
     return shape
 end
 
+local function ColorFromLua(color)
+    return ccc3(color[1], color[2], color[3])
+end
+
+--- Create the Box2D fixture definitions and sprite colors for prefab
+-- geometry (see prefab.lua).  They are stored in the geometry and shared
+-- by all instances: CreateFixture copies the shape into each body.
+local function BuildPrefabFixtures(geometry)
+    local fixtures = {}
+    local white = ccc3(255, 255, 255)
+    for _, line in ipairs(geometry.lines) do
+        local center = b2Vec2:new_local(util.ScreenToWorld(line.center[1]),
+                                        util.ScreenToWorld(line.center[2]))
+        local shape = b2PolygonShape:new_local()
+        shape:SetAsBox(util.ScreenToWorld(line.half_length),
+                       util.ScreenToWorld(brush_thickness), center, line.angle)
+        -- Keep the shape alive for as long as the def points at it.
+        table.insert(fixtures, { shape = shape, def = MakeFixtureDef(shape, false),
+                                 layer = line.layer })
+        line.cc_color = line.color and ColorFromLua(line.color) or white
+    end
+    local texture_cache = CCTextureCache:sharedTextureCache()
+    for _, image in ipairs(geometry.images) do
+        image.filename = game_obj.assets[image.image]
+        local size = texture_cache:addImage(image.filename):getContentSize()
+        local sphere = b2CircleShape:new_local()
+        sphere.m_radius = util.ScreenToWorld(size.height / 2 * geometry.scale)
+        sphere.m_p.x = util.ScreenToWorld(image.pos[1])
+        sphere.m_p.y = util.ScreenToWorld(image.pos[2])
+        table.insert(fixtures, { shape = sphere, def = MakeFixtureDef(sphere, image.sensor),
+                                 layer = image.layer })
+    end
+    geometry.fixtures = fixtures
+end
+
+--- Place an instance of a prefab.  |instance_def| is a resolved shapes
+-- entry and |geometry| the prefab's shared geometry, both from the
+-- level's prefab library.
+function drawing.CreatePrefabInstance(instance_def, geometry)
+    if not geometry.fixtures then
+        BuildPrefabFixtures(geometry)
+    end
+
+    local pos = util.PointFromLua(instance_def.pos)
+    local shape = CreatePhysicsNode(pos, instance_def.dynamic, instance_def.tag)
+    local body = shape:getB2Body()
+    local collision = level_obj.collision
+    for _, fixture in ipairs(geometry.fixtures) do
+        -- The defs are shared, so set the filter for this instance.
+        local filter = fixture.def.filter
+        filter.categoryBits, filter.maskBits = collision:Filter(fixture.layer or instance_def.layer)
+        body:CreateFixture(fixture.def)
+    end
+    if instance_def.rotation then
+        shape:setRotation(instance_def.rotation)
+    end
+
+    if #geometry.lines > 0 then
+        local batch_node = CreateBrushBatch(shape)
+        local color = instance_def.color and ColorFromLua(instance_def.color)
+        for _, line in ipairs(geometry.lines) do
+            for _, point in ipairs(line.sprites) do
+                DrawBrush(batch_node, ccp(point[1], point[2]), color or line.cc_color)
+            end
+        end
+    end
+
+    for _, image in ipairs(geometry.images) do
+        local sprite = CCSprite:create(image.filename)
+        sprite:setPosition(ccp(image.pos[1], image.pos[2]))
+        sprite:setScale(geometry.scale)
+        shape:addChild(sprite)
+    end
+
+    if instance_def.anchor then
+        CreatePivot(util.PointFromLua(instance_def.anchor), body)
+    end
+
+    return shape
+end
+
 --- Create a single circlular point with the brush.
 -- This is used to start shapes that the user draws.  The returned
 -- node is the an invisible node that acts as the physics objects.
@@ -306,7 +403,7 @@ function drawing.DrawStartPoint(location, color, tag, dynamic)
 
     -- Add collision info
     local fixture = AddSphereToBody(node:getB2Body(), location, brush_thickness, false)
-    SetCategory(fixture, DRAWING_CATEGORY)
+    SetLayer(fixture, 'drawing')
 
     return node
 end
@@ -333,7 +430,7 @@ function drawing.DrawCircle(center, radius, color, tag)
 
     -- Create the box2d physics body to match the sphere.
     local fixture = AddSphereToBody(node:getB2Body(), center, radius, false)
-    SetCategory(fixture, DRAWING_CATEGORY)
+    SetLayer(fixture, 'drawing')
     return node
 end
 
@@ -347,12 +444,67 @@ function drawing.DrawEndPoint(node, location, color)
     -- Add collision info
     local body = node:getB2Body()
     local fixture = AddSphereToBody(body, location, brush_thickness, false)
-    SetCategory(fixture, DRAWING_CATEGORY)
+    SetLayer(fixture, 'drawing')
 end
 
 function drawing.AddLineToShape(sprite, from, to, color)
     fixture = AddLineToShape(sprite, from, to, color, true)
-    SetCategory(fixture, DRAWING_CATEGORY)
+    SetLayer(fixture, 'drawing')
+end
+
+--- Change the stroke prediction settings (see stroke_predictor.lua).
+-- nil restores the defaults.
+function drawing.SetPrediction(settings)
+    predictor:Configure(settings)
+end
+
+--- Draw the predicted tail of the freehand stroke in |node|: brush
+-- sprites from the end of its last segment, through the touch at |pos|,
+-- to where the touch is predicted to go.  The tail has no fixtures, and
+-- its sprites are reused from one move to the next.
+local function UpdateTail(node, pos)
+    local count = 0
+    local function DrawTailLine(from, to)
+        local dist_x = to.x - from.x
+        local dist_y = to.y - from.y
+        local num_sprites = math.ceil(ccpDistance(from, to) / brush_step)
+        for i = 1, num_sprites do
+            count = count + 1
+            local sprite = tail_sprites[count]
+            if not sprite then
+                sprite = CCSprite:createWithTexture(brush_tex)
+                tail_node:addChild(sprite)
+                tail_sprites[count] = sprite
+            end
+            local location = ccp(from.x + dist_x * i / num_sprites,
+                                 from.y + dist_y * i / num_sprites)
+            sprite:setPosition(node:convertToNodeSpace(location))
+            sprite:setColor(brush_color)
+            sprite:setOpacity(predictor.opacity)
+            sprite:setVisible(true)
+        end
+    end
+
+    local predicted_x, predicted_y = predictor:Predict()
+    if predicted_x then
+        if not tail_node then
+            tail_node = CCSpriteBatchNode:createWithTexture(brush_tex, DEFAULT_BATCH_COUNT)
+            node:addChild(tail_node, 1)
+        end
+        DrawTailLine(last_pos, pos)
+        DrawTailLine(pos, ccp(predicted_x, predicted_y))
+    end
+    for i = count + 1, #tail_sprites do
+        tail_sprites[i]:setVisible(false)
+    end
+end
+
+local function RemoveTail()
+    if tail_node then
+        tail_node:removeFromParentAndCleanup(true)
+    end
+    tail_node = nil
+    tail_sprites = {}
 end
 
 function drawing.IsDrawing()
@@ -382,6 +534,8 @@ function drawing.OnTouchBegan(x, y)
     }
 
     if drawing.mode == drawing.MODE_FREEHAND or drawing.mode == drawing.MODE_LINE then
+        predictor:Reset()
+        predictor:AddSample(x, y, CCTime:getTime())
         -- create initial sphere to represent start of shape
         shape.node = drawing.DrawStartPoint(start_pos, brush_color, current_tag)
     elseif drawing.mode == drawing.MODE_CIRCLE then
@@ -412,11 +566,13 @@ function drawing.OnTouchMoved(x, y)
     new_pos = ccp(x, y)
     if drawing.mode == drawing.MODE_FREEHAND then
         -- Draw line segments as the touch moves
+        predictor:AddSample(x, y, CCTime:getTime())
         local length = ccpDistance(new_pos, last_pos);
         if length > brush_thickness * 2 then
             drawing.AddLineToShape(current_shape.node, last_pos, new_pos, brush_color)
             last_pos = new_pos
         end
+        UpdateTail(current_shape.node, new_pos)
     elseif drawing.mode == drawing.MODE_LINE then
         local tag = current_shape.node:getTag()
         drawing.DestroySprite(current_shape.node)
@@ -439,6 +595,7 @@ function drawing.OnTouchEnded(x, y)
     -- Draw the final line segment and the end point of the line
 
     if drawing.mode == drawing.MODE_FREEHAND then
+        RemoveTail()
         new_pos = ccp(x, y)
         local length = ccpDistance(new_pos, last_pos);
         if length > brush_thickness then
@@ -25,7 +25,8 @@ local function Set(list)
 end
 
 local function SerializeLevel()
-    local ignore_keys = Set({ 'tag', 'script', 'tag_map', 'tag_list', 'object_map' })
+    local ignore_keys = Set({ 'tag', 'script', 'tag_map', 'tag_list', 'object_map',
+                              'prefab_library' })
     local key_map = { tag_str = 'tag', script_name = 'script' }
     local output = util.TableToYaml(level_obj, ignore_keys, key_map)
     return '# Automatically generated by editor.lua\n\n' .. output
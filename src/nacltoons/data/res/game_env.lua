@@ -0,0 +1,100 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+--- Per-game script environments.
+--
+-- Every script belonging to a game (game.script, object and level scripts
+-- and the modules they require from the game folder) runs in an
+-- environment table created for that game.  Globals the scripts define
+-- land in that table, and reads fall through to the real globals, so the
+-- engine and the C++ bindings stay visible.
+--
+-- Engine modules required by a game are wrapped in a per-game view: reads
+-- go to the shared module, but assigning to a field (for example to
+-- override drawing.RemoveShape) only changes the game's view.  Tables
+-- nested inside a module are not wrapped and are still shared.
+--
+-- Nothing outside the environment refers to it, so dropping the last
+-- reference (see loader.lua) is all it takes to unload a game; the garbage
+-- collector reclaims everything it loaded during its following cycles.
+-- Worker states are started afresh for each game by workers.SetPath().
+-- This is isolation between well-behaved games, not a sandbox: a script
+-- can still reach the shared state through rawget, getfenv or the
+-- engine's own tables.
+
+local path = require 'path'
+
+local game_env = {}
+
+--- Return a per-game view of engine module |module|.  Fields assigned
+-- through the view are stored in the view itself.
+local function NewView(module)
+    return setmetatable({}, { __index = module })
+end
+
+local function FileExists(filename)
+    local f = io.open(filename)
+    if not f then
+        return false
+    end
+    f:close()
+    return true
+end
+
+--- Load |filename| and run it with |env| as its globals.
+-- @return whatever the script returns.
+function game_env.DoFile(env, filename)
+    local chunk = assert(loadfile(filename))
+    setfenv(chunk, env)
+    return chunk()
+end
+
+--- Create the environment for the game whose files are in |root_dir|.
+function game_env.New(root_dir)
+    local env = setmetatable({}, { __index = _G })
+    env._G = env
+
+    -- Modules loaded from the game folder, and views of engine modules.
+    local loaded = {}
+    local views = {}
+    local loading = {}
+
+    --- require() for game scripts.  Modules in the game folder take
+    -- precedence over engine modules of the same name.
+    function env.require(name)
+        if loaded[name] ~= nil then
+            return loaded[name]
+        end
+        local filename = path.join(root_dir, string.gsub(name, '%.', '/') .. '.lua')
+        if FileExists(filename) then
+            assert(not loading[name], 'loop requiring game module: ' .. name)
+            loading[name] = true
+            local result = game_env.DoFile(env, filename)
+            loading[name] = nil
+            if result == nil then
+                result = true
+            end
+            loaded[name] = result
+            return result
+        end
+
+        if views[name] == nil then
+            local module = require(name)
+            if type(module) == 'table' then
+                views[name] = NewView(module)
+            else
+                views[name] = module
+            end
+        end
+        return views[name]
+    end
+
+    function env.dofile(filename)
+        return game_env.DoFile(env, filename)
+    end
+
+    return env
+end
+
+return game_env
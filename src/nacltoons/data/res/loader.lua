@@ -8,14 +8,22 @@
 --  - LoadGame  (called my game_manager to load game.def)
 --  - LoadLevel  (called by level_layer to load a level)
 --
--- There are also 3 functions for which the game can define its own
+-- There are also 4 functions for which the game can define its own
 -- handlers:
 --  - OnContactBegan
 --  - OnContactEnded
+--  - OnBehaviourEvent
 --  - StartLevel
+--
+-- Game scripts run in an environment of their own (see game_env.lua),
+-- which is thrown away when another game is loaded.
 
+local behaviours = require 'behaviours'
+local collision = require 'collision'
 local drawing = require 'drawing'
+local game_env = require 'game_env'
 local path = require 'path'
+local prefab = require 'prefab'
 local touch_handler = require 'touch_handler'
 local util = require 'util'
 local validate = require 'validate'
@@ -30,6 +38,9 @@ game_obj = nil
 -- The currently loaded level (set by LoadLevel)
 level_obj = nil
 
+-- The environment the current game's scripts run in (set by LoadGame)
+local env = nil
+
 --- Load game def from the given filename.  This function loads
 -- the game.def file which is essentailly a dictionary and performs
 -- a bit of post-processing on it.
@@ -43,7 +54,7 @@ local function LoadGameDef(filename)
 
     if game.script then
         Log('loading game script: ' .. game.script)
-        game.script = dofile(path.join(game.root, game.script))
+        game.script = game_env.DoFile(env, path.join(game.root, game.script))
     end
 
     return game
@@ -78,24 +89,68 @@ local function LoadScript(obj_def)
     if obj_def.script and game_obj.game_mode ~= "edit" then
         Log('loading object script: ' .. obj_def.script)
         local script = path.join(game_obj.root, obj_def.script)
-        obj_def.script = dofile(script)
+        obj_def.script = game_env.DoFile(env, script)
         if obj_def.script and obj_def.script.Update then
             obj_def.node:scheduleUpdateWithPriorityLua(obj_def.script.Update, 0)
         end
     end
 end
 
+local function ApplyToAllChildren(node, callback)
+    callback(node)
+    local children = node:getChildren()
+    if children then
+        for i=0,children:count()-1 do
+            local child = children:objectAtIndex(i)
+            ApplyToAllChildren(child, callback)
+        end
+    end
+end
+
+--- Stop the updates scheduled on the current level, if any.
+local function StopLevel()
+    if level_obj and level_obj.layer then
+        local function unschedule(node)
+            node:unscheduleUpdate()
+        end
+        ApplyToAllChildren(level_obj.layer, unschedule)
+    end
+end
+
+--- Forget the currently loaded game, if any.  Everything its scripts
+-- created is reachable only from its environment and from game_obj and
+-- level_obj, so dropping these is enough; what the old scenes still
+-- hold is released when they are replaced.  No collection is forced
+-- here: the incremental collector reclaims the old game over the next
+-- frames rather than stalling the switch on a full pass over the heap.
+local function UnloadGame()
+    if not game_obj then
+        return
+    end
+    Log('unloading game: ' .. game_obj.filename)
+    StopLevel()
+    level_obj = nil
+    game_obj = nil
+    env = nil
+end
+
 --- Load game data from a given root directory.
 -- This game then becomes the currently running game.
 -- @param The root directory of the game to be loaded.
 function LoadGame(root_dir)
-   game_root = root_dir
-   game_obj = LoadGameDef(path.join(game_root, 'game.def'))
+   UnloadGame()
+   env = game_env.New(root_dir)
+   if workers then
+       -- Let game scripts hand work to workers.Run().
+       workers.SetPath(path.join(root_dir, '?.lua'))
+   end
+   game_obj = LoadGameDef(path.join(root_dir, 'game.def'))
+   drawing.SetPrediction(game_obj.stroke_prediction)
    game_obj.origin = CCDirector:sharedDirector():getVisibleOrigin()
    local default_game
 
    if not game_obj.script or not game_obj.script.StartGame then
-       default_game = dofile('default_game.lua')
+       default_game = game_env.DoFile(env, 'default_game.lua')
    end
 
    if not game_obj.script then
@@ -148,6 +203,8 @@ function LoadLevel(layer, level_number)
     LevelInit()
     level_obj.layer = layer
     level_obj.world = layer:GetWorld()
+    level_obj.collision = collision.NewMatrix(game_obj.collision_layers,
+                                              level_obj.collision_layers)
 
     local assets = game_obj.assets
 
@@ -169,11 +226,28 @@ function LoadLevel(layer, level_number)
         layer:addChild(sprite)
     end
 
+    -- Prefab geometry is computed on first use and shared by all
+    -- instances in the level.
+    level_obj.prefab_library = prefab.NewLibrary(game_obj.prefabs,
+                                                 level_obj.prefabs,
+                                                 drawing.GetBrushStep())
+
     -- Load shapes
+    local with_behaviours = {}
     local function LoadShapes(shapes)
         for _, shape_def in ipairs(shapes) do
+            if shape_def.behaviours then
+                table.insert(with_behaviours, shape_def)
+            end
             if #shape_def > 0 then
                 LoadShapes(shape_def)
+            elseif shape_def.prefab then
+                local library = level_obj.prefab_library
+                library:Resolve(shape_def)
+                RegisterObjectDef(shape_def)
+                shape_def.node = drawing.CreatePrefabInstance(shape_def,
+                                                              library:Geometry(shape_def))
+                LoadScript(shape_def)
             else
                 RegisterObjectDef(shape_def)
                 shape_def.node = drawing.CreateShape(shape_def)
@@ -186,6 +260,15 @@ function LoadLevel(layer, level_number)
         LoadShapes(level_obj.shapes)
     end
 
+    -- Attach native behaviours once every tag is known.  Like object
+    -- scripts they do not run in the editor.
+    if game_obj.game_mode ~= "edit" then
+        local manager = layer:GetBehaviours()
+        for _, shape_def in ipairs(with_behaviours) do
+            behaviours.Attach(manager, shape_def, level_obj.tag_map, game_obj.assets)
+        end
+    end
+
     -- Load custom level script
     level_obj.node = level_obj.layer
     LoadScript(level_obj)
@@ -198,17 +281,6 @@ function LoadLevel(layer, level_number)
     StartLevel(level_number)
 end
 
-local function ApplyToAllChildren(node, callback)
-    callback(node)
-    local children = node:getChildren()
-    if children then
-        for i=0,children:count()-1 do
-            child = children:objectAtIndex(i)
-            ApplyToAllChildren(child, callback)
-        end
-    end
-end
-
 function LevelComplete()
     level_obj.layer:unscheduleUpdate()
     level_obj.layer:LevelComplete()
@@ -255,6 +327,35 @@ function OnContactEnded(tag1, tag2)
     CallCollisionHandler(tag1, tag2, 'OnContactEnded')
 end
 
+--- Called by the native behaviours (see behaviours.lua) when something
+-- happens to an object.  A 'goal' event completes the level once the
+-- handlers have run.
+function OnBehaviourEvent(tag, event, value)
+    -- The level may already be over.
+    if level_obj == nil then
+        return
+    end
+    local object = level_obj.object_map[tag]
+    if object == nil then
+        return
+    end
+
+    if object.script and object.script.OnBehaviourEvent then
+        object.script.OnBehaviourEvent(object, event, value)
+    end
+    if level_obj.script and level_obj.script.OnBehaviourEvent then
+        level_obj.script.OnBehaviourEvent(object, event, value)
+    end
+    if game_obj.script.OnBehaviourEvent then
+        game_obj.script.OnBehaviourEvent(object, event, value)
+    end
+
+    -- A handler may have ended the level itself.
+    if event == 'goal' and level_obj then
+        LevelComplete()
+    end
+end
+
 function StartLevel(level_number)
     -- only call handlers if the objects in question have tags
     -- that are known to the currently running level
@@ -0,0 +1,128 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+-- Prefabs are compound shapes defined once, in a 'prefabs' section of
+-- game.def or level.def, and placed any number of times from a level's
+-- 'shapes' list:
+--
+--   prefabs:
+--     box: { type: compound, children: [ { type: line, ... }, ... ] }
+--   shapes:
+--     - { prefab: box, pos: [ 500, 200 ], rotation: 45, tag: BOX1 }
+--
+-- An instance is placed at 'pos', rotated by 'rotation' degrees
+-- (clockwise, like cocos nodes) and scaled by 'scale'.  'dynamic',
+-- 'script', 'color' and 'layer' default to the prefab's values; 'tag',
+-- 'anchor' and 'behaviours' belong to the instance alone.  A 'color'
+-- recolours all of the prefab's lines.  Children may have a collision
+-- 'layer' of their own (see collision.lua).
+--
+-- The geometry of a prefab (line fixtures, brush sprite positions and
+-- image placements, all relative to the prefab's origin) is worked out
+-- once per scale and shared by every instance.  This module only does the
+-- arithmetic; drawing.CreatePrefabInstance turns the result into nodes
+-- and bodies.
+
+local prefab = {}
+
+-- Keys a prefab definition may have.
+prefab.DEF_KEYS = { 'type', 'children', 'dynamic', 'script', 'color', 'layer' }
+
+-- Keys an instance may have.
+prefab.INSTANCE_KEYS = { 'prefab', 'pos', 'rotation', 'scale', 'tag',
+                         'dynamic', 'script', 'color', 'layer', 'anchor',
+                         'behaviours' }
+
+-- Instance keys that default to the prefab's value.
+local INHERITED_KEYS = { 'dynamic', 'script', 'color', 'layer' }
+
+local Library = {}
+Library.__index = Library
+
+--- Create the prefab library of a level.  Level prefabs hide game
+-- prefabs of the same name.
+-- @param game_prefabs the 'prefabs' table of game.def (may be nil)
+-- @param level_prefabs the 'prefabs' table of level.def (may be nil)
+-- @param brush_step distance between brush sprites along a line
+function prefab.NewLibrary(game_prefabs, level_prefabs, brush_step)
+    local defs = {}
+    for name, def in pairs(game_prefabs or {}) do
+        defs[name] = def
+    end
+    for name, def in pairs(level_prefabs or {}) do
+        defs[name] = def
+    end
+    local library = { defs = defs, compiled = {}, brush_step = brush_step }
+    return setmetatable(library, Library)
+end
+
+--- Fill in the keys an instance inherits from its prefab.
+function Library:Resolve(instance)
+    local def = self.defs[instance.prefab]
+    assert(def, 'unknown prefab: ' .. tostring(instance.prefab))
+    for _, key in ipairs(INHERITED_KEYS) do
+        if instance[key] == nil then
+            instance[key] = def[key]
+        end
+    end
+    return instance
+end
+
+--- Return the shared geometry for an instance, computing it the first
+-- time a prefab is used at a given scale.
+function Library:Geometry(instance)
+    local scale = instance.scale or 1
+    local key = instance.prefab .. '@' .. scale
+    local geometry = self.compiled[key]
+    if not geometry then
+        local def = self.defs[instance.prefab]
+        assert(def, 'unknown prefab: ' .. tostring(instance.prefab))
+        geometry = prefab.Compile(def, scale, self.brush_step)
+        self.compiled[key] = geometry
+    end
+    return geometry
+end
+
+--- Work out the geometry of a prefab definition at the given scale.
+-- Lines get the centre, half length and angle of their box fixture and
+-- the positions of their brush sprites, spaced as drawing.lua spaces them
+-- for ordinary lines.  Images keep their name, position and sensor flag.
+-- Both keep their collision layer, if any.
+function prefab.Compile(def, scale, brush_step)
+    local geometry = { scale = scale, lines = {}, images = {} }
+    for _, child in ipairs(def.children or {}) do
+        if child.type == 'line' then
+            local x1 = child.start[1] * scale
+            local y1 = child.start[2] * scale
+            local dx = child.finish[1] * scale - x1
+            local dy = child.finish[2] * scale - y1
+            local length = math.sqrt(dx * dx + dy * dy)
+            local count = math.ceil(length / brush_step)
+            local sprites = {}
+            for i = 1, count do
+                sprites[i] = { x1 + dx * i / count, y1 + dy * i / count }
+            end
+            table.insert(geometry.lines, {
+                center = { x1 + dx / 2, y1 + dy / 2 },
+                half_length = length / 2,
+                angle = math.atan2(dy, dx),
+                color = child.color,
+                layer = child.layer,
+                sprites = sprites,
+            })
+        elseif child.type == 'image' then
+            table.insert(geometry.images, {
+                image = child.image,
+                pos = { child.pos[1] * scale, child.pos[2] * scale },
+                sensor = child.sensor,
+                layer = child.layer,
+            })
+        else
+            error('invalid prefab child type: ' .. tostring(child.type))
+        end
+    end
+    return geometry
+end
+
+return prefab
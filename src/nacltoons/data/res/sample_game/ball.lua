@@ -9,6 +9,7 @@
 --   OnTouchEnded(self, x, y)
 --   OnContactBegan(self, other)
 --   OnContactEnded(self, other)
+--   OnBehaviourEvent(self, event, value)
 --
 -- As well as arguments recieved this script has access
 -- to global game variables:
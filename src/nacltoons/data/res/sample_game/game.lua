@@ -8,8 +8,11 @@
 --   OnTouchEnded(x, y)
 --   OnContactBegan
 --   OnContactEnded
+--   OnBehaviourEvent
 --
--- This file should not alter to global namespace.
+-- This file should not alter to global namespace.  Globals it does
+-- define, and changes it makes to engine modules such as drawing, only
+-- affect this game (see game_env.lua).
 --
 -- As well as arguments recieved this script has access
 -- to the global game variables:
@@ -88,16 +91,10 @@ function handlers.StartLevel(level_number)
 
     -- Initialize game state
     level_obj.game_state = {
-        goal_reached = false,
         time_remaining = 30,
-        stars_collected = { },
+        stars_collected = 0,
     }
 
-    -- Lookup some tags that are used later in the collution code.
-    level_obj.ball_tag = level_obj.tag_map['BALL']
-    level_obj.goal_tag = level_obj.tag_map['GOAL']
-    level_obj.star_tag = level_obj.tag_map['STAR1']
-
     -- Create a textual menu as a sibling of the LevelLayer
     menu_def = {
         font_size = 24,
@@ -180,53 +177,18 @@ function handlers.OnTouchEnded(x, y)
     last_drawn_shape = drawing.OnTouchEnded(x, y)
 end
 
---- Called when two tagged objects start colliding (in the box2d world).
+--- Called by the native behaviours attached in the level.def files.
 --
--- In this game we check for collisions between the 'BALL' and the
--- 'STAR's that can be collects as well as the 'GOAL'.  Objects
--- are identified using tags.  The numeric tag values are looked up
--- and cached when the level first starts.
-function handlers.OnContactBegan(object1, object2)
-    -- util.Log('game.lua: OnContactBegan')
-
-    -- We are only interested in collisions involving the ball
-    if object1.tag == level_obj.ball_tag then
-        other = object2
-    elseif object2.tag == level_obj.ball_tag then
-        other = object1
-    else
-        return
-    end
-
-    local state = level_obj.game_state
-    for i=1,level_obj.num_stars do
-        local star_tag = level_obj.star_tag + i - 1
-        if other.tag == star_tag then
-            if state.stars_collected[i] ~= true then
-                util.Log('star ' .. i .. ' reached')
-                state.stars_collected[i] = true
-                local star = level_obj.layer:getChildByTag(star_tag)
-                local action = CCFadeOut:create(0.5)
-                star:runAction(action);
-            end
-        end
-    end
-
-    if state.goal_reached ~= true then
-        if other.tag == level_obj.goal_tag then
-            util.Log('goal reached')
-            state.goal_reached = true
-
-            local function GoalFadeoutComplete(sender)
-                LevelComplete()
-            end
-
-            local goal = level_obj.layer:getChildByTag(level_obj.goal_tag)
-            local fadeout = CCFadeOut:create(0.5)
-            local fadeout_done = CCCallFuncN:create(GoalFadeoutComplete)
-            local seq = CCSequence:createWithTwoActions(fadeout, fadeout_done);
-            goal:runAction(seq);
-        end
+-- Stars are 'collectible' behaviours and the goal is a 'goal' behaviour
+-- that only the 'BALL' triggers; the fading and level completion happen
+-- natively, so all that is left to do here is keep score.
+function handlers.OnBehaviourEvent(object, event, value)
+    if event == 'collected' then
+        util.Log('star ' .. object.tag_str .. ' reached')
+        level_obj.game_state.stars_collected = value
+    elseif event == 'goal' then
+        util.Log('goal reached with ' .. level_obj.game_state.stars_collected ..
+                 ' star(s)')
     end
 end
 
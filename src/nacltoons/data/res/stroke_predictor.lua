@@ -0,0 +1,122 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+--- Touch position prediction for strokes.
+--
+-- A stroke only grows once the touch has moved far enough for a new
+-- segment, and segments show up a frame or more after the touch that
+-- made them.  drawing.lua hides some of that by drawing a tail of brush
+-- sprites, with no physics, out to where the touch is expected to be
+-- |lookahead| seconds from now.  The tail is redrawn on every move, so the
+-- real segments replace it as they are committed.
+--
+-- The velocity is taken over the samples from the last |window| seconds,
+-- and the prediction is never further than |max_distance| points from
+-- the last sample.  Settings can be given in game.def:
+--
+--   stroke_prediction: { lookahead: 0.05, max_distance: 30 }
+--
+-- and 'enabled: false' turns the tail off.
+
+local stroke_predictor = {}
+
+stroke_predictor.DEFAULTS = {
+    enabled = true,
+    -- Seconds to predict ahead; about two frames at 60fps.
+    lookahead = 0.033,
+    -- Seconds of samples to take the velocity from.
+    window = 0.05,
+    -- Longest prediction, in points.
+    max_distance = 40,
+    -- Opacity of the tail sprites (0-255).
+    opacity = 160,
+}
+
+-- Samples kept, whatever the window.
+local MAX_SAMPLES = 8
+
+--- Return an error message if a 'stroke_prediction' table is invalid, or
+-- nil.
+function stroke_predictor.Check(settings)
+    if type(settings) ~= 'table' then
+        return 'stroke_prediction must be a table'
+    end
+    for key, value in pairs(settings) do
+        local default = stroke_predictor.DEFAULTS[key]
+        if default == nil then
+            return 'invalid key in stroke_prediction: ' .. tostring(key)
+        end
+        if type(value) ~= type(default) then
+            return 'stroke_prediction.' .. key .. ' must be a ' .. type(default)
+        end
+    end
+end
+
+local Predictor = {}
+Predictor.__index = Predictor
+
+--- Create a predictor.  |settings| override DEFAULTS (may be nil).
+function stroke_predictor.New(settings)
+    local predictor = setmetatable({ samples = {} }, Predictor)
+    predictor:Configure(settings)
+    return predictor
+end
+
+--- Go back to the defaults, then apply |settings| (may be nil).
+function Predictor:Configure(settings)
+    for key, value in pairs(stroke_predictor.DEFAULTS) do
+        self[key] = value
+    end
+    for key, value in pairs(settings or {}) do
+        assert(stroke_predictor.DEFAULTS[key] ~= nil,
+               'invalid key in stroke_prediction: ' .. tostring(key))
+        self[key] = value
+    end
+end
+
+--- Forget the samples of the previous stroke.
+function Predictor:Reset()
+    self.samples = {}
+end
+
+--- Record the touch position at |time| seconds.
+function Predictor:AddSample(x, y, time)
+    local samples = self.samples
+    if #samples == MAX_SAMPLES then
+        table.remove(samples, 1)
+    end
+    table.insert(samples, { x, y, time })
+end
+
+--- Return the predicted touch position, or nil when prediction is off or
+-- the samples don't give a velocity.
+function Predictor:Predict()
+    local samples = self.samples
+    if not self.enabled or #samples < 2 then
+        return nil
+    end
+    local newest = samples[#samples]
+    local oldest = newest
+    for i = #samples - 1, 1, -1 do
+        if newest[3] - samples[i][3] > self.window then
+            break
+        end
+        oldest = samples[i]
+    end
+    local dt = newest[3] - oldest[3]
+    if dt <= 0 then
+        return nil
+    end
+
+    local dx = (newest[1] - oldest[1]) / dt * self.lookahead
+    local dy = (newest[2] - oldest[2]) / dt * self.lookahead
+    local distance = math.sqrt(dx * dx + dy * dy)
+    if distance > self.max_distance then
+        dx = dx * self.max_distance / distance
+        dy = dy * self.max_distance / distance
+    end
+    return newest[1] + dx, newest[2] + dy
+end
+
+return stroke_predictor
@@ -11,7 +11,11 @@
 -- It is possible to run this code a game.def file from the command line:
 -- $ ./lua.sh ./data/res/validate.lua data/res/sample_game/game.def
 
+local behaviours = require 'behaviours'
+local collision = require 'collision'
 local path = require 'path'
+local prefab = require 'prefab'
+local stroke_predictor = require 'stroke_predictor'
 local util = require 'util'
 local yaml = require 'yaml'
 
@@ -47,6 +51,53 @@ local function CheckRequiredKeys(filename, object, required_keys, name)
     end
 end
 
+--- Check the 'behaviours' list of a shape or prefab instance.
+local function ValidateBehaviours(filename, list)
+    if type(list) ~= 'table' then
+        return Error(filename, 'behaviours must be a list')
+    end
+    for _, def in ipairs(list) do
+        local message = behaviours.Check(def)
+        if message then
+            Error(filename, message)
+        end
+    end
+end
+
+--- Check the 'collision_layers' table of a game.def or level.def.
+local function ValidateCollisionLayers(filename, layers)
+    local message = collision.Check(layers)
+    if message then
+        Error(filename, message)
+    end
+end
+
+--- Check the 'prefabs' table of a game.def or level.def.
+local function ValidatePrefabs(filename, prefabs)
+    if type(prefabs) ~= 'table' then
+        return Error(filename, 'prefabs must be a table')
+    end
+    local child_keys = { 'type', 'start', 'finish', 'color', 'pos', 'image', 'sensor', 'layer' }
+    for name, def in pairs(prefabs) do
+        CheckValidKeys(filename, def, prefab.DEF_KEYS)
+        CheckRequiredKeys(filename, def, { 'type', 'children' }, 'prefab ' .. name)
+        if def.type ~= 'compound' then
+            Error(filename, 'prefab ' .. name .. ' must be of type compound')
+        end
+        for _, child in ipairs(def.children) do
+            CheckValidKeys(filename, child, child_keys)
+            CheckRequiredKeys(filename, child, { 'type' }, 'prefab ' .. name)
+            if child.type == 'line' then
+                CheckRequiredKeys(filename, child, { 'start', 'finish' }, 'prefab ' .. name)
+            elseif child.type == 'image' then
+                CheckRequiredKeys(filename, child, { 'pos', 'image' }, 'prefab ' .. name)
+            else
+                Error(filename, 'invalid prefab child type: ' .. tostring(child.type))
+            end
+        end
+    end
+end
+
 validate = {}
 
 --- Validate a game.def file.
@@ -62,7 +113,21 @@ validate.ValidateGameDef = function(filename, gamedef)
     end
 
 
-    CheckValidKeys(filename, gamedef, { 'assets', 'script', 'levels', 'root' })
+    CheckValidKeys(filename, gamedef, { 'assets', 'script', 'levels', 'root', 'prefabs',
+                                        'collision_layers', 'stroke_prediction' })
+    if gamedef.prefabs then
+        ValidatePrefabs(filename, gamedef.prefabs)
+    end
+    if gamedef.collision_layers then
+        ValidateCollisionLayers(filename, gamedef.collision_layers)
+    end
+    if gamedef.stroke_prediction then
+        local message = stroke_predictor.Check(gamedef.stroke_prediction)
+        if message then
+            Err(message)
+        end
+    end
+
     if not gamedef.assets then
         return
     end
@@ -93,10 +158,38 @@ validate.ValidateLevelDef = function(filename, gamedef, leveldef)
         return Err("file does not evaluate to an object of type 'table'")
     end
 
-    CheckValidKeys(filename, leveldef, { 'num_stars', 'shapes', 'script' })
+    CheckValidKeys(filename, leveldef, { 'num_stars', 'shapes', 'script', 'prefabs',
+                                         'collision_layers' })
+    if leveldef.prefabs then
+        ValidatePrefabs(filename, leveldef.prefabs)
+    end
+    if leveldef.collision_layers then
+        ValidateCollisionLayers(filename, leveldef.collision_layers)
+    end
+
+    -- Every layer named in the level must exist once the game's and the
+    -- level's layers are merged.
+    local layers = collision.Merge(gamedef.collision_layers, leveldef.collision_layers)
+    local message = collision.CheckNames(layers)
+    if message then
+        Err(message)
+    end
+    local function CheckLayer(object)
+        if object.layer ~= nil and not layers[object.layer] then
+            Err('unknown collision layer: ' .. tostring(object.layer))
+        end
+    end
+    for _, prefabs in ipairs({ gamedef.prefabs or {}, leveldef.prefabs or {} }) do
+        for _, def in pairs(prefabs) do
+            CheckLayer(def)
+            for _, child in ipairs(def.children) do
+                CheckLayer(child)
+            end
+        end
+    end
 
     if leveldef.shapes then
-        local valid_keys = { 'script', 'pos', 'children', 'sensor', 'image', 'start', 'finish', 'color', 'type', 'anchor', 'tag', 'dynamic' }
+        local valid_keys = { 'script', 'pos', 'children', 'sensor', 'image', 'start', 'finish', 'color', 'type', 'anchor', 'tag', 'dynamic', 'behaviours', 'layer' }
         local valid_types = { 'compound', 'line', 'edge', 'image' }
         local required_keys = { 'type' }
 
@@ -104,13 +197,28 @@ validate.ValidateLevelDef = function(filename, gamedef, leveldef)
             for _, shape in pairs(shapes) do
                 if #shape > 0 then
                     ValidateShapeList(shape)
+                elseif shape.prefab then
+                    CheckValidKeys(filename, shape, prefab.INSTANCE_KEYS)
+                    CheckRequiredKeys(filename, shape, { 'pos' }, 'prefab instance')
+                    local known = (leveldef.prefabs and leveldef.prefabs[shape.prefab]) or
+                                  (gamedef.prefabs and gamedef.prefabs[shape.prefab])
+                    if not known then
+                        Err('unknown prefab: ' .. tostring(shape.prefab))
+                    end
                 else
                     CheckValidKeys(filename, shape, valid_keys)
                     CheckRequiredKeys(filename, shape, required_keys, 'shape')
                     if not ListContains(valid_types, shape.type) then
                         Err('invalid shape type: ' .. shape.type)
                     end
+                    for _, child in ipairs(shape.children or {}) do
+                        CheckLayer(child)
+                    end
+                end
+                if shape.behaviours then
+                    ValidateBehaviours(filename, shape.behaviours)
                 end
+                CheckLayer(shape)
             end
         end
 
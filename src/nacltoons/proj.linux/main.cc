@@ -3,19 +3,45 @@
 // found in the LICENSE file.
 
 #include "../src/app_delegate.h"
+#include "../src/metrics_server.h"
 #include "cocos2d.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <string>
+#include <X11/Xlib.h>
+#include <GL/glfw.h>
 
 USING_NS_CC;
 
+static bool WindowVisible()
+{
+    return !glfwGetWindowParam(GLFW_ICONIFIED);
+}
+
 int main(int argc, char **argv)
 {
     // create the application instance
     AppDelegate app;
+    int metrics_port = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--render-thread")) {
+            // The render thread makes GLX calls of its own.
+            XInitThreads();
+            app.set_render_mode(kRenderThreaded);
+        } else if (!strcmp(argv[i], "--record-draws")) {
+            app.set_render_mode(kRenderRecorded);
+        } else if (!strcmp(argv[i], "--partial-redraw")) {
+            app.set_render_mode(kRenderPartial);
+        } else if (!strncmp(argv[i], "--background-texture-budget=", 28)) {
+            app.set_background_texture_budget(atoi(argv[i] + 28));
+        } else if (!strncmp(argv[i], "--metrics-port=", 15)) {
+            metrics_port = atoi(argv[i] + 15);
+        }
+    }
 
     CCEGLView* eglView = CCEGLView::sharedOpenGLView();
     eglView->setFrameSize(700, 500);
@@ -25,5 +51,10 @@ int main(int argc, char **argv)
     strcat(respath, "/../../../data/res");
     CCFileUtils::sharedFileUtils()->addSearchPath(respath);
 
-    return CCApplication::sharedApplication()->run();
+    // Serve engine counters for soak tests (see metrics_server.h).
+    if (metrics_port)
+        MetricsServer::Start(metrics_port);
+
+    // Minimizing the window puts the game in the background.
+    return app.Run(WindowVisible);
 }
@@ -3,17 +3,56 @@
 // found in the LICENSE file.
 #include "app_delegate.h"
 
+#ifndef WIN32
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
 #include "CCLuaEngine.h"
+#include "SimpleAudioEngine.h"
 #include "LuaBox2D.h"
 #include "LuaCocos2dExtensions.h"
 #include "lua_level_layer.h"
 #include "game_manager.h"
+#ifndef WIN32
+#include "job_system.h"
+#include "lua_workers.h"
+#endif
 
 extern "C" {
 LUALIB_API int luaopen_yaml(lua_State *L);
 }
 
 USING_NS_CC;
+using CocosDenshion::SimpleAudioEngine;
+
+#ifndef WIN32
+/**
+ * Runs the job system's main thread continuations once per frame, before
+ * anything else is updated.
+ */
+class MainThreadJobRunner : public CCObject {
+ public:
+  virtual void update(float dt) {
+    JobSystem::sharedJobSystem()->RunMainThreadJobs();
+  }
+};
+#endif
+
+AppDelegate::AppDelegate()
+    : background_texture_budget_(-1),
+      in_background_(false),
+      paused_director_(false),
+      displayed_stats_(false),
+      hidden_scene_(NULL) {
+#ifndef WIN32
+  render_mode_ = kRenderDirect;
+#endif
+}
+
+AppDelegate::~AppDelegate() {
+  CC_SAFE_RELEASE(hidden_scene_);
+}
 
 bool AppDelegate::applicationDidFinishLaunching() {
   CCEGLView* view = CCEGLView::sharedOpenGLView();
@@ -29,6 +68,14 @@ bool AppDelegate::applicationDidFinishLaunching() {
 
   director->setDisplayStats(true);
 
+#ifndef WIN32
+  // Start the worker threads now rather than on first use.
+  JobSystem::sharedJobSystem();
+  director->getScheduler()->scheduleUpdateForTarget(new MainThreadJobRunner,
+                                                    kCCPrioritySystem, false);
+  RenderPipeline::Install(render_mode_);
+#endif
+
   // Create lua engine
   CCLuaEngine* engine = CCLuaEngine::defaultEngine();
   assert(engine);
@@ -49,12 +96,20 @@ bool AppDelegate::applicationDidFinishLaunching() {
   tolua_extensions_open(lua_state);
   // add yaml bindings
   luaopen_yaml(lua_state);
+#ifndef WIN32
+  // add worker lua states
+  luaopen_workers(lua_state);
+#endif
 
   CCFileUtils* utils = CCFileUtils::sharedFileUtils();
   std::string path = utils->fullPathForFilename("loader.lua");
+  std::string engine_dir = path.substr(0, path.find_last_of("/"));
 
   // add the location of the lua file to the search path
-  engine->addSearchPath(path.substr(0, path.find_last_of("/")).c_str());
+  engine->addSearchPath(engine_dir.c_str());
+#ifndef WIN32
+  LuaWorkerPool::sharedPool()->SetEngineDir(engine_dir);
+#endif
 
   // execute loader file
   int rtn = engine->executeScriptFile(path.c_str());
@@ -65,3 +120,107 @@ bool AppDelegate::applicationDidFinishLaunching() {
   GameManager::sharedManager()->LoadGame("sample_game");
   return true;
 }
+
+int CachedTextureBytes() {
+  CCDictionary* textures =
+      CCTextureCache::sharedTextureCache()->snapshotTextures();
+  int bytes = 0;
+  CCDictElement* element;
+  CCDICT_FOREACH(textures, element) {
+    CCTexture2D* texture = static_cast<CCTexture2D*>(element->getObject());
+    bytes += texture->getPixelsWide() * texture->getPixelsHigh() *
+             texture->bitsPerPixelForFormat() / 8;
+  }
+  return bytes;
+}
+
+void AppDelegate::applicationDidEnterBackground() {
+  if (in_background_)
+    return;
+  in_background_ = true;
+
+  // Pausing the director stops the scheduler, and with it physics, Lua
+  // updates and actions, and drops the frame rate to four a second.  If the
+  // game had paused it already, leave it to the game to resume.
+  CCDirector* director = CCDirector::sharedDirector();
+  paused_director_ = !director->isPaused();
+  if (paused_director_)
+    director->pause();
+
+  // Nothing is shown, so draw nothing.  The scene stays as it is, so
+  // coming back is immediate.
+  displayed_stats_ = director->isDisplayStats();
+  director->setDisplayStats(false);
+  hidden_scene_ = director->getRunningScene();
+  if (hidden_scene_ && hidden_scene_->isVisible()) {
+    hidden_scene_->retain();
+    hidden_scene_->setVisible(false);
+  } else {
+    hidden_scene_ = NULL;
+  }
+
+  SimpleAudioEngine* audio = SimpleAudioEngine::sharedEngine();
+  audio->pauseBackgroundMusic();
+  audio->pauseAllEffects();
+
+  if (background_texture_budget_ >= 0 &&
+      CachedTextureBytes() > background_texture_budget_) {
+    // Sprite frames hold on to their textures, so release them first.
+    CCSpriteFrameCache::sharedSpriteFrameCache()->removeUnusedSpriteFrames();
+    CCTextureCache::sharedTextureCache()->removeUnusedTextures();
+    CCLog("textures kept in background: %d bytes", CachedTextureBytes());
+  }
+}
+
+void AppDelegate::applicationWillEnterForeground() {
+  if (!in_background_)
+    return;
+  in_background_ = false;
+
+  SimpleAudioEngine* audio = SimpleAudioEngine::sharedEngine();
+  audio->resumeBackgroundMusic();
+  audio->resumeAllEffects();
+
+  CCDirector* director = CCDirector::sharedDirector();
+  if (hidden_scene_) {
+    hidden_scene_->setVisible(true);
+    hidden_scene_->release();
+    hidden_scene_ = NULL;
+  }
+  director->setDisplayStats(displayed_stats_);
+  // Restores the frame rate and starts the next frame with a zero delta,
+  // so physics does not try to catch up on the time spent away.
+  if (paused_director_)
+    director->resume();
+}
+
+#ifndef WIN32
+static long NowMilliseconds() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+int AppDelegate::Run(bool (*is_visible)()) {
+  if (!applicationDidFinishLaunching())
+    return 0;
+
+  CCDirector* director = CCDirector::sharedDirector();
+  for (;;) {
+    long start = NowMilliseconds();
+    director->mainLoop();
+
+    bool visible = is_visible();
+    if (!visible && !in_background_)
+      applicationDidEnterBackground();
+    else if (visible && in_background_)
+      applicationWillEnterForeground();
+
+    long interval = director->getAnimationInterval() * 1000;
+    long elapsed = NowMilliseconds() - start;
+    if (elapsed < interval)
+      usleep((interval - elapsed) * 1000);
+  }
+  return -1;
+}
+#endif
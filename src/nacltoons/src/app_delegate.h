@@ -5,17 +5,60 @@
 #define APP_DELEGATE_H_
 
 #include "cocos2d.h"
+#ifndef WIN32
+#include "render_pipeline.h"
+#endif
 
 /**
  * The cocos2d-x application entry point.
  */
 class AppDelegate : private cocos2d::CCApplication {
  public:
-  AppDelegate() {}
+  AppDelegate();
+  ~AppDelegate();
+
+#ifndef WIN32
+  // How frames are drawn (see render_pipeline.h).  Set before running.
+  void set_render_mode(RenderMode mode) { render_mode_ = mode; }
+#endif
+
+  // Texture memory to keep while in the background, in bytes.  If the
+  // texture cache holds more than this, textures and sprite frames that
+  // nothing is using are released on entering the background.  They are
+  // reloaded from disk if needed again.  Negative (the default) keeps
+  // everything.
+  void set_background_texture_budget(int bytes) {
+    background_texture_budget_ = bytes;
+  }
 
   virtual bool applicationDidFinishLaunching();
-  virtual void applicationDidEnterBackground() {}
-  virtual void applicationWillEnterForeground() {}
+
+  // Stop updating the game (scheduled updates, actions, physics and Lua),
+  // pause audio and draw nothing, at a few frames per second, until
+  // applicationWillEnterForeground().
+  virtual void applicationDidEnterBackground();
+  virtual void applicationWillEnterForeground();
+
+#ifndef WIN32
+  // Run the application as CCApplication::run() does, entering and leaving
+  // the background as |is_visible| changes.  It is polled once a frame.
+  int Run(bool (*is_visible)());
+#endif
+
+ private:
+#ifndef WIN32
+  RenderMode render_mode_;
+#endif
+  int background_texture_budget_;
+
+  bool in_background_;
+  // What entering the background changed.
+  bool paused_director_;
+  bool displayed_stats_;
+  cocos2d::CCScene* hidden_scene_;
 };
 
+// Bytes of texture memory held by the texture cache.
+int CachedTextureBytes();
+
 #endif  // APP_DELEGATE_H_
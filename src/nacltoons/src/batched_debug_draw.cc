@@ -0,0 +1,210 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+
+#include <algorithm>
+
+#include "batched_debug_draw.h"
+
+// Number of segments used to approximate a circle.
+static const int kCircleSegments = 16;
+
+// Length of the axes drawn by DrawTransform, in meters.
+static const float32 kAxisScale = 0.4f;
+
+// Converts a Box2D color to the premultiplied form Flush() blends with.
+static ccColor4B ToColor4B(const b2Color& color, float alpha) {
+  return ccc4((GLubyte)(color.r * alpha * 255),
+              (GLubyte)(color.g * alpha * 255),
+              (GLubyte)(color.b * alpha * 255),
+              (GLubyte)(alpha * 255));
+}
+
+BatchedDebugDraw::BatchedDebugDraw(float32 ratio)
+    : ratio_(ratio),
+      cull_(false),
+      vertex_buffer_(0),
+      buffer_size_(0),
+      program_(NULL) {
+}
+
+BatchedDebugDraw::~BatchedDebugDraw() {
+  if (vertex_buffer_)
+    glDeleteBuffers(1, &vertex_buffer_);
+}
+
+void BatchedDebugDraw::SetVisibleRect(const CCRect& rect) {
+  visible_.lowerBound.Set(rect.getMinX() / ratio_, rect.getMinY() / ratio_);
+  visible_.upperBound.Set(rect.getMaxX() / ratio_, rect.getMaxY() / ratio_);
+  cull_ = true;
+}
+
+bool BatchedDebugDraw::IsVisible(const b2Vec2& lower,
+                                 const b2Vec2& upper) const {
+  if (!cull_)
+    return true;
+  return lower.x <= visible_.upperBound.x && upper.x >= visible_.lowerBound.x &&
+         lower.y <= visible_.upperBound.y && upper.y >= visible_.lowerBound.y;
+}
+
+bool BatchedDebugDraw::IsVisible(const b2Vec2* vertices,
+                                 int32 vertex_count) const {
+  if (!cull_)
+    return true;
+  if (!vertex_count)
+    return false;
+  b2Vec2 lower = vertices[0];
+  b2Vec2 upper = vertices[0];
+  for (int32 i = 1; i < vertex_count; i++) {
+    lower = b2Min(lower, vertices[i]);
+    upper = b2Max(upper, vertices[i]);
+  }
+  return IsVisible(lower, upper);
+}
+
+void BatchedDebugDraw::AddVertex(std::vector<Vertex>* list, const b2Vec2& v,
+                                 const ccColor4B& color) {
+  Vertex vertex = { v.x * ratio_, v.y * ratio_, color };
+  list->push_back(vertex);
+}
+
+void BatchedDebugDraw::AddOutline(const b2Vec2* vertices, int32 vertex_count,
+                                  const ccColor4B& color) {
+  for (int32 i = 0; i < vertex_count; i++) {
+    AddVertex(&lines_, vertices[i], color);
+    AddVertex(&lines_, vertices[(i + 1) % vertex_count], color);
+  }
+}
+
+void BatchedDebugDraw::AddFill(const b2Vec2* vertices, int32 vertex_count,
+                               const ccColor4B& color) {
+  // Box2D polygons are convex, so a fan around the first vertex covers them.
+  for (int32 i = 1; i + 1 < vertex_count; i++) {
+    AddVertex(&triangles_, vertices[0], color);
+    AddVertex(&triangles_, vertices[i], color);
+    AddVertex(&triangles_, vertices[i + 1], color);
+  }
+}
+
+void BatchedDebugDraw::DrawPolygon(const b2Vec2* vertices, int32 vertex_count,
+                                   const b2Color& color) {
+  if (!IsVisible(vertices, vertex_count))
+    return;
+  AddOutline(vertices, vertex_count, ToColor4B(color, 1.0f));
+}
+
+void BatchedDebugDraw::DrawSolidPolygon(const b2Vec2* vertices,
+                                        int32 vertex_count,
+                                        const b2Color& color) {
+  if (!IsVisible(vertices, vertex_count))
+    return;
+  AddFill(vertices, vertex_count, ToColor4B(color, 0.5f));
+  AddOutline(vertices, vertex_count, ToColor4B(color, 1.0f));
+}
+
+void BatchedDebugDraw::DrawCircle(const b2Vec2& center, float32 radius,
+                                  const b2Color& color) {
+  b2Vec2 extent(radius, radius);
+  if (!IsVisible(center - extent, center + extent))
+    return;
+  b2Vec2 vertices[kCircleSegments];
+  for (int i = 0; i < kCircleSegments; i++) {
+    float32 angle = 2.0f * b2_pi * i / kCircleSegments;
+    vertices[i] = center + radius * b2Vec2(cosf(angle), sinf(angle));
+  }
+  AddOutline(vertices, kCircleSegments, ToColor4B(color, 1.0f));
+}
+
+void BatchedDebugDraw::DrawSolidCircle(const b2Vec2& center, float32 radius,
+                                       const b2Vec2& axis,
+                                       const b2Color& color) {
+  b2Vec2 extent(radius, radius);
+  if (!IsVisible(center - extent, center + extent))
+    return;
+  b2Vec2 vertices[kCircleSegments];
+  for (int i = 0; i < kCircleSegments; i++) {
+    float32 angle = 2.0f * b2_pi * i / kCircleSegments;
+    vertices[i] = center + radius * b2Vec2(cosf(angle), sinf(angle));
+  }
+  ccColor4B outline = ToColor4B(color, 1.0f);
+  AddFill(vertices, kCircleSegments, ToColor4B(color, 0.5f));
+  AddOutline(vertices, kCircleSegments, outline);
+
+  // Radius line showing the body's rotation.
+  AddVertex(&lines_, center, outline);
+  AddVertex(&lines_, center + radius * axis, outline);
+}
+
+void BatchedDebugDraw::DrawSegment(const b2Vec2& p1, const b2Vec2& p2,
+                                   const b2Color& color) {
+  if (!IsVisible(b2Min(p1, p2), b2Max(p1, p2)))
+    return;
+  ccColor4B color4 = ToColor4B(color, 1.0f);
+  AddVertex(&lines_, p1, color4);
+  AddVertex(&lines_, p2, color4);
+}
+
+void BatchedDebugDraw::DrawTransform(const b2Transform& xf) {
+  if (!IsVisible(xf.p, xf.p))
+    return;
+  ccColor4B red = ccc4(255, 0, 0, 255);
+  ccColor4B green = ccc4(0, 255, 0, 255);
+  AddVertex(&lines_, xf.p, red);
+  AddVertex(&lines_, xf.p + kAxisScale * xf.q.GetXAxis(), red);
+  AddVertex(&lines_, xf.p, green);
+  AddVertex(&lines_, xf.p + kAxisScale * xf.q.GetYAxis(), green);
+}
+
+void BatchedDebugDraw::Flush() {
+  if (triangles_.empty() && lines_.empty())
+    return;
+
+  if (!program_) {
+    program_ = CCShaderCache::sharedShaderCache()->programForKey(
+        kCCShader_PositionColor);
+    glGenBuffers(1, &vertex_buffer_);
+  }
+
+  size_t triangle_bytes = triangles_.size() * sizeof(Vertex);
+  size_t line_bytes = lines_.size() * sizeof(Vertex);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  // Grow geometrically so that a level that keeps gaining strokes does not
+  // need a bigger buffer every frame.  Respecifying the store each frame
+  // also lets the driver hand us fresh memory instead of waiting for the
+  // previous frame's draws.
+  if (triangle_bytes + line_bytes > buffer_size_)
+    buffer_size_ = std::max(triangle_bytes + line_bytes, buffer_size_ * 2);
+  glBufferData(GL_ARRAY_BUFFER, buffer_size_, NULL, GL_DYNAMIC_DRAW);
+  if (triangle_bytes)
+    glBufferSubData(GL_ARRAY_BUFFER, 0, triangle_bytes, &triangles_[0]);
+  if (line_bytes)
+    glBufferSubData(GL_ARRAY_BUFFER, triangle_bytes, line_bytes, &lines_[0]);
+
+  program_->use();
+  program_->setUniformsForBuiltins();
+  ccGLBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  ccGLEnableVertexAttribs(kCCVertexAttribFlag_Position |
+                          kCCVertexAttribFlag_Color);
+  glVertexAttribPointer(kCCVertexAttrib_Position, 2, GL_FLOAT, GL_FALSE,
+                        sizeof(Vertex), (GLvoid*)offsetof(Vertex, x));
+  glVertexAttribPointer(kCCVertexAttrib_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                        sizeof(Vertex), (GLvoid*)offsetof(Vertex, color));
+
+  int draws = 0;
+  if (!triangles_.empty()) {
+    glDrawArrays(GL_TRIANGLES, 0, triangles_.size());
+    draws++;
+  }
+  if (!lines_.empty()) {
+    glDrawArrays(GL_LINES, triangles_.size(), lines_.size());
+    draws++;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  CC_INCREMENT_GL_DRAWS(draws);
+
+  // clear() keeps the capacity for the next frame.
+  triangles_.clear();
+  lines_.clear();
+}
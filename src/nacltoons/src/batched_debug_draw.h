@@ -0,0 +1,80 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef BATCHED_DEBUG_DRAW_H_
+#define BATCHED_DEBUG_DRAW_H_
+
+#include <vector>
+
+#include "cocos2d.h"
+#include "Box2D/Box2D.h"
+
+USING_NS_CC;
+
+/**
+ * Box2D debug renderer that collects everything b2World::DrawDebugData
+ * emits for a frame and draws it with one triangle and one line draw call
+ * from a single dynamic vertex buffer.  Shapes entirely outside the visible
+ * rect are dropped before they are tessellated.
+ *
+ * Usage per frame: SetVisibleRect(), world->DrawDebugData(), Flush().
+ */
+class BatchedDebugDraw : public b2Draw {
+ public:
+  // |ratio| is the number of points per Box2D meter.
+  explicit BatchedDebugDraw(float32 ratio);
+  ~BatchedDebugDraw();
+
+  // The area to keep, in points.  Everything is kept until this is called.
+  void SetVisibleRect(const CCRect& rect);
+
+  // Draw and discard everything collected since the last Flush().
+  void Flush();
+
+  // b2Draw implementation.
+  virtual void DrawPolygon(const b2Vec2* vertices, int32 vertex_count,
+                           const b2Color& color);
+  virtual void DrawSolidPolygon(const b2Vec2* vertices, int32 vertex_count,
+                                const b2Color& color);
+  virtual void DrawCircle(const b2Vec2& center, float32 radius,
+                          const b2Color& color);
+  virtual void DrawSolidCircle(const b2Vec2& center, float32 radius,
+                               const b2Vec2& axis, const b2Color& color);
+  virtual void DrawSegment(const b2Vec2& p1, const b2Vec2& p2,
+                           const b2Color& color);
+  virtual void DrawTransform(const b2Transform& xf);
+
+ private:
+  struct Vertex {
+    GLfloat x, y;
+    ccColor4B color;
+  };
+
+  // True if the box from |lower| to |upper| (in meters) can be seen.
+  bool IsVisible(const b2Vec2& lower, const b2Vec2& upper) const;
+  bool IsVisible(const b2Vec2* vertices, int32 vertex_count) const;
+
+  void AddVertex(std::vector<Vertex>* list, const b2Vec2& v,
+                 const ccColor4B& color);
+  void AddOutline(const b2Vec2* vertices, int32 vertex_count,
+                  const ccColor4B& color);
+  void AddFill(const b2Vec2* vertices, int32 vertex_count,
+               const ccColor4B& color);
+
+  // Points per meter.
+  float32 ratio_;
+
+  // Visible area in meters.
+  bool cull_;
+  b2AABB visible_;
+
+  std::vector<Vertex> triangles_;
+  std::vector<Vertex> lines_;
+
+  GLuint vertex_buffer_;
+  // Size of the buffer's data store in bytes.
+  size_t buffer_size_;
+  CCGLProgram* program_;
+};
+
+#endif  // BATCHED_DEBUG_DRAW_H_
@@ -0,0 +1,409 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include "behaviours.h"
+#include "level_layer.h"
+
+#include "physics_nodes/CCPhysicsSprite.h"
+
+namespace {
+
+class CollectibleBehaviour : public Behaviour {
+ public:
+  CollectibleBehaviour(BehaviourManager* manager, int tag, int collector,
+                       const char* group, float fade_time)
+      : Behaviour(manager, tag),
+        collector_(collector),
+        group_(group),
+        fade_time_(fade_time),
+        collected_(false) {}
+
+  virtual void OnContact(int other) {
+    if (collected_ || (collector_ && other != collector_))
+      return;
+    CCPhysicsNode* node = GetNode();
+    if (!node)
+      return;
+    collected_ = true;
+    // The body stays in the world (the node needs it for its position) but
+    // takes no further part in the simulation.
+    GetBody()->SetActive(false);
+    node->runAction(CCFadeOut::create(fade_time_));
+    manager_->QueueEvent(tag_, "collected", manager_->Collect(group_));
+  }
+
+ private:
+  int collector_;
+  std::string group_;
+  float fade_time_;
+  bool collected_;
+};
+
+class GoalBehaviour : public Behaviour {
+ public:
+  GoalBehaviour(BehaviourManager* manager, int tag, int collector,
+                const char* required_group, float fade_time)
+      : Behaviour(manager, tag),
+        collector_(collector),
+        required_group_(required_group),
+        fade_time_(fade_time),
+        state_(kWaiting),
+        remaining_(0) {}
+
+  virtual void OnContact(int other) {
+    if (state_ != kWaiting || (collector_ && other != collector_))
+      return;
+    if (!required_group_.empty()) {
+      const char* group = required_group_.c_str();
+      if (manager_->GetCollected(group) < manager_->GetCollectibles(group))
+        return;
+    }
+    CCPhysicsNode* node = GetNode();
+    if (!node)
+      return;
+    node->runAction(CCFadeOut::create(fade_time_));
+    remaining_ = fade_time_;
+    state_ = kFading;
+  }
+
+  virtual void Update(float dt) {
+    if (state_ != kFading)
+      return;
+    remaining_ -= dt;
+    if (remaining_ <= 0) {
+      // Sent once the fade has finished; Lua completes the level on it.
+      manager_->QueueEvent(tag_, "goal", 0);
+      state_ = kReached;
+    }
+  }
+
+ private:
+  enum State { kWaiting, kFading, kReached };
+
+  int collector_;
+  std::string required_group_;
+  float fade_time_;
+  State state_;
+  // Seconds left of the fade.
+  float remaining_;
+};
+
+class RotatorBehaviour : public Behaviour {
+ public:
+  RotatorBehaviour(BehaviourManager* manager, int tag,
+                   float degrees_per_second)
+      : Behaviour(manager, tag) {
+    // A kinematic body spun by Box2D costs nothing per frame here and
+    // still pushes dynamic bodies around.
+    b2Body* body = GetBody();
+    if (!body)
+      return;
+    body->SetType(b2_kinematicBody);
+    body->SetAngularVelocity(-CC_DEGREES_TO_RADIANS(degrees_per_second));
+  }
+};
+
+class MoverBehaviour : public Behaviour {
+ public:
+  enum Mode { kLoop, kPingPong, kOnce };
+
+  MoverBehaviour(BehaviourManager* manager, int tag, float speed, Mode mode)
+      : Behaviour(manager, tag),
+        speed_(speed / PTM_RATIO),
+        mode_(mode),
+        next_(0),
+        direction_(1),
+        done_(false) {
+    b2Body* body = GetBody();
+    if (body)
+      body->SetType(b2_kinematicBody);
+  }
+
+  void AddPoint(float x, float y) {
+    points_.push_back(b2Vec2(x / PTM_RATIO, y / PTM_RATIO));
+  }
+
+  virtual void Update(float dt) {
+    if (done_ || points_.empty())
+      return;
+    b2Body* body = GetBody();
+    if (!body)
+      return;
+
+    b2Vec2 offset = points_[next_] - body->GetPosition();
+    float distance = offset.Length();
+    if (distance <= speed_ * dt) {
+      // Close enough to land on the point this frame.
+      body->SetTransform(points_[next_], body->GetAngle());
+      if (!Advance()) {
+        body->SetLinearVelocity(b2Vec2_zero);
+        done_ = true;
+        manager_->QueueEvent(tag_, "arrived", next_ + 1);
+        return;
+      }
+      offset = points_[next_] - body->GetPosition();
+      distance = offset.Length();
+    }
+    if (distance > b2_epsilon)
+      body->SetLinearVelocity((speed_ / distance) * offset);
+  }
+
+ private:
+  // Pick the next point.  Returns false at the end of a 'once' path.
+  bool Advance() {
+    int count = points_.size();
+    if (count == 1)
+      return mode_ != kOnce;
+    switch (mode_) {
+      case kLoop:
+        next_ = (next_ + 1) % count;
+        return true;
+      case kPingPong:
+        if (next_ + direction_ < 0 || next_ + direction_ >= count)
+          direction_ = -direction_;
+        next_ += direction_;
+        return true;
+      case kOnce:
+        if (next_ + 1 >= count)
+          return false;
+        next_++;
+        return true;
+    }
+    return false;
+  }
+
+  // Meters per second.
+  float speed_;
+  Mode mode_;
+  std::vector<b2Vec2> points_;
+  int next_;
+  int direction_;
+  bool done_;
+};
+
+class SpawnerBehaviour : public Behaviour {
+ public:
+  SpawnerBehaviour(BehaviourManager* manager, int tag, const char* image,
+                   float interval, int max_alive)
+      : Behaviour(manager, tag),
+        image_(image),
+        interval_(interval),
+        max_alive_(max_alive),
+        elapsed_(0),
+        spawned_(0) {}
+
+  ~SpawnerBehaviour() {
+    for (size_t i = 0; i < alive_.size(); i++)
+      alive_[i]->release();
+  }
+
+  virtual void Update(float dt) {
+    elapsed_ += dt;
+    if (elapsed_ < interval_)
+      return;
+    elapsed_ -= interval_;
+    Spawn();
+  }
+
+ private:
+  void Spawn() {
+    b2Body* body = GetBody();
+    if (!body)
+      return;
+    b2World* world = manager_->layer()->GetWorld();
+
+    if (max_alive_ > 0 && (int)alive_.size() >= max_alive_) {
+      CCPhysicsSprite* oldest = alive_.front();
+      alive_.erase(alive_.begin());
+      if (oldest->getParent()) {
+        world->DestroyBody(oldest->getB2Body());
+        oldest->removeFromParentAndCleanup(true);
+      }
+      oldest->release();
+    }
+
+    CCPhysicsSprite* sprite = CCPhysicsSprite::create(image_.c_str());
+    b2BodyDef body_def;
+    body_def.type = b2_dynamicBody;
+    body_def.position = body->GetPosition();
+    b2Body* spawned = world->CreateBody(&body_def);
+
+    b2CircleShape shape;
+    shape.m_radius = sprite->getContentSize().height / 2 / PTM_RATIO;
+    b2FixtureDef fixture_def;
+    fixture_def.shape = &shape;
+    fixture_def.density = 1.0f;
+    fixture_def.friction = 0.5f;
+    fixture_def.restitution = 0.3f;
+    // Spawned objects go on the spawner's collision layer.
+    if (body->GetFixtureList())
+      fixture_def.filter = body->GetFixtureList()->GetFilterData();
+    spawned->CreateFixture(&fixture_def);
+
+    sprite->setB2Body(spawned);
+    sprite->setPTMRatio(PTM_RATIO);
+    manager_->layer()->addChild(sprite, 1);
+    sprite->retain();
+    alive_.push_back(sprite);
+
+    manager_->QueueEvent(tag_, "spawned", ++spawned_);
+  }
+
+  std::string image_;
+  float interval_;
+  int max_alive_;
+  float elapsed_;
+  int spawned_;
+  // Oldest first.
+  std::vector<CCPhysicsSprite*> alive_;
+};
+
+}  // namespace
+
+Behaviour::Behaviour(BehaviourManager* manager, int tag)
+    : manager_(manager),
+      tag_(tag) {
+  CCNode* child = manager->layer()->getChildByTag(tag);
+  node_ = dynamic_cast<CCPhysicsNode*>(child);
+  if (node_)
+    node_->retain();
+  else
+    CCLog("behaviour attached to unknown object: %d", tag);
+}
+
+Behaviour::~Behaviour() {
+  if (node_)
+    node_->release();
+}
+
+CCPhysicsNode* Behaviour::GetNode() {
+  // Lua removes objects from the layer when it destroys their bodies.
+  if (!node_ || !node_->getParent())
+    return NULL;
+  return node_;
+}
+
+b2Body* Behaviour::GetBody() {
+  CCPhysicsNode* node = GetNode();
+  return node ? node->getB2Body() : NULL;
+}
+
+BehaviourManager::BehaviourManager(LevelLayer* layer) : layer_(layer) {
+}
+
+BehaviourManager::~BehaviourManager() {
+  for (size_t i = 0; i < behaviours_.size(); i++)
+    delete behaviours_[i];
+}
+
+void BehaviourManager::Add(Behaviour* behaviour) {
+  behaviours_.push_back(behaviour);
+  by_tag_.insert(std::make_pair(behaviour->tag(), behaviour));
+}
+
+void BehaviourManager::AddCollectible(int tag, int collector,
+                                      const char* group, float fade_time) {
+  Add(new CollectibleBehaviour(this, tag, collector, group, fade_time));
+  collectibles_[group]++;
+}
+
+void BehaviourManager::AddGoal(int tag, int collector,
+                               const char* required_group, float fade_time) {
+  Add(new GoalBehaviour(this, tag, collector, required_group, fade_time));
+}
+
+void BehaviourManager::AddRotator(int tag, float degrees_per_second) {
+  Add(new RotatorBehaviour(this, tag, degrees_per_second));
+}
+
+void BehaviourManager::AddMover(int tag, float speed, const char* mode) {
+  MoverBehaviour::Mode mover_mode = MoverBehaviour::kLoop;
+  if (!strcmp(mode, "pingpong"))
+    mover_mode = MoverBehaviour::kPingPong;
+  else if (!strcmp(mode, "once"))
+    mover_mode = MoverBehaviour::kOnce;
+  Add(new MoverBehaviour(this, tag, speed, mover_mode));
+}
+
+void BehaviourManager::AddMoverPoint(int tag, float x, float y) {
+  // Points go to the most recently added mover of the object.
+  for (int i = behaviours_.size() - 1; i >= 0; i--) {
+    if (behaviours_[i]->tag() != tag)
+      continue;
+    MoverBehaviour* mover = dynamic_cast<MoverBehaviour*>(behaviours_[i]);
+    if (mover) {
+      mover->AddPoint(x, y);
+      return;
+    }
+  }
+  CCLog("no mover for object: %d", tag);
+}
+
+void BehaviourManager::AddSpawner(int tag, const char* image, float interval,
+                                  int max_alive) {
+  Add(new SpawnerBehaviour(this, tag, image, interval, max_alive));
+}
+
+int BehaviourManager::GetCollected(const char* group) {
+  std::map<std::string, int>::iterator it = collected_.find(group);
+  return it == collected_.end() ? 0 : it->second;
+}
+
+int BehaviourManager::GetCollectibles(const char* group) {
+  std::map<std::string, int>::iterator it = collectibles_.find(group);
+  return it == collectibles_.end() ? 0 : it->second;
+}
+
+int BehaviourManager::Collect(const std::string& group) {
+  return ++collected_[group];
+}
+
+void BehaviourManager::QueueEvent(int tag, const char* event, int value) {
+  Event e = { tag, event, value };
+  events_.push_back(e);
+}
+
+void BehaviourManager::BeginContact(int tag1, int tag2) {
+  // Called during the physics step, where bodies cannot be changed, so
+  // only remember contacts that a behaviour cares about.
+  if (by_tag_.count(tag1) || by_tag_.count(tag2))
+    contacts_.push_back(std::make_pair(tag1, tag2));
+}
+
+void BehaviourManager::Update(float dt) {
+  if (behaviours_.empty())
+    return;
+
+  for (size_t i = 0; i < contacts_.size(); i++) {
+    int tag1 = contacts_[i].first;
+    int tag2 = contacts_[i].second;
+    typedef std::multimap<int, Behaviour*>::iterator Iterator;
+    std::pair<Iterator, Iterator> range = by_tag_.equal_range(tag1);
+    for (Iterator it = range.first; it != range.second; ++it)
+      it->second->OnContact(tag2);
+    range = by_tag_.equal_range(tag2);
+    for (Iterator it = range.first; it != range.second; ++it)
+      it->second->OnContact(tag1);
+  }
+  contacts_.clear();
+
+  for (size_t i = 0; i < behaviours_.size(); i++)
+    behaviours_[i]->Update(dt);
+
+  if (events_.empty())
+    return;
+
+  // Lua may end or restart the level from an event, which releases the
+  // layer (and this manager), so work from a copy and keep the layer alive
+  // until we are done.
+  std::vector<Event> events;
+  events.swap(events_);
+  layer_->retain();
+  for (size_t i = 0; i < events.size(); i++)
+    layer_->NotifyBehaviourEvent(events[i].tag, events[i].name,
+                                 events[i].value);
+  layer_->release();
+}
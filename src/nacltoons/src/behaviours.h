@@ -0,0 +1,114 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef BEHAVIOURS_H_
+#define BEHAVIOURS_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cocos2d.h"
+#include "Box2D/Box2D.h"
+#include "physics_nodes/CCPhysicsNode.h"
+
+USING_NS_CC;
+USING_NS_CC_EXT;
+
+class BehaviourManager;
+class LevelLayer;
+
+/**
+ * A native behaviour component attached to a tagged level object.
+ * Behaviours are listed under 'behaviours' in level.def (see
+ * behaviours.lua) and run entirely in C++.  Lua only hears about them
+ * through OnBehaviourEvent when something happens.
+ */
+class Behaviour {
+ public:
+  Behaviour(BehaviourManager* manager, int tag);
+  virtual ~Behaviour();
+
+  int tag() const { return tag_; }
+
+  // Called once per frame after the physics step.
+  virtual void Update(float dt) {}
+
+  // Called after the physics step when this object started touching the
+  // object tagged |other|.
+  virtual void OnContact(int other) {}
+
+ protected:
+  // The object's node and body, or NULL once the object has been removed
+  // from the level.
+  CCPhysicsNode* GetNode();
+  b2Body* GetBody();
+
+  BehaviourManager* manager_;
+  int tag_;
+  CCPhysicsNode* node_;
+};
+
+/**
+ * Owns the behaviours of a level and drives them from LevelLayer.
+ * Contacts reported during the physics step are queued and handled in
+ * Update(), where bodies may be changed safely; Lua events are sent once
+ * all behaviours have been updated.
+ */
+class BehaviourManager {
+ public:
+  explicit BehaviourManager(LevelLayer* layer);
+  ~BehaviourManager();
+
+  // Attach a behaviour to the object tagged |tag|.  A |collector| of 0
+  // means any tagged object.  Positions and speeds are in points.
+
+  // Fade out and count as collected in |group| when touched.
+  void AddCollectible(int tag, int collector, const char* group,
+                      float fade_time);
+  // Fade out and complete the level when touched, once every collectible
+  // in |required_group| (if not empty) has been collected.
+  void AddGoal(int tag, int collector, const char* required_group,
+               float fade_time);
+  // Spin clockwise at a constant rate.
+  void AddRotator(int tag, float degrees_per_second);
+  // Move through a list of points added with AddMoverPoint.  |mode| is
+  // "loop", "pingpong" or "once".
+  void AddMover(int tag, float speed, const char* mode);
+  void AddMoverPoint(int tag, float x, float y);
+  // Drop a new dynamic |image| body at the object's position every
+  // |interval| seconds, removing the oldest beyond |max_alive|.
+  void AddSpawner(int tag, const char* image, float interval, int max_alive);
+
+  // Number of collected and total collectibles in |group|.
+  int GetCollected(const char* group);
+  int GetCollectibles(const char* group);
+
+  void Update(float dt);
+  void BeginContact(int tag1, int tag2);
+
+  // Used by behaviours.
+  LevelLayer* layer() { return layer_; }
+  int Collect(const std::string& group);
+  void QueueEvent(int tag, const char* event, int value);
+
+ private:
+  struct Event {
+    int tag;
+    const char* name;
+    int value;
+  };
+
+  void Add(Behaviour* behaviour);
+
+  LevelLayer* layer_;
+  std::vector<Behaviour*> behaviours_;
+  // Behaviours by tag, for contact dispatch.
+  std::multimap<int, Behaviour*> by_tag_;
+  std::vector<std::pair<int, int> > contacts_;
+  std::vector<Event> events_;
+  std::map<std::string, int> collected_;
+  std::map<std::string, int> collectibles_;
+};
+
+#endif  // BEHAVIOURS_H_
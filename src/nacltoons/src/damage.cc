@@ -0,0 +1,120 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "damage.h"
+
+typedef std::vector<DrawList::Item> Items;
+
+// Myers' O(ND) difference algorithm: flag the items of |a| and |b| that
+// are not part of a longest common subsequence.  |trace| keeps the
+// furthest reaching paths before each round, for walking back.
+static bool Diff(const Items& a, const Items& b, int max_edits,
+                 std::vector<bool>* a_changed, std::vector<bool>* b_changed) {
+  int n = a.size();
+  int m = b.size();
+  int max_d = MIN(n + m, max_edits);
+  int offset = max_d + 1;
+  std::vector<int> v(2 * max_d + 3, 0);
+  std::vector<std::vector<int> > trace;
+  int edits = -1;
+  for (int d = 0; d <= max_d && edits < 0; d++) {
+    trace.push_back(v);
+    for (int k = -d; k <= d; k += 2) {
+      int x;
+      if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+        x = v[offset + k + 1];
+      else
+        x = v[offset + k - 1] + 1;
+      int y = x - k;
+      while (x < n && y < m && a[x].hash == b[y].hash) {
+        x++;
+        y++;
+      }
+      v[offset + k] = x;
+      if (x >= n && y >= m) {
+        edits = d;
+        break;
+      }
+    }
+  }
+  if (edits < 0)
+    return false;
+
+  a_changed->assign(n, false);
+  b_changed->assign(m, false);
+  int x = n;
+  int y = m;
+  for (int d = edits; d > 0; d--) {
+    const std::vector<int>& previous = trace[d];
+    int k = x - y;
+    bool insertion = k == -d || (k != d && previous[offset + k - 1] <
+                                               previous[offset + k + 1]);
+    int previous_k = insertion ? k + 1 : k - 1;
+    int previous_x = previous[offset + previous_k];
+    int previous_y = previous_x - previous_k;
+    if (insertion)
+      (*b_changed)[previous_y] = true;
+    else
+      (*a_changed)[previous_x] = true;
+    x = previous_x;
+    y = previous_y;
+  }
+  return true;
+}
+
+bool FindDamage(const DrawList& before, const DrawList& after, int max_edits,
+                std::vector<CCRect>* rects) {
+  const Items& a = before.items();
+  const Items& b = after.items();
+  std::vector<bool> a_changed;
+  std::vector<bool> b_changed;
+  if (!Diff(a, b, max_edits, &a_changed, &b_changed))
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a_changed[i])
+      rects->push_back(a[i].bounds);
+  }
+  for (size_t i = 0; i < b.size(); i++) {
+    if (b_changed[i])
+      rects->push_back(b[i].bounds);
+  }
+  return true;
+}
+
+static CCRect Union(const CCRect& r1, const CCRect& r2) {
+  float min_x = MIN(r1.getMinX(), r2.getMinX());
+  float min_y = MIN(r1.getMinY(), r2.getMinY());
+  float max_x = MAX(r1.getMaxX(), r2.getMaxX());
+  float max_y = MAX(r1.getMaxY(), r2.getMaxY());
+  return CCRectMake(min_x, min_y, max_x - min_x, max_y - min_y);
+}
+
+static float Area(const CCRect& rect) {
+  return rect.size.width * rect.size.height;
+}
+
+void AddDamageRect(const CCRect& rect, size_t max_rects,
+                   std::vector<CCRect>* rects) {
+  rects->push_back(rect);
+  if (rects->size() <= max_rects)
+    return;
+
+  size_t best_i = 0;
+  size_t best_j = 1;
+  float best_waste = 0;
+  for (size_t i = 0; i < rects->size(); i++) {
+    for (size_t j = i + 1; j < rects->size(); j++) {
+      const CCRect& r1 = (*rects)[i];
+      const CCRect& r2 = (*rects)[j];
+      float waste = Area(Union(r1, r2)) - Area(r1) - Area(r2);
+      if ((i == 0 && j == 1) || waste < best_waste) {
+        best_i = i;
+        best_j = j;
+        best_waste = waste;
+      }
+    }
+  }
+  (*rects)[best_i] = Union((*rects)[best_i], (*rects)[best_j]);
+  rects->erase(rects->begin() + best_j);
+}
@@ -0,0 +1,29 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef DAMAGE_H_
+#define DAMAGE_H_
+
+#include <vector>
+
+#include "cocos2d.h"
+#include "draw_list.h"
+
+USING_NS_CC;
+
+// Find where |after| draws differently from |before|, which must both
+// have kept their items.  The items are matched up by hash in drawing
+// order, as a diff would match lines; the bounds of every item left over
+// on either side are appended to |rects|, in scene space.  An item that
+// moved in the drawing order is left over, so overlapping items are
+// redrawn in their new order.  Returns false if more than |max_edits|
+// items were left over, when it is cheaper to redraw everything.
+bool FindDamage(const DrawList& before, const DrawList& after, int max_edits,
+                std::vector<CCRect>* rects);
+
+// Add |rect| to |rects|.  If that makes more than |max_rects|, the two
+// whose bounding rect adds the least area are replaced by it.
+void AddDamageRect(const CCRect& rect, size_t max_rects,
+                   std::vector<CCRect>* rects);
+
+#endif  // DAMAGE_H_
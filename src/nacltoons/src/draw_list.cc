@@ -0,0 +1,418 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <math.h>
+
+#include <map>
+#include <typeinfo>
+
+#include "draw_list.h"
+#include "level_layer.h"
+#include "sprite_hull.h"
+
+#include "physics_nodes/CCPhysicsNode.h"
+
+// Quads per draw call, limited by 16-bit indices.
+static const int kMaxQuadsPerDraw = 65536 / 4;
+
+// Index data shared by every list: two triangles per quad, in the same
+// order CCTextureAtlas uses.
+static std::vector<GLushort> g_quad_indices;
+
+// CC_MVPMatrix location of each program recorded so far.  Only used on
+// the cocos2d-x thread.
+static std::map<GLuint, GLint> g_mvp_uniforms;
+
+static GLint GetMVPUniform(GLuint program) {
+  std::map<GLuint, GLint>::iterator it = g_mvp_uniforms.find(program);
+  if (it != g_mvp_uniforms.end())
+    return it->second;
+  GLint location = glGetUniformLocation(program, kCCUniformMVPMatrix_s);
+  g_mvp_uniforms[program] = location;
+  return location;
+}
+
+static void TransformVertex(const CCAffineTransform& t, ccVertex3F* v) {
+  float x = v->x;
+  float y = v->y;
+  v->x = t.a * x + t.c * y + t.tx;
+  v->y = t.b * x + t.d * y + t.ty;
+}
+
+DrawList::DrawList() : keep_items_(false) {
+  kmMat4Identity(&view_projection_);
+  if (g_quad_indices.empty()) {
+    g_quad_indices.resize(kMaxQuadsPerDraw * 6);
+    for (int i = 0; i < kMaxQuadsPerDraw; i++) {
+      g_quad_indices[i * 6 + 0] = i * 4 + 0;
+      g_quad_indices[i * 6 + 1] = i * 4 + 1;
+      g_quad_indices[i * 6 + 2] = i * 4 + 2;
+      g_quad_indices[i * 6 + 3] = i * 4 + 3;
+      g_quad_indices[i * 6 + 4] = i * 4 + 2;
+      g_quad_indices[i * 6 + 5] = i * 4 + 1;
+    }
+  }
+}
+
+DrawList::~DrawList() {
+  Clear();
+}
+
+void DrawList::Clear() {
+  commands_.clear();
+  quads_.clear();
+  triangles_.clear();
+  items_.clear();
+  for (size_t i = 0; i < textures_.size(); i++)
+    textures_[i]->release();
+  textures_.clear();
+}
+
+void DrawList::Append(CCGLProgram* program, CCTexture2D* texture,
+                      const ccBlendFunc& blend, bool triangles, int count) {
+  GLuint program_name = program->getProgram();
+  GLuint texture_name = texture ? texture->getName() : 0;
+  Command* last = commands_.empty() ? NULL : &commands_.back();
+  if (last && last->program == program_name &&
+      last->texture == texture_name && last->blend.src == blend.src &&
+      last->blend.dst == blend.dst && last->triangles == triangles) {
+    last->count += count;
+  } else {
+    int first = triangles ? triangles_.size() : quads_.size();
+    Command command = { program_name, GetMVPUniform(program_name),
+                        texture_name, blend, triangles, first, count };
+    commands_.push_back(command);
+    if (texture) {
+      texture->retain();
+      textures_.push_back(texture);
+    }
+  }
+}
+
+// FNV-1a.
+static unsigned int Hash(const void* data, size_t size, unsigned int hash) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void DrawList::AddItem(const ccV3F_C4B_T2F* vertices, int count) {
+  if (!keep_items_)
+    return;
+  const Command& command = commands_.back();
+  unsigned int hash = 2166136261u;
+  hash = Hash(&command.program, sizeof(command.program), hash);
+  hash = Hash(&command.texture, sizeof(command.texture), hash);
+  hash = Hash(&command.blend, sizeof(command.blend), hash);
+  hash = Hash(vertices, count * sizeof(*vertices), hash);
+
+  float min_x = vertices[0].vertices.x;
+  float max_x = min_x;
+  float min_y = vertices[0].vertices.y;
+  float max_y = min_y;
+  for (int i = 1; i < count; i++) {
+    min_x = MIN(min_x, vertices[i].vertices.x);
+    max_x = MAX(max_x, vertices[i].vertices.x);
+    min_y = MIN(min_y, vertices[i].vertices.y);
+    max_y = MAX(max_y, vertices[i].vertices.y);
+  }
+  Item item = { hash, CCRectMake(min_x, min_y, max_x - min_x, max_y - min_y) };
+  items_.push_back(item);
+}
+
+void DrawList::AddQuads(CCGLProgram* program, CCTexture2D* texture,
+                        const ccBlendFunc& blend,
+                        const ccV3F_C4B_T2F_Quad* quads, int count,
+                        const CCAffineTransform& transform) {
+  if (!count)
+    return;
+
+  Append(program, texture, blend, false, count);
+  size_t first = quads_.size();
+  quads_.insert(quads_.end(), quads, quads + count);
+  for (size_t i = first; i < quads_.size(); i++) {
+    ccV3F_C4B_T2F_Quad& quad = quads_[i];
+    TransformVertex(transform, &quad.tl.vertices);
+    TransformVertex(transform, &quad.bl.vertices);
+    TransformVertex(transform, &quad.tr.vertices);
+    TransformVertex(transform, &quad.br.vertices);
+    AddItem(&quad.tl, 4);
+  }
+}
+
+// Return true if |quad| shows the whole of a texture whose image spans
+// texture coordinates (0, 0) to (|max_s|, |max_t|).
+static bool ShowsWholeTexture(const ccV3F_C4B_T2F_Quad& quad, float max_s,
+                              float max_t) {
+  const ccTex2F* corners[] = { &quad.bl.texCoords, &quad.br.texCoords,
+                               &quad.tl.texCoords, &quad.tr.texCoords };
+  float min_u = corners[0]->u;
+  float max_u = min_u;
+  float min_v = corners[0]->v;
+  float max_v = min_v;
+  for (int i = 1; i < 4; i++) {
+    min_u = MIN(min_u, corners[i]->u);
+    max_u = MAX(max_u, corners[i]->u);
+    min_v = MIN(min_v, corners[i]->v);
+    max_v = MAX(max_v, corners[i]->v);
+  }
+  const float kEpsilon = 1e-4f;
+  return fabsf(min_u) < kEpsilon && fabsf(min_v) < kEpsilon &&
+         fabsf(max_u - max_s) < kEpsilon && fabsf(max_v - max_t) < kEpsilon;
+}
+
+void DrawList::AddHullQuads(CCGLProgram* program, CCTexture2D* texture,
+                            const ccBlendFunc& blend, const SpriteHull& hull,
+                            const ccV3F_C4B_T2F_Quad* quads, int count,
+                            const CCAffineTransform& transform) {
+  float max_s = texture->getMaxS();
+  float max_t = texture->getMaxT();
+  const std::vector<CCPoint>& points = hull.points();
+  std::vector<ccV3F_C4B_T2F> fan(points.size());
+  for (int i = 0; i < count; i++) {
+    const ccV3F_C4B_T2F_Quad& quad = quads[i];
+    if (!ShowsWholeTexture(quad, max_s, max_t)) {
+      AddQuads(program, texture, blend, &quad, 1, transform);
+      continue;
+    }
+
+    // A sprite quad is a parallelogram in both position and texture
+    // space, flipped or rotated as the sprite is.  Find where each
+    // outline point lies along its bottom and left edges, and put the
+    // vertex at the same place in position space.
+    float s_u = quad.br.texCoords.u - quad.bl.texCoords.u;
+    float s_v = quad.br.texCoords.v - quad.bl.texCoords.v;
+    float t_u = quad.tl.texCoords.u - quad.bl.texCoords.u;
+    float t_v = quad.tl.texCoords.v - quad.bl.texCoords.v;
+    float det = s_u * t_v - s_v * t_u;
+    const ccVertex3F& origin = quad.bl.vertices;
+    float s_x = quad.br.vertices.x - origin.x;
+    float s_y = quad.br.vertices.y - origin.y;
+    float t_x = quad.tl.vertices.x - origin.x;
+    float t_y = quad.tl.vertices.y - origin.y;
+    for (size_t j = 0; j < points.size(); j++) {
+      ccV3F_C4B_T2F& vertex = fan[j];
+      vertex.texCoords = tex2(points[j].x * max_s, points[j].y * max_t);
+      float du = vertex.texCoords.u - quad.bl.texCoords.u;
+      float dv = vertex.texCoords.v - quad.bl.texCoords.v;
+      float s = (du * t_v - dv * t_u) / det;
+      float t = (s_u * dv - s_v * du) / det;
+      vertex.vertices = vertex3(origin.x + s * s_x + t * t_x,
+                                origin.y + s * s_y + t * t_y, origin.z);
+      TransformVertex(transform, &vertex.vertices);
+      vertex.colors = quad.bl.colors;
+    }
+
+    // The outline is convex, so a fan from its first point covers it.
+    int vertex_count = (points.size() - 2) * 3;
+    Append(program, texture, blend, true, vertex_count);
+    for (size_t j = 1; j + 1 < points.size(); j++) {
+      triangles_.push_back(fan[0]);
+      triangles_.push_back(fan[j]);
+      triangles_.push_back(fan[j + 1]);
+    }
+    AddItem(&fan[0], fan.size());
+  }
+}
+
+void DrawList::Execute() const {
+  if (commands_.empty())
+    return;
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glEnableVertexAttribArray(kCCVertexAttrib_Position);
+  glEnableVertexAttribArray(kCCVertexAttrib_Color);
+  glEnableVertexAttribArray(kCCVertexAttrib_TexCoords);
+  glActiveTexture(GL_TEXTURE0);
+
+  const int stride = sizeof(ccV3F_C4B_T2F);
+  const Command* previous = NULL;
+  for (size_t i = 0; i < commands_.size(); i++) {
+    const Command& command = commands_[i];
+    if (!previous || previous->program != command.program) {
+      glUseProgram(command.program);
+      glUniformMatrix4fv(command.mvp_uniform, 1, GL_FALSE,
+                         view_projection_.mat);
+    }
+    if (!previous || previous->texture != command.texture)
+      glBindTexture(GL_TEXTURE_2D, command.texture);
+    if (!previous || previous->blend.src != command.blend.src ||
+        previous->blend.dst != command.blend.dst) {
+      // As ccGLBlendFunc does.
+      if (command.blend.src == GL_ONE && command.blend.dst == GL_ZERO) {
+        glDisable(GL_BLEND);
+      } else {
+        glEnable(GL_BLEND);
+        glBlendFunc(command.blend.src, command.blend.dst);
+      }
+    }
+    previous = &command;
+
+    if (command.triangles) {
+      const ccV3F_C4B_T2F* vertex = &triangles_[command.first];
+      glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE,
+                            stride, &vertex->vertices);
+      glVertexAttribPointer(kCCVertexAttrib_Color, 4, GL_UNSIGNED_BYTE,
+                            GL_TRUE, stride, &vertex->colors);
+      glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE,
+                            stride, &vertex->texCoords);
+      glDrawArrays(GL_TRIANGLES, 0, command.count);
+      continue;
+    }
+
+    for (int done = 0; done < command.count; done += kMaxQuadsPerDraw) {
+      int count = MIN(command.count - done, kMaxQuadsPerDraw);
+      const ccV3F_C4B_T2F* vertex = &quads_[command.first + done].tl;
+      glVertexAttribPointer(kCCVertexAttrib_Position, 3, GL_FLOAT, GL_FALSE,
+                            stride, &vertex->vertices);
+      glVertexAttribPointer(kCCVertexAttrib_Color, 4, GL_UNSIGNED_BYTE,
+                            GL_TRUE, stride, &vertex->colors);
+      glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE,
+                            stride, &vertex->texCoords);
+      glDrawElements(GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT,
+                     &g_quad_indices[0]);
+    }
+  }
+}
+
+// Add |count| sprite quads drawn with |texture|, trimmed to the outline of
+// its image if it has one.
+static void AddSprites(CCGLProgram* program, CCTexture2D* texture,
+                       const ccBlendFunc& blend,
+                       const ccV3F_C4B_T2F_Quad* quads, int count,
+                       const CCAffineTransform& transform, DrawList* list) {
+  const SpriteHull* hull = SpriteHull::ForTexture(texture);
+  if (hull) {
+    list->AddHullQuads(program, texture, blend, *hull, quads, count,
+                       transform);
+  } else {
+    list->AddQuads(program, texture, blend, quads, count, transform);
+  }
+}
+
+// Record the quads of a batch node, which draws all of its descendants.
+static void RecordBatch(CCSpriteBatchNode* batch,
+                        const CCAffineTransform& transform, DrawList* list) {
+  // CCSpriteBatchNode::draw does this to bring the quads up to date.
+  CCArray* children = batch->getChildren();
+  if (children) {
+    CCObject* child;
+    CCARRAY_FOREACH(children, child) {
+      static_cast<CCSprite*>(child)->updateTransform();
+    }
+  }
+
+  CCTextureAtlas* atlas = batch->getTextureAtlas();
+  AddSprites(batch->getShaderProgram(), atlas->getTexture(),
+             batch->getBlendFunc(), atlas->getQuads(), atlas->getTotalQuads(),
+             transform, list);
+}
+
+static void RecordColorLayer(CCLayerColor* layer,
+                             const CCAffineTransform& transform,
+                             DrawList* list) {
+  CCSize size = layer->getContentSize();
+  ccColor3B rgb = layer->getDisplayedColor();
+  ccColor4B color = ccc4(rgb.r, rgb.g, rgb.b, layer->getDisplayedOpacity());
+  ccV3F_C4B_T2F_Quad quad;
+  quad.bl.vertices = vertex3(0, 0, 0);
+  quad.br.vertices = vertex3(size.width, 0, 0);
+  quad.tl.vertices = vertex3(0, size.height, 0);
+  quad.tr.vertices = vertex3(size.width, size.height, 0);
+  ccV3F_C4B_T2F* corners[] = { &quad.tl, &quad.bl, &quad.tr, &quad.br };
+  for (int i = 0; i < 4; i++) {
+    corners[i]->colors = color;
+    corners[i]->texCoords = tex2(0, 0);
+  }
+
+  CCGLProgram* program = CCShaderCache::sharedShaderCache()->programForKey(
+      kCCShader_PositionColor);
+  list->AddQuads(program, NULL, layer->getBlendFunc(), &quad, 1, transform);
+}
+
+// Nodes that draw nothing themselves.  Exact types only: a subclass may
+// have overridden draw().
+static bool IsContainer(CCNode* node) {
+  const std::type_info& type = typeid(*node);
+  return type == typeid(CCNode) || type == typeid(CCScene) ||
+         type == typeid(CCLayer) || type == typeid(CCPhysicsNode) ||
+         dynamic_cast<CCMenu*>(node) || dynamic_cast<CCMenuItem*>(node);
+}
+
+static bool IsColorLayer(CCNode* node) {
+  if (typeid(*node) == typeid(CCLayerColor))
+    return true;
+  LevelLayer* level = dynamic_cast<LevelLayer*>(node);
+  return level && !level->debug_enabled();
+}
+
+// Record what |node|->visit() would draw.
+static bool RecordNode(CCNode* node, const CCAffineTransform& parent,
+                       DrawList* list) {
+  CCGridBase* grid = node->getGrid();
+  if ((grid && grid->isActive()) || node->getVertexZ() != 0)
+    return false;
+
+  CCAffineTransform transform =
+      CCAffineTransformConcat(node->nodeToParentTransform(), parent);
+
+  CCSpriteBatchNode* batch = dynamic_cast<CCSpriteBatchNode*>(node);
+  if (batch) {
+    RecordBatch(batch, transform, list);
+    return true;
+  }
+
+  CCSprite* sprite = dynamic_cast<CCSprite*>(node);
+  bool color_layer = !sprite && IsColorLayer(node);
+  if (!sprite && !color_layer && !IsContainer(node))
+    return false;
+
+  // Children with negative z first, then the node, then the rest, as in
+  // CCNode::visit.
+  node->sortAllChildren();
+  CCArray* children = node->getChildren();
+  unsigned int count = children ? children->count() : 0;
+  unsigned int i = 0;
+  for (; i < count; i++) {
+    CCNode* child = static_cast<CCNode*>(children->objectAtIndex(i));
+    if (child->getZOrder() >= 0)
+      break;
+    if (child->isVisible() && !RecordNode(child, transform, list))
+      return false;
+  }
+
+  if (sprite) {
+    ccV3F_C4B_T2F_Quad quad = sprite->getQuad();
+    AddSprites(sprite->getShaderProgram(), sprite->getTexture(),
+               sprite->getBlendFunc(), &quad, 1, transform, list);
+  } else if (color_layer) {
+    RecordColorLayer(static_cast<CCLayerColor*>(node), transform, list);
+  }
+
+  for (; i < count; i++) {
+    CCNode* child = static_cast<CCNode*>(children->objectAtIndex(i));
+    if (child->isVisible() && !RecordNode(child, transform, list))
+      return false;
+  }
+  return true;
+}
+
+bool RecordDrawList(CCNode* root, DrawList* list) {
+  list->Clear();
+
+  // The matrices CCDirector::drawScene visits the scene with.
+  kmMat4 projection;
+  kmMat4 view;
+  kmMat4 view_projection;
+  kmGLGetMatrix(KM_GL_PROJECTION, &projection);
+  kmGLGetMatrix(KM_GL_MODELVIEW, &view);
+  kmMat4Multiply(&view_projection, &projection, &view);
+  list->SetViewProjection(view_projection);
+
+  return RecordNode(root, CCAffineTransformIdentity, list);
+}
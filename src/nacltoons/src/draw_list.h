@@ -0,0 +1,120 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef DRAW_LIST_H_
+#define DRAW_LIST_H_
+
+#include <vector>
+
+#include "cocos2d.h"
+
+USING_NS_CC;
+
+class SpriteHull;
+
+/**
+ * A frame's worth of drawing, recorded from the scene graph so that it can
+ * be submitted later, possibly by another thread.
+ *
+ * Quads are stored already transformed to scene space, so executing a list
+ * reads nothing but the list: no nodes, no Box2D bodies and none of the
+ * cocos2d-x GL state caches or matrix stacks.  Consecutive quads sharing a
+ * program, texture and blend function become a single draw call.  Sprites
+ * whose image has an outline (see sprite_hull.h) are stored as triangles
+ * covering just the outline, which batch the same way.
+ *
+ * The list retains the textures it draws with until it is cleared or
+ * destroyed, which must happen on the cocos2d-x thread once nothing is
+ * executing it; nodes may drop their textures in the meantime.  Programs
+ * are referred to by GL name and must stay alive until the list has been
+ * executed.
+ */
+class DrawList {
+ public:
+  // One quad or outlined sprite, for telling what changed between two
+  // lists (see damage.h).
+  struct Item {
+    // Of everything that affects its pixels: vertices, program, texture
+    // and blend function.
+    unsigned int hash;
+    // In scene space.
+    CCRect bounds;
+  };
+
+  DrawList();
+  ~DrawList();
+
+  void Clear();
+
+  // Keep an Item for everything added from now on.  Off by default.
+  void set_keep_items(bool keep) { keep_items_ = keep; }
+
+  // The projection and view applied to every vertex.
+  void SetViewProjection(const kmMat4& matrix) { view_projection_ = matrix; }
+  const kmMat4& view_projection() const { return view_projection_; }
+
+  // Append |count| quads, given in the space that |transform| maps to scene
+  // space.  |program| must take the standard cocos2d-x vertex attributes
+  // and a CC_MVPMatrix uniform.  |texture| may be NULL.
+  void AddQuads(CCGLProgram* program, CCTexture2D* texture,
+                const ccBlendFunc& blend, const ccV3F_C4B_T2F_Quad* quads,
+                int count, const CCAffineTransform& transform);
+
+  // As AddQuads, but quads showing the whole of |texture| are drawn as
+  // |hull| instead.  Their four corners must share a color.
+  void AddHullQuads(CCGLProgram* program, CCTexture2D* texture,
+                    const ccBlendFunc& blend, const SpriteHull& hull,
+                    const ccV3F_C4B_T2F_Quad* quads, int count,
+                    const CCAffineTransform& transform);
+
+  // Issue the recorded draw calls with plain GL calls.  Callers on the
+  // cocos2d-x thread must call ccGLInvalidateStateCache() afterwards.
+  void Execute() const;
+
+  int quad_count() const { return quads_.size(); }
+  int triangle_count() const { return triangles_.size() / 3; }
+  int command_count() const { return commands_.size(); }
+  const std::vector<Item>& items() const { return items_; }
+
+ private:
+  struct Command {
+    GLuint program;
+    GLint mvp_uniform;
+    GLuint texture;
+    ccBlendFunc blend;
+    // Draws |count| quads from quads_, or if |triangles| is set, |count|
+    // vertices from triangles_.
+    bool triangles;
+    int first;
+    int count;
+  };
+
+  // Make the last command draw |count| more quads or triangle vertices,
+  // or start a new one if it draws differently.
+  void Append(CCGLProgram* program, CCTexture2D* texture,
+              const ccBlendFunc& blend, bool triangles, int count);
+
+  // Keep an Item for |count| vertices drawn the way the last command
+  // draws, if items are kept.
+  void AddItem(const ccV3F_C4B_T2F* vertices, int count);
+
+  bool keep_items_;
+  kmMat4 view_projection_;
+  std::vector<Command> commands_;
+  std::vector<ccV3F_C4B_T2F_Quad> quads_;
+  std::vector<ccV3F_C4B_T2F> triangles_;
+  std::vector<Item> items_;
+  // Retained, once per command that draws with them.
+  std::vector<CCTexture2D*> textures_;
+};
+
+// Record |root| and its visible descendants into |list|, replacing its
+// contents.  |root| itself is recorded even if it is hidden.  The view and
+// projection are taken from the kazmath matrix stacks, so call this where
+// CCDirector would visit |root|, or between frames.  Returns false if the
+// tree contains a node whose drawing cannot be recorded (particles, render
+// textures, grids, debug drawing and so on), in which case it must be
+// drawn by cocos2d-x as usual.
+bool RecordDrawList(CCNode* root, DrawList* list);
+
+#endif  // DRAW_LIST_H_
@@ -0,0 +1,262 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "job_system.h"
+
+// Reads |value| with a full barrier.
+static int AtomicLoad(const volatile int* value) {
+  return __sync_add_and_fetch(const_cast<volatile int*>(value), 0);
+}
+
+static JobSystem* g_shared_job_system = NULL;
+
+bool JobCounter::Done() const {
+  // A thread that took the count to zero may still be releasing waiters,
+  // and the counter must stay alive until it has finished.
+  return AtomicLoad(&value_) == 0 && AtomicLoad(&finishing_) == 0;
+}
+
+JobSystem* JobSystem::sharedJobSystem() {
+  if (!g_shared_job_system)
+    g_shared_job_system = new JobSystem(0);
+  return g_shared_job_system;
+}
+
+void JobSystem::purgeSharedJobSystem() {
+  delete g_shared_job_system;
+  g_shared_job_system = NULL;
+}
+
+JobSystem::JobSystem(int worker_count)
+    : tracer_(NULL),
+      pending_(0),
+      sleeping_(0),
+      quit_(0),
+      next_worker_(0) {
+  if (worker_count <= 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    worker_count = cores > 1 ? cores - 1 : 1;
+  }
+
+  pthread_key_create(&thread_key_, NULL);
+  pthread_mutex_init(&dependency_mutex_, NULL);
+  pthread_mutex_init(&main_mutex_, NULL);
+  pthread_mutex_init(&sleep_mutex_, NULL);
+  pthread_cond_init(&wake_, NULL);
+
+  // All deques must exist before any worker starts stealing.
+  for (int i = 0; i < worker_count; i++) {
+    Worker* worker = new Worker;
+    worker->system = this;
+    worker->index = i + 1;
+    pthread_mutex_init(&worker->mutex, NULL);
+    workers_.push_back(worker);
+  }
+  for (int i = 0; i < worker_count; i++)
+    pthread_create(&workers_[i]->thread, NULL, WorkerMain, workers_[i]);
+}
+
+JobSystem::~JobSystem() {
+  pthread_mutex_lock(&sleep_mutex_);
+  quit_ = 1;
+  pthread_cond_broadcast(&wake_);
+  pthread_mutex_unlock(&sleep_mutex_);
+
+  for (size_t i = 0; i < workers_.size(); i++) {
+    pthread_join(workers_[i]->thread, NULL);
+    pthread_mutex_destroy(&workers_[i]->mutex);
+    delete workers_[i];
+  }
+
+  pthread_cond_destroy(&wake_);
+  pthread_mutex_destroy(&sleep_mutex_);
+  pthread_mutex_destroy(&main_mutex_);
+  pthread_mutex_destroy(&dependency_mutex_);
+  pthread_key_delete(thread_key_);
+}
+
+int JobSystem::CurrentThread() const {
+  return (intptr_t)pthread_getspecific(thread_key_);
+}
+
+void* JobSystem::WorkerMain(void* arg) {
+  Worker* worker = static_cast<Worker*>(arg);
+  worker->system->WorkerLoop(worker->index);
+  return NULL;
+}
+
+void JobSystem::WorkerLoop(int index) {
+  pthread_setspecific(thread_key_, (void*)(intptr_t)index);
+  for (;;) {
+    Job job;
+    if (Take(index, &job)) {
+      Execute(job, index);
+      continue;
+    }
+
+    // Nothing to run or steal.  sleeping_ is raised before pending_ is
+    // checked, and Queue raises pending_ before checking sleeping_, so a
+    // job queued now either is seen here or wakes us.
+    pthread_mutex_lock(&sleep_mutex_);
+    __sync_add_and_fetch(&sleeping_, 1);
+    while (!AtomicLoad(&pending_) && !quit_)
+      pthread_cond_wait(&wake_, &sleep_mutex_);
+    __sync_sub_and_fetch(&sleeping_, 1);
+    bool quit = quit_ && !AtomicLoad(&pending_);
+    pthread_mutex_unlock(&sleep_mutex_);
+    if (quit)
+      return;
+  }
+}
+
+void JobSystem::Queue(const Job& job) {
+  if (job.main_thread) {
+    pthread_mutex_lock(&main_mutex_);
+    main_jobs_.push_back(job);
+    pthread_mutex_unlock(&main_mutex_);
+    return;
+  }
+
+  // Workers keep what they spawn; other threads deal jobs out.
+  int thread = CurrentThread();
+  Worker* worker;
+  if (thread)
+    worker = workers_[thread - 1];
+  else
+    worker = workers_[__sync_fetch_and_add(&next_worker_, 1) % workers_.size()];
+
+  pthread_mutex_lock(&worker->mutex);
+  worker->jobs.push_back(job);
+  pthread_mutex_unlock(&worker->mutex);
+
+  __sync_add_and_fetch(&pending_, 1);
+  if (AtomicLoad(&sleeping_)) {
+    pthread_mutex_lock(&sleep_mutex_);
+    pthread_cond_signal(&wake_);
+    pthread_mutex_unlock(&sleep_mutex_);
+  }
+}
+
+void JobSystem::QueueOrDefer(JobCounter* dependency, const Job& job) {
+  if (dependency) {
+    pthread_mutex_lock(&dependency_mutex_);
+    bool wait = AtomicLoad(&dependency->value_) != 0;
+    if (wait)
+      dependency->waiters_.push_back(job);
+    pthread_mutex_unlock(&dependency_mutex_);
+    if (wait)
+      return;
+  }
+  Queue(job);
+}
+
+void JobSystem::Run(JobFunction function, void* data, JobCounter* counter,
+                    const char* name) {
+  RunAfter(NULL, function, data, counter, name);
+}
+
+void JobSystem::RunAfter(JobCounter* dependency, JobFunction function,
+                         void* data, JobCounter* counter, const char* name) {
+  if (counter)
+    __sync_add_and_fetch(&counter->value_, 1);
+  Job job = { function, data, counter, name, false };
+  QueueOrDefer(dependency, job);
+}
+
+void JobSystem::RunOnMainThread(JobFunction function, void* data,
+                                JobCounter* dependency, const char* name) {
+  Job job = { function, data, NULL, name, true };
+  QueueOrDefer(dependency, job);
+}
+
+bool JobSystem::Take(int thread, Job* job) {
+  if (thread) {
+    Worker* own = workers_[thread - 1];
+    pthread_mutex_lock(&own->mutex);
+    bool found = !own->jobs.empty();
+    if (found) {
+      *job = own->jobs.back();
+      own->jobs.pop_back();
+    }
+    pthread_mutex_unlock(&own->mutex);
+    if (found) {
+      __sync_sub_and_fetch(&pending_, 1);
+      return true;
+    }
+  }
+
+  // Steal, starting after ourselves so that thieves spread out.
+  int count = workers_.size();
+  for (int i = 0; i < count; i++) {
+    Worker* victim = workers_[(thread + i) % count];
+    if (victim->index == thread)
+      continue;
+    pthread_mutex_lock(&victim->mutex);
+    bool found = !victim->jobs.empty();
+    if (found) {
+      *job = victim->jobs.front();
+      victim->jobs.pop_front();
+    }
+    pthread_mutex_unlock(&victim->mutex);
+    if (found) {
+      __sync_sub_and_fetch(&pending_, 1);
+      if (tracer_)
+        tracer_->JobStolen(thread, victim->index);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::Execute(const Job& job, int thread) {
+  if (tracer_)
+    tracer_->JobStarted(job.name, thread);
+  job.function(job.data);
+  if (tracer_)
+    tracer_->JobFinished(job.name, thread);
+  if (job.counter)
+    Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+  __sync_add_and_fetch(&counter->finishing_, 1);
+  if (__sync_sub_and_fetch(&counter->value_, 1) == 0) {
+    std::vector<Job> ready;
+    pthread_mutex_lock(&dependency_mutex_);
+    ready.swap(counter->waiters_);
+    pthread_mutex_unlock(&dependency_mutex_);
+    for (size_t i = 0; i < ready.size(); i++)
+      Queue(ready[i]);
+  }
+  // Last access: the counter may be destroyed as soon as this is seen.
+  __sync_sub_and_fetch(&counter->finishing_, 1);
+}
+
+void JobSystem::Wait(JobCounter* counter) {
+  int thread = CurrentThread();
+  while (!counter->Done()) {
+    Job job;
+    if (Take(thread, &job))
+      Execute(job, thread);
+    else
+      sched_yield();
+  }
+}
+
+int JobSystem::RunMainThreadJobs() {
+  std::vector<Job> jobs;
+  pthread_mutex_lock(&main_mutex_);
+  jobs.swap(main_jobs_);
+  pthread_mutex_unlock(&main_mutex_);
+
+  // Jobs queued by these run next frame.
+  for (size_t i = 0; i < jobs.size(); i++)
+    Execute(jobs[i], 0);
+  return jobs.size();
+}
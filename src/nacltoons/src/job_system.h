@@ -0,0 +1,162 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef JOB_SYSTEM_H_
+#define JOB_SYSTEM_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+
+typedef void (*JobFunction)(void* data);
+
+class JobCounter;
+
+struct Job {
+  JobFunction function;
+  void* data;
+  // Decremented when the job has run (may be NULL).
+  JobCounter* counter;
+  // For tracing only (may be NULL).
+  const char* name;
+  // Run from JobSystem::RunMainThreadJobs() rather than by a worker.
+  bool main_thread;
+};
+
+/**
+ * Counts the unfinished jobs it was passed to.  Jobs can be made to wait
+ * for a counter to reach zero (JobSystem::RunAfter), and so can threads
+ * (JobSystem::Wait).  A counter must outlive the jobs that use it and may
+ * be reused once it has reached zero.
+ */
+class JobCounter {
+ public:
+  JobCounter() : value_(0), finishing_(0) {}
+
+  // True once every job counted has run.
+  bool Done() const;
+
+ private:
+  friend class JobSystem;
+
+  volatile int value_;
+  // Threads still releasing waiters after taking value_ to zero.
+  volatile int finishing_;
+  // Jobs waiting for value_ to reach zero, guarded by the job system's
+  // dependency mutex.
+  std::vector<Job> waiters_;
+};
+
+/**
+ * Receives a callback around every job, for profiling.  Called on the
+ * thread running the job, so implementations must be thread safe.
+ * Threads are numbered 0 for any thread outside the pool (normally the
+ * cocos thread) and 1..N for the workers.
+ */
+class JobTracer {
+ public:
+  virtual ~JobTracer() {}
+  virtual void JobStarted(const char* name, int thread) = 0;
+  virtual void JobFinished(const char* name, int thread) = 0;
+  // |thief| took a job queued by |victim|.
+  virtual void JobStolen(int thief, int victim) {}
+};
+
+/**
+ * Pool of worker threads for engine work such as asset decoding, level
+ * parsing and simulation batches.
+ *
+ * Each worker has its own deque: it pushes and pops the jobs it spawns
+ * at the back (so nested work stays hot in its cache) and idle threads
+ * steal the oldest jobs from the front of other workers' deques.  Jobs
+ * queued from outside the pool are dealt out round robin.  Idle workers
+ * sleep until a job is queued.
+ *
+ * Results that must reach cocos or Lua are handed back with
+ * RunOnMainThread, and run from RunMainThreadJobs() once per frame.
+ */
+class JobSystem {
+ public:
+  // The engine's pool, with one worker per core besides the main thread.
+  static JobSystem* sharedJobSystem();
+  static void purgeSharedJobSystem();
+
+  // |worker_count| of 0 picks one worker per core besides the calling
+  // thread (at least one).
+  explicit JobSystem(int worker_count);
+  // Waits for queued jobs to run.  Jobs still waiting for a counter are
+  // dropped.
+  ~JobSystem();
+
+  int worker_count() const { return workers_.size(); }
+
+  // Queue |function|(|data|).  If |counter| is given it counts the job
+  // from now until it has run.
+  void Run(JobFunction function, void* data, JobCounter* counter = NULL,
+           const char* name = NULL);
+
+  // As Run, but the job is only queued once |dependency| reaches zero.
+  void RunAfter(JobCounter* dependency, JobFunction function, void* data,
+                JobCounter* counter = NULL, const char* name = NULL);
+
+  // Run |function| on the main thread, from RunMainThreadJobs(), once
+  // |dependency| (if any) reaches zero.
+  void RunOnMainThread(JobFunction function, void* data,
+                       JobCounter* dependency = NULL,
+                       const char* name = NULL);
+
+  // Block until |counter| reaches zero, running queued jobs meanwhile.
+  void Wait(JobCounter* counter);
+
+  // Run the main thread jobs that are ready.  Returns how many ran.
+  int RunMainThreadJobs();
+
+  // |tracer| is not owned.  Set it while no jobs are running.
+  void SetTracer(JobTracer* tracer) { tracer_ = tracer; }
+
+  // 0 outside the pool, 1..N on the workers.
+  int CurrentThread() const;
+
+ private:
+  struct Worker {
+    JobSystem* system;
+    int index;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    std::deque<Job> jobs;
+  };
+
+  static void* WorkerMain(void* arg);
+  void WorkerLoop(int index);
+
+  void Queue(const Job& job);
+  void QueueOrDefer(JobCounter* dependency, const Job& job);
+  // Take a job, from the back of our own deque or the front of another's.
+  bool Take(int thread, Job* job);
+  void Execute(const Job& job, int thread);
+  void Finish(JobCounter* counter);
+
+  std::vector<Worker*> workers_;
+  pthread_key_t thread_key_;
+  JobTracer* tracer_;
+
+  // Guards every counter's waiters_.
+  pthread_mutex_t dependency_mutex_;
+
+  pthread_mutex_t main_mutex_;
+  std::vector<Job> main_jobs_;
+
+  // Idle workers sleep on wake_.  pending_ counts queued jobs and
+  // sleeping_ the workers asleep, so that Queue only signals when needed.
+  pthread_mutex_t sleep_mutex_;
+  pthread_cond_t wake_;
+  volatile int pending_;
+  volatile int sleeping_;
+  volatile int quit_;
+
+  // Round robin position for jobs queued from outside the pool.
+  volatile unsigned int next_worker_;
+};
+
+#endif  // JOB_SYSTEM_H_
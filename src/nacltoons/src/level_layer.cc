@@ -6,6 +6,7 @@
 
 #include "level_layer.h"
 #include "app_delegate.h"
+#include "behaviours.h"
 #include "game_manager.h"
 
 #include "physics_nodes/CCPhysicsSprite.h"
@@ -19,10 +20,6 @@ extern "C" {
 #include "tolua_fix.h"
 }
 
-// Pixels-to-meters ratio for converting screen coordinates
-// to Box2D "meters".
-#define PTM_RATIO 32
-
 USING_NS_CC_EXT;
 
 class Box2DCallbackHandler : public b2QueryCallback
@@ -58,6 +55,10 @@ bool LevelLayer::init() {
     return false;
 
   InitPhysics();
+  behaviours_ = new BehaviourManager(this);
+  // Behaviours run after the Lua update handler (which steps the world)
+  // in update().
+  scheduleUpdate();
   return true;
 }
 
@@ -69,16 +70,15 @@ bool LevelLayer::LoadLevel(int level_number) {
   return true;
 }
 
-LevelLayer::LevelLayer() : debug_enabled_(false) {
+LevelLayer::LevelLayer() : behaviours_(NULL), debug_enabled_(false) {
 }
 
 LevelLayer::~LevelLayer() {
+  delete behaviours_;
   delete box2d_world_;
 #ifdef COCOS2D_DEBUG
-#ifndef WIN32
   delete box2d_debug_draw_;
 #endif
-#endif
 }
 
 bool LevelLayer::LoadLua(int level_number) {
@@ -107,8 +107,7 @@ bool LevelLayer::InitPhysics() {
   box2d_world_->SetContactListener(this);
 
 #ifdef COCOS2D_DEBUG
-#ifndef WIN32
-  box2d_debug_draw_ = new GLESDebugDraw(PTM_RATIO);
+  box2d_debug_draw_ = new BatchedDebugDraw(PTM_RATIO);
   box2d_world_->SetDebugDraw(box2d_debug_draw_);
 
   uint32 flags = 0;
@@ -118,7 +117,6 @@ bool LevelLayer::InitPhysics() {
   //flags += b2Draw::e_aabbBit;
   //flags += b2Draw::e_pairBit;
   box2d_debug_draw_->SetFlags(flags);
-#endif
 #endif
   return true;
 }
@@ -172,6 +170,10 @@ void LevelLayer::LuaNotifyContact(b2Contact* contact,
 }
 
 void LevelLayer::BeginContact(b2Contact* contact) {
+  int tag1 = (intptr_t)contact->GetFixtureA()->GetBody()->GetUserData();
+  int tag2 = (intptr_t)contact->GetFixtureB()->GetBody()->GetUserData();
+  if (tag1 && tag2)
+    behaviours_->BeginContact(tag1, tag2);
   LuaNotifyContact(contact, "OnContactBegan");
 }
 
@@ -179,6 +181,28 @@ void LevelLayer::EndContact(b2Contact* contact) {
   LuaNotifyContact(contact, "OnContactEnded");
 }
 
+void LevelLayer::NotifyBehaviourEvent(int tag, const char* event,
+                                      int value) {
+  lua_State* state = lua_stack_->getLuaState();
+  lua_getglobal(state, "OnBehaviourEvent");
+  bool is_func = lua_isfunction(state, -1);
+  lua_pop(state, 1);
+
+  if (!is_func)
+    return;
+
+  lua_stack_->pushInt(tag);
+  lua_stack_->pushString(event);
+  lua_stack_->pushInt(value);
+  lua_stack_->executeFunctionByName("OnBehaviourEvent", 3);
+}
+
+void LevelLayer::update(float dt) {
+  // Runs the Lua update handler, if any.
+  CCLayerColor::update(dt);
+  behaviours_->Update(dt);
+}
+
 void LevelLayer::LevelComplete() {
   setTouchEnabled(false);
   GameManager::sharedManager()->GameOver(true);
@@ -189,9 +213,21 @@ void LevelLayer::draw() {
 
 #ifdef COCOS2D_DEBUG
   if (debug_enabled_) {
-    ccGLEnableVertexAttribs(kCCVertexAttribFlag_Position);
+    // Skip shapes that are off screen.  The visible area is converted to
+    // layer space, which is the space the debug draw works in.
+    CCDirector* director = CCDirector::sharedDirector();
+    CCPoint origin = director->getVisibleOrigin();
+    CCSize size = director->getVisibleSize();
+    CCPoint p1 = convertToNodeSpace(origin);
+    CCPoint p2 = convertToNodeSpace(ccp(origin.x + size.width,
+                                        origin.y + size.height));
+    box2d_debug_draw_->SetVisibleRect(
+        CCRectMake(MIN(p1.x, p2.x), MIN(p1.y, p2.y),
+                   fabsf(p2.x - p1.x), fabsf(p2.y - p1.y)));
+
     kmGLPushMatrix();
     box2d_world_->DrawDebugData();
+    box2d_debug_draw_->Flush();
     kmGLPopMatrix();
   }
 #endif
@@ -9,13 +9,17 @@
 #include "Box2D/Box2D.h"
 
 #ifdef COCOS2D_DEBUG
-#ifndef WIN32
-#include "GLES-Render.h"
-#endif
+#include "batched_debug_draw.h"
 #endif
 
 USING_NS_CC;
 
+// Pixels-to-meters ratio for converting screen coordinates
+// to Box2D "meters".
+#define PTM_RATIO 32
+
+class BehaviourManager;
+
 typedef std::vector<cocos2d::CCPoint> PointList;
 
 /**
@@ -32,14 +36,19 @@ class LevelLayer : public CCLayerColor,
 
   virtual bool init();
   virtual void draw();
+  virtual void update(float dt);
 
   b2World* GetWorld() { return box2d_world_; }
 
+  // Native behaviours of the level's objects (see behaviours.h).
+  BehaviourManager* GetBehaviours() { return behaviours_; }
+
   // Find all bodies at a given position and call the
   // given lua_handler for each one.
   void FindBodiesAt(b2Vec2* pos, int lua_handler);
 
   void ToggleDebug();
+  bool debug_enabled() const { return debug_enabled_; }
   bool LoadLevel(int level_number);
 
   // Called by box2d when contacts start
@@ -52,6 +61,9 @@ class LevelLayer : public CCLayerColor,
   // script.
   void LevelComplete();
 
+  // Call the Lua OnBehaviourEvent function, if defined.
+  void NotifyBehaviourEvent(int tag, const char* event, int value);
+
  protected:
   // Called by BeginContact and EndContact to nofify Lua code when box2d
   // contacts start and finish.
@@ -65,11 +77,11 @@ class LevelLayer : public CCLayerColor,
   // Box2D physics world
   b2World* box2d_world_;
 
+  BehaviourManager* behaviours_;
+
 #ifdef COCOS2D_DEBUG
-#ifndef WIN32
   // Debug drawing support for Box2D.
-  GLESDebugDraw* box2d_debug_draw_;
-#endif
+  BatchedDebugDraw* box2d_debug_draw_;
 #endif
 
   // Flag to enable drawing of Box2D debug data.
@@ -0,0 +1,475 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lua_workers.h"
+#include "job_system.h"
+
+#include "cocos2d.h"
+
+extern "C" {
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+LUALIB_API int luaopen_yaml(lua_State *L);
+}
+
+USING_NS_CC;
+
+// Nesting limit when copying tables, which also catches cycles.
+static const int kMaxDepth = 32;
+
+// Type tags of the serialized form.
+enum {
+  kNil,
+  kFalse,
+  kTrue,
+  kNumber,
+  kString,
+  kTable,
+  kTableEnd,
+};
+
+// Append the value at |index| of |state| to |out|.  Returns false, with a
+// message in |error|, if the value cannot be copied to another state.
+static bool Serialize(lua_State* state, int index, int depth,
+                      std::string* out, std::string* error) {
+  if (index < 0)
+    index = lua_gettop(state) + index + 1;
+
+  switch (lua_type(state, index)) {
+    case LUA_TNIL:
+      out->push_back(kNil);
+      return true;
+    case LUA_TBOOLEAN:
+      out->push_back(lua_toboolean(state, index) ? kTrue : kFalse);
+      return true;
+    case LUA_TNUMBER: {
+      lua_Number number = lua_tonumber(state, index);
+      out->push_back(kNumber);
+      out->append((const char*)&number, sizeof(number));
+      return true;
+    }
+    case LUA_TSTRING: {
+      size_t length;
+      const char* string = lua_tolstring(state, index, &length);
+      uint32_t length32 = length;
+      out->push_back(kString);
+      out->append((const char*)&length32, sizeof(length32));
+      out->append(string, length);
+      return true;
+    }
+    case LUA_TTABLE: {
+      if (depth >= kMaxDepth) {
+        *error = "tables nested too deeply (or cyclic)";
+        return false;
+      }
+      luaL_checkstack(state, 2, "serializing table");
+      out->push_back(kTable);
+      lua_pushnil(state);
+      while (lua_next(state, index)) {
+        if (!Serialize(state, -2, depth + 1, out, error) ||
+            !Serialize(state, -1, depth + 1, out, error)) {
+          lua_pop(state, 2);
+          return false;
+        }
+        lua_pop(state, 1);
+      }
+      out->push_back(kTableEnd);
+      return true;
+    }
+    default:
+      *error = std::string("cannot pass a ") +
+               lua_typename(state, lua_type(state, index)) +
+               " to or from a worker";
+      return false;
+  }
+}
+
+// Push the value serialized at |*pos| onto |state| and advance |*pos|.
+// The data always comes from Serialize, so it is not validated.
+static void Deserialize(lua_State* state, const char** pos) {
+  luaL_checkstack(state, 2, "deserializing");
+  char type = *(*pos)++;
+  switch (type) {
+    case kNil:
+      lua_pushnil(state);
+      break;
+    case kFalse:
+    case kTrue:
+      lua_pushboolean(state, type == kTrue);
+      break;
+    case kNumber: {
+      lua_Number number;
+      memcpy(&number, *pos, sizeof(number));
+      *pos += sizeof(number);
+      lua_pushnumber(state, number);
+      break;
+    }
+    case kString: {
+      uint32_t length;
+      memcpy(&length, *pos, sizeof(length));
+      *pos += sizeof(length);
+      lua_pushlstring(state, *pos, length);
+      *pos += length;
+      break;
+    }
+    case kTable:
+      lua_newtable(state);
+      while (**pos != kTableEnd) {
+        Deserialize(state, pos);
+        Deserialize(state, pos);
+        lua_rawset(state, -3);
+      }
+      (*pos)++;
+      break;
+  }
+}
+
+// The message of the error value at |index|, which need not be a string.
+static std::string ErrorMessage(lua_State* state, int index) {
+  const char* message = lua_tostring(state, index);
+  if (message)
+    return message;
+  return std::string("(error object is a ") +
+         luaL_typename(state, index) + " value)";
+}
+
+// Data for the protected calls below.  Serialize and Deserialize may raise
+// Lua errors (luaL_checkstack, out of memory), which must not escape into
+// a job thread or a main thread callback.
+struct CopyCall {
+  const std::string* in;
+  std::string* out;
+  std::string* error;
+  int count;
+  bool ok;
+};
+
+static int ProtectedSerialize(lua_State* state) {
+  CopyCall* call = static_cast<CopyCall*>(lua_touserdata(state, 1));
+  call->ok = true;
+  for (int i = 2; call->ok && i <= lua_gettop(state); i++)
+    call->ok = Serialize(state, i, 0, call->out, call->error);
+  return 0;
+}
+
+static int ProtectedDeserialize(lua_State* state) {
+  CopyCall* call = static_cast<CopyCall*>(lua_touserdata(state, 1));
+  luaL_checkstack(state, call->count, "deserializing");
+  const char* pos = call->in->data();
+  for (int i = 0; i < call->count; i++)
+    Deserialize(state, &pos);
+  return call->count;
+}
+
+// Serialize |count| values starting at |first|.
+static bool SerializeValues(lua_State* state, int first, int count,
+                            std::string* out, std::string* error) {
+  if (!lua_checkstack(state, count + 2)) {
+    *error = "too many values";
+    return false;
+  }
+  CopyCall call = { NULL, out, error, count, false };
+  lua_pushcfunction(state, ProtectedSerialize);
+  lua_pushlightuserdata(state, &call);
+  for (int i = 0; i < count; i++)
+    lua_pushvalue(state, first + i);
+  if (lua_pcall(state, count + 1, 0, 0)) {
+    *error = ErrorMessage(state, -1);
+    lua_pop(state, 1);
+    return false;
+  }
+  return call.ok;
+}
+
+// Push |count| values serialized in |data|.  Returns false, with nothing
+// pushed, if that failed.
+static bool DeserializeValues(lua_State* state, const std::string& data,
+                              int count, std::string* error) {
+  CopyCall call = { &data, NULL, NULL, count, false };
+  lua_pushcfunction(state, ProtectedDeserialize);
+  lua_pushlightuserdata(state, &call);
+  if (lua_pcall(state, 1, count, 0)) {
+    *error = ErrorMessage(state, -1);
+    lua_pop(state, 1);
+    return false;
+  }
+  return true;
+}
+
+struct LuaWorkerPool::Request {
+  LuaWorkerPool* pool;
+  // Copied when the call is made so that workers never read the pool's
+  // settings while the main thread changes them.
+  std::string engine_dir;
+  std::string script_path;
+  // The pool's generation when the call was made.
+  int generation;
+  std::string module;
+  std::string function;
+  std::string args;
+  int arg_count;
+  // Registry reference to the callback in the main state.
+  int callback;
+
+  bool ok;
+  std::string results;
+  int result_count;
+  std::string error;
+};
+
+static LuaWorkerPool* g_shared_pool = NULL;
+
+LuaWorkerPool* LuaWorkerPool::sharedPool() {
+  return g_shared_pool;
+}
+
+LuaWorkerPool::LuaWorkerPool(lua_State* main_state, JobSystem* jobs)
+    : main_state_(main_state),
+      jobs_(jobs),
+      script_path_("./?.lua"),
+      generation_(0),
+      pending_(0) {
+  // Thread 0 is any thread outside the pool, which runs jobs while it
+  // waits in JobSystem::Wait.
+  for (int i = 0; i <= jobs->worker_count(); i++) {
+    Slot* slot = new Slot;
+    pthread_mutex_init(&slot->mutex, NULL);
+    slot->state = NULL;
+    slot->generation = 0;
+    slots_.push_back(slot);
+  }
+}
+
+LuaWorkerPool::~LuaWorkerPool() {
+  for (size_t i = 0; i < slots_.size(); i++) {
+    if (slots_[i]->state)
+      lua_close(slots_[i]->state);
+    pthread_mutex_destroy(&slots_[i]->mutex);
+    delete slots_[i];
+  }
+}
+
+void LuaWorkerPool::SetScriptPath(const std::string& path) {
+  script_path_ = path;
+  __sync_add_and_fetch(&generation_, 1);
+}
+
+lua_State* LuaWorkerPool::CreateState(const std::string& engine_dir) {
+  lua_State* state = luaL_newstate();
+
+  static const luaL_Reg kLibs[] = {
+    { "", luaopen_base },
+    { LUA_LOADLIBNAME, luaopen_package },
+    { LUA_TABLIBNAME, luaopen_table },
+    { LUA_STRLIBNAME, luaopen_string },
+    { LUA_MATHLIBNAME, luaopen_math },
+    { NULL, NULL }
+  };
+  for (const luaL_Reg* lib = kLibs; lib->func; lib++) {
+    lua_pushcfunction(state, lib->func);
+    lua_pushstring(state, lib->name);
+    lua_call(state, 1, 0);
+  }
+
+  // No file access from base, and no C modules.
+  lua_pushnil(state);
+  lua_setglobal(state, "dofile");
+  lua_pushnil(state);
+  lua_setglobal(state, "loadfile");
+
+  lua_getglobal(state, LUA_LOADLIBNAME);
+  lua_pushnil(state);
+  lua_setfield(state, -2, "loadlib");
+  lua_pushstring(state, "");
+  lua_setfield(state, -2, "cpath");
+  lua_getfield(state, -1, "loaders");
+  // Keep the preload and Lua file searchers only.
+  for (int i = lua_objlen(state, -1); i > 2; i--) {
+    lua_pushnil(state);
+    lua_rawseti(state, -2, i);
+  }
+  lua_pop(state, 1);
+
+  // The engine modules workers may use.
+  lua_getfield(state, -1, "preload");
+  lua_pushcfunction(state, luaopen_yaml);
+  lua_setfield(state, -2, "yaml");
+  static const char* kEngineModules[] = { "util", "path" };
+  for (size_t i = 0; i < sizeof(kEngineModules) / sizeof(*kEngineModules);
+       i++) {
+    std::string filename = engine_dir + "/" + kEngineModules[i] + ".lua";
+    if (luaL_loadfile(state, filename.c_str())) {
+      CCLog("workers: %s", ErrorMessage(state, -1).c_str());
+      lua_pop(state, 1);
+      continue;
+    }
+    lua_setfield(state, -2, kEngineModules[i]);
+  }
+  lua_pop(state, 2);
+  return state;
+}
+
+void LuaWorkerPool::RunJob(void* data) {
+  Request* request = static_cast<Request*>(data);
+  LuaWorkerPool* pool = request->pool;
+
+  // A call made before SetPath belongs to a game that has gone, and its
+  // callback will be dropped; don't let it touch the new game's states.
+  if (request->generation == pool->generation_) {
+    Slot* slot = pool->slots_[pool->jobs_->CurrentThread()];
+    pthread_mutex_lock(&slot->mutex);
+    // Modules loaded for an earlier game must not be found by this one.
+    if (slot->state && slot->generation != request->generation) {
+      lua_close(slot->state);
+      slot->state = NULL;
+    }
+    if (!slot->state) {
+      slot->state = pool->CreateState(request->engine_dir);
+      slot->generation = request->generation;
+    }
+    pool->Execute(slot->state, request);
+    pthread_mutex_unlock(&slot->mutex);
+  }
+
+  pool->jobs_->RunOnMainThread(CompleteJob, request, NULL, "lua_complete");
+}
+
+void LuaWorkerPool::Execute(lua_State* state, Request* request) {
+  int top = lua_gettop(state);
+  request->ok = false;
+
+  lua_getglobal(state, LUA_LOADLIBNAME);
+  lua_pushstring(state, request->script_path.c_str());
+  lua_setfield(state, -2, "path");
+  lua_pop(state, 1);
+
+  lua_getglobal(state, "require");
+  lua_pushstring(state, request->module.c_str());
+  if (lua_pcall(state, 1, 1, 0)) {
+    request->error = ErrorMessage(state, -1);
+    lua_settop(state, top);
+    return;
+  }
+  if (lua_istable(state, -1))
+    lua_getfield(state, -1, request->function.c_str());
+  if (!lua_isfunction(state, -1)) {
+    request->error = "no function '" + request->function + "' in module '" +
+                     request->module + "'";
+    lua_settop(state, top);
+    return;
+  }
+
+  int base = lua_gettop(state);
+  if (!DeserializeValues(state, request->args, request->arg_count,
+                         &request->error)) {
+    lua_settop(state, top);
+    return;
+  }
+  if (lua_pcall(state, request->arg_count, LUA_MULTRET, 0)) {
+    request->error = ErrorMessage(state, -1);
+    lua_settop(state, top);
+    return;
+  }
+
+  request->result_count = lua_gettop(state) - base + 1;
+  request->ok = SerializeValues(state, base, request->result_count,
+                                &request->results, &request->error);
+  lua_settop(state, top);
+}
+
+void LuaWorkerPool::CompleteJob(void* data) {
+  Request* request = static_cast<Request*>(data);
+  request->pool->Complete(request);
+  delete request;
+}
+
+void LuaWorkerPool::Complete(Request* request) {
+  lua_State* state = main_state_;
+  int top = lua_gettop(state);
+  pending_--;
+
+  lua_rawgeti(state, LUA_REGISTRYINDEX, request->callback);
+  luaL_unref(state, LUA_REGISTRYINDEX, request->callback);
+  // The callback belongs to a game unloaded since the call was made.
+  if (request->generation != generation_) {
+    lua_settop(state, top);
+    return;
+  }
+  int count = 2;
+  bool ok = request->ok;
+  if (ok) {
+    lua_pushboolean(state, 1);
+    ok = DeserializeValues(state, request->results, request->result_count,
+                           &request->error);
+    if (ok)
+      count = request->result_count + 1;
+    else
+      lua_pop(state, 1);
+  }
+  if (!ok) {
+    lua_pushboolean(state, 0);
+    lua_pushstring(state, request->error.c_str());
+  }
+  if (lua_pcall(state, count, 0, 0))
+    CCLog("workers: callback failed: %s", ErrorMessage(state, -1).c_str());
+  lua_settop(state, top);
+}
+
+int LuaWorkerPool::Run(lua_State* state) {
+  LuaWorkerPool* pool = g_shared_pool;
+  const char* module = luaL_checkstring(state, 1);
+  const char* function = luaL_checkstring(state, 2);
+  luaL_checktype(state, 3, LUA_TFUNCTION);
+
+  Request* request = new Request;
+  request->pool = pool;
+  request->engine_dir = pool->engine_dir_;
+  request->script_path = pool->script_path_;
+  request->generation = pool->generation_;
+  request->module = module;
+  request->function = function;
+  request->arg_count = lua_gettop(state) - 3;
+  request->ok = false;
+  request->result_count = 0;
+  std::string error;
+  if (!SerializeValues(state, 4, request->arg_count, &request->args,
+                       &error)) {
+    delete request;
+    return luaL_error(state, "workers.Run: %s", error.c_str());
+  }
+
+  lua_pushvalue(state, 3);
+  request->callback = luaL_ref(state, LUA_REGISTRYINDEX);
+  pool->pending_++;
+  pool->jobs_->Run(RunJob, request, NULL, "lua_worker");
+  return 0;
+}
+
+int LuaWorkerPool::SetPath(lua_State* state) {
+  g_shared_pool->SetScriptPath(luaL_checkstring(state, 1));
+  return 0;
+}
+
+int LuaWorkerPool::Pending(lua_State* state) {
+  lua_pushinteger(state, g_shared_pool->pending());
+  return 1;
+}
+
+int luaopen_workers(lua_State* state) {
+  if (!g_shared_pool)
+    g_shared_pool = new LuaWorkerPool(state, JobSystem::sharedJobSystem());
+
+  static const luaL_Reg kFunctions[] = {
+    { "Run", LuaWorkerPool::Run },
+    { "SetPath", LuaWorkerPool::SetPath },
+    { "Pending", LuaWorkerPool::Pending },
+    { NULL, NULL }
+  };
+  luaL_register(state, "workers", kFunctions);
+  return 1;
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef LUA_WORKERS_H_
+#define LUA_WORKERS_H_
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "lua.h"
+}
+
+class JobSystem;
+
+/**
+ * Runs pure Lua functions (puzzle evaluation, path planning, scoring...)
+ * on worker lua_States so that heavy script work leaves the frame loop.
+ *
+ * From the main Lua state:
+ *
+ *   workers.Run('solver', 'Solve', callback, arg1, arg2, ...)
+ *
+ * requires module 'solver' in a worker state, calls solver.Solve(arg1,
+ * arg2, ...) on a job system thread, and later calls callback(true,
+ * results...) on the main thread, or callback(false, message) if it
+ * failed.  Arguments and results are copied between states, so they may
+ * only be nil, booleans, numbers, strings and tables of those.
+ *
+ * Worker states have the base (minus dofile and loadfile), table, string
+ * and math libraries, and can require the engine's util, path and yaml
+ * modules plus scripts on the path given to workers.SetPath().  They have
+ * no cocos2d-x, Box2D, io or os bindings.  Each worker keeps its state
+ * (and so its loaded modules) between calls.
+ *
+ * workers.SetPath() starts over, as the loader does for every game: later
+ * calls run in fresh worker states, and the callbacks of earlier calls
+ * still in flight are dropped, so one game never sees another's modules
+ * or results.
+ */
+class LuaWorkerPool {
+ public:
+  // The pool created by luaopen_workers, or NULL.
+  static LuaWorkerPool* sharedPool();
+
+  // Results are delivered to |main_state|; work runs on |jobs|.
+  LuaWorkerPool(lua_State* main_state, JobSystem* jobs);
+  ~LuaWorkerPool();
+
+  // Directory holding the engine's util.lua and path.lua.
+  void SetEngineDir(const std::string& dir) { engine_dir_ = dir; }
+
+  // package.path for scripts required by worker functions.  Starts a new
+  // generation of worker states, as described above.
+  void SetScriptPath(const std::string& path);
+
+  // Number of calls whose callbacks have not run yet.
+  int pending() const { return pending_; }
+
+ private:
+  friend int luaopen_workers(lua_State* state);
+
+  struct Request;
+  struct Slot {
+    pthread_mutex_t mutex;
+    lua_State* state;
+    // The generation |state| was created for.
+    int generation;
+  };
+
+  static int Run(lua_State* state);
+  static int SetPath(lua_State* state);
+  static int Pending(lua_State* state);
+
+  static void RunJob(void* data);
+  static void CompleteJob(void* data);
+
+  static lua_State* CreateState(const std::string& engine_dir);
+  void Execute(lua_State* state, Request* request);
+  void Complete(Request* request);
+
+  lua_State* main_state_;
+  JobSystem* jobs_;
+  std::string engine_dir_;
+  std::string script_path_;
+  // Bumped by SetScriptPath on the main thread, read by workers to skip
+  // calls made before it.
+  volatile int generation_;
+  // One state per job system thread, indexed by JobSystem::CurrentThread.
+  std::vector<Slot*> slots_;
+  // Only touched on the main thread.
+  int pending_;
+};
+
+// Create the shared pool for |state| (the main cocos state) and register
+// the 'workers' module in it.
+int luaopen_workers(lua_State* state);
+
+#endif  // LUA_WORKERS_H_
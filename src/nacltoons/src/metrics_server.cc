@@ -0,0 +1,282 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "metrics_server.h"
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "CCLuaEngine.h"
+#include "app_delegate.h"
+#include "game_manager.h"
+#include "level_layer.h"
+
+// Node and texture counts walk the scene and the texture cache, so they
+// are only taken every this many frames.
+static const int kSlowSampleFrames = 30;
+
+MetricsServer* MetricsServer::Start(int port) {
+  int listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_socket < 0)
+    return NULL;
+  int reuse = 1;
+  setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(listen_socket, (struct sockaddr*)&address, sizeof(address)) ||
+      listen(listen_socket, 4)) {
+    CCLog("metrics: can't listen on port %d", port);
+    close(listen_socket);
+    return NULL;
+  }
+
+  MetricsServer* server = new MetricsServer(listen_socket);
+  // After the game's updates, so that this frame's physics step is done.
+  CCDirector::sharedDirector()->getScheduler()->scheduleUpdateForTarget(
+      server, 1000, false);
+  pthread_create(&server->thread_, NULL, ServerMain, server);
+  CCLog("metrics: serving on http://127.0.0.1:%d/metrics", port);
+  return server;
+}
+
+MetricsServer::MetricsServer(int listen_socket)
+    : listen_socket_(listen_socket),
+      sequence_(0),
+      watched_state_(NULL),
+      gc_cycles_(0),
+      slow_sample_countdown_(0) {
+  memset(&counters_, 0, sizeof(counters_));
+}
+
+static int CountNodes(CCNode* node) {
+  int count = 1;
+  CCArray* children = node->getChildren();
+  if (children) {
+    CCObject* child;
+    CCARRAY_FOREACH(children, child) {
+      count += CountNodes(static_cast<CCNode*>(child));
+    }
+  }
+  return count;
+}
+
+void MetricsServer::update(float dt) {
+  // Everything is gathered before publishing, to keep the window in
+  // which the server thread has to retry short.
+  CCDirector* director = CCDirector::sharedDirector();
+  CCScene* scene = director->getRunningScene();
+  b2World* world = NULL;
+  if (scene) {
+    LevelLayer* level =
+        dynamic_cast<LevelLayer*>(scene->getChildByTag(TAG_LAYER_LEVEL));
+    if (level)
+      world = level->GetWorld();
+  }
+
+  lua_State* state = NULL;
+  CCScriptEngineProtocol* engine =
+      CCScriptEngineManager::sharedManager()->getScriptEngine();
+  if (engine)
+    state = static_cast<CCLuaEngine*>(engine)->getLuaStack()->getLuaState();
+  if (state && state != watched_state_)
+    WatchGc(state);
+  int lua_heap_bytes = 0;
+  if (state) {
+    lua_heap_bytes = lua_gc(state, LUA_GCCOUNT, 0) * 1024 +
+                     lua_gc(state, LUA_GCCOUNTB, 0);
+  }
+
+  bool slow_sample = --slow_sample_countdown_ <= 0;
+  int nodes = 0;
+  int texture_bytes = 0;
+  if (slow_sample) {
+    slow_sample_countdown_ = kSlowSampleFrames;
+    if (scene)
+      nodes = CountNodes(scene);
+    texture_bytes = CachedTextureBytes();
+  }
+
+  __sync_fetch_and_add(&sequence_, 1);
+  counters_.frames[counters_.frame_count % kFrameWindow] = dt;
+  counters_.frame_count++;
+  counters_.frame_seconds += dt;
+  if (world) {
+    // b2Profile times are in milliseconds.
+    counters_.physics_step_seconds = world->GetProfile().step / 1000;
+    counters_.bodies = world->GetBodyCount();
+    counters_.contacts = world->GetContactCount();
+  } else {
+    counters_.physics_step_seconds = 0;
+    counters_.bodies = 0;
+    counters_.contacts = 0;
+  }
+  counters_.lua_heap_bytes = lua_heap_bytes;
+  counters_.lua_gc_cycles = gc_cycles_;
+  if (slow_sample) {
+    counters_.nodes = nodes;
+    counters_.texture_bytes = texture_bytes;
+  }
+  __sync_fetch_and_add(&sequence_, 1);
+}
+
+void MetricsServer::Read(Counters* counters) {
+  for (;;) {
+    unsigned int before = __sync_add_and_fetch(&sequence_, 0);
+    if (before & 1) {
+      sched_yield();
+      continue;
+    }
+    memcpy(counters, &counters_, sizeof(*counters));
+    if (__sync_add_and_fetch(&sequence_, 0) == before)
+      return;
+  }
+}
+
+int MetricsServer::OnGcCycle(lua_State* state) {
+  MetricsServer* server =
+      static_cast<MetricsServer*>(lua_touserdata(state, lua_upvalueindex(1)));
+  server->gc_cycles_++;
+  server->WatchGc(state);
+  return 0;
+}
+
+void MetricsServer::WatchGc(lua_State* state) {
+  watched_state_ = state;
+  // Nothing refers to the sentinel, so the next cycle finalizes it.
+  lua_newuserdata(state, 1);
+  lua_newtable(state);
+  lua_pushlightuserdata(state, this);
+  lua_pushcclosure(state, OnGcCycle, 1);
+  lua_setfield(state, -2, "__gc");
+  lua_setmetatable(state, -2);
+  lua_pop(state, 1);
+}
+
+void* MetricsServer::ServerMain(void* arg) {
+  static_cast<MetricsServer*>(arg)->Serve();
+  return NULL;
+}
+
+void MetricsServer::Serve() {
+  for (;;) {
+    int connection = accept(listen_socket_, NULL, NULL);
+    if (connection < 0)
+      continue;
+    // Don't let a client that never sends its request hold up the rest.
+    struct timeval timeout = { 1, 0 };
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+               sizeof(timeout));
+    Respond(connection);
+    close(connection);
+  }
+}
+
+void MetricsServer::Respond(int connection) {
+  // Read up to the end of the request headers.  Whatever the path, the
+  // answer is the same.
+  std::string request;
+  char buffer[512];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < 8192) {
+    ssize_t size = read(connection, buffer, sizeof(buffer));
+    if (size <= 0)
+      return;
+    request.append(buffer, size);
+  }
+
+  Counters counters;
+  Read(&counters);
+  std::string body = Format(counters);
+  char header[128];
+  snprintf(header, sizeof(header),
+           "HTTP/1.0 200 OK\r\n"
+           "Content-Type: text/plain; version=0.0.4\r\n"
+           "Content-Length: %d\r\n\r\n",
+           (int)body.size());
+  std::string response = header + body;
+  const char* data = response.data();
+  size_t left = response.size();
+  while (left > 0) {
+    // A client that hangs up early must not raise SIGPIPE, which would
+    // kill the game.
+    ssize_t written = send(connection, data, left, MSG_NOSIGNAL);
+    if (written <= 0)
+      return;
+    data += written;
+    left -= written;
+  }
+}
+
+static void AppendMetric(std::string* out, const char* name,
+                         const char* type, const char* help, double value) {
+  char line[256];
+  snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %.9g\n",
+           name, help, name, type, name, value);
+  *out += line;
+}
+
+std::string MetricsServer::Format(const Counters& counters) {
+  std::string out;
+
+  int count = std::min<unsigned int>(counters.frame_count, kFrameWindow);
+  std::vector<float> frames(counters.frames, counters.frames + count);
+  std::sort(frames.begin(), frames.end());
+  char line[128];
+  snprintf(line, sizeof(line),
+           "# HELP nacltoons_frame_seconds Time between frames, over the "
+           "last %d frames.\n"
+           "# TYPE nacltoons_frame_seconds summary\n",
+           kFrameWindow);
+  out += line;
+  static const double kQuantiles[] = { 0.5, 0.9, 0.99, 1 };
+  for (size_t i = 0; i < sizeof(kQuantiles) / sizeof(kQuantiles[0]); i++) {
+    double value = 0;
+    if (count > 0) {
+      // Nearest rank.
+      int rank = (int)ceil(kQuantiles[i] * count) - 1;
+      value = frames[std::max(0, rank)];
+    }
+    snprintf(line, sizeof(line),
+             "nacltoons_frame_seconds{quantile=\"%g\"} %.9g\n",
+             kQuantiles[i], value);
+    out += line;
+  }
+  snprintf(line, sizeof(line),
+           "nacltoons_frame_seconds_sum %.9g\n"
+           "nacltoons_frame_seconds_count %u\n",
+           counters.frame_seconds, counters.frame_count);
+  out += line;
+
+  AppendMetric(&out, "nacltoons_physics_step_seconds", "gauge",
+               "Time the last Box2D step took.",
+               counters.physics_step_seconds);
+  AppendMetric(&out, "nacltoons_bodies", "gauge",
+               "Box2D bodies in the running level.", counters.bodies);
+  AppendMetric(&out, "nacltoons_contacts", "gauge",
+               "Box2D contacts in the running level.", counters.contacts);
+  AppendMetric(&out, "nacltoons_nodes", "gauge",
+               "Nodes in the running scene.", counters.nodes);
+  AppendMetric(&out, "nacltoons_lua_heap_bytes", "gauge",
+               "Memory in use by the Lua state.", counters.lua_heap_bytes);
+  AppendMetric(&out, "nacltoons_lua_gc_cycles_total", "counter",
+               "Lua garbage collection cycles completed.",
+               counters.lua_gc_cycles);
+  AppendMetric(&out, "nacltoons_texture_bytes", "gauge",
+               "Texture memory held by the texture cache.",
+               counters.texture_bytes);
+  return out;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef METRICS_SERVER_H_
+#define METRICS_SERVER_H_
+
+#include <pthread.h>
+
+#include <string>
+
+#include "cocos2d.h"
+
+struct lua_State;
+
+USING_NS_CC;
+
+/**
+ * Serves live engine counters over HTTP on the loopback interface, in the
+ * Prometheus text format, for watching soak tests:
+ *
+ *   $ ./nacltoons --metrics-port=9100 &
+ *   $ curl http://127.0.0.1:9100/metrics
+ *
+ * The counters are sampled on the cocos2d-x thread by a scheduled update
+ * that runs after the game's own, and published with a sequence lock: the
+ * game thread never waits for the server thread, which copies the
+ * counters again if a frame was published while it was reading.  Sorting
+ * out percentiles and formatting is left to the server thread.
+ */
+class MetricsServer : public CCObject {
+ public:
+  // Frames the frame time percentiles are taken over.
+  static const int kFrameWindow = 300;
+
+  // Start sampling and serving on 127.0.0.1:|port|.  Can be called before
+  // the application is launched.  Returns NULL if the port can't be
+  // bound.  The server lives until the process exits.
+  static MetricsServer* Start(int port);
+
+  virtual void update(float dt);
+
+ private:
+  struct Counters {
+    // Frame intervals in seconds; the newest is at
+    // frames[(frame_count - 1) % kFrameWindow].
+    float frames[kFrameWindow];
+    unsigned int frame_count;
+    double frame_seconds;
+    // Time the last Box2D step took, in seconds.
+    float physics_step_seconds;
+    int bodies;
+    int contacts;
+    int nodes;
+    int lua_heap_bytes;
+    int lua_gc_cycles;
+    int texture_bytes;
+  };
+
+  explicit MetricsServer(int listen_socket);
+
+  static void* ServerMain(void* arg);
+  void Serve();
+  void Respond(int connection);
+  // Copy the counters as last published.
+  void Read(Counters* counters);
+  static std::string Format(const Counters& counters);
+
+  // Count the Lua collector's cycles with an object that is finalized at
+  // the end of each cycle and replaces itself.
+  static int OnGcCycle(lua_State* state);
+  void WatchGc(lua_State* state);
+
+  int listen_socket_;
+  pthread_t thread_;
+
+  // Odd while the game thread is publishing.
+  volatile unsigned int sequence_;
+  Counters counters_;
+
+  // Game thread only.
+  lua_State* watched_state_;
+  int gc_cycles_;
+  int slow_sample_countdown_;
+};
+
+#endif  // METRICS_SERVER_H_
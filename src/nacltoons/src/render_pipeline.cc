@@ -0,0 +1,603 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "damage.h"
+#include "render_pipeline.h"
+
+#if CC_TARGET_PLATFORM == CC_PLATFORM_LINUX
+#include <GL/glx.h>
+#endif
+
+/**
+ * A GL context for the render thread that shares textures and programs
+ * with the cocos2d-x context.
+ */
+class RenderContext {
+ public:
+  // Create a context sharing with the one current on this thread, or return
+  // NULL if that is not supported here.
+  static RenderContext* CreateShared();
+
+  virtual ~RenderContext() {}
+
+  // Called on the render thread.
+  virtual bool MakeCurrent() = 0;
+  virtual void ReleaseCurrent() = 0;
+};
+
+#if CC_TARGET_PLATFORM == CC_PLATFORM_LINUX
+class GLXRenderContext : public RenderContext {
+ public:
+  GLXRenderContext(Display* display, GLXContext context, GLXPbuffer pbuffer)
+      : display_(display), context_(context), pbuffer_(pbuffer) {}
+
+  virtual ~GLXRenderContext() {
+    glXDestroyPbuffer(display_, pbuffer_);
+    glXDestroyContext(display_, context_);
+  }
+
+  virtual bool MakeCurrent() {
+    return glXMakeContextCurrent(display_, pbuffer_, pbuffer_, context_);
+  }
+
+  virtual void ReleaseCurrent() {
+    glXMakeContextCurrent(display_, None, None, NULL);
+  }
+
+ private:
+  Display* display_;
+  GLXContext context_;
+  // Everything is drawn to textures; this just satisfies MakeCurrent.
+  GLXPbuffer pbuffer_;
+};
+
+RenderContext* RenderContext::CreateShared() {
+  Display* display = glXGetCurrentDisplay();
+  GLXContext share = glXGetCurrentContext();
+  if (!display || !share)
+    return NULL;
+
+  // Use the cocos2d-x context's own config, if it can have a pbuffer.
+  int config_id = 0;
+  int screen = 0;
+  glXQueryContext(display, share, GLX_FBCONFIG_ID, &config_id);
+  glXQueryContext(display, share, GLX_SCREEN, &screen);
+  int config_attribs[] = { GLX_FBCONFIG_ID, config_id, None };
+  int count = 0;
+  GLXFBConfig* configs =
+      glXChooseFBConfig(display, screen, config_attribs, &count);
+  if (!configs)
+    return NULL;
+  GLXFBConfig config = configs[0];
+  XFree(configs);
+  int drawable_types = 0;
+  glXGetFBConfigAttrib(display, config, GLX_DRAWABLE_TYPE, &drawable_types);
+  if (!count || !(drawable_types & GLX_PBUFFER_BIT))
+    return NULL;
+
+  GLXContext context =
+      glXCreateNewContext(display, config, GLX_RGBA_TYPE, share, True);
+  if (!context)
+    return NULL;
+  int pbuffer_attribs[] = { GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1,
+                            None };
+  GLXPbuffer pbuffer = glXCreatePbuffer(display, config, pbuffer_attribs);
+  return new GLXRenderContext(display, context, pbuffer);
+}
+#else
+RenderContext* RenderContext::CreateShared() {
+  return NULL;
+}
+#endif
+
+/**
+ * Executes draw lists into a pair of textures on its own thread.  While it
+ * draws one, the cocos2d-x thread shows the other.
+ */
+class RenderThread {
+ public:
+  // Takes ownership of |context|.  Frames are |width| by |height| pixels
+  // and drawn with |viewport|, as the director sets it.
+  RenderThread(RenderContext* context, int width, int height,
+               const CCRect& viewport);
+  ~RenderThread();
+
+  // Start the thread.  Returns false if its context could not be used.
+  bool Start();
+
+  // Wait for the previous list to be drawn, then hand |list| over.  Returns
+  // the texture holding the previous list's frame, or 0 before the first
+  // one.  |list| must not change until the next Submit returns.
+  GLuint Submit(const DrawList* list);
+
+ private:
+  static void* ThreadMain(void* arg);
+  void Run();
+  bool CreateTargets();
+  void DeleteTargets();
+
+  RenderContext* context_;
+  int width_;
+  int height_;
+  CCRect viewport_;
+  pthread_t thread_;
+  bool running_;
+
+  // Created on the render thread; the textures are shared.
+  GLuint textures_[2];
+  GLuint framebuffers_[2];
+
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  // Guarded by mutex_.
+  bool started_;
+  bool failed_;
+  bool quit_;
+  // The list being drawn, if any.
+  const DrawList* list_;
+  // Texture index the next list is drawn into.
+  int target_;
+  // Texture index of the last finished frame, or -1.
+  int finished_;
+};
+
+RenderThread::RenderThread(RenderContext* context, int width, int height,
+                           const CCRect& viewport)
+    : context_(context),
+      width_(width),
+      height_(height),
+      viewport_(viewport),
+      running_(false),
+      started_(false),
+      failed_(false),
+      quit_(false),
+      list_(NULL),
+      target_(0),
+      finished_(-1) {
+  textures_[0] = textures_[1] = 0;
+  framebuffers_[0] = framebuffers_[1] = 0;
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&cond_, NULL);
+}
+
+RenderThread::~RenderThread() {
+  if (running_) {
+    pthread_mutex_lock(&mutex_);
+    quit_ = true;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+    pthread_join(thread_, NULL);
+  }
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&mutex_);
+  delete context_;
+}
+
+bool RenderThread::Start() {
+  if (pthread_create(&thread_, NULL, ThreadMain, this))
+    return false;
+  running_ = true;
+
+  pthread_mutex_lock(&mutex_);
+  while (!started_ && !failed_)
+    pthread_cond_wait(&cond_, &mutex_);
+  bool ok = !failed_;
+  pthread_mutex_unlock(&mutex_);
+  return ok;
+}
+
+GLuint RenderThread::Submit(const DrawList* list) {
+  // Make textures uploaded on this thread visible to the render thread,
+  // and finish reading the texture it is about to draw into.
+  glFinish();
+
+  pthread_mutex_lock(&mutex_);
+  while (list_)
+    pthread_cond_wait(&cond_, &mutex_);
+  GLuint frame = finished_ >= 0 ? textures_[finished_] : 0;
+  list_ = list;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+  return frame;
+}
+
+void* RenderThread::ThreadMain(void* arg) {
+  static_cast<RenderThread*>(arg)->Run();
+  return NULL;
+}
+
+bool RenderThread::CreateTargets() {
+  glGenTextures(2, textures_);
+  glGenFramebuffers(2, framebuffers_);
+  for (int i = 0; i < 2; i++) {
+    glBindTexture(GL_TEXTURE_2D, textures_[i]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width_, height_, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, NULL);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[i]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, textures_[i], 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      return false;
+  }
+  // The textures must be complete before the other context samples them.
+  glFinish();
+  return true;
+}
+
+void RenderThread::DeleteTargets() {
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(2, framebuffers_);
+  glDeleteTextures(2, textures_);
+}
+
+void RenderThread::Run() {
+  bool ok = context_->MakeCurrent();
+  if (ok && !CreateTargets()) {
+    DeleteTargets();
+    ok = false;
+  }
+
+  pthread_mutex_lock(&mutex_);
+  started_ = ok;
+  failed_ = !ok;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+  if (!ok) {
+    context_->ReleaseCurrent();
+    return;
+  }
+
+  glDisable(GL_DEPTH_TEST);
+  glClearColor(0, 0, 0, 1);
+  for (;;) {
+    pthread_mutex_lock(&mutex_);
+    while (!list_ && !quit_)
+      pthread_cond_wait(&cond_, &mutex_);
+    const DrawList* list = list_;
+    int target = target_;
+    pthread_mutex_unlock(&mutex_);
+    if (!list)
+      break;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[target]);
+    glViewport(viewport_.origin.x, viewport_.origin.y, viewport_.size.width,
+               viewport_.size.height);
+    glClear(GL_COLOR_BUFFER_BIT);
+    list->Execute();
+    // Complete the frame before the other context shows it.
+    glFinish();
+
+    pthread_mutex_lock(&mutex_);
+    finished_ = target;
+    target_ = target ^ 1;
+    list_ = NULL;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  DeleteTargets();
+  context_->ReleaseCurrent();
+}
+
+// Partial redraws: the most items that may differ between two lists, the
+// most rects redrawn, and the share of the viewport above which the whole
+// frame is redrawn instead.
+static const int kMaxDamageEdits = 128;
+static const size_t kMaxDamageRects = 4;
+static const float kMaxDamageFraction = 0.5f;
+
+// Map |rect|, in the scene space of a list drawn with |view_projection|,
+// to window pixels in |viewport|.  It is rounded out and padded by a pixel
+// for filtering, and clipped to the viewport.
+static CCRect SceneToWindow(const CCRect& rect, const kmMat4& view_projection,
+                            const CCRect& viewport) {
+  const float* m = view_projection.mat;
+  float xs[] = { rect.getMinX(), rect.getMaxX() };
+  float ys[] = { rect.getMinY(), rect.getMaxY() };
+  float min_x = viewport.getMaxX();
+  float min_y = viewport.getMaxY();
+  float max_x = viewport.getMinX();
+  float max_y = viewport.getMinY();
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      float w = m[3] * xs[i] + m[7] * ys[j] + m[15];
+      float ndc_x = (m[0] * xs[i] + m[4] * ys[j] + m[12]) / w;
+      float ndc_y = (m[1] * xs[i] + m[5] * ys[j] + m[13]) / w;
+      float x = viewport.origin.x + (ndc_x + 1) / 2 * viewport.size.width;
+      float y = viewport.origin.y + (ndc_y + 1) / 2 * viewport.size.height;
+      min_x = MIN(min_x, x);
+      min_y = MIN(min_y, y);
+      max_x = MAX(max_x, x);
+      max_y = MAX(max_y, y);
+    }
+  }
+  min_x = MAX(floorf(min_x) - 1, viewport.getMinX());
+  min_y = MAX(floorf(min_y) - 1, viewport.getMinY());
+  max_x = MIN(ceilf(max_x) + 1, viewport.getMaxX());
+  max_y = MIN(ceilf(max_y) + 1, viewport.getMaxY());
+  if (max_x <= min_x || max_y <= min_y)
+    return CCRectMake(0, 0, 0, 0);
+  return CCRectMake(min_x, min_y, max_x - min_x, max_y - min_y);
+}
+
+// Find the window rects to redraw to turn what |before| drew into what
+// |after| draws.  Returns false if the whole frame should be redrawn.
+static bool FindWindowDamage(const DrawList& before, const DrawList& after,
+                             const CCRect& viewport,
+                             std::vector<CCRect>* rects) {
+  const kmMat4& view_projection = after.view_projection();
+  if (memcmp(before.view_projection().mat, view_projection.mat,
+             sizeof(view_projection.mat))) {
+    return false;
+  }
+  std::vector<CCRect> scene_rects;
+  if (!FindDamage(before, after, kMaxDamageEdits, &scene_rects))
+    return false;
+  for (size_t i = 0; i < scene_rects.size(); i++) {
+    CCRect rect = SceneToWindow(scene_rects[i], view_projection, viewport);
+    if (rect.size.width > 0)
+      AddDamageRect(rect, kMaxDamageRects, rects);
+  }
+
+  // Merged rects may overlap, so this overestimates a little.
+  float area = 0;
+  for (size_t i = 0; i < rects->size(); i++)
+    area += (*rects)[i].size.width * (*rects)[i].size.height;
+  return area <= kMaxDamageFraction * viewport.size.width *
+                     viewport.size.height;
+}
+
+// DrawList::Execute bypasses the cocos2d-x GL state cache.  Put the state
+// it touched back to values the cache agrees with.
+static void ResyncStateCache() {
+  glUseProgram(0);
+  ccGLUseProgram(0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  ccGLBindTexture2D(0);
+  glEnable(GL_BLEND);
+  glBlendFunc(CC_BLEND_SRC, CC_BLEND_DST);
+  ccGLBlendFunc(CC_BLEND_SRC, CC_BLEND_DST);
+  // Execute leaves all three attributes enabled.
+  ccGLEnableVertexAttribs(kCCVertexAttribFlag_PosColorTex);
+}
+
+void RenderPipeline::Install(RenderMode mode) {
+  if (mode == kRenderDirect)
+    return;
+
+  RenderPipeline* pipeline = new RenderPipeline(mode);
+  CCDirector* director = CCDirector::sharedDirector();
+  director->setNotificationNode(pipeline);
+  // Record after everything else has updated the scene.
+  director->getScheduler()->scheduleUpdateForTarget(pipeline, INT_MAX, false);
+  pipeline->release();
+}
+
+RenderPipeline::RenderPipeline(RenderMode mode)
+    : mode_(mode),
+      thread_(NULL),
+      scene_(NULL),
+      hidden_(false),
+      list_index_(0),
+      frame_texture_(0),
+      frame_mvp_uniform_(-1),
+      retained_texture_(0),
+      retained_framebuffer_(0),
+      retained_valid_(false) {
+  if (mode_ == kRenderPartial) {
+    lists_[0].set_keep_items(true);
+    lists_[1].set_keep_items(true);
+  }
+  if (mode_ != kRenderThreaded)
+    return;
+
+  CCEGLView* view = CCEGLView::sharedOpenGLView();
+  CCSize frame_size = view->getFrameSize();
+  RenderContext* context = RenderContext::CreateShared();
+  if (context) {
+    thread_ = new RenderThread(context, frame_size.width, frame_size.height,
+                               view->getViewPortRect());
+    if (!thread_->Start()) {
+      delete thread_;
+      thread_ = NULL;
+    }
+  }
+  if (!thread_) {
+    CCLog("render thread unavailable, recording draw lists instead");
+    mode_ = kRenderRecorded;
+  }
+}
+
+RenderPipeline::~RenderPipeline() {
+  // Joins the thread, so neither list is in use after this.
+  delete thread_;
+  DeleteRetainedFrame();
+  CC_SAFE_RELEASE(scene_);
+}
+
+void RenderPipeline::update(float dt) {
+  CCScene* scene = CCDirector::sharedDirector()->getRunningScene();
+  if (scene != scene_) {
+    CC_SAFE_RETAIN(scene);
+    CC_SAFE_RELEASE(scene_);
+    scene_ = scene;
+    retained_valid_ = false;
+  }
+  // Leave hidden scenes, and ones we cannot record, to cocos2d-x.  What
+  // it draws isn't in the kept frame.
+  if (!scene_ || !scene_->isVisible()) {
+    retained_valid_ = false;
+    return;
+  }
+  // Recording releases the textures the list held from two frames ago.
+  // The render thread finished with it before the last Submit returned.
+  DrawList* list = &lists_[list_index_];
+  if (!RecordDrawList(scene_, list)) {
+    retained_valid_ = false;
+    return;
+  }
+
+  if (thread_) {
+    frame_texture_ = thread_->Submit(list);
+    list_index_ ^= 1;
+  }
+  scene_->setVisible(false);
+  hidden_ = true;
+}
+
+void RenderPipeline::visit() {
+  if (!hidden_)
+    return;
+  // Touch handlers (menus in particular) ignore hidden scenes, so the
+  // scene is only hidden while CCDirector visits it.
+  scene_->setVisible(true);
+  hidden_ = false;
+
+  // The director may have moved on to a new scene, which it has drawn.
+  if (scene_ != CCDirector::sharedDirector()->getRunningScene()) {
+    retained_valid_ = false;
+    return;
+  }
+
+  if (mode_ == kRenderPartial) {
+    CCSize frame_size = CCEGLView::sharedOpenGLView()->getFrameSize();
+    if (retained_framebuffer_ && !frame_size.equals(retained_size_))
+      DeleteRetainedFrame();
+    if (!retained_framebuffer_ && !CreateRetainedFrame(frame_size)) {
+      CCLog("can't keep frames, recording draw lists instead");
+      mode_ = kRenderRecorded;
+    }
+  }
+
+  if (thread_) {
+    DrawFrame(frame_texture_);
+  } else if (mode_ == kRenderPartial) {
+    DrawPartial();
+  } else {
+    const DrawList& list = lists_[list_index_];
+    list.Execute();
+    ResyncStateCache();
+    CC_INCREMENT_GL_DRAWS(list.command_count());
+  }
+}
+
+void RenderPipeline::DrawFrame(GLuint texture) {
+  // Nothing to show until the render thread has finished a frame.
+  if (!texture)
+    return;
+
+  CCGLProgram* program = CCShaderCache::sharedShaderCache()->programForKey(
+      kCCShader_PositionTexture);
+  program->use();
+  if (frame_mvp_uniform_ < 0) {
+    frame_mvp_uniform_ = glGetUniformLocation(program->getProgram(),
+                                              kCCUniformMVPMatrix_s);
+  }
+  kmMat4 identity;
+  kmMat4Identity(&identity);
+  program->setUniformLocationWithMatrix4fv(frame_mvp_uniform_, identity.mat,
+                                           1);
+
+  ccGLBindTexture2D(texture);
+  ccGLBlendFunc(GL_ONE, GL_ZERO);
+  ccGLEnableVertexAttribs(kCCVertexAttribFlag_Position |
+                          kCCVertexAttribFlag_TexCoords);
+  static const GLfloat kPositions[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+  static const GLfloat kTexCoords[] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+  glVertexAttribPointer(kCCVertexAttrib_Position, 2, GL_FLOAT, GL_FALSE, 0,
+                        kPositions);
+  glVertexAttribPointer(kCCVertexAttrib_TexCoords, 2, GL_FLOAT, GL_FALSE, 0,
+                        kTexCoords);
+
+  // The texture covers the whole frame buffer, not just the viewport.
+  CCSize frame_size = CCEGLView::sharedOpenGLView()->getFrameSize();
+  glViewport(0, 0, frame_size.width, frame_size.height);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  CCDirector::sharedDirector()->setViewport();
+  CC_INCREMENT_GL_DRAWS(1);
+}
+
+bool RenderPipeline::CreateRetainedFrame(const CCSize& size) {
+  GLint old_framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_framebuffer);
+  glGenTextures(1, &retained_texture_);
+  ccGLBindTexture2D(retained_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.width, size.height, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glGenFramebuffers(1, &retained_framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, retained_framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         retained_texture_, 0);
+  bool ok =
+      glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, old_framebuffer);
+  if (!ok) {
+    DeleteRetainedFrame();
+    return false;
+  }
+  retained_size_ = size;
+  retained_valid_ = false;
+  return true;
+}
+
+void RenderPipeline::DeleteRetainedFrame() {
+  if (retained_framebuffer_)
+    glDeleteFramebuffers(1, &retained_framebuffer_);
+  if (retained_texture_)
+    ccGLDeleteTexture(retained_texture_);
+  retained_framebuffer_ = 0;
+  retained_texture_ = 0;
+  retained_valid_ = false;
+}
+
+void RenderPipeline::DrawPartial() {
+  const DrawList& list = lists_[list_index_];
+  const DrawList& previous = lists_[list_index_ ^ 1];
+  CCRect viewport = CCEGLView::sharedOpenGLView()->getViewPortRect();
+  std::vector<CCRect> rects;
+  bool partial = retained_valid_ &&
+                 FindWindowDamage(previous, list, viewport, &rects);
+
+  // The kept frame is the size of the frame buffer, so the director's
+  // viewport applies as it is.
+  GLint old_framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, retained_framebuffer_);
+  if (partial) {
+    glEnable(GL_SCISSOR_TEST);
+    for (size_t i = 0; i < rects.size(); i++) {
+      const CCRect& rect = rects[i];
+      glScissor(rect.origin.x, rect.origin.y, rect.size.width,
+                rect.size.height);
+      glClear(GL_COLOR_BUFFER_BIT);
+      list.Execute();
+    }
+    glDisable(GL_SCISSOR_TEST);
+    CC_INCREMENT_GL_DRAWS(list.command_count() * rects.size());
+  } else {
+    glClear(GL_COLOR_BUFFER_BIT);
+    list.Execute();
+    CC_INCREMENT_GL_DRAWS(list.command_count());
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, old_framebuffer);
+  ResyncStateCache();
+
+  // The next list is recorded into the other one and compared with this.
+  retained_valid_ = true;
+  list_index_ ^= 1;
+  DrawFrame(retained_texture_);
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef RENDER_PIPELINE_H_
+#define RENDER_PIPELINE_H_
+
+#include "cocos2d.h"
+#include "draw_list.h"
+
+USING_NS_CC;
+
+class RenderThread;
+
+enum RenderMode {
+  // cocos2d-x visits and draws the scene itself.
+  kRenderDirect,
+  // The scene is recorded into a DrawList which is executed straight away
+  // on the cocos2d-x thread.
+  kRenderRecorded,
+  // Draw lists are executed by a render thread while the cocos2d-x thread
+  // runs the next frame.  What is shown lags the simulation by one frame.
+  kRenderThreaded,
+  // As kRenderRecorded, but into a frame kept from one frame to the next,
+  // redrawing only the parts of it that changed.
+  kRenderPartial,
+};
+
+/**
+ * Takes over drawing of the running scene.
+ *
+ * Each frame, after every other scheduled update has run, the scene is
+ * recorded into a DrawList and hidden so that CCDirector skips it.  The
+ * pipeline is the director's notification node, so it is visited right
+ * after the scene: it shows the scene again and draws the frame, either by
+ * executing the list or, in threaded mode, by drawing the texture that the
+ * render thread finished for the previous frame.  Frames that cannot be
+ * recorded (transitions, debug drawing...) are drawn by cocos2d-x.
+ *
+ * Threaded mode needs a second GL context sharing objects with the
+ * cocos2d-x one, which is only implemented for Linux (GLX, with
+ * XInitThreads() called before the window is created).  Elsewhere it falls
+ * back to recorded mode.
+ *
+ * In partial mode each list is compared with the previous one (see
+ * damage.h), the few rects covering what changed are redrawn into the
+ * kept frame with scissoring, and the frame is then copied to the screen.
+ * The whole frame is redrawn after anything drawn by cocos2d-x, such as a
+ * transition, when the view moves, and when too much has changed.
+ */
+class RenderPipeline : public CCNode {
+ public:
+  // Install a pipeline running in |mode| on the director.  Call once GL is
+  // set up.  Does nothing for kRenderDirect.
+  static void Install(RenderMode mode);
+
+  RenderMode mode() const { return mode_; }
+
+  virtual void update(float dt);
+  virtual void visit();
+
+ private:
+  explicit RenderPipeline(RenderMode mode);
+  ~RenderPipeline();
+
+  // Draw the render thread's |texture| over the whole frame buffer.
+  void DrawFrame(GLuint texture);
+
+  // kRenderPartial.  Bring the kept frame up to date with the list just
+  // recorded and show it.
+  void DrawPartial();
+  bool CreateRetainedFrame(const CCSize& size);
+  void DeleteRetainedFrame();
+
+  RenderMode mode_;
+  RenderThread* thread_;
+
+  // The scene being recorded, hidden from CCDirector until visit().
+  CCScene* scene_;
+  bool hidden_;
+
+  // Alternate lists, so that one can be recorded while the render thread
+  // executes the other.
+  DrawList lists_[2];
+  int list_index_;
+
+  // The last frame the render thread finished, or 0.
+  GLuint frame_texture_;
+  GLint frame_mvp_uniform_;
+
+  // The frame kept in partial mode, and whether it holds what the list
+  // recorded before the current one draws.
+  GLuint retained_texture_;
+  GLuint retained_framebuffer_;
+  CCSize retained_size_;
+  bool retained_valid_;
+};
+
+#endif  // RENDER_PIPELINE_H_
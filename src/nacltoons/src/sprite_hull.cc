@@ -0,0 +1,96 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+
+#include <map>
+
+#include "sprite_hull.h"
+
+// Textures are looked up by their unique object ID rather than their
+// address, which a later texture may reuse.  Label textures are replaced
+// whenever their text changes, so the map is dropped when it gets this
+// big; outlines stay loaded in g_hulls_by_path.
+static const size_t kMaxCachedTextures = 256;
+
+// Outline of each image looked up so far, or NULL if it has none.
+static std::map<std::string, SpriteHull*> g_hulls_by_path;
+static std::map<unsigned int, const SpriteHull*> g_hulls_by_texture;
+
+// Return the path |texture| was loaded from, or "".
+static std::string TexturePath(CCTexture2D* texture) {
+  CCDictionary* textures =
+      CCTextureCache::sharedTextureCache()->snapshotTextures();
+  CCDictElement* element;
+  CCDICT_FOREACH(textures, element) {
+    if (element->getObject() == texture)
+      return element->getStrKey();
+  }
+  return "";
+}
+
+const SpriteHull* SpriteHull::ForTexture(CCTexture2D* texture) {
+  if (!texture)
+    return NULL;
+  std::map<unsigned int, const SpriteHull*>::iterator it =
+      g_hulls_by_texture.find(texture->m_uID);
+  if (it != g_hulls_by_texture.end())
+    return it->second;
+
+  if (g_hulls_by_texture.size() >= kMaxCachedTextures)
+    g_hulls_by_texture.clear();
+  const SpriteHull* hull = NULL;
+  std::string path = TexturePath(texture);
+  if (!path.empty()) {
+    std::map<std::string, SpriteHull*>::iterator loaded =
+        g_hulls_by_path.find(path);
+    if (loaded == g_hulls_by_path.end())
+      loaded = g_hulls_by_path.insert(std::make_pair(path, Load(path))).first;
+    hull = loaded->second;
+  }
+  g_hulls_by_texture[texture->m_uID] = hull;
+  return hull;
+}
+
+SpriteHull* SpriteHull::Load(const std::string& image_path) {
+  size_t dot = image_path.rfind('.');
+  size_t slash = image_path.rfind('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return NULL;
+  std::string path = image_path.substr(0, dot) + ".hull";
+  CCFileUtils* utils = CCFileUtils::sharedFileUtils();
+  if (!utils->isFileExist(path))
+    return NULL;
+  unsigned long size = 0;
+  unsigned char* data = utils->getFileData(path.c_str(), "rb", &size);
+  if (!data)
+    return NULL;
+
+  // "u v" per line; lines starting with '#' are comments.
+  SpriteHull* hull = new SpriteHull;
+  std::string text(reinterpret_cast<char*>(data), size);
+  delete[] data;
+  size_t start = 0;
+  bool ok = true;
+  while (ok && start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos)
+      end = text.size();
+    std::string line = text.substr(start, end - start);
+    start = end + 1;
+    if (line.empty() || line[0] == '#')
+      continue;
+    float u;
+    float v;
+    ok = sscanf(line.c_str(), "%f %f", &u, &v) == 2 && u >= 0 && u <= 1 &&
+         v >= 0 && v <= 1;
+    hull->points_.push_back(ccp(u, v));
+  }
+  if (!ok || hull->points_.size() < 3) {
+    CCLog("invalid sprite outline: %s", path.c_str());
+    delete hull;
+    return NULL;
+  }
+  return hull;
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef SPRITE_HULL_H_
+#define SPRITE_HULL_H_
+
+#include <string>
+#include <vector>
+
+#include "cocos2d.h"
+
+USING_NS_CC;
+
+/**
+ * A convex polygon around the opaque pixels of an image, made by
+ * tools/sprite_hull.py and stored next to the image: images/ball.png has
+ * its outline in images/ball.hull.
+ *
+ * Draw lists (see draw_list.h) draw sprites that show the whole of such an
+ * image as a triangle fan over the polygon instead of a quad, so that the
+ * transparent corners of round sprites aren't blended.  Sprites drawn by
+ * cocos2d-x itself (kRenderDirect) are still quads.
+ */
+class SpriteHull {
+ public:
+  // Return the outline of the image |texture| was loaded from, or NULL if
+  // it has none or wasn't loaded through the texture cache.
+  static const SpriteHull* ForTexture(CCTexture2D* texture);
+
+  // Points in order around the polygon, in texture coordinates of the
+  // image: (0, 0) is its top left corner and (1, 1) its bottom right.
+  const std::vector<CCPoint>& points() const { return points_; }
+
+ private:
+  SpriteHull() {}
+
+  // Load the outline for |image_path|, or return NULL.
+  static SpriteHull* Load(const std::string& image_path);
+
+  std::vector<CCPoint> points_;
+};
+
+#endif  // SPRITE_HULL_H_
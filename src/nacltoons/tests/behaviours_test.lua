@@ -0,0 +1,83 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+require "lunit"
+
+module("behaviours_test", lunit.testcase, package.seeall)
+
+behaviours = require "behaviours"
+
+--- Stand-in for the native BehaviourManager that records calls.
+local function MockManager()
+    local manager = { calls = {} }
+    setmetatable(manager, { __index = function(_, name)
+        return function(self, ...)
+            table.insert(self.calls, { name, ... })
+        end
+    end })
+    return manager
+end
+
+function setup()
+    -- util.PointFromLua works with these globals.
+    _G.game_obj = { origin = { x = 10, y = 20 } }
+    _G.ccp = function(x, y) return { x = x, y = y } end
+end
+
+function test_CheckValid()
+    assert_nil(behaviours.Check({ type = 'collectible' }))
+    assert_nil(behaviours.Check({ type = 'goal', collector = 'BALL', requires = 'stars' }))
+    assert_nil(behaviours.Check({ type = 'mover', path = { { 0, 0 } }, speed = 10, mode = 'once' }))
+end
+
+function test_CheckInvalid()
+    assert_not_nil(behaviours.Check({ type = 'teleporter' }))
+    assert_not_nil(behaviours.Check({ type = 'rotator' }))
+    assert_not_nil(behaviours.Check({ type = 'rotator', speed = 90, path = { } }))
+    assert_not_nil(behaviours.Check({ type = 'mover', path = { }, speed = 10, mode = 'bounce' }))
+end
+
+function test_AttachDefaults()
+    local manager = MockManager()
+    local object = { tag = 3, behaviours = {
+        { type = 'collectible' },
+        { type = 'goal', collector = 'BALL', requires = 'stars' },
+    } }
+    behaviours.Attach(manager, object, { BALL = 1 }, { })
+    assert_equal(2, #manager.calls)
+    local call = manager.calls[1]
+    assert_equal('AddCollectible', call[1])
+    assert_equal(3, call[2])
+    assert_equal(0, call[3])
+    assert_equal('default', call[4])
+    assert_equal(0.5, call[5])
+    call = manager.calls[2]
+    assert_equal('AddGoal', call[1])
+    assert_equal(1, call[3])
+    assert_equal('stars', call[4])
+end
+
+function test_AttachMover()
+    local manager = MockManager()
+    local object = { tag = 5, behaviours = {
+        { type = 'mover', path = { { 0, 0 }, { 100, 50 } }, speed = 40 },
+    } }
+    behaviours.Attach(manager, object, { }, { })
+    assert_equal(3, #manager.calls)
+    assert_equal('AddMover', manager.calls[1][1])
+    assert_equal('loop', manager.calls[1][4])
+    -- Points are made absolute like any other level.def position.
+    local point = manager.calls[3]
+    assert_equal('AddMoverPoint', point[1])
+    assert_equal(110, point[3])
+    assert_equal(70, point[4])
+end
+
+function test_AttachUnknownCollector()
+    local function doError()
+        local object = { tag = 1, behaviours = { { type = 'goal', collector = 'BALL' } } }
+        behaviours.Attach(MockManager(), object, { }, { })
+    end
+    assert_error("unknown collector failed to generate error", doError)
+end
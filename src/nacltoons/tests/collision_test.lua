@@ -0,0 +1,117 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+require "lunit"
+
+module("collision_test", lunit.testcase, package.seeall)
+
+collision = require "collision"
+validate = require "validate"
+
+game_layers = {
+    ball = { 'default', 'stroke', 'collectible' },
+    collectible = {},
+}
+
+function test_BuiltinLayers()
+    local matrix = collision.NewMatrix()
+    -- Level shapes meet each other and finished strokes, strokes being
+    -- drawn only meet each other.
+    assert_true(matrix:ShouldCollide(nil, 'default'))
+    assert_true(matrix:ShouldCollide('default', 'stroke'))
+    assert_true(matrix:ShouldCollide('stroke', 'stroke'))
+    assert_true(matrix:ShouldCollide('drawing', 'drawing'))
+    assert_false(matrix:ShouldCollide('drawing', 'default'))
+    assert_false(matrix:ShouldCollide('drawing', 'stroke'))
+end
+
+function test_DeclaredLayers()
+    local matrix = collision.NewMatrix(game_layers)
+    -- Pairs only need listing on one side.
+    assert_true(matrix:ShouldCollide('collectible', 'ball'))
+    assert_true(matrix:ShouldCollide('stroke', 'ball'))
+    assert_false(matrix:ShouldCollide('collectible', 'default'))
+    assert_false(matrix:ShouldCollide('collectible', 'stroke'))
+    assert_false(matrix:ShouldCollide('collectible', 'collectible'))
+    assert_false(matrix:ShouldCollide('ball', 'ball'))
+
+    local category, mask = matrix:Filter('collectible')
+    assert_equal(16, category)
+    assert_equal(8, mask)
+end
+
+function test_LevelLayersReplaceGameLayers()
+    local matrix = collision.NewMatrix(game_layers, { collectible = { 'stroke' } })
+    assert_true(matrix:ShouldCollide('collectible', 'stroke'))
+    -- The ball still lists collectibles.
+    assert_true(matrix:ShouldCollide('collectible', 'ball'))
+end
+
+function test_UnknownLayer()
+    assert_error(function()
+        collision.NewMatrix({ ball = { 'terrain' } })
+    end)
+    assert_error(function()
+        collision.NewMatrix():Filter('ball')
+    end)
+    assert_equal('collision layer ball must list the layers it collides with',
+                 collision.Check({ ball = 'default' }))
+end
+
+function test_TooManyLayers()
+    local layers = {}
+    for i = 1, collision.MAX_LAYERS - 3 do
+        layers['layer' .. i] = {}
+    end
+    collision.NewMatrix(layers)
+    layers.extra = {}
+    assert_error(function() collision.NewMatrix(layers) end)
+end
+
+function test_ValidateLayers()
+    local gamedef = { collision_layers = game_layers }
+    validate.ValidateGameDef('dummygame.def', gamedef)
+    local level = { shapes = {
+        { type = 'image', image = 'ball_image', layer = 'ball' },
+        { type = 'compound', children = { { type = 'image', layer = 'collectible' } } },
+    } }
+    validate.ValidateLevelDef('dummylevel.def', gamedef, level)
+
+    level.shapes[2].children[1].layer = 'terrain'
+    assert_error(function()
+        validate.ValidateLevelDef('dummylevel.def', gamedef, level)
+    end)
+end
+
+--- Count the pairs of fixtures the filter lets Box2D make contacts for.
+local function CountPairs(matrix, layers)
+    local count = 0
+    for i = 1, #layers do
+        for j = i + 1, #layers do
+            if matrix:ShouldCollide(layers[i], layers[j]) then
+                count = count + 1
+            end
+        end
+    end
+    return count
+end
+
+function test_FewerPairs()
+    -- A ball, ten stars, ten ramps and ten strokes.
+    local with_layers = { 'ball' }
+    local without_layers = { 'default' }
+    for i = 1, 10 do
+        table.insert(with_layers, 'collectible')
+        table.insert(with_layers, 'default')
+        table.insert(with_layers, 'stroke')
+        for j = 1, 3 do
+            table.insert(without_layers, 'default')
+        end
+    end
+    local pairs_before = CountPairs(collision.NewMatrix(), without_layers)
+    local pairs_after = CountPairs(collision.NewMatrix(game_layers), with_layers)
+    assert_equal(465, pairs_before)
+    -- ball with everything, then ramps and strokes among themselves.
+    assert_equal(30 + 190, pairs_after)
+end
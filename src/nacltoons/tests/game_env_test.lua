@@ -0,0 +1,77 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+require "lunit"
+
+module("game_env_test", lunit.testcase, package.seeall)
+
+game_env = require "game_env"
+path = require "path"
+
+local GAMES = 'tests/games'
+
+local function LoadGame(name)
+    local root = path.join(GAMES, name)
+    local env = game_env.New(root)
+    return env, game_env.DoFile(env, path.join(root, 'game.lua'))
+end
+
+function test_GlobalsStayInGame()
+    local first_env, first = LoadGame('first')
+    local second_env, second = LoadGame('second')
+    assert_equal('first', first.Name())
+    assert_equal('second', second.Name())
+    assert_equal('first', first_env.game_name)
+    assert_nil(second_env.level_data)
+    assert_nil(rawget(_G, 'game_name'))
+    assert_nil(rawget(_G, 'level_data'))
+end
+
+function test_GameModules()
+    local _, first = LoadGame('first')
+    assert_equal(1, first.Count())
+    assert_equal(2, first.Count())
+    assert_nil(package.loaded.counter)
+
+    -- Loading the game again starts from scratch.
+    local _, reloaded = LoadGame('first')
+    assert_equal(1, reloaded.Count())
+end
+
+function test_EngineModuleViews()
+    local _, first = LoadGame('first')
+    local _, second = LoadGame('second')
+    assert_equal('first', first.path.basename('a/b'))
+    assert_nil(second.path.basename)
+    assert_nil(path.basename)
+    -- The rest of the module is shared.
+    assert_equal(path.join, first.path.join)
+    assert_equal('a/b', second.path.join('a', 'b'))
+end
+
+function test_UnloadReclaimsMemory()
+    local weak = setmetatable({}, { __mode = 'k' })
+    local env, first = LoadGame('first')
+    weak[env] = true
+    weak[first] = true
+    env = nil
+    first = nil
+    collectgarbage('collect')
+    assert_nil(next(weak))
+
+    -- Switching back and forth does not grow the heap.
+    local _, current = LoadGame('second')
+    current = nil
+    collectgarbage('collect')
+    local before = collectgarbage('count')
+    for i = 1, 20 do
+        _, current = LoadGame('first')
+        assert_equal('first', current.Name())
+        _, current = LoadGame('second')
+        assert_equal('second', current.Name())
+    end
+    current = nil
+    collectgarbage('collect')
+    assert_true(collectgarbage('count') - before < 64)
+end
@@ -0,0 +1,10 @@
+-- Module private to the 'first' test game.
+
+local counter = { value = 0 }
+
+function counter.Next()
+    counter.value = counter.value + 1
+    return counter.value
+end
+
+return counter
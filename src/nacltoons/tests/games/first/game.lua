@@ -0,0 +1,31 @@
+-- Game script loaded by game_env_test.lua.  It defines globals, requires
+-- a module from its own folder and overrides an engine module function.
+
+local counter = require 'counter'
+local path = require 'path'
+
+game_name = 'first'
+
+-- Enough data for the test to notice if it is never freed.
+level_data = {}
+for i = 1, 10000 do
+    level_data[i] = { i }
+end
+
+function path.basename(filename)
+    return 'first'
+end
+
+local handlers = {}
+
+function handlers.Name()
+    return game_name
+end
+
+function handlers.Count()
+    return counter.Next()
+end
+
+handlers.path = path
+
+return handlers
@@ -0,0 +1,9 @@
+-- Worker module of the 'first' test game, used by tools/lua_workers_test.cc.
+
+local solver = {}
+
+function solver.Name()
+    return 'first'
+end
+
+return solver
@@ -0,0 +1,15 @@
+-- Game script loaded by game_env_test.lua.
+
+local path = require 'path'
+
+game_name = 'second'
+
+local handlers = {}
+
+function handlers.Name()
+    return game_name
+end
+
+handlers.path = path
+
+return handlers
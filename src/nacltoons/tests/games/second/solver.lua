@@ -0,0 +1,9 @@
+-- Worker module of the 'second' test game, used by tools/lua_workers_test.cc.
+
+local solver = {}
+
+function solver.Name()
+    return 'second'
+end
+
+return solver
@@ -0,0 +1,77 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+require "lunit"
+
+module("prefab_test", lunit.testcase, package.seeall)
+
+prefab = require "prefab"
+
+box = {
+    type = 'compound',
+    dynamic = true,
+    color = { 10, 20, 30 },
+    children = {
+        { type = 'line', start = { 0, 0 }, finish = { 0, 100 } },
+        { type = 'line', start = { 0, 100 }, finish = { 100, 100 } },
+        { type = 'image', pos = { 50, 50 }, image = 'star_image', sensor = true },
+    },
+}
+
+function test_CompileLine()
+    local geometry = prefab.Compile(box, 1, 10)
+    assert_equal(2, #geometry.lines)
+    assert_equal(1, #geometry.images)
+
+    local line = geometry.lines[1]
+    assert_equal(50, line.half_length)
+    assert_equal(0, line.center[1])
+    assert_equal(50, line.center[2])
+    assert_equal(math.pi / 2, line.angle)
+    assert_equal(10, #line.sprites)
+    assert_equal(0, line.sprites[10][1])
+    assert_equal(100, line.sprites[10][2])
+end
+
+function test_CompileScale()
+    local geometry = prefab.Compile(box, 2, 10)
+    assert_equal(100, geometry.lines[2].half_length)
+    assert_equal(20, #geometry.lines[2].sprites)
+    assert_equal(100, geometry.images[1].pos[1])
+    assert_equal(2, geometry.scale)
+end
+
+function test_GeometryShared()
+    local library = prefab.NewLibrary(nil, { box = box }, 10)
+    local first = library:Geometry({ prefab = 'box', pos = { 0, 0 } })
+    local second = library:Geometry({ prefab = 'box', pos = { 200, 0 } })
+    local scaled = library:Geometry({ prefab = 'box', pos = { 0, 0 }, scale = 2 })
+    assert_true(rawequal(first, second))
+    assert_false(rawequal(first, scaled))
+end
+
+function test_ResolveInherits()
+    local library = prefab.NewLibrary({ box = box }, nil, 10)
+    local instance = library:Resolve({ prefab = 'box', pos = { 0, 0 } })
+    assert_equal(true, instance.dynamic)
+    assert_equal(box.color, instance.color)
+
+    instance = library:Resolve({ prefab = 'box', pos = { 0, 0 }, dynamic = false })
+    assert_equal(false, instance.dynamic)
+end
+
+function test_LevelPrefabHidesGamePrefab()
+    local level_box = { type = 'compound', children = {} }
+    local library = prefab.NewLibrary({ box = box }, { box = level_box }, 10)
+    local geometry = library:Geometry({ prefab = 'box', pos = { 0, 0 } })
+    assert_equal(0, #geometry.lines)
+end
+
+function test_UnknownPrefab()
+    local library = prefab.NewLibrary(nil, nil, 10)
+    local function doError()
+        library:Resolve({ prefab = 'missing', pos = { 0, 0 } })
+    end
+    assert_error("unknown prefab failed to generate error", doError)
+end
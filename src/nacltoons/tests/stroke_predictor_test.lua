@@ -0,0 +1,71 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+require "lunit"
+
+module("stroke_predictor_test", lunit.testcase, package.seeall)
+
+stroke_predictor = require "stroke_predictor"
+
+function test_NeedsTwoSamples()
+    local predictor = stroke_predictor.New()
+    assert_nil(predictor:Predict())
+    predictor:AddSample(10, 10, 1.0)
+    assert_nil(predictor:Predict())
+end
+
+function test_ExtrapolatesVelocity()
+    local predictor = stroke_predictor.New({ lookahead = 0.5, window = 1 })
+    predictor:AddSample(0, 0, 1.0)
+    predictor:AddSample(10, 5, 1.25)
+    predictor:AddSample(20, 10, 1.5)
+    -- 40 points/s along x and 20 along y.
+    local x, y = predictor:Predict()
+    assert_equal(20 + 20, x)
+    assert_equal(10 + 10, y)
+end
+
+function test_LimitsDistance()
+    local predictor = stroke_predictor.New({ lookahead = 1, max_distance = 30 })
+    predictor:AddSample(0, 0, 1.0)
+    predictor:AddSample(0, 100, 1.01)
+    local x, y = predictor:Predict()
+    assert_equal(0, x)
+    assert_equal(130, y)
+end
+
+function test_OnlyRecentSamples()
+    local predictor = stroke_predictor.New({ lookahead = 0.5, window = 0.5 })
+    predictor:AddSample(-1000, 0, 0)
+    predictor:AddSample(0, 0, 1.0)
+    predictor:AddSample(10, 0, 1.25)
+    local x, y = predictor:Predict()
+    assert_equal(30, x)
+    assert_equal(0, y)
+
+    -- A touch that stopped moving has no velocity to go on.
+    predictor:AddSample(10, 0, 2.0)
+    assert_nil(predictor:Predict())
+end
+
+function test_ResetAndDisable()
+    local predictor = stroke_predictor.New({ enabled = false })
+    predictor:AddSample(0, 0, 1.0)
+    predictor:AddSample(10, 0, 1.01)
+    assert_nil(predictor:Predict())
+
+    predictor:Configure(nil)
+    assert_true(predictor.enabled)
+    assert_not_nil(predictor:Predict())
+    predictor:Reset()
+    assert_nil(predictor:Predict())
+end
+
+function test_Check()
+    assert_nil(stroke_predictor.Check({ lookahead = 0.05, enabled = false }))
+    assert_equal('invalid key in stroke_prediction: speed',
+                 stroke_predictor.Check({ speed = 1 }))
+    assert_equal('stroke_prediction.lookahead must be a number',
+                 stroke_predictor.Check({ lookahead = 'soon' }))
+end
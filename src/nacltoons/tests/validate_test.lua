@@ -29,3 +29,45 @@ function test_LevelDefInvalidKey()
     end
     assert_error("invalid key failed to generate error", doError)
 end
+
+function test_LevelDefPrefab()
+    local level = {
+        prefabs = { box = { type = 'compound', children = {
+            { type = 'line', start = { 0, 0 }, finish = { 0, 100 } } } } },
+        shapes = { { prefab = 'box', pos = { 10, 10 }, tag = 'BOX' } },
+    }
+    validate.ValidateLevelDef('dummylevel.def', { }, level)
+end
+
+function test_LevelDefUnknownPrefab()
+    local function doError()
+        local level = { shapes = { { prefab = 'box', pos = { 10, 10 } } } }
+        validate.ValidateLevelDef('dummylevel.def', { }, level)
+    end
+    assert_error("unknown prefab failed to generate error", doError)
+end
+
+function test_PrefabInvalidType()
+    local function doError()
+        local level = { prefabs = { box = { type = 'line', children = { } } } }
+        validate.ValidateLevelDef('dummylevel.def', { }, level)
+    end
+    assert_error("non-compound prefab failed to generate error", doError)
+end
+
+function test_LevelDefBehaviours()
+    local level = { shapes = {
+        { type = 'image', pos = { 10, 10 }, image = 'star_image',
+          behaviours = { { type = 'collectible', collector = 'BALL' } } } } }
+    validate.ValidateLevelDef('dummylevel.def', { }, level)
+end
+
+function test_LevelDefInvalidBehaviour()
+    local function doError()
+        local level = { shapes = {
+            { type = 'image', pos = { 10, 10 }, image = 'star_image',
+              behaviours = { { type = 'rotator' } } } } }
+        validate.ValidateLevelDef('dummylevel.def', { }, level)
+    end
+    assert_error("invalid behaviour failed to generate error", doError)
+end
@@ -0,0 +1,33 @@
+-- Copyright (c) 2013 The Chromium Authors. All rights reserved.
+-- Use of this source code is governed by a BSD-style license that can be
+-- found in the LICENSE file.
+
+--- Worker functions called by tools/lua_workers_test.cc.
+
+local worker_jobs = {}
+
+function worker_jobs.Sum(values)
+    local sum = 0
+    for _, value in ipairs(values) do
+        sum = sum + value
+    end
+    return sum, { count = #values }
+end
+
+function worker_jobs.FailWithString()
+    error('bad input', 0)
+end
+
+function worker_jobs.FailWithTable()
+    error({ code = 42 })
+end
+
+function worker_jobs.FailWithNil()
+    error()
+end
+
+function worker_jobs.ReturnFunction()
+    return print
+end
+
+return worker_jobs
@@ -0,0 +1,762 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// GL call recorder, loaded into the Linux build with LD_PRELOAD:
+//
+//   export GLTRACE_FILE=level.gltrace GLTRACE_START=300 GLTRACE_FRAMES=5
+//   LD_PRELOAD=out/libgltrace.so ./nacltoons
+//
+// Every GL function in gltrace_format.h is replaced by one that records the
+// call and then forwards it to the real one.  Functions looked up through
+// glXGetProcAddress or eglGetProcAddress, as GLEW does for everything past
+// GL 1.1, get the same wrappers.  Buffer swaps end frames.
+//
+// From the start, state changes and uploads are recorded so that the
+// replayer can recreate textures, buffers and programs.  Frames
+// GLTRACE_START to GLTRACE_START + GLTRACE_FRAMES - 1 are recorded in full,
+// together with the client side vertex and index data each draw reads.
+// After that the file is closed and calls go straight through.
+//
+// Only the first thread to make a GL call is recorded, so the game should
+// be run without --render-thread.  Vertex array objects are not handled.
+
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glx.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <vector>
+
+#include "gltrace_format.h"
+
+namespace {
+
+enum CallKind {
+  kSTATE,
+  kDRAW,
+};
+
+FILE* g_file;
+const char* g_path;
+TraceHeader g_header;
+bool g_done;
+unsigned int g_frame;
+
+// Contents of element array buffers, to find the vertices a draw reads.
+std::map<GLuint, std::vector<char> > g_element_buffers;
+
+pthread_once_t g_thread_once = PTHREAD_ONCE_INIT;
+pthread_t g_thread;
+
+void SetTracedThread() {
+  g_thread = pthread_self();
+}
+
+void* Real(const char* name) {
+  void* proc = dlsym(RTLD_NEXT, name);
+  if (proc)
+    return proc;
+
+  typedef void* (*GetProcAddress)(const char*);
+  static GetProcAddress glx_get_proc_address =
+      reinterpret_cast<GetProcAddress>(dlsym(RTLD_NEXT,
+                                             "glXGetProcAddressARB"));
+  static GetProcAddress egl_get_proc_address =
+      reinterpret_cast<GetProcAddress>(dlsym(RTLD_NEXT, "eglGetProcAddress"));
+  if (glx_get_proc_address)
+    proc = glx_get_proc_address(name);
+  if (!proc && egl_get_proc_address)
+    proc = egl_get_proc_address(name);
+  if (!proc) {
+    fprintf(stderr, "gltrace: %s not found\n", name);
+    abort();
+  }
+  return proc;
+}
+
+#define REAL(name) \
+  static PFN_##name real_##name = \
+      reinterpret_cast<PFN_##name>(Real(#name))
+
+typedef void (*PFN_glGetIntegerv)(GLenum, GLint*);
+typedef void (*PFN_glGetVertexAttribiv)(GLuint, GLenum, GLint*);
+typedef void (*PFN_glGetVertexAttribPointerv)(GLuint, GLenum, GLvoid**);
+
+GLint GetInteger(GLenum pname) {
+  REAL(glGetIntegerv);
+  GLint value = 0;
+  real_glGetIntegerv(pname, &value);
+  return value;
+}
+
+void Finish() {
+  if (!g_file)
+    return;
+  g_header.frame_count =
+      g_frame > g_header.first_frame ? g_frame - g_header.first_frame : 0;
+  fseek(g_file, 0, SEEK_SET);
+  fwrite(&g_header, sizeof(g_header), 1, g_file);
+  fclose(g_file);
+  g_file = NULL;
+  g_done = true;
+  g_element_buffers.clear();
+  fprintf(stderr, "gltrace: wrote %u frames to %s\n", g_header.frame_count,
+          g_path);
+}
+
+__attribute__((destructor)) void FinishAtExit() {
+  Finish();
+}
+
+unsigned int EnvInt(const char* name, unsigned int default_value) {
+  const char* value = getenv(name);
+  return value ? strtoul(value, NULL, 10) : default_value;
+}
+
+bool Open() {
+  g_path = getenv("GLTRACE_FILE");
+  if (!g_path)
+    g_path = "nacltoons.gltrace";
+  g_file = fopen(g_path, "wb");
+  if (!g_file) {
+    fprintf(stderr, "gltrace: can't open %s\n", g_path);
+    g_done = true;
+    return false;
+  }
+  setvbuf(g_file, NULL, _IOFBF, 1 << 20);
+
+  g_header.magic = GLTRACE_MAGIC;
+  g_header.version = GLTRACE_VERSION;
+  g_header.first_frame = EnvInt("GLTRACE_START", 100);
+  unsigned int frames = EnvInt("GLTRACE_FRAMES", 5);
+  fwrite(&g_header, sizeof(g_header), 1, g_file);
+  fprintf(stderr, "gltrace: recording frames %u to %u to %s\n",
+          g_header.first_frame, g_header.first_frame + frames - 1, g_path);
+  g_header.frame_count = frames;
+  return true;
+}
+
+// Whether a call of |kind| made now should be recorded.
+bool Recording(CallKind kind) {
+  if (g_done)
+    return false;
+  pthread_once(&g_thread_once, SetTracedThread);
+  if (!pthread_equal(g_thread, pthread_self())) {
+    static bool warned;
+    if (!warned)
+      fprintf(stderr, "gltrace: ignoring GL calls from a second thread\n");
+    warned = true;
+    return false;
+  }
+  if (!g_file && !Open())
+    return false;
+  return kind == kSTATE || g_frame >= g_header.first_frame;
+}
+
+void Write(const void* data, size_t size) {
+  fwrite(data, size, 1, g_file);
+}
+
+void Write(unsigned int value) { Write(&value, sizeof(value)); }
+void Write(int value) { Write(&value, sizeof(value)); }
+void Write(float value) { Write(&value, sizeof(value)); }
+void Write(double value) { Write(&value, sizeof(value)); }
+void Write(int64_t value) { Write(&value, sizeof(value)); }
+void Write(unsigned char value) { Write(static_cast<unsigned int>(value)); }
+
+void WriteOp(TraceOpcode op) {
+  uint8_t byte = op;
+  Write(&byte, 1);
+}
+
+void WriteData(const void* data, size_t size) {
+  Write(static_cast<unsigned int>(size));
+  if (size)
+    Write(data, size);
+}
+
+void WriteString(const char* string, int length) {
+  WriteData(string, length < 0 ? strlen(string) : length);
+}
+
+void WriteArgs() {}
+
+template <typename A1>
+void WriteArgs(A1 a1) {
+  Write(a1);
+}
+
+template <typename A1, typename A2>
+void WriteArgs(A1 a1, A2 a2) {
+  Write(a1);
+  Write(a2);
+}
+
+template <typename A1, typename A2, typename A3>
+void WriteArgs(A1 a1, A2 a2, A3 a3) {
+  WriteArgs(a1, a2);
+  Write(a3);
+}
+
+template <typename A1, typename A2, typename A3, typename A4>
+void WriteArgs(A1 a1, A2 a2, A3 a3, A4 a4) {
+  WriteArgs(a1, a2, a3);
+  Write(a4);
+}
+
+template <typename A1, typename A2, typename A3, typename A4, typename A5>
+void WriteArgs(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5) {
+  WriteArgs(a1, a2, a3, a4);
+  Write(a5);
+}
+
+template <typename A1, typename A2, typename A3, typename A4, typename A5,
+          typename A6>
+void WriteArgs(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6) {
+  WriteArgs(a1, a2, a3, a4, a5);
+  Write(a6);
+}
+
+template <typename A1, typename A2, typename A3, typename A4, typename A5,
+          typename A6, typename A7, typename A8>
+void WriteArgs(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8) {
+  WriteArgs(a1, a2, a3, a4, a5, a6);
+  Write(a7);
+  Write(a8);
+}
+
+int TypeSize(GLenum type) {
+  switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+      return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+    case GL_HALF_FLOAT:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+// Bytes read by glTex(Sub)Image2D for an image of the given size.
+size_t ImageSize(GLsizei width, GLsizei height, GLenum format, GLenum type) {
+  if (width <= 0 || height <= 0)
+    return 0;
+  int components;
+  switch (format) {
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+    case GL_RED:
+    case GL_DEPTH_COMPONENT:
+      components = 1;
+      break;
+    case GL_LUMINANCE_ALPHA:
+    case GL_RG:
+      components = 2;
+      break;
+    case GL_RGB:
+    case GL_BGR:
+      components = 3;
+      break;
+    default:
+      components = 4;
+      break;
+  }
+  bool packed = type == GL_UNSIGNED_SHORT_5_6_5 ||
+                type == GL_UNSIGNED_SHORT_4_4_4_4 ||
+                type == GL_UNSIGNED_SHORT_5_5_5_1;
+  size_t pixel = packed ? 2 : components * TypeSize(type);
+  size_t alignment = GetInteger(GL_UNPACK_ALIGNMENT);
+  // The query leaves 0 without a working context; assume GL's default.
+  if (alignment != 1 && alignment != 2 && alignment != 8)
+    alignment = 4;
+  size_t row = (width * pixel + alignment - 1) / alignment * alignment;
+  return row * (height - 1) + width * pixel;
+}
+
+GLuint MaxIndex(GLenum type, const void* indices, GLsizei count) {
+  GLuint max = 0;
+  for (GLsizei i = 0; i < count; i++) {
+    GLuint index;
+    if (type == GL_UNSIGNED_BYTE)
+      index = static_cast<const GLubyte*>(indices)[i];
+    else if (type == GL_UNSIGNED_SHORT)
+      index = static_cast<const GLushort*>(indices)[i];
+    else
+      index = static_cast<const GLuint*>(indices)[i];
+    if (index > max)
+      max = index;
+  }
+  return max;
+}
+
+// Record the client side vertex arrays read by a draw of vertices 0 to
+// |max_vertex|.
+void WriteClientArrays(GLuint max_vertex) {
+  REAL(glGetVertexAttribiv);
+  REAL(glGetVertexAttribPointerv);
+  GLint attribs = GetInteger(GL_MAX_VERTEX_ATTRIBS);
+  for (GLint i = 0; i < attribs; i++) {
+    GLint enabled, buffer, size, type, normalized, stride;
+    real_glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+    real_glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING,
+                             &buffer);
+    if (!enabled || buffer)
+      continue;
+    real_glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+    real_glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+    real_glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED,
+                             &normalized);
+    real_glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+    GLvoid* pointer = NULL;
+    real_glGetVertexAttribPointerv(i, GL_VERTEX_ATTRIB_ARRAY_POINTER,
+                                   &pointer);
+    if (!pointer)
+      continue;
+
+    size_t element = size * TypeSize(type);
+    size_t step = stride ? stride : element;
+    WriteOp(kOp_ClientArray);
+    WriteArgs(i, size, type, normalized, stride);
+    WriteData(pointer, max_vertex * step + element);
+  }
+}
+
+}  // namespace
+
+// Wrappers for the functions that only take scalars.
+#define GLTRACE_SCALAR_WRAPPER(name, kind, count, types) \
+  extern "C" void name GLTRACE_PARAMS(count, types) { \
+    typedef void (*Proc) GLTRACE_PARAMS(count, types); \
+    static Proc real = reinterpret_cast<Proc>(Real(#name)); \
+    if (Recording(k##kind)) { \
+      WriteOp(kOp_##name); \
+      WriteArgs GLTRACE_ARGS(count); \
+    } \
+    real GLTRACE_ARGS(count); \
+  }
+GLTRACE_SCALAR_FUNCTIONS(GLTRACE_SCALAR_WRAPPER)
+#undef GLTRACE_SCALAR_WRAPPER
+
+// The rest, in the order of GLTRACE_CUSTOM_FUNCTIONS.  Their records are
+// described next to each one.
+
+typedef void (*PFN_glBindAttribLocation)(GLuint, GLuint, const GLchar*);
+typedef void (*PFN_glBufferData)(GLenum, GLsizeiptr, const GLvoid*, GLenum);
+typedef void (*PFN_glBufferSubData)(GLenum, GLintptr, GLsizeiptr,
+                                    const GLvoid*);
+typedef void (*PFN_glCompressedTexImage2D)(GLenum, GLint, GLenum, GLsizei,
+                                           GLsizei, GLint, GLsizei,
+                                           const GLvoid*);
+typedef GLuint (*PFN_glCreateProgram)();
+typedef GLuint (*PFN_glCreateShader)(GLenum);
+typedef void (*PFN_glDeleteNames)(GLsizei, const GLuint*);
+typedef void (*PFN_glDrawArrays)(GLenum, GLint, GLsizei);
+typedef void (*PFN_glDrawElements)(GLenum, GLsizei, GLenum, const GLvoid*);
+typedef void (*PFN_glGenNames)(GLsizei, GLuint*);
+typedef GLint (*PFN_glGetUniformLocation)(GLuint, const GLchar*);
+typedef void (*PFN_glShaderSource)(GLuint, GLsizei, const GLchar* const*,
+                                   const GLint*);
+typedef void (*PFN_glTexImage2D)(GLenum, GLint, GLint, GLsizei, GLsizei,
+                                 GLint, GLenum, GLenum, const GLvoid*);
+typedef void (*PFN_glTexSubImage2D)(GLenum, GLint, GLint, GLint, GLsizei,
+                                    GLsizei, GLenum, GLenum, const GLvoid*);
+typedef void (*PFN_glUniformfv)(GLint, GLsizei, const GLfloat*);
+typedef void (*PFN_glUniformiv)(GLint, GLsizei, const GLint*);
+typedef void (*PFN_glUniformMatrixfv)(GLint, GLsizei, GLboolean,
+                                      const GLfloat*);
+typedef void (*PFN_glVertexAttribPointer)(GLuint, GLint, GLenum, GLboolean,
+                                          GLsizei, const GLvoid*);
+
+// program, index, name
+extern "C" void glBindAttribLocation(GLuint program, GLuint index,
+                                     const GLchar* name) {
+  REAL(glBindAttribLocation);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glBindAttribLocation);
+    WriteArgs(program, index);
+    WriteString(name, -1);
+  }
+  real_glBindAttribLocation(program, index, name);
+}
+
+static void ShadowElementBuffer(GLenum target, GLintptr offset,
+                                GLsizeiptr size, const GLvoid* data,
+                                bool resize) {
+  if (target != GL_ELEMENT_ARRAY_BUFFER)
+    return;
+  std::vector<char>& shadow =
+      g_element_buffers[GetInteger(GL_ELEMENT_ARRAY_BUFFER_BINDING)];
+  if (resize)
+    shadow.resize(size);
+  if (data && offset + size <= static_cast<GLsizeiptr>(shadow.size()))
+    memcpy(&shadow[offset], data, size);
+}
+
+// target, size (64 bits), data (empty for NULL), usage
+extern "C" void glBufferData(GLenum target, GLsizeiptr size,
+                             const GLvoid* data, GLenum usage) {
+  REAL(glBufferData);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glBufferData);
+    Write(target);
+    Write(static_cast<int64_t>(size));
+    WriteData(data, data ? size : 0);
+    Write(usage);
+    ShadowElementBuffer(target, 0, size, data, true);
+  }
+  real_glBufferData(target, size, data, usage);
+}
+
+// target, offset (64 bits), data
+extern "C" void glBufferSubData(GLenum target, GLintptr offset,
+                                GLsizeiptr size, const GLvoid* data) {
+  REAL(glBufferSubData);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glBufferSubData);
+    Write(target);
+    Write(static_cast<int64_t>(offset));
+    WriteData(data, size);
+    ShadowElementBuffer(target, offset, size, data, false);
+  }
+  real_glBufferSubData(target, offset, size, data);
+}
+
+// target, level, internal format, width, height, border, data
+extern "C" void glCompressedTexImage2D(GLenum target, GLint level,
+                                       GLenum internal_format, GLsizei width,
+                                       GLsizei height, GLint border,
+                                       GLsizei image_size,
+                                       const GLvoid* data) {
+  REAL(glCompressedTexImage2D);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glCompressedTexImage2D);
+    WriteArgs(target, level, internal_format, width, height, border);
+    WriteData(data, data ? image_size : 0);
+  }
+  real_glCompressedTexImage2D(target, level, internal_format, width, height,
+                              border, image_size, data);
+}
+
+// result
+extern "C" GLuint glCreateProgram() {
+  REAL(glCreateProgram);
+  GLuint program = real_glCreateProgram();
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glCreateProgram);
+    Write(program);
+  }
+  return program;
+}
+
+// type, result
+extern "C" GLuint glCreateShader(GLenum type) {
+  REAL(glCreateShader);
+  GLuint shader = real_glCreateShader(type);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glCreateShader);
+    WriteArgs(type, shader);
+  }
+  return shader;
+}
+
+// n, names
+#define GLTRACE_DELETE_WRAPPER(name) \
+  extern "C" void name(GLsizei n, const GLuint* names) { \
+    static PFN_glDeleteNames real = \
+        reinterpret_cast<PFN_glDeleteNames>(Real(#name)); \
+    if (Recording(kSTATE)) { \
+      WriteOp(kOp_##name); \
+      WriteData(names, n * sizeof(GLuint)); \
+    } \
+    real(n, names); \
+  }
+GLTRACE_DELETE_WRAPPER(glDeleteBuffers)
+GLTRACE_DELETE_WRAPPER(glDeleteFramebuffers)
+GLTRACE_DELETE_WRAPPER(glDeleteRenderbuffers)
+GLTRACE_DELETE_WRAPPER(glDeleteTextures)
+#undef GLTRACE_DELETE_WRAPPER
+
+// Preceded by the client arrays it reads.  mode, first, count
+extern "C" void glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  REAL(glDrawArrays);
+  if (Recording(kDRAW) && count > 0) {
+    WriteClientArrays(first + count - 1);
+    WriteOp(kOp_glDrawArrays);
+    WriteArgs(mode, first, count);
+  }
+  real_glDrawArrays(mode, first, count);
+}
+
+// Preceded by the client arrays it reads.  mode, count, type, then a 32-bit
+// 1 and the indices if they are in client memory, or 0 and the offset in
+// the element array buffer (64 bits).
+extern "C" void glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                               const GLvoid* indices) {
+  REAL(glDrawElements);
+  if (Recording(kDRAW) && count > 0) {
+    GLuint buffer = GetInteger(GL_ELEMENT_ARRAY_BUFFER_BINDING);
+    size_t size = count * TypeSize(type);
+    const char* data = static_cast<const char*>(indices);
+    if (buffer) {
+      std::vector<char>& shadow = g_element_buffers[buffer];
+      size_t offset = reinterpret_cast<size_t>(indices);
+      data = offset + size <= shadow.size() ? &shadow[offset] : NULL;
+    }
+    if (data)
+      WriteClientArrays(MaxIndex(type, data, count));
+    WriteOp(kOp_glDrawElements);
+    WriteArgs(mode, count, type);
+    if (buffer) {
+      Write(0);
+      Write(static_cast<int64_t>(reinterpret_cast<size_t>(indices)));
+    } else {
+      Write(1);
+      WriteData(indices, size);
+    }
+  }
+  real_glDrawElements(mode, count, type, indices);
+}
+
+// names
+#define GLTRACE_GEN_WRAPPER(name) \
+  extern "C" void name(GLsizei n, GLuint* names) { \
+    static PFN_glGenNames real = \
+        reinterpret_cast<PFN_glGenNames>(Real(#name)); \
+    real(n, names); \
+    if (Recording(kSTATE)) { \
+      WriteOp(kOp_##name); \
+      WriteData(names, n * sizeof(GLuint)); \
+    } \
+  }
+GLTRACE_GEN_WRAPPER(glGenBuffers)
+GLTRACE_GEN_WRAPPER(glGenFramebuffers)
+GLTRACE_GEN_WRAPPER(glGenRenderbuffers)
+GLTRACE_GEN_WRAPPER(glGenTextures)
+#undef GLTRACE_GEN_WRAPPER
+
+// program, name, result
+extern "C" GLint glGetUniformLocation(GLuint program, const GLchar* name) {
+  REAL(glGetUniformLocation);
+  GLint location = real_glGetUniformLocation(program, name);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glGetUniformLocation);
+    Write(program);
+    WriteString(name, -1);
+    Write(location);
+  }
+  return location;
+}
+
+// shader, count, strings
+extern "C" void glShaderSource(GLuint shader, GLsizei count,
+                               const GLchar* const* strings,
+                               const GLint* lengths) {
+  REAL(glShaderSource);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glShaderSource);
+    WriteArgs(shader, count);
+    for (GLsizei i = 0; i < count; i++)
+      WriteString(strings[i], lengths ? lengths[i] : -1);
+  }
+  real_glShaderSource(shader, count, strings, lengths);
+}
+
+// target, level, internal format, width, height, border, format, type, data
+extern "C" void glTexImage2D(GLenum target, GLint level,
+                             GLint internal_format, GLsizei width,
+                             GLsizei height, GLint border, GLenum format,
+                             GLenum type, const GLvoid* data) {
+  REAL(glTexImage2D);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glTexImage2D);
+    WriteArgs(target, level, internal_format, width, height, border, format,
+              type);
+    WriteData(data, data ? ImageSize(width, height, format, type) : 0);
+  }
+  real_glTexImage2D(target, level, internal_format, width, height, border,
+                    format, type, data);
+}
+
+// target, level, x, y, width, height, format, type, data
+extern "C" void glTexSubImage2D(GLenum target, GLint level, GLint x,
+                                GLint y, GLsizei width, GLsizei height,
+                                GLenum format, GLenum type,
+                                const GLvoid* data) {
+  REAL(glTexSubImage2D);
+  if (Recording(kSTATE)) {
+    WriteOp(kOp_glTexSubImage2D);
+    WriteArgs(target, level, x, y, width, height, format, type);
+    WriteData(data, ImageSize(width, height, format, type));
+  }
+  real_glTexSubImage2D(target, level, x, y, width, height, format, type,
+                       data);
+}
+
+// location, count, values
+#define GLTRACE_UNIFORM_WRAPPER(name, type, components) \
+  extern "C" void name(GLint location, GLsizei count, const type* values) { \
+    typedef void (*Proc)(GLint, GLsizei, const type*); \
+    static Proc real = reinterpret_cast<Proc>(Real(#name)); \
+    if (Recording(kSTATE)) { \
+      WriteOp(kOp_##name); \
+      WriteArgs(location, count); \
+      WriteData(values, count * components * sizeof(type)); \
+    } \
+    real(location, count, values); \
+  }
+GLTRACE_UNIFORM_WRAPPER(glUniform1fv, GLfloat, 1)
+GLTRACE_UNIFORM_WRAPPER(glUniform2fv, GLfloat, 2)
+GLTRACE_UNIFORM_WRAPPER(glUniform3fv, GLfloat, 3)
+GLTRACE_UNIFORM_WRAPPER(glUniform4fv, GLfloat, 4)
+GLTRACE_UNIFORM_WRAPPER(glUniform1iv, GLint, 1)
+GLTRACE_UNIFORM_WRAPPER(glUniform2iv, GLint, 2)
+GLTRACE_UNIFORM_WRAPPER(glUniform3iv, GLint, 3)
+GLTRACE_UNIFORM_WRAPPER(glUniform4iv, GLint, 4)
+#undef GLTRACE_UNIFORM_WRAPPER
+
+// location, count, transpose, values
+#define GLTRACE_MATRIX_WRAPPER(name, size) \
+  extern "C" void name(GLint location, GLsizei count, GLboolean transpose, \
+                       const GLfloat* values) { \
+    static PFN_glUniformMatrixfv real = \
+        reinterpret_cast<PFN_glUniformMatrixfv>(Real(#name)); \
+    if (Recording(kSTATE)) { \
+      WriteOp(kOp_##name); \
+      WriteArgs(location, count, transpose); \
+      WriteData(values, count * size * size * sizeof(GLfloat)); \
+    } \
+    real(location, count, transpose, values); \
+  }
+GLTRACE_MATRIX_WRAPPER(glUniformMatrix2fv, 2)
+GLTRACE_MATRIX_WRAPPER(glUniformMatrix3fv, 3)
+GLTRACE_MATRIX_WRAPPER(glUniformMatrix4fv, 4)
+#undef GLTRACE_MATRIX_WRAPPER
+
+// index, size, type, normalized, stride, offset in the array buffer (64
+// bits).  Only recorded for buffer data: client pointers are recorded by
+// the draws that read them.
+extern "C" void glVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                      GLboolean normalized, GLsizei stride,
+                                      const GLvoid* pointer) {
+  REAL(glVertexAttribPointer);
+  if (Recording(kSTATE) && GetInteger(GL_ARRAY_BUFFER_BINDING)) {
+    WriteOp(kOp_glVertexAttribPointer);
+    WriteArgs(index, size, type, normalized, stride);
+    Write(static_cast<int64_t>(reinterpret_cast<size_t>(pointer)));
+  }
+  real_glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+// Frames.
+
+static void EndFrame(GLint width, GLint height) {
+  if (!Recording(kSTATE))
+    return;
+  if (!g_header.width) {
+    g_header.width = width;
+    g_header.height = height;
+  }
+  WriteOp(kOp_Frame);
+  g_frame++;
+  if (g_frame >= g_header.first_frame + g_header.frame_count)
+    Finish();
+}
+
+extern "C" void glXSwapBuffers(Display* display, GLXDrawable drawable) {
+  typedef void (*PFN_glXSwapBuffers)(Display*, GLXDrawable);
+  typedef int (*PFN_glXQueryDrawable)(Display*, GLXDrawable, int,
+                                      unsigned int*);
+  REAL(glXSwapBuffers);
+  REAL(glXQueryDrawable);
+  unsigned int width = 0;
+  unsigned int height = 0;
+  if (!g_header.width) {
+    real_glXQueryDrawable(display, drawable, GLX_WIDTH, &width);
+    real_glXQueryDrawable(display, drawable, GLX_HEIGHT, &height);
+  }
+  EndFrame(width, height);
+  real_glXSwapBuffers(display, drawable);
+}
+
+extern "C" EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
+  typedef EGLBoolean (*PFN_eglSwapBuffers)(EGLDisplay, EGLSurface);
+  typedef EGLBoolean (*PFN_eglQuerySurface)(EGLDisplay, EGLSurface, EGLint,
+                                            EGLint*);
+  REAL(eglSwapBuffers);
+  REAL(eglQuerySurface);
+  EGLint width = 0;
+  EGLint height = 0;
+  if (!g_header.width) {
+    real_eglQuerySurface(display, surface, EGL_WIDTH, &width);
+    real_eglQuerySurface(display, surface, EGL_HEIGHT, &height);
+  }
+  EndFrame(width, height);
+  return real_eglSwapBuffers(display, surface);
+}
+
+// Function lookup.
+
+namespace {
+
+struct Wrapper {
+  const char* name;
+  void* proc;
+};
+
+const Wrapper kWrappers[] = {
+#define GLTRACE_SCALAR_ENTRY(name, kind, count, types) \
+  { #name, reinterpret_cast<void*>(&name) },
+#define GLTRACE_CUSTOM_ENTRY(name) \
+  { #name, reinterpret_cast<void*>(&name) },
+  GLTRACE_SCALAR_FUNCTIONS(GLTRACE_SCALAR_ENTRY)
+  GLTRACE_CUSTOM_FUNCTIONS(GLTRACE_CUSTOM_ENTRY)
+#undef GLTRACE_SCALAR_ENTRY
+#undef GLTRACE_CUSTOM_ENTRY
+};
+
+void* FindWrapper(const char* name) {
+  for (size_t i = 0; i < sizeof(kWrappers) / sizeof(kWrappers[0]); i++) {
+    if (!strcmp(kWrappers[i].name, name))
+      return kWrappers[i].proc;
+  }
+  return NULL;
+}
+
+}  // namespace
+
+typedef void (*Proc)();
+
+extern "C" Proc glXGetProcAddressARB(const GLubyte* name) {
+  typedef Proc (*PFN_glXGetProcAddressARB)(const GLubyte*);
+  REAL(glXGetProcAddressARB);
+  void* wrapper = FindWrapper(reinterpret_cast<const char*>(name));
+  if (wrapper)
+    return reinterpret_cast<Proc>(wrapper);
+  return real_glXGetProcAddressARB(name);
+}
+
+extern "C" Proc glXGetProcAddress(const GLubyte* name) {
+  return glXGetProcAddressARB(name);
+}
+
+extern "C" Proc eglGetProcAddress(const char* name) {
+  typedef Proc (*PFN_eglGetProcAddress)(const char*);
+  REAL(eglGetProcAddress);
+  void* wrapper = FindWrapper(name);
+  if (wrapper)
+    return reinterpret_cast<Proc>(wrapper);
+  return real_eglGetProcAddress(name);
+}
@@ -0,0 +1,202 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef GLTRACE_FORMAT_H_
+#define GLTRACE_FORMAT_H_
+
+// The trace file shared by the recorder (gltrace.cc) and the replayer
+// (gltrace_replay.cc).
+//
+// A trace is a TraceHeader followed by records.  Each record is a one byte
+// opcode and its arguments, in host byte order with no padding:
+//
+//   32-bit GL scalars (enums, ints, floats, names...)  4 bytes
+//   GLclampd, GLsizeiptr, GLintptr                     8 bytes
+//   data and strings                                   uint32 size + bytes
+//
+// Object names and uniform locations are recorded as the application saw
+// them and mapped to the replayer's own on replay.
+
+#include <stdint.h>
+
+#define GLTRACE_MAGIC 0x52544c47  // "GLTR"
+#define GLTRACE_VERSION 1
+
+struct TraceHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Size of the window surface.
+  uint32_t width;
+  uint32_t height;
+  // Frames before first_frame only contain state changes and resource
+  // uploads; their draws and clears are left out.
+  uint32_t first_frame;
+  // Frames recorded in full, from first_frame on.
+  uint32_t frame_count;
+};
+
+// Functions whose arguments are all scalars:
+//   F(name, kind, argument count, (argument types))
+// Kind is STATE, or DRAW for calls that are only recorded in captured
+// frames.  Types other than GL ones tell the replayer what to remap.
+#define GLTRACE_SCALAR_FUNCTIONS(F) \
+  F(glActiveTexture, STATE, 1, (GLenum)) \
+  F(glAttachShader, STATE, 2, (ProgramName, ShaderName)) \
+  F(glBindBuffer, STATE, 2, (GLenum, BufferName)) \
+  F(glBindFramebuffer, STATE, 2, (GLenum, FramebufferName)) \
+  F(glBindRenderbuffer, STATE, 2, (GLenum, RenderbufferName)) \
+  F(glBindTexture, STATE, 2, (GLenum, TextureName)) \
+  F(glBlendEquation, STATE, 1, (GLenum)) \
+  F(glBlendFunc, STATE, 2, (GLenum, GLenum)) \
+  F(glBlendFuncSeparate, STATE, 4, (GLenum, GLenum, GLenum, GLenum)) \
+  F(glClear, DRAW, 1, (GLbitfield)) \
+  F(glClearColor, STATE, 4, (GLclampf, GLclampf, GLclampf, GLclampf)) \
+  F(glClearDepth, STATE, 1, (GLclampd)) \
+  F(glClearStencil, STATE, 1, (GLint)) \
+  F(glColorMask, STATE, 4, (GLboolean, GLboolean, GLboolean, GLboolean)) \
+  F(glCompileShader, STATE, 1, (ShaderName)) \
+  F(glCopyTexImage2D, STATE, 8, (GLenum, GLint, GLenum, GLint, GLint, \
+                                 GLsizei, GLsizei, GLint)) \
+  F(glCopyTexSubImage2D, STATE, 8, (GLenum, GLint, GLint, GLint, GLint, \
+                                    GLint, GLsizei, GLsizei)) \
+  F(glCullFace, STATE, 1, (GLenum)) \
+  F(glDeleteProgram, STATE, 1, (ProgramName)) \
+  F(glDeleteShader, STATE, 1, (ShaderName)) \
+  F(glDepthFunc, STATE, 1, (GLenum)) \
+  F(glDepthMask, STATE, 1, (GLboolean)) \
+  F(glDetachShader, STATE, 2, (ProgramName, ShaderName)) \
+  F(glDisable, STATE, 1, (GLenum)) \
+  F(glDisableVertexAttribArray, STATE, 1, (GLuint)) \
+  F(glEnable, STATE, 1, (GLenum)) \
+  F(glEnableVertexAttribArray, STATE, 1, (GLuint)) \
+  F(glFinish, STATE, 0, ()) \
+  F(glFlush, STATE, 0, ()) \
+  F(glFramebufferRenderbuffer, STATE, 4, (GLenum, GLenum, GLenum, \
+                                          RenderbufferName)) \
+  F(glFramebufferTexture2D, STATE, 5, (GLenum, GLenum, GLenum, TextureName, \
+                                       GLint)) \
+  F(glFrontFace, STATE, 1, (GLenum)) \
+  F(glGenerateMipmap, STATE, 1, (GLenum)) \
+  F(glHint, STATE, 2, (GLenum, GLenum)) \
+  F(glLineWidth, STATE, 1, (GLfloat)) \
+  F(glLinkProgram, STATE, 1, (ProgramName)) \
+  F(glPixelStorei, STATE, 2, (GLenum, GLint)) \
+  F(glPolygonOffset, STATE, 2, (GLfloat, GLfloat)) \
+  F(glRenderbufferStorage, STATE, 4, (GLenum, GLenum, GLsizei, GLsizei)) \
+  F(glScissor, STATE, 4, (GLint, GLint, GLsizei, GLsizei)) \
+  F(glStencilFunc, STATE, 3, (GLenum, GLint, GLuint)) \
+  F(glStencilMask, STATE, 1, (GLuint)) \
+  F(glStencilOp, STATE, 3, (GLenum, GLenum, GLenum)) \
+  F(glTexParameterf, STATE, 3, (GLenum, GLenum, GLfloat)) \
+  F(glTexParameteri, STATE, 3, (GLenum, GLenum, GLint)) \
+  F(glUniform1f, STATE, 2, (UniformLocation, GLfloat)) \
+  F(glUniform2f, STATE, 3, (UniformLocation, GLfloat, GLfloat)) \
+  F(glUniform3f, STATE, 4, (UniformLocation, GLfloat, GLfloat, GLfloat)) \
+  F(glUniform4f, STATE, 5, (UniformLocation, GLfloat, GLfloat, GLfloat, \
+                            GLfloat)) \
+  F(glUniform1i, STATE, 2, (UniformLocation, GLint)) \
+  F(glUniform2i, STATE, 3, (UniformLocation, GLint, GLint)) \
+  F(glUniform3i, STATE, 4, (UniformLocation, GLint, GLint, GLint)) \
+  F(glUniform4i, STATE, 5, (UniformLocation, GLint, GLint, GLint, GLint)) \
+  F(glUseProgram, STATE, 1, (ProgramName)) \
+  F(glViewport, STATE, 4, (GLint, GLint, GLsizei, GLsizei))
+
+// Functions with pointer arguments, recorded by hand: F(name).
+#define GLTRACE_CUSTOM_FUNCTIONS(F) \
+  F(glBindAttribLocation) \
+  F(glBufferData) \
+  F(glBufferSubData) \
+  F(glCompressedTexImage2D) \
+  F(glCreateProgram) \
+  F(glCreateShader) \
+  F(glDeleteBuffers) \
+  F(glDeleteFramebuffers) \
+  F(glDeleteRenderbuffers) \
+  F(glDeleteTextures) \
+  F(glDrawArrays) \
+  F(glDrawElements) \
+  F(glGenBuffers) \
+  F(glGenFramebuffers) \
+  F(glGenRenderbuffers) \
+  F(glGenTextures) \
+  F(glGetUniformLocation) \
+  F(glShaderSource) \
+  F(glTexImage2D) \
+  F(glTexSubImage2D) \
+  F(glUniform1fv) \
+  F(glUniform2fv) \
+  F(glUniform3fv) \
+  F(glUniform4fv) \
+  F(glUniform1iv) \
+  F(glUniform2iv) \
+  F(glUniform3iv) \
+  F(glUniform4iv) \
+  F(glUniformMatrix2fv) \
+  F(glUniformMatrix3fv) \
+  F(glUniformMatrix4fv) \
+  F(glVertexAttribPointer)
+
+enum TraceOpcode {
+#define GLTRACE_SCALAR_OPCODE(name, kind, count, types) kOp_##name,
+#define GLTRACE_CUSTOM_OPCODE(name) kOp_##name,
+  GLTRACE_SCALAR_FUNCTIONS(GLTRACE_SCALAR_OPCODE)
+  GLTRACE_CUSTOM_FUNCTIONS(GLTRACE_CUSTOM_OPCODE)
+#undef GLTRACE_SCALAR_OPCODE
+#undef GLTRACE_CUSTOM_OPCODE
+
+  // Client side vertex data for the next draw: index, size, type,
+  // normalized, stride, data.  The data runs from vertex 0 to the last
+  // vertex the draw reads.
+  kOp_ClientArray,
+  // End of a frame (a buffer swap).
+  kOp_Frame,
+  kOpCount
+};
+
+// Argument declarations for the scalar function list.  The types are
+// pasted onto GLTRACE_TYPE_ to get the GL type.
+#define GLTRACE_TYPE(type) GLTRACE_TYPE_##type
+#define GLTRACE_TYPE_GLenum GLenum
+#define GLTRACE_TYPE_GLbitfield GLbitfield
+#define GLTRACE_TYPE_GLboolean GLboolean
+#define GLTRACE_TYPE_GLint GLint
+#define GLTRACE_TYPE_GLuint GLuint
+#define GLTRACE_TYPE_GLsizei GLsizei
+#define GLTRACE_TYPE_GLfloat GLfloat
+#define GLTRACE_TYPE_GLclampf GLclampf
+#define GLTRACE_TYPE_GLclampd GLclampd
+#define GLTRACE_TYPE_BufferName GLuint
+#define GLTRACE_TYPE_FramebufferName GLuint
+#define GLTRACE_TYPE_ProgramName GLuint
+#define GLTRACE_TYPE_RenderbufferName GLuint
+#define GLTRACE_TYPE_ShaderName GLuint
+#define GLTRACE_TYPE_TextureName GLuint
+#define GLTRACE_TYPE_UniformLocation GLint
+
+#define GLTRACE_PARAMS(count, types) GLTRACE_PARAMS_##count types
+#define GLTRACE_PARAMS_0() (void)
+#define GLTRACE_PARAMS_1(t1) (GLTRACE_TYPE(t1) a1)
+#define GLTRACE_PARAMS_2(t1, t2) (GLTRACE_TYPE(t1) a1, GLTRACE_TYPE(t2) a2)
+#define GLTRACE_PARAMS_3(t1, t2, t3) \
+  (GLTRACE_TYPE(t1) a1, GLTRACE_TYPE(t2) a2, GLTRACE_TYPE(t3) a3)
+#define GLTRACE_PARAMS_4(t1, t2, t3, t4) \
+  (GLTRACE_TYPE(t1) a1, GLTRACE_TYPE(t2) a2, GLTRACE_TYPE(t3) a3, \
+   GLTRACE_TYPE(t4) a4)
+#define GLTRACE_PARAMS_5(t1, t2, t3, t4, t5) \
+  (GLTRACE_TYPE(t1) a1, GLTRACE_TYPE(t2) a2, GLTRACE_TYPE(t3) a3, \
+   GLTRACE_TYPE(t4) a4, GLTRACE_TYPE(t5) a5)
+#define GLTRACE_PARAMS_8(t1, t2, t3, t4, t5, t6, t7, t8) \
+  (GLTRACE_TYPE(t1) a1, GLTRACE_TYPE(t2) a2, GLTRACE_TYPE(t3) a3, \
+   GLTRACE_TYPE(t4) a4, GLTRACE_TYPE(t5) a5, GLTRACE_TYPE(t6) a6, \
+   GLTRACE_TYPE(t7) a7, GLTRACE_TYPE(t8) a8)
+
+#define GLTRACE_ARGS(count) GLTRACE_ARGS_##count
+#define GLTRACE_ARGS_0 ()
+#define GLTRACE_ARGS_1 (a1)
+#define GLTRACE_ARGS_2 (a1, a2)
+#define GLTRACE_ARGS_3 (a1, a2, a3)
+#define GLTRACE_ARGS_4 (a1, a2, a3, a4)
+#define GLTRACE_ARGS_5 (a1, a2, a3, a4, a5)
+#define GLTRACE_ARGS_8 (a1, a2, a3, a4, a5, a6, a7, a8)
+
+#endif  // GLTRACE_FORMAT_H_
@@ -0,0 +1,601 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays a trace written by gltrace.cc on an offscreen EGL context and
+// prints how long each kind of GL call took:
+//
+//   gltrace_replay [--repeat=N] [--sync] [--dump=FILE.ppm] FILE
+//
+// The frames before the recorded ones only set up textures, buffers and
+// programs and are not timed.  The recorded frames are replayed once to
+// warm up the driver (which compiles shaders on first use, for one), then
+// N times more with timing, each frame ending with glFinish().  GL drivers
+// do most of their work lazily, so the time of a call is mostly the CPU
+// cost of making it, and the rendering itself shows up in the glFinish at
+// the end of the frame.  --sync adds a
+// glFinish to every draw and clear so that they are charged for their own
+// rendering.  --dump writes the last frame to a PPM file.
+
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gltrace_format.h"
+
+namespace {
+
+const char* const kOpNames[] = {
+#define GLTRACE_SCALAR_NAME(name, kind, count, types) #name,
+#define GLTRACE_CUSTOM_NAME(name) #name,
+  GLTRACE_SCALAR_FUNCTIONS(GLTRACE_SCALAR_NAME)
+  GLTRACE_CUSTOM_FUNCTIONS(GLTRACE_CUSTOM_NAME)
+#undef GLTRACE_SCALAR_NAME
+#undef GLTRACE_CUSTOM_NAME
+  "(client arrays)",
+  "(end of frame)",
+};
+
+struct CallStats {
+  CallStats() : count(0), nanoseconds(0) {}
+  int64_t count;
+  int64_t nanoseconds;
+};
+
+// The trace being replayed.
+std::vector<char> g_trace;
+const char* g_cursor;
+const char* g_end;
+
+bool g_timing;
+bool g_sync;
+CallStats g_stats[kOpCount];
+
+// Traced names to ours.
+typedef std::map<GLuint, GLuint> NameMap;
+NameMap g_buffers;
+NameMap g_framebuffers;
+NameMap g_programs;
+NameMap g_renderbuffers;
+NameMap g_shaders;
+NameMap g_textures;
+
+// (traced program, traced location) to our location.
+std::map<std::pair<GLuint, GLint>, GLint> g_uniforms;
+// The traced program in use, and the last one read.
+GLuint g_program;
+GLuint g_last_program;
+
+int64_t Now() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void Fail(const char* message) {
+  fprintf(stderr, "gltrace_replay: %s\n", message);
+  exit(1);
+}
+
+const char* Read(size_t size) {
+  if (static_cast<size_t>(g_end - g_cursor) < size)
+    Fail("truncated trace");
+  const char* data = g_cursor;
+  g_cursor += size;
+  return data;
+}
+
+template <typename T>
+T ReadValue() {
+  T value;
+  memcpy(&value, Read(sizeof(value)), sizeof(value));
+  return value;
+}
+
+// Returns NULL for empty data.
+const void* ReadData(GLsizei* size) {
+  uint32_t length = ReadValue<uint32_t>();
+  if (size)
+    *size = length;
+  return length ? Read(length) : NULL;
+}
+
+std::string ReadString() {
+  GLsizei size;
+  const char* data = static_cast<const char*>(ReadData(&size));
+  return std::string(data ? data : "", size);
+}
+
+GLuint MapName(const NameMap& names, GLuint name) {
+  NameMap::const_iterator it = names.find(name);
+  return it == names.end() ? name : it->second;
+}
+
+GLenum ReadGLenum() { return ReadValue<GLenum>(); }
+GLbitfield ReadGLbitfield() { return ReadValue<GLbitfield>(); }
+GLboolean ReadGLboolean() { return ReadValue<uint32_t>(); }
+GLint ReadGLint() { return ReadValue<GLint>(); }
+GLuint ReadGLuint() { return ReadValue<GLuint>(); }
+GLsizei ReadGLsizei() { return ReadValue<GLsizei>(); }
+GLfloat ReadGLfloat() { return ReadValue<GLfloat>(); }
+GLclampf ReadGLclampf() { return ReadValue<GLclampf>(); }
+GLclampd ReadGLclampd() { return ReadValue<GLclampd>(); }
+GLuint ReadBufferName() { return MapName(g_buffers, ReadGLuint()); }
+GLuint ReadFramebufferName() { return MapName(g_framebuffers, ReadGLuint()); }
+GLuint ReadRenderbufferName() {
+  return MapName(g_renderbuffers, ReadGLuint());
+}
+GLuint ReadShaderName() { return MapName(g_shaders, ReadGLuint()); }
+GLuint ReadTextureName() { return MapName(g_textures, ReadGLuint()); }
+
+GLuint ReadProgramName() {
+  g_last_program = ReadGLuint();
+  return MapName(g_programs, g_last_program);
+}
+
+GLint ReadUniformLocation() {
+  GLint location = ReadGLint();
+  std::map<std::pair<GLuint, GLint>, GLint>::const_iterator it =
+      g_uniforms.find(std::make_pair(g_program, location));
+  return it == g_uniforms.end() ? location : it->second;
+}
+
+#define READ_ARGS(count, types) READ_ARGS_##count types
+#define READ_ARGS_0()
+#define READ_ARGS_1(t1) GLTRACE_TYPE(t1) a1 = Read##t1();
+#define READ_ARGS_2(t1, t2) READ_ARGS_1(t1) GLTRACE_TYPE(t2) a2 = Read##t2();
+#define READ_ARGS_3(t1, t2, t3) \
+  READ_ARGS_2(t1, t2) GLTRACE_TYPE(t3) a3 = Read##t3();
+#define READ_ARGS_4(t1, t2, t3, t4) \
+  READ_ARGS_3(t1, t2, t3) GLTRACE_TYPE(t4) a4 = Read##t4();
+#define READ_ARGS_5(t1, t2, t3, t4, t5) \
+  READ_ARGS_4(t1, t2, t3, t4) GLTRACE_TYPE(t5) a5 = Read##t5();
+#define READ_ARGS_8(t1, t2, t3, t4, t5, t6, t7, t8) \
+  READ_ARGS_5(t1, t2, t3, t4, t5) GLTRACE_TYPE(t6) a6 = Read##t6(); \
+  GLTRACE_TYPE(t7) a7 = Read##t7(); GLTRACE_TYPE(t8) a8 = Read##t8();
+
+// Make |call| and charge it to |op|.
+#define TIMED(op, call) \
+  do { \
+    if (g_timing) { \
+      int64_t start = Now(); \
+      call; \
+      g_stats[op].count++; \
+      g_stats[op].nanoseconds += Now() - start; \
+    } else { \
+      call; \
+    } \
+  } while (0)
+
+#define TIMED_STATE(op, call) TIMED(op, call)
+#define TIMED_DRAW(op, call) TIMED(op, call; if (g_sync) glFinish())
+
+void GenNames(TraceOpcode op, void (*gen)(GLsizei, GLuint*),
+              NameMap* names) {
+  GLsizei size;
+  const GLuint* traced = static_cast<const GLuint*>(ReadData(&size));
+  GLsizei n = size / sizeof(GLuint);
+  std::vector<GLuint> ours(n);
+  if (n)
+    TIMED(op, gen(n, &ours[0]));
+  for (GLsizei i = 0; i < n; i++) {
+    GLuint name;
+    memcpy(&name, &traced[i], sizeof(name));
+    (*names)[name] = ours[i];
+  }
+}
+
+void DeleteNames(TraceOpcode op, void (*del)(GLsizei, const GLuint*),
+                 NameMap* names) {
+  GLsizei size;
+  const GLuint* traced = static_cast<const GLuint*>(ReadData(&size));
+  GLsizei n = size / sizeof(GLuint);
+  std::vector<GLuint> ours(n);
+  for (GLsizei i = 0; i < n; i++) {
+    GLuint name;
+    memcpy(&name, &traced[i], sizeof(name));
+    ours[i] = MapName(*names, name);
+    names->erase(name);
+  }
+  if (n)
+    TIMED(op, del(n, &ours[0]));
+}
+
+void ReplayClientArray() {
+  GLuint index = ReadGLuint();
+  GLint size = ReadGLint();
+  GLenum type = ReadGLenum();
+  GLboolean normalized = ReadGLboolean();
+  GLsizei stride = ReadGLsizei();
+  const void* data = ReadData(NULL);
+
+  GLint buffer;
+  glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  TIMED(kOp_ClientArray,
+        glVertexAttribPointer(index, size, type, normalized, stride, data));
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+}
+
+// Replay the next record.  Returns true at the end of a frame.
+bool ReplayRecord() {
+  TraceOpcode op = static_cast<TraceOpcode>(ReadValue<uint8_t>());
+  switch (op) {
+#define GLTRACE_REPLAY_SCALAR(name, kind, count, types) \
+    case kOp_##name: { \
+      READ_ARGS(count, types) \
+      TIMED_##kind(op, name GLTRACE_ARGS(count)); \
+      break; \
+    }
+    GLTRACE_SCALAR_FUNCTIONS(GLTRACE_REPLAY_SCALAR)
+#undef GLTRACE_REPLAY_SCALAR
+
+    case kOp_glBindAttribLocation: {
+      GLuint program = ReadProgramName();
+      GLuint index = ReadGLuint();
+      std::string name = ReadString();
+      TIMED(op, glBindAttribLocation(program, index, name.c_str()));
+      break;
+    }
+    case kOp_glBufferData: {
+      GLenum target = ReadGLenum();
+      GLsizeiptr size = ReadValue<int64_t>();
+      const void* data = ReadData(NULL);
+      GLenum usage = ReadGLenum();
+      TIMED(op, glBufferData(target, size, data, usage));
+      break;
+    }
+    case kOp_glBufferSubData: {
+      GLenum target = ReadGLenum();
+      GLintptr offset = ReadValue<int64_t>();
+      GLsizei size;
+      const void* data = ReadData(&size);
+      TIMED(op, glBufferSubData(target, offset, size, data));
+      break;
+    }
+    case kOp_glCompressedTexImage2D: {
+      READ_ARGS_5(GLenum, GLint, GLenum, GLsizei, GLsizei)
+      GLint border = ReadGLint();
+      GLsizei size;
+      const void* data = ReadData(&size);
+      TIMED(op, glCompressedTexImage2D(a1, a2, a3, a4, a5, border, size,
+                                       data));
+      break;
+    }
+    case kOp_glCreateProgram: {
+      GLuint traced = ReadGLuint();
+      GLuint program;
+      TIMED(op, program = glCreateProgram());
+      g_programs[traced] = program;
+      break;
+    }
+    case kOp_glCreateShader: {
+      GLenum type = ReadGLenum();
+      GLuint traced = ReadGLuint();
+      GLuint shader;
+      TIMED(op, shader = glCreateShader(type));
+      g_shaders[traced] = shader;
+      break;
+    }
+    case kOp_glDeleteBuffers:
+      DeleteNames(op, glDeleteBuffers, &g_buffers);
+      break;
+    case kOp_glDeleteFramebuffers:
+      DeleteNames(op, glDeleteFramebuffers, &g_framebuffers);
+      break;
+    case kOp_glDeleteRenderbuffers:
+      DeleteNames(op, glDeleteRenderbuffers, &g_renderbuffers);
+      break;
+    case kOp_glDeleteTextures:
+      DeleteNames(op, glDeleteTextures, &g_textures);
+      break;
+    case kOp_glDrawArrays: {
+      READ_ARGS_3(GLenum, GLint, GLsizei)
+      TIMED_DRAW(op, glDrawArrays(a1, a2, a3));
+      break;
+    }
+    case kOp_glDrawElements: {
+      READ_ARGS_3(GLenum, GLsizei, GLenum)
+      const void* indices;
+      if (ReadGLuint())
+        indices = ReadData(NULL);
+      else
+        indices = reinterpret_cast<const void*>(ReadValue<int64_t>());
+      TIMED_DRAW(op, glDrawElements(a1, a2, a3, indices));
+      break;
+    }
+    case kOp_glGenBuffers:
+      GenNames(op, glGenBuffers, &g_buffers);
+      break;
+    case kOp_glGenFramebuffers:
+      GenNames(op, glGenFramebuffers, &g_framebuffers);
+      break;
+    case kOp_glGenRenderbuffers:
+      GenNames(op, glGenRenderbuffers, &g_renderbuffers);
+      break;
+    case kOp_glGenTextures:
+      GenNames(op, glGenTextures, &g_textures);
+      break;
+    case kOp_glGetUniformLocation: {
+      GLuint program = ReadProgramName();
+      std::string name = ReadString();
+      GLint traced = ReadGLint();
+      GLint location;
+      TIMED(op, location = glGetUniformLocation(program, name.c_str()));
+      g_uniforms[std::make_pair(g_last_program, traced)] = location;
+      break;
+    }
+    case kOp_glShaderSource: {
+      GLuint shader = ReadShaderName();
+      GLsizei count = ReadGLsizei();
+      std::vector<const GLchar*> strings(count);
+      std::vector<GLint> lengths(count);
+      for (GLsizei i = 0; i < count; i++)
+        strings[i] = static_cast<const GLchar*>(ReadData(&lengths[i]));
+      if (count)
+        TIMED(op, glShaderSource(shader, count, &strings[0], &lengths[0]));
+      break;
+    }
+    case kOp_glTexImage2D: {
+      READ_ARGS_8(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum,
+                  GLenum)
+      const void* data = ReadData(NULL);
+      TIMED(op, glTexImage2D(a1, a2, a3, a4, a5, a6, a7, a8, data));
+      break;
+    }
+    case kOp_glTexSubImage2D: {
+      READ_ARGS_8(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum,
+                  GLenum)
+      const void* data = ReadData(NULL);
+      TIMED(op, glTexSubImage2D(a1, a2, a3, a4, a5, a6, a7, a8, data));
+      break;
+    }
+#define GLTRACE_REPLAY_UNIFORM(name, type) \
+    case kOp_##name: { \
+      READ_ARGS_2(UniformLocation, GLsizei) \
+      const type* values = static_cast<const type*>(ReadData(NULL)); \
+      TIMED(op, name(a1, a2, values)); \
+      break; \
+    }
+    GLTRACE_REPLAY_UNIFORM(glUniform1fv, GLfloat)
+    GLTRACE_REPLAY_UNIFORM(glUniform2fv, GLfloat)
+    GLTRACE_REPLAY_UNIFORM(glUniform3fv, GLfloat)
+    GLTRACE_REPLAY_UNIFORM(glUniform4fv, GLfloat)
+    GLTRACE_REPLAY_UNIFORM(glUniform1iv, GLint)
+    GLTRACE_REPLAY_UNIFORM(glUniform2iv, GLint)
+    GLTRACE_REPLAY_UNIFORM(glUniform3iv, GLint)
+    GLTRACE_REPLAY_UNIFORM(glUniform4iv, GLint)
+#undef GLTRACE_REPLAY_UNIFORM
+#define GLTRACE_REPLAY_MATRIX(name) \
+    case kOp_##name: { \
+      READ_ARGS_3(UniformLocation, GLsizei, GLboolean) \
+      const GLfloat* values = static_cast<const GLfloat*>(ReadData(NULL)); \
+      TIMED(op, name(a1, a2, a3, values)); \
+      break; \
+    }
+    GLTRACE_REPLAY_MATRIX(glUniformMatrix2fv)
+    GLTRACE_REPLAY_MATRIX(glUniformMatrix3fv)
+    GLTRACE_REPLAY_MATRIX(glUniformMatrix4fv)
+#undef GLTRACE_REPLAY_MATRIX
+    case kOp_glVertexAttribPointer: {
+      READ_ARGS_5(GLuint, GLint, GLenum, GLboolean, GLsizei)
+      const void* offset =
+          reinterpret_cast<const void*>(ReadValue<int64_t>());
+      TIMED(op, glVertexAttribPointer(a1, a2, a3, a4, a5, offset));
+      break;
+    }
+
+    case kOp_ClientArray:
+      ReplayClientArray();
+      break;
+    case kOp_Frame:
+      TIMED(op, glFinish());
+      return true;
+    default:
+      Fail("bad opcode");
+  }
+
+  if (op == kOp_glUseProgram)
+    g_program = g_last_program;
+  return false;
+}
+
+bool CreateContext(int width, int height) {
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (!eglInitialize(display, NULL, NULL)) {
+    // No window system: try Mesa's surfaceless platform.
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (!get_platform_display)
+      return false;
+    display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                   EGL_DEFAULT_DISPLAY, NULL);
+    if (!eglInitialize(display, NULL, NULL))
+      return false;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API))
+    return false;
+
+  const EGLint config_attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_STENCIL_SIZE, 8,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint configs;
+  if (!eglChooseConfig(display, config_attribs, &config, 1, &configs) ||
+      !configs) {
+    return false;
+  }
+
+  const EGLint surface_attribs[] = {
+    EGL_WIDTH, width,
+    EGL_HEIGHT, height,
+    EGL_NONE
+  };
+  EGLSurface surface =
+      eglCreatePbufferSurface(display, config, surface_attribs);
+  EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+                                        NULL);
+  return surface != EGL_NO_SURFACE && context != EGL_NO_CONTEXT &&
+         eglMakeCurrent(display, surface, surface, context);
+}
+
+void DumpFrame(const char* path, int width, int height) {
+  GLint framebuffer;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &framebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  std::vector<unsigned char> pixels(width * height * 3);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+
+  FILE* file = fopen(path, "wb");
+  if (!file)
+    Fail("can't write the frame");
+  fprintf(file, "P6\n%d %d\n255\n", width, height);
+  for (int y = height - 1; y >= 0; y--)
+    fwrite(&pixels[y * width * 3], width * 3, 1, file);
+  fclose(file);
+}
+
+bool CompareTotal(int a, int b) {
+  return g_stats[a].nanoseconds > g_stats[b].nanoseconds;
+}
+
+void PrintStats(const std::vector<int64_t>& frame_times) {
+  int64_t total = 0;
+  std::vector<int> ops;
+  for (int op = 0; op < kOpCount; op++) {
+    total += g_stats[op].nanoseconds;
+    if (g_stats[op].count)
+      ops.push_back(op);
+  }
+  std::sort(ops.begin(), ops.end(), CompareTotal);
+
+  printf("%-28s %8s %10s %10s %7s\n", "call", "count", "total ms",
+         "us/call", "share");
+  for (size_t i = 0; i < ops.size(); i++) {
+    const CallStats& stats = g_stats[ops[i]];
+    printf("%-28s %8lld %10.3f %10.3f %6.1f%%\n", kOpNames[ops[i]],
+           static_cast<long long>(stats.count), stats.nanoseconds / 1e6,
+           stats.nanoseconds / 1e3 / stats.count,
+           total ? 100.0 * stats.nanoseconds / total : 0.0);
+  }
+
+  if (frame_times.empty())
+    return;
+  int64_t sum = 0;
+  int64_t min = frame_times[0];
+  int64_t max = frame_times[0];
+  for (size_t i = 0; i < frame_times.size(); i++) {
+    sum += frame_times[i];
+    min = std::min(min, frame_times[i]);
+    max = std::max(max, frame_times[i]);
+  }
+  printf("\n%d frames: %.3f ms mean, %.3f ms min, %.3f ms max\n",
+         static_cast<int>(frame_times.size()),
+         sum / 1e6 / frame_times.size(), min / 1e6, max / 1e6);
+}
+
+void Usage() {
+  fprintf(stderr, "usage: gltrace_replay [--repeat=N] [--sync] "
+                  "[--dump=FILE.ppm] FILE\n");
+  exit(1);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int repeat = 1;
+  const char* dump_path = NULL;
+  const char* path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "--repeat=", 9))
+      repeat = atoi(argv[i] + 9);
+    else if (!strcmp(argv[i], "--sync"))
+      g_sync = true;
+    else if (!strncmp(argv[i], "--dump=", 7))
+      dump_path = argv[i] + 7;
+    else if (argv[i][0] == '-' || path)
+      Usage();
+    else
+      path = argv[i];
+  }
+  if (!path || repeat < 1)
+    Usage();
+
+  FILE* file = fopen(path, "rb");
+  if (!file)
+    Fail("can't open the trace");
+  char buffer[1 << 16];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    g_trace.insert(g_trace.end(), buffer, buffer + size);
+  fclose(file);
+  if (g_trace.size() < sizeof(TraceHeader))
+    Fail("not a trace");
+  g_cursor = &g_trace[0];
+  g_end = g_cursor + g_trace.size();
+  TraceHeader header = ReadValue<TraceHeader>();
+  if (header.magic != GLTRACE_MAGIC || header.version != GLTRACE_VERSION)
+    Fail("not a trace, or from another version of gltrace");
+  if (!header.width || !header.height)
+    Fail("no frames in the trace");
+  printf("%s: %ux%u, frames %u to %u\n", path, header.width, header.height,
+         header.first_frame, header.first_frame + header.frame_count - 1);
+
+  if (!CreateContext(header.width, header.height))
+    Fail("can't create an EGL context");
+
+  // Bring the context to the state the first recorded frame starts in.
+  unsigned int frame = 0;
+  while (frame < header.first_frame && g_cursor < g_end) {
+    if (ReplayRecord())
+      frame++;
+  }
+  glFinish();
+
+  const char* frames_start = g_cursor;
+  while (g_cursor < g_end)
+    ReplayRecord();
+
+  std::vector<int64_t> frame_times;
+  g_timing = true;
+  for (int i = 0; i < repeat; i++) {
+    g_cursor = frames_start;
+    int64_t start = Now();
+    while (g_cursor < g_end) {
+      if (ReplayRecord()) {
+        int64_t end = Now();
+        frame_times.push_back(end - start);
+        start = end;
+      }
+    }
+  }
+  g_timing = false;
+
+  if (dump_path)
+    DumpFrame(dump_path, header.width, header.height);
+  PrintStats(frame_times);
+  return 0;
+}
@@ -0,0 +1,16 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Stand-in for the parts of cocos2d.h used by engine sources that host
+// tools build on their own (see the Makefile), so that they don't need a
+// cocos2d-x build.
+#ifndef HOST_COCOS2D_H_
+#define HOST_COCOS2D_H_
+
+#include <stdio.h>
+
+#define USING_NS_CC
+#define CCLog(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+
+#endif  // HOST_COCOS2D_H_
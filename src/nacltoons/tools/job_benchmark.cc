@@ -0,0 +1,182 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Standalone benchmark for the engine job system (src/job_system.cc).
+// Build and run with 'make benchmark' from the nacltoons directory.
+//
+// Usage: job_benchmark [worker_count]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "job_system.h"
+
+static double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Counts jobs and steals per thread.
+class CountingTracer : public JobTracer {
+ public:
+  explicit CountingTracer(int threads) : jobs_(threads + 1), steals_(0) {}
+
+  virtual void JobStarted(const char* name, int thread) {}
+  virtual void JobFinished(const char* name, int thread) {
+    __sync_add_and_fetch(&jobs_[thread], 1);
+  }
+  virtual void JobStolen(int thief, int victim) {
+    __sync_add_and_fetch(&steals_, 1);
+  }
+
+  void Print() {
+    printf("    jobs per thread:");
+    for (size_t i = 0; i < jobs_.size(); i++)
+      printf(" %d", jobs_[i]);
+    printf("  steals: %d\n", steals_);
+  }
+
+ private:
+  std::vector<int> jobs_;
+  int steals_;
+};
+
+// Some floating point work that the compiler cannot drop.
+static void Work(int iterations) {
+  double sum = 0;
+  for (int i = 1; i <= iterations; i++)
+    sum += sqrt((double)i);
+  volatile double sink = sum;
+  (void)sink;
+}
+
+// Many small independent jobs queued from the main thread.
+static const int kSmallJobs = 20000;
+static const int kSmallWork = 2000;
+
+static void SmallJob(void* data) {
+  Work(kSmallWork);
+}
+
+// Recursive splitting: each job spawns two children until the range is
+// small, which is the pattern work stealing is for.
+struct SplitTask {
+  JobSystem* system;
+  JobCounter* counter;
+  int begin;
+  int end;
+};
+
+static const int kSplitItems = 1 << 16;
+static const int kSplitLeaf = 64;
+
+static void SplitJob(void* data) {
+  SplitTask* task = static_cast<SplitTask*>(data);
+  if (task->end - task->begin <= kSplitLeaf) {
+    Work((task->end - task->begin) * 200);
+    delete task;
+    return;
+  }
+  int middle = (task->begin + task->end) / 2;
+  SplitTask left = { task->system, task->counter, task->begin, middle };
+  SplitTask right = { task->system, task->counter, middle, task->end };
+  task->system->Run(SplitJob, new SplitTask(left), task->counter, "split");
+  task->system->Run(SplitJob, new SplitTask(right), task->counter, "split");
+  delete task;
+}
+
+// A fan-out / fan-in graph: stages of parallel jobs, each stage waiting
+// for the previous one through a counter.
+static const int kStages = 50;
+static const int kStageWidth = 64;
+
+static void StageJob(void* data) {
+  Work(kSmallWork * 4);
+}
+
+static int g_continuations;
+
+static void Continuation(void* data) {
+  g_continuations++;
+}
+
+static void Report(const char* name, double serial, double parallel,
+                   CountingTracer* tracer) {
+  printf("%-10s serial %7.1f ms  pool %7.1f ms  speedup %.2fx\n", name,
+         serial * 1000, parallel * 1000, serial / parallel);
+  tracer->Print();
+}
+
+int main(int argc, char* argv[]) {
+  int worker_count = argc > 1 ? atoi(argv[1]) : 0;
+  JobSystem system(worker_count);
+  printf("%d worker(s)\n", system.worker_count());
+
+  // Small independent jobs.
+  {
+    double start = Now();
+    for (int i = 0; i < kSmallJobs; i++)
+      SmallJob(NULL);
+    double serial = Now() - start;
+
+    CountingTracer tracer(system.worker_count());
+    system.SetTracer(&tracer);
+    JobCounter counter;
+    start = Now();
+    for (int i = 0; i < kSmallJobs; i++)
+      system.Run(SmallJob, NULL, &counter, "small");
+    system.Wait(&counter);
+    double parallel = Now() - start;
+    system.SetTracer(NULL);
+    Report("small", serial, parallel, &tracer);
+  }
+
+  // Recursive splitting.
+  {
+    double start = Now();
+    Work(kSplitItems * 200);
+    double serial = Now() - start;
+
+    CountingTracer tracer(system.worker_count());
+    system.SetTracer(&tracer);
+    JobCounter counter;
+    start = Now();
+    SplitTask root = { &system, &counter, 0, kSplitItems };
+    system.Run(SplitJob, new SplitTask(root), &counter, "split");
+    system.Wait(&counter);
+    double parallel = Now() - start;
+    system.SetTracer(NULL);
+    Report("split", serial, parallel, &tracer);
+  }
+
+  // Dependent stages with a main thread continuation at the end.
+  {
+    double start = Now();
+    for (int i = 0; i < kStages * kStageWidth; i++)
+      StageJob(NULL);
+    double serial = Now() - start;
+
+    CountingTracer tracer(system.worker_count());
+    system.SetTracer(&tracer);
+    std::vector<JobCounter> counters(kStages);
+    start = Now();
+    for (int stage = 0; stage < kStages; stage++) {
+      JobCounter* dependency = stage ? &counters[stage - 1] : NULL;
+      for (int i = 0; i < kStageWidth; i++)
+        system.RunAfter(dependency, StageJob, NULL, &counters[stage], "stage");
+    }
+    system.RunOnMainThread(Continuation, NULL, &counters[kStages - 1]);
+    system.Wait(&counters[kStages - 1]);
+    while (!g_continuations)
+      system.RunMainThreadJobs();
+    double parallel = Now() - start;
+    system.SetTracer(NULL);
+    Report("stages", serial, parallel, &tracer);
+  }
+
+  return 0;
+}
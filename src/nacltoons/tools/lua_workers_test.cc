@@ -0,0 +1,164 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Host test for the Lua worker pool (src/lua_workers.cc), calling the
+// functions in tests/worker_jobs.lua and the solver modules of the games
+// in tests/games.  Build and run with 'make workers_test' from the
+// nacltoons directory.
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "job_system.h"
+#include "lua_workers.h"
+
+extern "C" {
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+
+// Worker states preload yaml for util.lua; no test job needs it.
+int luaopen_yaml(lua_State* state) {
+  lua_newtable(state);
+  return 1;
+}
+}
+
+static const double kTimeout = 10;
+
+// Queues the jobs; each callback stores its arguments in results[name].
+static const char kRunJobs[] =
+    "results = {}\n"
+    "local function Store(name)\n"
+    "  return function(...) results[name] = { n = select('#', ...), ... } end\n"
+    "end\n"
+    "workers.SetPath('tests/?.lua')\n"
+    "workers.Run('worker_jobs', 'Sum', Store('sum'), { 1, 2, 3.5 })\n"
+    "workers.Run('worker_jobs', 'FailWithString', Store('string_error'))\n"
+    "workers.Run('worker_jobs', 'FailWithTable', Store('table_error'))\n"
+    "workers.Run('worker_jobs', 'FailWithNil', Store('nil_error'))\n"
+    "workers.Run('worker_jobs', 'ReturnFunction', Store('bad_result'))\n"
+    "workers.Run('worker_jobs', 'Missing', Store('missing'))\n";
+
+// Returns a description of every check that failed, or nil.
+static const char kCheckResults[] =
+    "local failures = {}\n"
+    "local function Check(name, ok, expected, message)\n"
+    "  local r = results[name]\n"
+    "  if not r then\n"
+    "    table.insert(failures, name .. ': no callback')\n"
+    "  elseif r[1] ~= ok or (message and not string.find(r[2], message, 1,\n"
+    "                                                      true)) then\n"
+    "    table.insert(failures, name .. ': got ' .. tostring(r[1]) .. ', ' ..\n"
+    "                 tostring(r[2]))\n"
+    "  elseif expected and not expected(r) then\n"
+    "    table.insert(failures, name .. ': wrong results')\n"
+    "  end\n"
+    "end\n"
+    "Check('sum', true, function(r)\n"
+    "  return r.n == 3 and r[2] == 6.5 and r[3].count == 3\n"
+    "end)\n"
+    "Check('string_error', false, nil, 'bad input')\n"
+    "Check('table_error', false, nil, '(error object is a table value)')\n"
+    "Check('nil_error', false, nil, '(error object is a nil value)')\n"
+    "Check('bad_result', false, nil, 'cannot pass a function')\n"
+    "Check('missing', false, nil, \"no function 'Missing'\")\n"
+    "if #failures > 0 then return table.concat(failures, '\\n') end\n";
+
+// Switches between the two test games, as LoadGame does.  Each game has
+// its own 'solver' module, and a switch drops the callbacks of calls the
+// previous game made.
+static const char kRunFirstGame[] =
+    "names = {}\n"
+    "workers.SetPath('tests/games/first/?.lua')\n"
+    "for i = 1, 16 do\n"
+    "  workers.Run('solver', 'Name', function(ok, name)\n"
+    "    table.insert(names, tostring(ok) .. ' ' .. tostring(name))\n"
+    "  end)\n"
+    "end\n";
+
+static const char kRunSecondGame[] =
+    "workers.SetPath('tests/games/first/?.lua')\n"
+    "workers.Run('solver', 'Name', function() dropped = true end)\n"
+    "workers.SetPath('tests/games/second/?.lua')\n"
+    "for i = 1, 16 do\n"
+    "  workers.Run('solver', 'Name', function(ok, name)\n"
+    "    table.insert(names, tostring(ok) .. ' ' .. tostring(name))\n"
+    "  end)\n"
+    "end\n";
+
+static const char kCheckSwitch[] =
+    "if dropped then return 'callback of an unloaded game ran' end\n"
+    "for i = 1, 32 do\n"
+    "  local expected = i <= 16 and 'true first' or 'true second'\n"
+    "  if names[i] ~= expected then\n"
+    "    return 'call ' .. i .. ': got ' .. tostring(names[i]) ..\n"
+    "           ', expected ' .. expected\n"
+    "  end\n"
+    "end\n";
+
+static double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static bool RunChunk(lua_State* state, const char* chunk) {
+  if (luaL_dostring(state, chunk)) {
+    fprintf(stderr, "%s\n", lua_tostring(state, -1));
+    return false;
+  }
+  return true;
+}
+
+// Run main thread jobs until every call has completed.
+static bool WaitForCalls() {
+  JobSystem* jobs = JobSystem::sharedJobSystem();
+  double deadline = Now() + kTimeout;
+  while (LuaWorkerPool::sharedPool()->pending() > 0 && Now() < deadline) {
+    if (!jobs->RunMainThreadJobs())
+      usleep(1000);
+  }
+  if (LuaWorkerPool::sharedPool()->pending() > 0) {
+    fprintf(stderr, "FAIL: %d jobs did not complete\n",
+            LuaWorkerPool::sharedPool()->pending());
+    return false;
+  }
+  return true;
+}
+
+// Run |chunk|, which returns a description of what failed, or nothing.
+static bool Check(lua_State* state, const char* chunk) {
+  int top = lua_gettop(state);
+  if (!RunChunk(state, chunk))
+    return false;
+  bool ok = true;
+  if (lua_gettop(state) > top && lua_isstring(state, -1)) {
+    fprintf(stderr, "FAIL:\n%s\n", lua_tostring(state, -1));
+    ok = false;
+  }
+  lua_settop(state, top);
+  return ok;
+}
+
+int main(int argc, char* argv[]) {
+  lua_State* state = luaL_newstate();
+  luaL_openlibs(state);
+  luaopen_workers(state);
+  lua_pop(state, 1);
+  LuaWorkerPool::sharedPool()->SetEngineDir("data/res");
+
+  if (!RunChunk(state, kRunJobs) || !WaitForCalls() ||
+      !Check(state, kCheckResults))
+    return 1;
+
+  if (!RunChunk(state, kRunFirstGame) || !WaitForCalls() ||
+      !RunChunk(state, kRunSecondGame) || !WaitForCalls() ||
+      !Check(state, kCheckSwitch))
+    return 1;
+
+  printf("PASS\n");
+  return 0;
+}
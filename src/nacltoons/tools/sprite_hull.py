@@ -0,0 +1,285 @@
+#!/usr/bin/env python
+# Copyright (c) 2013 The Chromium Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Compute a tight convex outline of the opaque pixels of sprite images.
+
+For each input image.png an image.hull file is written next to it,
+listing at most --max-vertices points of a convex polygon that contains
+every pixel with alpha above --threshold, padded by half a pixel for
+linear filtering and kept within the image.  Points are one per line,
+"u v", in texture coordinates: (0, 0) is the top left corner of the image
+and (1, 1) the bottom right.  The engine draws sprites showing the whole
+image as that polygon instead of a quad (see src/sprite_hull.h), so the
+transparent corners are never blended.
+
+Only the standard library is used so the tool runs anywhere.
+
+Usage: sprite_hull.py [options] image.png...
+"""
+
+import optparse
+import os
+import struct
+import sys
+import zlib
+
+PNG_SIGNATURE = b'\x89PNG\r\n\x1a\n'
+
+
+class Error(Exception):
+  pass
+
+
+def _Paeth(a, b, c):
+  p = a + b - c
+  pa = abs(p - a)
+  pb = abs(p - b)
+  pc = abs(p - c)
+  if pa <= pb and pa <= pc:
+    return a
+  if pb <= pc:
+    return b
+  return c
+
+
+def ReadAlpha(filename):
+  """Decode a non-interlaced PNG; return (width, height, alpha rows)."""
+  with open(filename, 'rb') as f:
+    data = f.read()
+  if data[:8] != PNG_SIGNATURE:
+    raise Error('%s: not a PNG file' % filename)
+
+  pos = 8
+  idat = []
+  transparency = None
+  header = None
+  while pos < len(data):
+    length, chunk_type = struct.unpack('>I4s', data[pos:pos + 8])
+    body = data[pos + 8:pos + 8 + length]
+    pos += 12 + length
+    if chunk_type == b'IHDR':
+      header = struct.unpack('>IIBBBBB', body)
+    elif chunk_type == b'tRNS':
+      transparency = bytearray(body)
+    elif chunk_type == b'IDAT':
+      idat.append(body)
+    elif chunk_type == b'IEND':
+      break
+
+  if not header:
+    raise Error('%s: missing IHDR' % filename)
+  width, height, depth, color_type, _, _, interlace = header
+  if depth not in (8, 16) or interlace:
+    raise Error('%s: only 8 and 16-bit non-interlaced PNGs are supported' %
+                filename)
+  samples = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(color_type)
+  if samples is None:
+    raise Error('%s: unsupported color type %d' % (filename, color_type))
+  if color_type == 3 and depth != 8:
+    raise Error('%s: bad palette depth' % filename)
+  bpp = samples * depth // 8
+
+  raw = bytearray(zlib.decompress(b''.join(idat)))
+  stride = width * bpp
+  rows = []
+  prev = bytearray(stride)
+  pos = 0
+  for _ in range(height):
+    filter_type = raw[pos]
+    row = raw[pos + 1:pos + 1 + stride]
+    pos += 1 + stride
+    for i in range(stride):
+      a = row[i - bpp] if i >= bpp else 0
+      b = prev[i]
+      if filter_type == 1:
+        row[i] = (row[i] + a) & 0xff
+      elif filter_type == 2:
+        row[i] = (row[i] + b) & 0xff
+      elif filter_type == 3:
+        row[i] = (row[i] + ((a + b) >> 1)) & 0xff
+      elif filter_type == 4:
+        c = prev[i - bpp] if i >= bpp else 0
+        row[i] = (row[i] + _Paeth(a, b, c)) & 0xff
+      elif filter_type != 0:
+        raise Error('%s: bad filter type %d' % (filename, filter_type))
+    rows.append(row)
+    prev = row
+
+  # Alpha only, as 8 bits: the high byte of 16-bit samples.
+  size = depth // 8
+  alpha_rows = []
+  for row in rows:
+    alpha = bytearray(width)
+    for x in range(width):
+      p = row[x * bpp:(x + 1) * bpp]
+      if color_type in (4, 6):
+        alpha[x] = p[(samples - 1) * size]
+      elif color_type == 3:
+        opaque = not transparency or p[0] >= len(transparency)
+        alpha[x] = 255 if opaque else transparency[p[0]]
+      elif transparency and bytearray(p) == transparency[:len(p)]:
+        alpha[x] = 0
+      else:
+        alpha[x] = 255
+    alpha_rows.append(alpha)
+  return width, height, alpha_rows
+
+
+def _Cross(o, a, b):
+  return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0])
+
+
+def ConvexHull(points):
+  """Counterclockwise hull of |points| (monotone chain), no collinear points."""
+  points = sorted(set(points))
+  if len(points) < 3:
+    return points
+  lower = []
+  for p in points:
+    while len(lower) >= 2 and _Cross(lower[-2], lower[-1], p) <= 0:
+      lower.pop()
+    lower.append(p)
+  upper = []
+  for p in reversed(points):
+    while len(upper) >= 2 and _Cross(upper[-2], upper[-1], p) <= 0:
+      upper.pop()
+    upper.append(p)
+  return lower[:-1] + upper[:-1]
+
+
+def Area(polygon):
+  area = 0.0
+  for i in range(len(polygon)):
+    x0, y0 = polygon[i - 1]
+    x1, y1 = polygon[i]
+    area += x0 * y1 - x1 * y0
+  return abs(area) / 2
+
+
+def _Clip(polygon, a, b):
+  """Keep the part of convex |polygon| to the left of the line a->b."""
+  out = []
+  for i in range(len(polygon)):
+    p = polygon[i - 1]
+    q = polygon[i]
+    side_p = _Cross(a, b, p)
+    side_q = _Cross(a, b, q)
+    if side_q >= 0:
+      if side_p < 0:
+        out.append(_Intersect(p, q, side_p, side_q))
+      out.append(q)
+    elif side_p >= 0:
+      out.append(_Intersect(p, q, side_p, side_q))
+  return out
+
+
+def _Intersect(p, q, side_p, side_q):
+  t = side_p / float(side_p - side_q)
+  return (p[0] + (q[0] - p[0]) * t, p[1] + (q[1] - p[1]) * t)
+
+
+def _Dedupe(polygon):
+  out = []
+  for p in polygon:
+    if not out or abs(p[0] - out[-1][0]) + abs(p[1] - out[-1][1]) > 1e-6:
+      out.append(p)
+  while len(out) > 1 and (abs(out[0][0] - out[-1][0]) +
+                          abs(out[0][1] - out[-1][1])) <= 1e-6:
+    out.pop()
+  return out
+
+
+def _Polygon(rect, edges):
+  polygon = rect
+  for a, b in edges:
+    polygon = _Clip(polygon, a, b)
+  return _Dedupe(polygon)
+
+
+def Outline(width, height, alpha_rows, threshold, max_vertices):
+  """Return a convex polygon of at most |max_vertices| points around the
+  pixels with alpha above |threshold|, in pixels, or None if there are
+  none.
+
+  The polygon is the image rectangle cut by edges of the pixels' hull.
+  Edges are dropped one at a time, each time the one whose loss adds the
+  least area, until few enough points are left.
+  """
+  # Corners of each opaque pixel, half a pixel out: linear filtering
+  # blends a pixel into its neighbours up to their centres.
+  points = []
+  for y, row in enumerate(alpha_rows):
+    for x in range(width):
+      if row[x] > threshold:
+        for cx in (x - 0.5, x + 1.5):
+          for cy in (y - 0.5, y + 1.5):
+            points.append((min(max(cx, 0), width), min(max(cy, 0), height)))
+  if not points:
+    return None
+
+  hull = ConvexHull(points)
+  rect = [(0, 0), (width, 0), (width, height), (0, height)]
+  edges = [(hull[i - 1], hull[i]) for i in range(len(hull))]
+  polygon = _Polygon(rect, edges)
+  while len(polygon) > max_vertices and edges:
+    best = None
+    for i in range(len(edges)):
+      candidate = _Polygon(rect, edges[:i] + edges[i + 1:])
+      key = (Area(candidate), len(candidate))
+      if best is None or key < best[0]:
+        best = (key, i, candidate)
+    del edges[best[1]]
+    polygon = best[2]
+  return polygon
+
+
+def WriteHull(filename, source, width, height, polygon):
+  with open(filename, 'w') as f:
+    f.write('# Outline of %s, made by tools/sprite_hull.py.\n' % source)
+    for x, y in polygon:
+      f.write('%.5f %.5f\n' % (x / float(width), y / float(height)))
+
+
+def main(args):
+  parser = optparse.OptionParser(usage='%prog [options] image.png...')
+  parser.add_option('--threshold', type='int', default=8,
+                    help='pixels with alpha above this are kept inside '
+                    'the outline; fainter ones may be cut off (default '
+                    '%default, about 3%)')
+  parser.add_option('--max-vertices', type='int', default=8,
+                    help='most points in an outline (default %default)')
+  options, args = parser.parse_args(args)
+  if not args:
+    parser.error('expected at least one image')
+  if options.max_vertices < 4:
+    parser.error('--max-vertices must be at least 4')
+
+  for filename in args:
+    try:
+      width, height, alpha_rows = ReadAlpha(filename)
+    except Error as e:
+      sys.stderr.write('%s\n' % e)
+      return 1
+    polygon = Outline(width, height, alpha_rows, options.threshold,
+                      options.max_vertices)
+    if not polygon:
+      sys.stderr.write('%s: no opaque pixels, skipped\n' % filename)
+      continue
+    output = os.path.splitext(filename)[0] + '.hull'
+    area = Area(polygon) / (width * height)
+    if area > 0.99:
+      # A quad is as good; don't leave a stale outline behind.
+      if os.path.exists(output):
+        os.remove(output)
+      print('%s: fills the quad, no outline' % filename)
+      continue
+    WriteHull(output, os.path.basename(filename), width, height, polygon)
+    print('%s: %d points, %.0f%% of the quad' %
+          (output, len(polygon), 100 * area))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv[1:]))
@@ -5,42 +5,626 @@
 
 """Python wrapper around gcc to make it behave a little
 more like cl.exe WRT to parallel building.
+
+Usage:
+  compiler_wrapper.py <compiler> <flags> -o <outdir> -- <sources>
+                      [--up-to-date <sources>]
+  compiler_wrapper.py --manifest <file>
+
+The sources after '--' are compiled.  Those after --up-to-date are the
+rest of the group, which only need compiling again when a unity batch
+they belong to does (see below).
+
+A manifest lists several such command lines, one per line, and all of
+their sources are scheduled on a single worker pool.
+
+When run from make -jN (MAKEFLAGS names a GNU make jobserver) each compile
+beyond the first waits for a jobserver token, so nested builds never run
+more than N jobs in total.  Otherwise the pool size is NACL_GCC_CORES or
+the number of CPUs.
+
+Sources are started longest first, using compile times remembered from
+earlier builds in compile_times.json in the first output directory (or
+NACL_GCC_TIMING_DB).  A timing report listing the NACL_GCC_TIMING_REPORT
+(default 5, 0 to disable) slowest files follows every build.
+
+Set NACL_GCC_CACHE_DIR to a directory to enable a local compile cache:
+objects are then reused whenever the preprocessed source, the compiler
+and the code generation flags all match a previous compile.
+
+Set NACL_GCC_UNITY=1 to compile the small sources of each group as unity
+translation units: generated files in the output directory that #include
+up to NACL_GCC_UNITY_BYTES (default 64K) of source each.  The unity object
+is written as the first member's object and the other members get empty
+objects, so the set of objects the linker sees does not change.  Because
+of that a batch is always compiled as a whole: when any of its sources is
+out of date, and when its sources were last compiled in a different batch
+or alone (unity_batches.json in the output directory records which), so
+that no object is left holding code that another one now has.  When a
+unity TU fails to compile, the sources whose objects are out of date are
+compiled one at a time instead.  If each of them compiles alone, the batch
+itself is at fault (e.g. two sources define the same static name) and is
+not tried again while it has the same sources.
 """
 
+import errno
+import hashlib
+import json
 import multiprocessing
 import os
 import Queue
+import re
+import select
 import shlex
+import shutil
 import subprocess
 import sys
+import tempfile
 import threading
 import time
+import traceback
 
 verbose = int(os.environ.get('NACL_GCC_VERBOSE', '0'))
 show_commands = int(os.environ.get('NACL_GCC_SHOW_COMMANDS', '0'))
 stop_on_error = False
+compile_cache = None
+jobserver = None
+compile_times = None
+unity_batches = None
+
+# Upper bound on worker threads when a jobserver limits concurrency; the
+# threads just wait for tokens.
+MAX_JOBSERVER_THREADS = 64
+
+# Bump to invalidate every existing cache entry.
+CACHE_VERSION = '2'
+
+# Options that only affect preprocessing.  Their effect is already captured
+# by hashing the preprocessed source, so leaving them out of the key lets
+# builds from different include layouts share entries.
+PREPROCESSOR_OPTIONS_WITH_ARG = ['-I', '-D', '-U', '-isystem', '-idirafter',
+                                 '-iquote', '-include', '-imacros']
+
+# Sources that may be #included into a unity translation unit.  Sources
+# are only batched with others of the same extension.
+UNITY_EXTENSIONS = ['.c', '.cc', '.cpp', '.cxx']
+DEFAULT_UNITY_BYTES = 64 * 1024
+UNITY_BATCHES_FILE = 'unity_batches.json'
+
+# Dependency file options.  They change side outputs only; the .d file is
+# cached alongside the object and rewritten on a hit.  The options without
+# an argument stay in the key, since they decide whether an entry has a .d
+# file at all and what it lists; the paths given to the others do not.
+DEPENDENCY_OPTIONS = ['-MD', '-MMD', '-MP']
+DEPENDENCY_OPTIONS_WITH_ARG = ['-MF', '-MT', '-MQ']
 
 
 def RunGCC(cmd, basename):
   """Run gcc and return the result along will the stdout/stderr."""
+  if compile_cache:
+    return compile_cache.Compile(cmd, basename)
+  return RunGCCUncached(cmd, basename)
+
+
+def RunGCCUncached(cmd, basename, note=''):
   cmdstring = subprocess.list2cmdline(cmd)
   p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
   stdout, stderr = p.communicate()
   p.wait()
+  return (p.returncode, stdout, LogHeader(cmd, basename, note) + stderr)
+
+
+def LogHeader(cmd, basename, note=''):
   if show_commands:
-    logmsg = cmdstring
+    logmsg = subprocess.list2cmdline(cmd)
   else:
     logmsg = basename
-  stderr = logmsg + '\n' + stderr
-  return (p.returncode, stdout, stderr)
+  return logmsg + note + '\n'
+
+
+def ReadFile(filename):
+  with open(filename, 'rb') as f:
+    return f.read()
+
+
+def WriteFile(filename, data):
+  with open(filename, 'wb') as f:
+    f.write(data)
+
+
+def RetargetDependencies(deps, out):
+  """Make |out| the target of the make rule in the .d file text |deps|."""
+  # The separator is the first colon followed by whitespace, which skips
+  # drive letters.
+  match = re.match(r'(.*?):(\s)', deps, re.S)
+  if match:
+    deps = out.replace(' ', '\\ ') + ':' + deps[match.end(1) + 1:]
+  return deps
+
+
+def DependencyFile(cmd, out):
+  """Return the .d file gcc writes for |cmd|, or None."""
+  for i, arg in enumerate(cmd):
+    if arg == '-MF' and i + 1 < len(cmd):
+      return cmd[i + 1]
+    if arg.startswith('-MF') and len(arg) > 3:
+      return arg[3:]
+  if '-MD' in cmd or '-MMD' in cmd:
+    return os.path.splitext(out)[0] + '.d'
+  return None
+
+
+class CompileCache(object):
+  """Local cache of object files keyed by the content of each compile.
+
+  The key combines the preprocessed source, the identity of the compiler
+  binary and the flags that affect code generation.  Entries hold the
+  object file, the compiler's diagnostics and the dependency file, so a hit
+  looks exactly like a real compile to Visual Studio.  Only successful
+  compiles are stored.
+  """
+
+  def __init__(self, cache_dir):
+    self.cache_dir = cache_dir
+    self.lock = threading.Lock()
+    self.hits = 0
+    self.misses = 0
+    self.uncacheable = 0
+    self.hit_outputs = set()
+    self.compiler_ids = {}
+
+  def CompilerIdentity(self, compiler):
+    with self.lock:
+      if compiler not in self.compiler_ids:
+        try:
+          st = os.stat(compiler)
+          ident = '%s:%d:%d' % (os.path.normcase(compiler), st.st_size,
+                                int(st.st_mtime))
+        except OSError:
+          ident = compiler
+        self.compiler_ids[compiler] = ident
+      return self.compiler_ids[compiler]
+
+  @staticmethod
+  def SplitCommand(cmd):
+    """Split |cmd| into (flags for the key, preprocess-only command).
+
+    |cmd| ends in '-c <source> -o <object>', as built by MakeCommand.
+    """
+    key_flags = []
+    pp_cmd = [cmd[0]]
+    args = cmd[1:-4]
+    i = 0
+    while i < len(args):
+      arg = args[i]
+      if arg in DEPENDENCY_OPTIONS_WITH_ARG:
+        i += 2
+        continue
+      if arg in DEPENDENCY_OPTIONS:
+        key_flags.append(arg)
+        i += 1
+        continue
+      if arg[:3] in DEPENDENCY_OPTIONS_WITH_ARG:
+        i += 1
+        continue
+      if arg == '-c':
+        i += 1
+        continue
+      if arg in PREPROCESSOR_OPTIONS_WITH_ARG and i + 1 < len(args):
+        pp_cmd += args[i:i + 2]
+        i += 2
+        continue
+      pp_cmd.append(arg)
+      if not [o for o in PREPROCESSOR_OPTIONS_WITH_ARG if arg.startswith(o)]:
+        key_flags.append(arg)
+      i += 1
+    return key_flags, pp_cmd + ['-E', cmd[-3]]
+
+  def Key(self, cmd):
+    """Hash the compile, or return None if the source cannot be
+    preprocessed (the real compile then reports the error)."""
+    key_flags, pp_cmd = self.SplitCommand(cmd)
+    p = subprocess.Popen(pp_cmd, stdout=subprocess.PIPE,
+                         stderr=subprocess.PIPE)
+    preprocessed, _ = p.communicate()
+    if p.returncode:
+      return None
+    h = hashlib.sha1()
+    h.update(CACHE_VERSION + '\0')
+    h.update(self.CompilerIdentity(cmd[0]) + '\0')
+    h.update('\0'.join(key_flags) + '\0')
+    h.update(preprocessed)
+    return h.hexdigest()
+
+  def EntryDir(self, key):
+    return os.path.join(self.cache_dir, key[:2], key)
+
+  def Compile(self, cmd, basename):
+    out = cmd[-1]
+    key = self.Key(cmd)
+    if key is None:
+      with self.lock:
+        self.uncacheable += 1
+      return RunGCCUncached(cmd, basename)
+
+    result = self.Restore(key, cmd, basename, out)
+    if result:
+      with self.lock:
+        self.hits += 1
+        self.hit_outputs.add(out)
+      return result
+
+    with self.lock:
+      self.misses += 1
+    result = RunGCCUncached(cmd, basename)
+    if result[0] == 0:
+      self.Store(key, cmd, out, result)
+    return result
+
+  def Restore(self, key, cmd, basename, out):
+    entry = self.EntryDir(key)
+    try:
+      shutil.copyfile(os.path.join(entry, 'obj'), out)
+      stdout = ReadFile(os.path.join(entry, 'stdout'))
+      stderr = ReadFile(os.path.join(entry, 'stderr'))
+      depfile = DependencyFile(cmd, out)
+      if depfile:
+        # The rule's target is the object path of the compile that filled
+        # the entry; point it at ours.
+        deps = ReadFile(os.path.join(entry, 'd'))
+        WriteFile(depfile, RetargetDependencies(deps, out))
+    except (IOError, OSError):
+      return None
+    return (0, stdout, LogHeader(cmd, basename, ' (cached)') + stderr)
+
+  def Store(self, key, cmd, out, result):
+    _, stdout, stderr = result
+    entry = self.EntryDir(key)
+    if os.path.isdir(entry):
+      return
+    # Build the entry next to its final location and rename it into place
+    # so concurrent builds never see a partial entry.
+    parent = os.path.dirname(entry)
+    try:
+      if not os.path.isdir(parent):
+        os.makedirs(parent)
+    except OSError as e:
+      if e.errno != errno.EEXIST:
+        return
+    try:
+      tmp = tempfile.mkdtemp(dir=parent)
+    except OSError:
+      return
+    try:
+      shutil.copyfile(out, os.path.join(tmp, 'obj'))
+      WriteFile(os.path.join(tmp, 'stdout'), stdout)
+      # Strip the header line RunGCCUncached added; Restore adds its own.
+      WriteFile(os.path.join(tmp, 'stderr'), stderr.split('\n', 1)[1])
+      depfile = DependencyFile(cmd, out)
+      if depfile:
+        shutil.copyfile(depfile, os.path.join(tmp, 'd'))
+      os.rename(tmp, entry)
+    except (IOError, OSError):
+      shutil.rmtree(tmp, ignore_errors=True)
+
+  def Report(self):
+    lookups = self.hits + self.misses
+    rate = 100.0 * self.hits / lookups if lookups else 0.0
+    Log('compile cache: %d hits, %d misses, %d uncacheable (%.0f%% hit rate)'
+        % (self.hits, self.misses, self.uncacheable, rate))
+
+
+class CompileTimes(object):
+  """Small database of how long each source took to compile last time.
+
+  Used to start the longest compiles first so that a single huge
+  translation unit does not begin last and set the wall time on its own.
+  """
+
+  # Weight of the newest measurement in the running average.
+  WEIGHT = 0.7
+
+  def __init__(self, path):
+    self.path = path
+    self.times = {}
+    try:
+      with open(path) as f:
+        self.times = json.load(f)
+    except (IOError, ValueError):
+      pass
+
+  @staticmethod
+  def Key(filename):
+    return os.path.normcase(os.path.abspath(filename))
+
+  def Expected(self, filename):
+    return self.times.get(self.Key(filename))
+
+  def Record(self, filename, seconds):
+    key = self.Key(filename)
+    old = self.times.get(key)
+    if old is not None:
+      seconds = self.WEIGHT * seconds + (1 - self.WEIGHT) * old
+    self.times[key] = round(seconds, 3)
+
+  def Save(self):
+    # Write and rename so that concurrent builds leave a valid file.
+    try:
+      fd, tmp = tempfile.mkstemp(dir=os.path.dirname(self.path) or '.')
+      with os.fdopen(fd, 'w') as f:
+        json.dump(self.times, f, indent=0, sort_keys=True)
+      if os.name == 'nt' and os.path.exists(self.path):
+        os.remove(self.path)
+      os.rename(tmp, self.path)
+    except (IOError, OSError):
+      Trace('unable to save compile times to %s' % self.path)
+
+  def SortJobs(self, jobs):
+    """Order |jobs| longest expected compile first.
+
+    Sources without history are estimated from their size, using the
+    average compile rate of the sources that have one.
+    """
+    sizes = {}
+    for job in jobs:
+      for source in JobSources(job):
+        try:
+          sizes[source] = os.path.getsize(source)
+        except OSError:
+          sizes[source] = 0
+    known = [(self.Expected(f), sizes[f]) for f in sizes
+             if self.Expected(f) is not None]
+    known_bytes = sum(size for _, size in known)
+    rate = sum(t for t, _ in known) / known_bytes if known_bytes else 1.0
+
+    def Estimate(job):
+      # A unity TU without history of its own is about as slow as its
+      # members.
+      expected = self.Expected(JobSource(job[0]))
+      if expected is None:
+        expected = 0
+        for source in JobSources(job):
+          known = self.Expected(source)
+          expected += sizes[source] * rate if known is None else known
+      return expected
+    jobs.sort(key=Estimate, reverse=True)
+
+
+class UnityBatches(object):
+  """The unity batch each source of an output directory was last compiled
+  in, kept in unity_batches.json there.
+
+  Sources compiled alone have no entry.  A source whose compile failed, or
+  is under way, is recorded in the empty batch, which matches no batch, so
+  that it is compiled again next time.
+  """
+
+  def __init__(self):
+    self.lock = threading.Lock()
+    self.batches = {}
+    self.dirty = set()
+
+  @staticmethod
+  def Key(filename):
+    return os.path.normcase(os.path.abspath(filename))
+
+  def Load(self, outpath):
+    with self.lock:
+      if outpath not in self.batches:
+        self.batches[outpath] = {}
+        try:
+          with open(os.path.join(outpath, UNITY_BATCHES_FILE)) as f:
+            self.batches[outpath] = json.load(f)
+        except (IOError, ValueError):
+          pass
+      return self.batches[outpath]
+
+  def Changed(self, outpath, files):
+    """True if |files| were not last compiled together as one batch (or,
+    for a single file, alone)."""
+    batch = sorted(self.Key(f) for f in files)
+    expected = batch if len(batch) > 1 else None
+    batches = self.Load(outpath)
+    return any(batches.get(key) != expected for key in batch)
+
+  def Record(self, outpath, files, ok):
+    batch = sorted(self.Key(f) for f in files)
+    batches = self.Load(outpath)
+    with self.lock:
+      for key in batch:
+        if not ok:
+          batches[key] = []
+        elif len(batch) > 1:
+          batches[key] = batch
+        else:
+          batches.pop(key, None)
+      self.dirty.add(outpath)
+
+  def Save(self):
+    for outpath in self.dirty:
+      path = os.path.join(outpath, UNITY_BATCHES_FILE)
+      try:
+        if not self.batches[outpath]:
+          if os.path.exists(path):
+            os.remove(path)
+          continue
+        fd, tmp = tempfile.mkstemp(dir=outpath)
+        with os.fdopen(fd, 'w') as f:
+          json.dump(self.batches[outpath], f, indent=0, sort_keys=True)
+        if os.name == 'nt' and os.path.exists(path):
+          os.remove(path)
+        os.rename(tmp, path)
+      except (IOError, OSError):
+        Trace('unable to save unity batches to %s' % path)
+
+
+def JobSource(cmd):
+  """The source file of a command built by MakeCommand."""
+  return cmd[-3]
+
+
+def JobSources(job):
+  """The original sources compiled by |job|."""
+  if len(job) > 2:
+    return [JobSource(member[0]) for member in job[2]]
+  return [JobSource(job[0])]
+
+
+def ReportTimes(timings, wall, threads, count):
+  """Log the slowest compiles and a lower bound on the build's wall time.
+
+  |timings| holds (seconds, basename) for every job that ran.  The
+  critical path of a set of independent compiles is bounded below by both
+  the longest single compile and the total work spread over all threads.
+  """
+  if not timings or count <= 0:
+    return
+  timings = sorted(timings, reverse=True)
+  total = sum(t for t, _ in timings)
+  longest, longest_name = timings[0]
+  Log('compile timing: %d files, %.2f s of compiles in %.2f s wall '
+      'on %d threads' % (len(timings), total, wall, threads))
+  Log('  critical path estimate %.2f s (longest file %s %.2f s)' %
+      (max(longest, total / threads), longest_name, longest))
+  for seconds, name in timings[:count]:
+    Log('  %7.2f s  %s' % (seconds, name))
+
+
+class JobServer(object):
+  """Client side of the GNU make jobserver protocol.
+
+  Every process owns one implicit job slot; each further job needs a token
+  read from the jobserver, which is written back when the job finishes.
+  """
 
+  # Returned by Acquire after Cancel.
+  CANCELLED = object()
 
-def BuildSerial(base_cmd, outpath, files):
+  def __init__(self, read_fd, write_fd):
+    self.read_fd = read_fd
+    self.write_fd = write_fd
+    self.cond = threading.Condition()
+    self.implicit_free = True
+    # Only one thread reads the jobserver at a time; the others wait on
+    # |cond| for the implicit slot or for their turn to read.
+    self.reading = False
+    # Written to when the implicit slot is released, so that the reading
+    # thread stops waiting for a token and takes the slot instead.
+    self.wake_read, self.wake_write = os.pipe()
+    self.cancelled = False
+
+  @staticmethod
+  def FromEnvironment():
+    """Return a JobServer for the one described by MAKEFLAGS, or None."""
+    makeflags = os.environ.get('MAKEFLAGS', '')
+    value = None
+    for arg in makeflags.split():
+      for prefix in ('--jobserver-auth=', '--jobserver-fds='):
+        if arg.startswith(prefix):
+          value = arg[len(prefix):]
+    if not value:
+      return None
+
+    try:
+      if value.startswith('fifo:'):
+        fd = os.open(value[5:], os.O_RDWR)
+        return JobServer(fd, fd)
+      read_fd, write_fd = [int(fd) for fd in value.split(',')]
+    except (OSError, ValueError):
+      # e.g. a Windows semaphore name, or a fifo that has gone away.
+      Trace('unsupported jobserver: %s' % value)
+      return None
+    if read_fd < 0 or write_fd < 0:
+      return None
+    try:
+      # make only passes the pipe on to recipes it knows are recursive
+      # ('+' or $(MAKE)); otherwise the descriptors are closed.
+      os.fstat(read_fd)
+      os.fstat(write_fd)
+    except OSError:
+      Trace('jobserver descriptors %s are not open' % value)
+      return None
+    return JobServer(read_fd, write_fd)
+
+  def Acquire(self):
+    """Block until a job may run.  Returns the token to pass to Release, or
+    CANCELLED once Cancel has been called."""
+    with self.cond:
+      while True:
+        if self.cancelled:
+          return JobServer.CANCELLED
+        if self.implicit_free:
+          self.implicit_free = False
+          return None
+        if not self.reading:
+          self.reading = True
+          break
+        self.cond.wait()
+    try:
+      return self.ReadToken()
+    finally:
+      with self.cond:
+        self.reading = False
+        self.cond.notify()
+
+  def ReadToken(self):
+    """Wait for a token from the jobserver or for the implicit slot."""
+    while True:
+      try:
+        ready = select.select([self.read_fd, self.wake_read], [], [])[0]
+      except select.error as e:
+        if e.args[0] != errno.EINTR:
+          raise
+        continue
+      if self.wake_read in ready:
+        os.read(self.wake_read, 4096)
+        with self.cond:
+          if self.cancelled:
+            return JobServer.CANCELLED
+          if self.implicit_free:
+            self.implicit_free = False
+            return None
+      if self.read_fd not in ready:
+        continue
+      try:
+        # Another process may take the token first, leaving this read
+        # blocked; other threads still get the implicit slot through
+        # |cond| meanwhile.
+        token = os.read(self.read_fd, 1)
+        if token:
+          return token
+      except OSError as e:
+        # Some make versions leave the pipe non-blocking.
+        if e.errno not in (errno.EAGAIN, errno.EINTR):
+          raise
+
+  def Cancel(self):
+    """Make threads waiting in Acquire, and any that call it later, return
+    CANCELLED."""
+    with self.cond:
+      self.cancelled = True
+      self.cond.notify_all()
+      wake = self.reading
+    if wake:
+      os.write(self.wake_write, 'x')
+
+  def Release(self, token):
+    if token is None:
+      with self.cond:
+        self.implicit_free = True
+        self.cond.notify()
+        wake = self.reading
+      if wake:
+        os.write(self.wake_write, 'x')
+    else:
+      os.write(self.write_fd, token)
+
+
+def BuildSerial(jobs):
   final_result = 0
 
-  for filename in files:
-    cmd, basename = MakeCommand(base_cmd, outpath, filename)
-    rtn, stdout, stderr = RunGCC(cmd, basename)
+  for job in jobs:
+    rtn, stdout, stderr = RunJob(job)
     sys.stdout.write(stdout)
     sys.stdout.flush()
     sys.stderr.write(stderr)
@@ -60,12 +644,31 @@ def Worker(queue, out_queue):
   there are no jobs left or until the main thread signals
   for the work to stop.
   """
-  while not queue.empty() and Worker.running:
-    item = queue.get(False)
-    if not item:
+  while Worker.running:
+    # Take the job slot first, so that no job sits in a thread that is
+    # waiting for one while another thread could run it.
+    token = jobserver.Acquire() if jobserver else None
+    if token is JobServer.CANCELLED:
       break
-    results = RunGCC(item[0], item[1])
-    out_queue.put(results)
+    try:
+      try:
+        item = queue.get(False)
+      except Queue.Empty:
+        break
+      if not Worker.running:
+        break
+      start = time.time()
+      try:
+        results = RunJob(item)
+      except Exception:
+        # Always post a result: the main thread waits for one per job.
+        results = (1, '', LogHeader(item[0], item[1]) +
+                   traceback.format_exc())
+      elapsed = time.time() - start
+    finally:
+      if jobserver:
+        jobserver.Release(token)
+    out_queue.put((results, item, elapsed))
 
 
 def MakeCommand(base_cmd, outpath, filename):
@@ -81,15 +684,238 @@ def MakeCommand(base_cmd, outpath, filename):
   return (base_cmd + ['-c', filename, '-o', out], basename)
 
 
-def BuildParallel(cores, base_cmd, outpath, files):
+def MakeGroupJobs(base_cmd, outpath, files, up_to_date, budget, cores):
+  """Return the jobs for one group.
+
+  |files| are the group's out of date sources and |up_to_date| the rest.
+  With a unity |budget| the sources are split into batches as described
+  in BatchSources, otherwise each source is a batch of its own.  A batch
+  is compiled if any of its sources is out of date or unity_batches says
+  its sources were last compiled differently.
+  """
+  stale = set(UnityBatches.Key(f) for f in files)
+  if budget:
+    batches = BatchSources(sorted(files + up_to_date, key=UnityBatches.Key),
+                           budget, cores)
+  else:
+    batches = [[filename] for filename in files + up_to_date]
+
+  jobs = []
+  for batch in batches:
+    if len(batch) > 1 and UnityFailed(outpath, batch):
+      parts = [[filename] for filename in batch]
+    else:
+      parts = [batch]
+    for part in parts:
+      if (not [f for f in part if UnityBatches.Key(f) in stale] and
+          not unity_batches.Changed(outpath, part)):
+        continue
+      if len(part) > 1:
+        jobs.append(MakeUnityJob(base_cmd, outpath, part, stale))
+      else:
+        jobs.append(MakeCommand(base_cmd, outpath, part[0]))
+  return jobs
+
+
+def BatchSources(files, budget, cores):
+  """Split |files| into lists of sources to compile together.
+
+  Small sources are batched in the order given, up to |budget| bytes of
+  source per unity TU but into at least |cores| batches so that the
+  worker pool stays busy.  Sources larger than half the budget, or of a
+  language we don't batch, are batches of their own.
+  """
+  batches = []
+  by_ext = {}
+  for filename in files:
+    ext = os.path.splitext(filename)[1].lower()
+    try:
+      size = os.path.getsize(filename)
+    except OSError:
+      size = budget
+    if ext in UNITY_EXTENSIONS and size <= budget / 2:
+      by_ext.setdefault(ext, []).append((filename, size))
+    else:
+      batches.append([filename])
+
+  for ext, sources in sorted(by_ext.items()):
+    total = sum(size for _, size in sources)
+    limit = min(budget, max(total / cores, 1))
+    batch = []
+    batch_size = 0
+    for filename, size in sources:
+      if batch and batch_size + size > limit:
+        batches.append(batch)
+        batch = []
+        batch_size = 0
+      batch.append(filename)
+      batch_size += size
+    if batch:
+      batches.append(batch)
+  return batches
+
+
+def UnitySource(outpath, files):
+  """Return the path and content of the unity TU that #includes |files|."""
+  content = '/* Generated by compiler_wrapper.py; do not edit. */\n'
+  for filename in files:
+    include = os.path.abspath(filename).replace('\\', '/')
+    content += '#include "%s"\n' % include
+  # Named after the content so that an unchanged batch keeps its file, and
+  # its timestamp, from one build to the next.
+  name = 'unity_%s%s' % (hashlib.sha1(content).hexdigest()[:10],
+                         os.path.splitext(files[0])[1].lower())
+  return os.path.join(outpath, name), content
+
+
+def UnityFailed(outpath, files):
+  """True if the unity TU for |files| failed although each of them
+  compiled alone.  The marker is named after the TU's content, so a batch
+  with other sources is tried again."""
+  return os.path.exists(UnityFailedMarker(UnitySource(outpath, files)[0]))
+
+
+def MakeUnityJob(base_cmd, outpath, files, stale):
+  """Return a (cmd, basename, members, fallback) job that compiles |files|
+  as a single translation unit into the object of the first of them.
+  |members| are the regular jobs for |files|, and |fallback| those to run
+  if the unity TU fails: the first member, whose object the failed compile
+  may have clobbered, and those whose object is missing, out of date (its
+  key is in |stale|) or was not last compiled from that source alone."""
+  members = [MakeCommand(base_cmd, outpath, filename) for filename in files]
+  fallback = [member for i, member in enumerate(members)
+              if i == 0 or UnityBatches.Key(files[i]) in stale or
+              unity_batches.Changed(outpath, [files[i]]) or
+              not os.path.exists(member[0][-1])]
+  path, content = UnitySource(outpath, files)
+  if not os.path.exists(path):
+    WriteFile(path, content)
+  cmd = base_cmd + ['-c', path, '-o', members[0][0][-1]]
+  basename = '%s (%s)' % (os.path.basename(path),
+                          ', '.join(member[1] for member in members))
+  return (cmd, basename, members, fallback)
+
+
+def UnityFailedMarker(unity_source):
+  return os.path.splitext(unity_source)[0] + '.failed'
+
+
+def RecordBatch(members, ok):
+  """Note in unity_batches how the sources of |members| were compiled."""
+  outpath = os.path.dirname(members[0][0][-1])
+  unity_batches.Record(outpath, [JobSource(cmd) for cmd, _ in members], ok)
+
+
+def RunJob(job):
+  if len(job) > 2:
+    return RunUnity(*job)
+  # Until it succeeds the object may still hold a unity batch.
+  RecordBatch([job], False)
+  result = RunGCC(job[0], job[1])
+  RecordBatch([job], result[0] == 0)
+  return result
+
+
+def RunUnity(cmd, basename, members, fallback):
+  """Compile a unity job and give every member an object and .d file.
+
+  If the unity TU does not compile, the |fallback| members are compiled
+  one by one and only their diagnostics are reported."""
+  # Until every member's object is written the batch is inconsistent.
+  RecordBatch(members, False)
+  rtn, stdout, stderr = RunGCC(cmd, basename)
+  if rtn == 0:
+    rtn, more_stdout, more_stderr = FinishUnity(cmd, basename, members)
+    RecordBatch(members, rtn == 0)
+    return (rtn, stdout + more_stdout, stderr + more_stderr)
+
+  Trace('unity TU %s failed, compiling its sources separately:\n%s' %
+        (basename, stderr))
+  rtn = 0
+  stdout = ''
+  stderr = ''
+  for member in members:
+    if member not in fallback:
+      # Its object is still the one compiled from it alone.
+      RecordBatch([member], True)
+      continue
+    result = RunGCC(*member)
+    RecordBatch([member], result[0] == 0)
+    rtn = rtn or result[0]
+    stdout += result[1]
+    stderr += result[2]
+  if rtn == 0:
+    # Every source compiles alone, so the batch is at fault; don't try it
+    # again while it has the same sources.
+    WriteFile(UnityFailedMarker(JobSource(cmd)), '')
+  return (rtn, stdout, stderr)
+
+
+def FinishUnity(cmd, basename, members):
+  """Write an empty object for each member after the first, which already
+  has the unity object, and a copy of the unity .d file for each."""
+  unity_source = JobSource(cmd)
+  empty_source = os.path.splitext(unity_source)[0] + '_empty' + \
+      os.path.splitext(unity_source)[1]
+  empty_obj = os.path.splitext(unity_source)[0] + '_empty.obj'
+  if not os.path.exists(empty_source):
+    WriteFile(empty_source, '')
+  # Built with the same flags so that it matches the other objects' ABI.
+  empty_cmd = cmd[:-4] + ['-c', empty_source, '-o', empty_obj]
+  result = RunGCC(empty_cmd, basename)
+  if result[0]:
+    return result
+
+  depfile = DependencyFile(cmd, cmd[-1])
+  deps = ReadFile(depfile) if depfile and os.path.exists(depfile) else None
+  for member_cmd, _ in members[1:]:
+    out = member_cmd[-1]
+    shutil.copyfile(empty_obj, out)
+    # Every member depends on all headers of the batch; that is only
+    # conservative.
+    member_depfile = DependencyFile(member_cmd, out)
+    if deps is not None and member_depfile:
+      WriteFile(member_depfile, RetargetDependencies(deps, out))
+  return (0, '', '')
+
+
+def WriteResult(result):
+  rtn, stdout, stderr = result
+  # stdout seem to be completely ignored by visual studio
+  # but GCC should output all useful information on stderr
+  # anyway.
+  sys.stdout.write(stdout)
+  sys.stdout.flush()
+  sys.stderr.write(stderr)
+  sys.stderr.flush()
+  return rtn
+
+
+def HandleResult(result, timings):
+  results, job, elapsed = result
+  cmd, basename = job[:2]
+  rtn = WriteResult(results)
+  timings.append((elapsed, basename))
+  # Cache hits and failures say little about how long a compile takes.
+  cached = compile_cache and cmd[-1] in compile_cache.hit_outputs
+  if compile_times and rtn == 0 and not cached:
+    compile_times.Record(JobSource(cmd), elapsed)
+  return rtn
+
+
+def BuildParallel(cores, jobs):
   Worker.running = True
   pool = []
   job_queue = Queue.Queue()
   out_queue = Queue.Queue()
+  timings = []
+  start = time.time()
 
-  for filename in files:
-    cmd, basename = MakeCommand(base_cmd, outpath, filename)
-    job_queue.put((cmd, basename))
+  if compile_times:
+    compile_times.SortJobs(jobs)
+
+  for job in jobs:
+    job_queue.put(job)
 
   # Create worker thread pool, passing job queue
   # and output queue to each worker.
@@ -97,27 +923,32 @@ def BuildParallel(cores, base_cmd, outpath, files):
   for i in xrange(cores):
     t = threading.Thread(target=Worker, args=args)
     t.start()
+    pool.append(t)
 
   results = 0
-  Trace("waiting for %d results" % len(files))
+  Trace("waiting for %d results" % len(jobs))
   final_result = 0
-  while results < len(files):
+  while results < len(jobs):
     results += 1
-    rtn, stdout, stderr = out_queue.get()
-    # stdout seem to be completely ignored by visual studio
-    # but GCC should output all useful information on stderr
-    # anyway.
-    sys.stdout.write(stdout)
-    sys.stdout.flush()
-    sys.stderr.write(stderr)
-    sys.stderr.flush()
+    rtn = HandleResult(out_queue.get(), timings)
     if rtn:
       final_result = rtn
       if stop_on_error:
-        # stop all workers
+        # Stop handing out new jobs, but let the ones already running
+        # finish so that their diagnostics are reported too.
         Worker.running = False
         break
 
+  if jobserver:
+    # Threads still waiting for a job slot have nothing left to run.
+    jobserver.Cancel()
+  for t in pool:
+    t.join()
+  while not out_queue.empty():
+    HandleResult(out_queue.get(), timings)
+
+  report_count = int(os.environ.get('NACL_GCC_TIMING_REPORT', '5'))
+  ReportTimes(timings, time.time() - start, cores, report_count)
   return final_result
 
 
@@ -134,11 +965,10 @@ def Trace(msg):
     Log("nacl_compiler:" + str(msg))
 
 
-def main(args):
-  if args[0][0] == '@':
-    rspfile = args[0][1:]
-    args = shlex.split(open(rspfile).read())
-
+def ParseGroup(args):
+  """Split '<compiler> <flags> -o <outpath> -- <sources>
+  [--up-to-date <sources>]' into the base command (without -o), the
+  output directory, the sources to compile and the up to date ones."""
   # find the last occurrence of '--' in the argument
   # list and use that to signify the start of the
   # list of sources
@@ -146,20 +976,91 @@ def main(args):
   index = len(args) - index
   base_cmd = args[:index-1]
   files = args[index:]
+  up_to_date = []
+  if '--up-to-date' in files:
+    index = files.index('--up-to-date')
+    up_to_date = files[index+1:]
+    files = files[:index]
 
   # remove -o <path> from base_cmd
   index = base_cmd.index('-o')
   outpath = base_cmd[index+1]
   del base_cmd[index+1]
   del base_cmd[index]
+  return base_cmd, outpath, files, up_to_date
+
+
+def ReadManifest(filename):
+  """Read a build manifest: one group per line, each in the same
+  '<compiler> <flags> -o <outpath> -- <sources>' form as a single group
+  on the command line.  Sources from every group share one worker pool."""
+  groups = []
+  with open(filename) as f:
+    for line in f:
+      if line.strip():
+        groups.append(ParseGroup(shlex.split(line)))
+  return groups
+
+
+def main(args):
+  global stop_on_error
+  if args[0][0] == '@':
+    rspfile = args[0][1:]
+    args = shlex.split(open(rspfile).read())
 
+  if args[0] == '--manifest':
+    groups = ReadManifest(args[1])
+    # Several groups used to be separate wrapper runs and the build stopped
+    # at the first failing one; keep failing fast now that they are merged.
+    stop_on_error = True
+  else:
+    groups = [ParseGroup(args)]
+
+  global jobserver
+  jobserver = JobServer.FromEnvironment()
   cores = int(os.environ.get('NACL_GCC_CORES', '0'))
   if not cores:
-    cores = multiprocessing.cpu_count()
-  cores = min(cores, len(files))
+    if jobserver:
+      # make's token count is the real limit.
+      cores = MAX_JOBSERVER_THREADS
+    else:
+      cores = multiprocessing.cpu_count()
+
+  unity_budget = 0
+  if int(os.environ.get('NACL_GCC_UNITY', '0')):
+    unity_budget = int(os.environ.get('NACL_GCC_UNITY_BYTES',
+                                      str(DEFAULT_UNITY_BYTES)))
+  # Kept up to date even without NACL_GCC_UNITY, so that the batches of
+  # an earlier unity build are split up again.
+  global unity_batches
+  unity_batches = UnityBatches()
+  jobs = []
+  for base_cmd, outpath, files, up_to_date in groups:
+    jobs += MakeGroupJobs(base_cmd, outpath, files, up_to_date, unity_budget,
+                          min(cores, multiprocessing.cpu_count()))
+  if not jobs:
+    return 0
+  cores = min(cores, len(jobs))
+
+  global compile_cache
+  cache_dir = os.environ.get('NACL_GCC_CACHE_DIR')
+  if cache_dir:
+    compile_cache = CompileCache(cache_dir)
+
+  global compile_times
+  timing_db = os.environ.get('NACL_GCC_TIMING_DB')
+  if not timing_db:
+    timing_db = os.path.join(groups[0][1], 'compile_times.json')
+  compile_times = CompileTimes(timing_db)
 
-  Trace("compiling %d sources using %d threads" % (len(files), cores))
-  rtn = BuildParallel(cores, base_cmd, outpath, files)
+  Trace("compiling %d sources from %d groups using %d threads%s" %
+        (len(jobs), len(groups), cores,
+         " (limited by make jobserver)" if jobserver else ""))
+  rtn = BuildParallel(cores, jobs)
+  compile_times.Save()
+  unity_batches.Save()
+  if compile_cache:
+    compile_cache.Report()
   Trace("returning %d" % rtn)
   return rtn
 
@@ -0,0 +1,102 @@
+#!/usr/bin/env python
+# Copyright (c) 2013 The Chromium Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file
+
+"""Tests for compiler_wrapper.py that run it under GNU make.
+
+Usage: python compiler_wrapper_test.py
+"""
+
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import threading
+import unittest
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+WRAPPER = os.path.join(SCRIPT_DIR, 'compiler_wrapper.py')
+
+# Stands in for gcc: writes the object after a short delay and records
+# the largest number of compiles it saw running at once.
+FAKE_COMPILER = r'''
+import os, sys, time
+running = os.path.join(os.path.dirname(sys.argv[0]), 'running')
+mine = os.path.join(running, str(os.getpid()))
+open(mine, 'w').close()
+count = len(os.listdir(running))
+with open(os.path.join(os.path.dirname(sys.argv[0]), 'counts'), 'a') as f:
+  f.write('%d\n' % count)
+time.sleep(0.2)
+open(sys.argv[sys.argv.index('-o') + 1], 'w').close()
+os.remove(mine)
+'''
+
+SOURCES = 6
+TIMEOUT = 60
+
+
+class JobServerTest(unittest.TestCase):
+  def setUp(self):
+    self.dir = tempfile.mkdtemp()
+    os.mkdir(os.path.join(self.dir, 'running'))
+    compiler = os.path.join(self.dir, 'fake_gcc.py')
+    with open(compiler, 'w') as f:
+      f.write(FAKE_COMPILER)
+
+    sources = []
+    for i in range(SOURCES):
+      sources.append('s%d.c' % i)
+      open(os.path.join(self.dir, sources[-1]), 'w').close()
+    # Two recursive ('+') recipes, so that both wrappers share make's
+    # jobserver.
+    command = '+%s %s %s %s -o $@ -- %s' % (
+        sys.executable, WRAPPER, sys.executable, compiler, ' '.join(sources))
+    with open(os.path.join(self.dir, 'Makefile'), 'w') as f:
+      f.write('all: a b\n'
+              'a b:\n'
+              '\tmkdir -p $@\n'
+              '\t%s\n'
+              '.PHONY: all a b\n' % command)
+
+  def tearDown(self):
+    shutil.rmtree(self.dir)
+
+  def RunMake(self, jobs):
+    env = dict(os.environ)
+    for name in env.keys():
+      if name.startswith('NACL_GCC_') or name == 'MAKEFLAGS':
+        del env[name]
+    env['NACL_GCC_TIMING_REPORT'] = '0'
+    # make runs in a process group of its own, so that a hung build can be
+    # killed along with the wrappers.
+    make = subprocess.Popen(['make', '-j%d' % jobs], cwd=self.dir, env=env,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                            preexec_fn=os.setsid)
+    timer = threading.Timer(TIMEOUT, os.killpg, [make.pid, signal.SIGKILL])
+    timer.start()
+    output = make.communicate()[0]
+    timed_out = not timer.is_alive()
+    timer.cancel()
+    if timed_out:
+      return -1, 'timed out after %d s:\n%s' % (TIMEOUT, output)
+    return make.returncode, output
+
+  def testTwoWrappersShareTheJobServer(self):
+    rtn, output = self.RunMake(2)
+    self.assertEqual(0, rtn, output)
+    for out in ('a', 'b'):
+      for i in range(SOURCES):
+        obj = os.path.join(self.dir, out, 's%d.obj' % i)
+        self.assertTrue(os.path.exists(obj), obj)
+    with open(os.path.join(self.dir, 'counts')) as f:
+      counts = [int(line) for line in f]
+    self.assertEqual(2 * SOURCES, len(counts))
+    self.assertTrue(max(counts) <= 2, counts)
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -0,0 +1,80 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file asset_io_posix.cc
+ * POSIX file implementation of AssetIO.
+ */
+
+//-----------------------------------------------------------------------------
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asset_io_posix.h"
+
+struct PosixStream {
+  int fd;
+  int64_t length;
+};
+
+
+PosixAssetIO::PosixAssetIO(const char* root)
+  : root_(strdup(root)),
+    hide_length_(false) {
+}
+
+
+PosixAssetIO::~PosixAssetIO() {
+  free(root_);
+}
+
+
+int32_t PosixAssetIO::Open(const char* url, AssetStreamClient* client,
+                           void** stream_out) {
+  PosixStream* stream = (PosixStream*) malloc(sizeof(PosixStream));
+  stream->fd = -1;
+  stream->length = -1;
+  *stream_out = stream;
+
+  size_t len = strlen(root_) + strlen(url) + 2;
+  char* path = (char*) malloc(len);
+  snprintf(path, len, "%s/%s", root_, url);
+  stream->fd = open(path, O_RDONLY);
+  free(path);
+  if (stream->fd < 0)
+    return ASSET_IO_FAILED;
+
+  struct stat st;
+  if (!hide_length_ && fstat(stream->fd, &st) == 0 && S_ISREG(st.st_mode))
+    stream->length = st.st_size;
+  return 0;
+}
+
+
+int64_t PosixAssetIO::GetLength(void* stream) {
+  return ((PosixStream*) stream)->length;
+}
+
+
+int32_t PosixAssetIO::Read(void* stream, char* buffer, int32_t size) {
+  int fd = ((PosixStream*) stream)->fd;
+  ssize_t result;
+  do {
+    result = read(fd, buffer, size);
+  } while (result < 0 && errno == EINTR);
+  return result < 0 ? ASSET_IO_FAILED : (int32_t) result;
+}
+
+
+void PosixAssetIO::Close(void* stream_handle) {
+  PosixStream* stream = (PosixStream*) stream_handle;
+  if (stream->fd >= 0)
+    close(stream->fd);
+  free(stream);
+}
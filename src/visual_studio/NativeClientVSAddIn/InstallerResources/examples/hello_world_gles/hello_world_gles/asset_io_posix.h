@@ -0,0 +1,39 @@
+#ifndef EXAMPLES_HELLO_WORLD_GLES_ASSET_IO_POSIX_H
+#define EXAMPLES_HELLO_WORLD_GLES_ASSET_IO_POSIX_H
+
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file asset_io_posix.h
+ * AssetIO backend that reads assets from the local filesystem.  This lets
+ * the loader (and code built on it) run and be tested as a plain Linux
+ * program.  All operations complete synchronously.
+ */
+
+//-----------------------------------------------------------------------------
+#include "asset_loader.h"
+
+class PosixAssetIO : public AssetIO {
+ public:
+  /// URLs are resolved relative to |root|.
+  explicit PosixAssetIO(const char* root);
+  virtual ~PosixAssetIO();
+
+  /// Report every length as unknown, exercising the same code path as a
+  /// chunked HTTP response.
+  void set_hide_length(bool hide) { hide_length_ = hide; }
+
+  virtual int32_t Open(const char* url, AssetStreamClient* client,
+                       void** stream);
+  virtual int64_t GetLength(void* stream);
+  virtual int32_t Read(void* stream, char* buffer, int32_t size);
+  virtual void Close(void* stream);
+
+ private:
+  char* root_;
+  bool hide_length_;
+};
+
+#endif  // EXAMPLES_HELLO_WORLD_GLES_ASSET_IO_POSIX_H
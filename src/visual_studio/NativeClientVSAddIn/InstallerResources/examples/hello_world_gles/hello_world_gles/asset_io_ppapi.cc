@@ -0,0 +1,160 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file asset_io_ppapi.cc
+ * PPB_URLLoader implementation of AssetIO.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+
+#include "ppapi/c/pp_completion_callback.h"
+#include "ppapi/c/pp_errors.h"
+
+#include "asset_io_ppapi.h"
+
+struct PepperAssetIO::Stream {
+  PepperAssetIO* io;
+  AssetStreamClient* client;
+  PP_Resource loader;
+  PP_Resource request;
+  // Set while a completion callback is outstanding.  Pepper still runs the
+  // callback (with PP_ERROR_ABORTED) after the loader is released, so a
+  // stream closed in that state is freed by the callback instead.
+  bool pending;
+  bool closed;
+};
+
+
+PepperAssetIO::PepperAssetIO(PP_Instance instance,
+                             const PPB_Core* core,
+                             const PPB_URLLoader* url_loader,
+                             const PPB_URLRequestInfo* request_info,
+                             const PPB_URLResponseInfo* response_info,
+                             const PPB_Var* var)
+  : instance_(instance),
+    core_(core),
+    url_loader_(url_loader),
+    request_info_(request_info),
+    response_info_(response_info),
+    var_(var) {
+}
+
+
+void PepperAssetIO::FreeStream(Stream* stream) {
+  free(stream);
+}
+
+
+int32_t PepperAssetIO::Open(const char* url, AssetStreamClient* client,
+                            void** stream_out) {
+  Stream* stream = (Stream*) malloc(sizeof(Stream));
+  memset(stream, 0, sizeof(Stream));
+  stream->io = this;
+  stream->client = client;
+  *stream_out = stream;
+
+  stream->loader = url_loader_->Create(instance_);
+  stream->request = request_info_->Create(instance_);
+  if (!stream->loader || !stream->request)
+    return ASSET_IO_FAILED;
+
+  struct PP_Var url_var = var_->VarFromUtf8(url, strlen(url));
+  struct PP_Var method_var = var_->VarFromUtf8("GET", 3);
+  request_info_->SetProperty(stream->request, PP_URLREQUESTPROPERTY_URL,
+                             url_var);
+  request_info_->SetProperty(stream->request, PP_URLREQUESTPROPERTY_METHOD,
+                             method_var);
+  request_info_->SetProperty(stream->request,
+                             PP_URLREQUESTPROPERTY_RECORDDOWNLOADPROGRESS,
+                             PP_MakeBool(PP_TRUE));
+  var_->Release(url_var);
+  var_->Release(method_var);
+
+  stream->pending = true;
+  int32_t result = url_loader_->Open(stream->loader, stream->request,
+      PP_MakeCompletionCallback(OpenComplete, stream));
+  if (result == PP_OK_COMPLETIONPENDING)
+    return ASSET_IO_PENDING;
+  stream->pending = false;
+  return CheckResponse(stream, result);
+}
+
+
+int32_t PepperAssetIO::CheckResponse(Stream* stream, int32_t result) {
+  if (result != PP_OK)
+    return ASSET_IO_FAILED;
+
+  // A missing file still opens successfully; the error is in the status.
+  PP_Resource response = url_loader_->GetResponseInfo(stream->loader);
+  if (!response)
+    return ASSET_IO_FAILED;
+  struct PP_Var status = response_info_->GetProperty(
+      response, PP_URLRESPONSEPROPERTY_STATUSCODE);
+  core_->ReleaseResource(response);
+  if (status.type == PP_VARTYPE_INT32 && status.value.as_int >= 400)
+    return ASSET_IO_FAILED;
+  return 0;
+}
+
+
+void PepperAssetIO::OpenComplete(void* user_data, int32_t result) {
+  Stream* stream = (Stream*) user_data;
+  stream->pending = false;
+  if (stream->closed) {
+    FreeStream(stream);
+    return;
+  }
+  stream->client->OnOpened(stream->io->CheckResponse(stream, result));
+}
+
+
+int64_t PepperAssetIO::GetLength(void* stream_handle) {
+  Stream* stream = (Stream*) stream_handle;
+  int64_t received = 0;
+  int64_t total = -1;
+  if (!url_loader_->GetDownloadProgress(stream->loader, &received, &total))
+    return -1;
+  return total;
+}
+
+
+int32_t PepperAssetIO::Read(void* stream_handle, char* buffer, int32_t size) {
+  Stream* stream = (Stream*) stream_handle;
+  stream->pending = true;
+  int32_t result = url_loader_->ReadResponseBody(stream->loader, buffer, size,
+      PP_MakeCompletionCallback(ReadComplete, stream));
+  if (result == PP_OK_COMPLETIONPENDING)
+    return ASSET_IO_PENDING;
+  stream->pending = false;
+  return result < 0 ? ASSET_IO_FAILED : result;
+}
+
+
+void PepperAssetIO::ReadComplete(void* user_data, int32_t result) {
+  Stream* stream = (Stream*) user_data;
+  stream->pending = false;
+  if (stream->closed) {
+    FreeStream(stream);
+    return;
+  }
+  stream->client->OnRead(result < 0 ? ASSET_IO_FAILED : result);
+}
+
+
+void PepperAssetIO::Close(void* stream_handle) {
+  Stream* stream = (Stream*) stream_handle;
+  if (stream->request)
+    core_->ReleaseResource(stream->request);
+  if (stream->loader)
+    core_->ReleaseResource(stream->loader);
+  stream->request = 0;
+  stream->loader = 0;
+  if (stream->pending)
+    stream->closed = true;
+  else
+    FreeStream(stream);
+}
@@ -0,0 +1,54 @@
+#ifndef EXAMPLES_HELLO_WORLD_GLES_ASSET_IO_PPAPI_H
+#define EXAMPLES_HELLO_WORLD_GLES_ASSET_IO_PPAPI_H
+
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file asset_io_ppapi.h
+ * AssetIO backend that fetches assets with PPB_URLLoader.
+ */
+
+//-----------------------------------------------------------------------------
+#include "ppapi/c/pp_instance.h"
+#include "ppapi/c/ppb_core.h"
+#include "ppapi/c/ppb_url_loader.h"
+#include "ppapi/c/ppb_url_request_info.h"
+#include "ppapi/c/ppb_url_response_info.h"
+#include "ppapi/c/ppb_var.h"
+
+#include "asset_loader.h"
+
+class PepperAssetIO : public AssetIO {
+ public:
+  PepperAssetIO(PP_Instance instance,
+                const PPB_Core* core,
+                const PPB_URLLoader* url_loader,
+                const PPB_URLRequestInfo* request_info,
+                const PPB_URLResponseInfo* response_info,
+                const PPB_Var* var);
+
+  virtual int32_t Open(const char* url, AssetStreamClient* client,
+                       void** stream);
+  virtual int64_t GetLength(void* stream);
+  virtual int32_t Read(void* stream, char* buffer, int32_t size);
+  virtual void Close(void* stream);
+
+ private:
+  struct Stream;
+
+  static void OpenComplete(void* user_data, int32_t result);
+  static void ReadComplete(void* user_data, int32_t result);
+  static void FreeStream(Stream* stream);
+  int32_t CheckResponse(Stream* stream, int32_t result);
+
+  PP_Instance instance_;
+  const PPB_Core* core_;
+  const PPB_URLLoader* url_loader_;
+  const PPB_URLRequestInfo* request_info_;
+  const PPB_URLResponseInfo* response_info_;
+  const PPB_Var* var_;
+};
+
+#endif  // EXAMPLES_HELLO_WORLD_GLES_ASSET_IO_PPAPI_H
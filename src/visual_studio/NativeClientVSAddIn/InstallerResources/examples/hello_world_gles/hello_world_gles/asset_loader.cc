@@ -0,0 +1,231 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file asset_loader.cc
+ * Backend independent part of the streaming asset loader.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "asset_loader.h"
+
+// Initial buffer size when the content length is not known, and the minimum
+// amount the buffer grows by when it fills up.
+static const int32_t kChunkSize = 64 * 1024;
+
+class AssetLoader::Request : public AssetStreamClient {
+ public:
+  Request(AssetLoader* loader, const char* url, AssetCallback callback,
+          void* user_data, bool required)
+    : loader_(loader),
+      url_(strdup(url)),
+      callback_(callback),
+      user_data_(user_data),
+      required_(required),
+      stream_(NULL),
+      buf_(NULL),
+      size_(0),
+      capacity_(0),
+      length_(-1),
+      done_(false),
+      next_(NULL) {}
+
+  virtual ~Request() {
+    if (stream_)
+      loader_->io_->Close(stream_);
+    free(buf_);
+    free(url_);
+  }
+
+  void Begin() {
+    int32_t result = loader_->io_->Open(url_, this, &stream_);
+    if (result != ASSET_IO_PENDING)
+      OnOpened(result);
+  }
+
+  virtual void OnOpened(int32_t result) {
+    if (result < 0) {
+      Finish(false);
+      return;
+    }
+
+    // Preallocate when we know the size (plus room for a terminating NUL),
+    // otherwise start with a single chunk and grow as data arrives.
+    length_ = loader_->io_->GetLength(stream_);
+    capacity_ = length_ >= 0 ? (int32_t) length_ + 1 : kChunkSize;
+    buf_ = (char*) malloc(capacity_);
+    if (!buf_) {
+      Finish(false);
+      return;
+    }
+    ReadMore();
+  }
+
+  virtual void OnRead(int32_t result) {
+    if (HandleRead(result))
+      ReadMore();
+  }
+
+  bool required() const { return required_; }
+  bool done() const { return done_; }
+  Request* next() const { return next_; }
+
+ private:
+  friend class AssetLoader;
+
+  // Issue reads until one goes asynchronous or the stream completes.
+  void ReadMore() {
+    while (true) {
+      if (length_ >= 0 && size_ == length_) {
+        Finish(true);
+        return;
+      }
+      if (size_ + 1 >= capacity_ && !Grow()) {
+        Finish(false);
+        return;
+      }
+      int32_t result = loader_->io_->Read(stream_, buf_ + size_,
+                                          capacity_ - 1 - size_);
+      if (result == ASSET_IO_PENDING || !HandleRead(result))
+        return;
+    }
+  }
+
+  // Returns true if more data should be read.
+  bool HandleRead(int32_t result) {
+    if (result < 0) {
+      Finish(false);
+      return false;
+    }
+    if (result == 0) {
+      // A stream that ends short of its announced length was cut off.
+      Finish(length_ < 0 || size_ == length_);
+      return false;
+    }
+    size_ += result;
+    return true;
+  }
+
+  bool Grow() {
+    int32_t grow_by = capacity_ > kChunkSize ? capacity_ : kChunkSize;
+    char* buf = (char*) realloc(buf_, capacity_ + grow_by);
+    if (!buf)
+      return false;
+    buf_ = buf;
+    capacity_ += grow_by;
+    return true;
+  }
+
+  void Finish(bool success) {
+    done_ = true;
+    if (stream_) {
+      loader_->io_->Close(stream_);
+      stream_ = NULL;
+    }
+
+    char* data = NULL;
+    if (success) {
+      data = buf_;
+      data[size_] = 0;
+      buf_ = NULL;
+    } else {
+      free(buf_);
+      buf_ = NULL;
+    }
+    callback_(user_data_, url_, data, success ? size_ : 0);
+    loader_->RequestDone(this, success);
+  }
+
+  AssetLoader* loader_;
+  char* url_;
+  AssetCallback callback_;
+  void* user_data_;
+  bool required_;
+  void* stream_;
+  char* buf_;
+  int32_t size_;
+  int32_t capacity_;
+  int64_t length_;
+  bool done_;
+  Request* next_;
+};
+
+
+AssetLoader::AssetLoader(AssetIO* io)
+  : io_(io),
+    requests_(NULL),
+    ready_(NULL),
+    ready_data_(NULL),
+    pending_(0),
+    required_pending_(0),
+    required_ok_(true),
+    started_(false) {
+}
+
+
+AssetLoader::~AssetLoader() {
+  while (requests_) {
+    Request* request = requests_;
+    requests_ = request->next();
+    delete request;
+  }
+}
+
+
+void AssetLoader::Add(const char* url, AssetCallback callback,
+                      void* user_data, bool required) {
+  if (started_)
+    required = false;
+
+  // Keep requests in the order they were added so they are issued in that
+  // order too.
+  Request* request = new Request(this, url, callback, user_data, required);
+  Request** tail = &requests_;
+  while (*tail)
+    tail = &(*tail)->next_;
+  *tail = request;
+  pending_++;
+  if (required)
+    required_pending_++;
+  if (started_)
+    request->Begin();
+}
+
+
+void AssetLoader::Start(AssetsReadyCallback ready, void* user_data) {
+  ready_ = ready;
+  ready_data_ = user_data;
+
+  // All counts are set up by Add, so requests that complete synchronously
+  // cannot make the required set look finished before the rest are issued.
+  for (Request* request = requests_; request; request = request->next()) {
+    if (!request->done())
+      request->Begin();
+  }
+
+  started_ = true;
+  if (required_pending_ == 0 && ready_) {
+    AssetsReadyCallback ready_callback = ready_;
+    ready_ = NULL;
+    ready_callback(ready_data_, required_ok_);
+  }
+}
+
+
+void AssetLoader::RequestDone(Request* request, bool success) {
+  pending_--;
+  if (!request->required())
+    return;
+
+  required_pending_--;
+  if (!success)
+    required_ok_ = false;
+  if (required_pending_ == 0 && started_ && ready_) {
+    AssetsReadyCallback ready_callback = ready_;
+    ready_ = NULL;
+    ready_callback(ready_data_, required_ok_);
+  }
+}
@@ -0,0 +1,107 @@
+#ifndef EXAMPLES_HELLO_WORLD_GLES_ASSET_LOADER_H
+#define EXAMPLES_HELLO_WORLD_GLES_ASSET_LOADER_H
+
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file asset_loader.h
+ * Streaming asset loader.  All requests are issued at once and each asset is
+ * delivered through its own completion callback.  The loader itself knows
+ * nothing about Pepper; it talks to an AssetIO backend so the same code can
+ * run on top of PPB_URLLoader or plain POSIX files.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+
+/// Returned by AssetIO::Open/Read when the result will be delivered later
+/// through the AssetStreamClient.
+#define ASSET_IO_PENDING (-1)
+
+/// Returned by AssetIO::Open/Read (or passed to the client) on failure.
+#define ASSET_IO_FAILED (-2)
+
+class AssetStreamClient {
+ public:
+  virtual ~AssetStreamClient() {}
+
+  /// Open completed.  |result| is 0 on success or ASSET_IO_FAILED.
+  virtual void OnOpened(int32_t result) = 0;
+
+  /// Read completed.  |result| is the number of bytes read, 0 at end of
+  /// stream, or ASSET_IO_FAILED.
+  virtual void OnRead(int32_t result) = 0;
+};
+
+/// Asynchronous I/O backend.  Operations either complete immediately (and
+/// return their result) or return ASSET_IO_PENDING and report the result
+/// later on the same thread through the stream's client.
+class AssetIO {
+ public:
+  virtual ~AssetIO() {}
+
+  /// Begin opening |url|.  |*stream| receives a handle that stays valid
+  /// until Close, even if the open fails.
+  virtual int32_t Open(const char* url, AssetStreamClient* client,
+                       void** stream) = 0;
+
+  /// Total length of an opened stream, or -1 if it is not known up front
+  /// (e.g. chunked HTTP responses).
+  virtual int64_t GetLength(void* stream) = 0;
+
+  virtual int32_t Read(void* stream, char* buffer, int32_t size) = 0;
+
+  virtual void Close(void* stream) = 0;
+};
+
+/// Receives a loaded asset.  On success |data| is a malloc'ed buffer of
+/// |size| bytes plus a terminating NUL, owned by the callee.  On failure
+/// |data| is NULL.
+typedef void (*AssetCallback)(void* user_data, const char* url, char* data,
+                              size_t size);
+
+/// Called once every required asset has completed.  |success| is false if
+/// any of them failed to load.
+typedef void (*AssetsReadyCallback)(void* user_data, bool success);
+
+class AssetLoader {
+ public:
+  explicit AssetLoader(AssetIO* io);
+
+  /// Outstanding requests are closed and their callbacks are not run.
+  ~AssetLoader();
+
+  /// Queue an asset.  Rendering typically waits on |required| assets only,
+  /// while optional ones keep streaming in behind it.  Assets added after
+  /// Start are issued straight away and are always treated as optional.
+  void Add(const char* url, AssetCallback callback, void* user_data,
+           bool required);
+
+  /// Issue every queued request in parallel.  |ready| fires once all required
+  /// assets are in, which may be before Start returns if the backend
+  /// completes synchronously.
+  void Start(AssetsReadyCallback ready, void* user_data);
+
+  /// Number of requests that have not completed yet.
+  int pending() const { return pending_; }
+
+ private:
+  class Request;
+  friend class Request;
+
+  void RequestDone(Request* request, bool success);
+
+  AssetIO* io_;
+  Request* requests_;
+  AssetsReadyCallback ready_;
+  void* ready_data_;
+  int pending_;
+  int required_pending_;
+  bool required_ok_;
+  bool started_;
+};
+
+#endif  // EXAMPLES_HELLO_WORLD_GLES_ASSET_LOADER_H
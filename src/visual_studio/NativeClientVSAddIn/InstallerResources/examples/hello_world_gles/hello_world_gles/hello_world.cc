@@ -39,12 +39,18 @@
 #include "ppapi/c/ppp_messaging.h"
 #include "ppapi/c/ppb_url_loader.h"
 #include "ppapi/c/ppb_url_request_info.h"
+#include "ppapi/c/ppb_url_response_info.h"
 
 #include "ppapi/c/ppp_graphics_3d.h"
 #include "ppapi/lib/gl/gles2/gl2ext_ppapi.h"
 
 #include <GLES2/gl2.h>
+#include "asset_io_ppapi.h"
+#include "asset_loader.h"
 #include "matrix.h"
+#include "shader_cache.h"
+#include "texture_loader.h"
+#include "vertex_format.h"
 
 static PPB_Messaging* ppb_messaging_interface = NULL;
 static PPB_Var* ppb_var_interface = NULL;
@@ -53,24 +59,29 @@ static PPB_Graphics3D* ppb_g3d_interface = NULL;
 static PPB_Instance* ppb_instance_interface = NULL;
 static PPB_URLRequestInfo* ppb_urlrequestinfo_interface = NULL;
 static PPB_URLLoader* ppb_urlloader_interface = NULL;
+static PPB_URLResponseInfo* ppb_urlresponseinfo_interface = NULL;
 
 static PP_Instance g_instance;
 static PP_Resource g_context;
 
-GLuint  g_positionLoc;
-GLuint  g_texCoordLoc;
-GLuint  g_colorLoc;
-GLuint  g_MVPLoc;
-GLuint  g_vboID;
+GLint   g_attribLocs[ATTRIB_COUNT];
+GLint   g_MVPLoc;
 GLuint  g_ibID;
 GLubyte g_Indices[36];
 
-GLuint g_programObj;
-GLuint g_vertexShader;
-GLuint g_fragmentShader;
+ProgramCache* g_programCache = NULL;
+Program* g_program = NULL;
+// Pepper does not expose GL_OES_get_program_binary; embedders that can
+// provide the entry points may set this before the context is created.
+const ProgramBinaryFuncs* g_programBinaryFuncs = NULL;
 
-GLuint g_textureLoc = 0;
+GLint g_textureLoc = 0;
 GLuint g_textureID = 0;
+GLuint g_placeholderTexture = 0;
+// Streams the KTX texture in over several frames; until it is complete the
+// cube is drawn with a 1x1 placeholder.
+TextureUploader* g_TextureUploader = NULL;
+static const size_t kTextureUploadBudget = 32 * 1024;
 
 float g_fSpinX = 0.0f;
 float g_fSpinY = 0.0f;
@@ -78,30 +89,32 @@ float g_fSpinY = 0.0f;
 //-----------------------------------------------------------------------------
 // Rendering Assets
 //-----------------------------------------------------------------------------
-struct Vertex
-{
-  float tu, tv;
-  float color[3];
-  float loc[3];
-};
-
 Vertex *g_quadVertices = NULL;
-const char *g_TextureData = NULL;
-const char *g_VShaderData = NULL;
-const char *g_FShaderData = NULL;
-int g_LoadCnt = 0;
+Mesh g_cubeMesh;
+// Selected with the "vertex_format" embed attribute (float, packed or half).
+VertexFormat g_vertexFormat = VERTEX_FORMAT_PACKED;
+char *g_VShaderData = NULL;
+char *g_FShaderData = NULL;
+
+AssetIO* g_AssetIO = NULL;
+AssetLoader* g_AssetLoader = NULL;
+bool g_AssetsReady = false;
+bool g_Rendering = false;
 
 //-----------------------------------------------------------------------------
 // PROTOTYPES
 //-----------------------------------------------------------------------------
 void PostMessage(const char *fmt, ...);
-char* LoadFile(const char *fileName);
 
 void BuildQuad(Vertex* verts, int axis[3], float depth, float color[3]);
 Vertex* BuildCube(void);
+void ReportVertexBandwidth(const Mesh* mesh);
 
 void InitGL(void);
 void InitProgram(void);
+void StartRendering(void);
+static void TextureLoaded(void* user_data, const char* url, char* data,
+                          size_t size);
 void Render(void);
 
 
@@ -127,18 +140,27 @@ void PostMessage(const char *fmt, ...) {
 }
 
 void MainLoop(void* foo, int bar) {
-  if (g_LoadCnt == 3) {
-    InitProgram();
-    g_LoadCnt++;
-  }
-  if (g_LoadCnt > 3) {
-    Render();
-    PP_CompletionCallback cc = PP_MakeCompletionCallback(MainLoop, 0);
-    ppb_g3d_interface->SwapBuffers(g_context, cc);
-  } else {
-    PP_CompletionCallback cc = PP_MakeCompletionCallback(MainLoop, 0);
-    ppb_core_interface->CallOnMainThread(0, cc, 0);
+  if (g_TextureUploader && !g_TextureUploader->complete() &&
+      g_TextureUploader->Step(kTextureUploadBudget)) {
+    g_textureID = g_TextureUploader->texture();
   }
+  Render();
+  PP_CompletionCallback cc = PP_MakeCompletionCallback(MainLoop, 0);
+  ppb_g3d_interface->SwapBuffers(g_context, cc);
+}
+
+
+/**
+ * Start the render loop once the context exists and the assets are in.
+ * Called from both places that can be last: DidChangeView and AssetsReady.
+ */
+void StartRendering(void) {
+  if (g_Rendering || !g_context || !g_AssetsReady)
+    return;
+  g_Rendering = true;
+  InitProgram();
+  if (g_program)
+    MainLoop(NULL, 0);
 }
 
 void InitGL(void)
@@ -160,23 +182,24 @@ void InitGL(void)
   {
     glSetCurrentContextPPAPI(0);
     printf("Failed to set context.\n");
+    // Without a context nothing may render (StartRendering checks for
+    // one), and the next view change tries again.
+    if (g_context)
+      ppb_core_interface->ReleaseResource(g_context);
+    g_context = 0;
     return;
   }
   glSetCurrentContextPPAPI(g_context);
+  g_programCache = new ProgramCache(PostMessage);
+  g_programCache->SetBinaryFuncs(g_programBinaryFuncs);
 
   glViewport(0,0, 640,480);
   glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
-}
 
-
-GLuint compileShader(GLenum type, const char *data) {
-  const char *shaderStrings[1];
-  shaderStrings[0] = data;
-
-  GLuint shader = glCreateShader(type);
-  glShaderSource(shader, 1, shaderStrings, NULL );
-  glCompileShader(shader);
-  return shader;
+  // The texture is optional for drawing, so it is requested only now that
+  // the context can tell us whether ETC1 is available.
+  g_AssetLoader->Add(Etc1Supported() ? "hello_etc1.ktx" : "hello.ktx",
+                     TextureLoaded, NULL, false);
 }
 
 
@@ -184,18 +207,15 @@ void InitProgram( void )
 {
   glSetCurrentContextPPAPI(g_context);
 
-  g_vertexShader = compileShader(GL_VERTEX_SHADER, g_VShaderData);
-  g_fragmentShader = compileShader(GL_FRAGMENT_SHADER, g_FShaderData);
-
-  g_programObj = glCreateProgram();
-  glAttachShader(g_programObj, g_vertexShader);
-  glAttachShader(g_programObj, g_fragmentShader);
-  glLinkProgram(g_programObj);
+  // Shaders are compiled once per context and failures are reported
+  // (with the driver's info log) via PostMessage.
+  g_program = g_programCache->GetProgram(g_VShaderData, g_FShaderData);
+  g_programCache->ReportStats();
+  if (!g_program)
+    return;
 
-  glGenBuffers(1, &g_vboID);
-  glBindBuffer(GL_ARRAY_BUFFER, g_vboID);
-  glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(Vertex), (void*)&g_quadVertices[0],
-               GL_STATIC_DRAW);
+  g_cubeMesh = CreateMesh(g_vertexFormat, g_quadVertices, 24);
+  ReportVertexBandwidth(&g_cubeMesh);
 
   glGenBuffers(1, &g_ibID);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ibID);
@@ -203,23 +223,44 @@ void InitProgram( void )
                GL_STATIC_DRAW);
 
   //
-  // Create a texture to test out our fragment shader...
+  // Draw with a white placeholder until the real texture has streamed in...
   //
-  glGenTextures(1, &g_textureID);
-  glBindTexture(GL_TEXTURE_2D, g_textureID);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 128, 128, 0, GL_RGB, GL_UNSIGNED_BYTE,
-               g_TextureData);
+  static const GLubyte white[4] = { 255, 255, 255, 255 };
+  glGenTextures(1, &g_placeholderTexture);
+  glBindTexture(GL_TEXTURE_2D, g_placeholderTexture);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               white);
+  if (!g_textureID)
+    g_textureID = g_placeholderTexture;
 
   //
   // Locate some parameters by name so we can set them later...
   //
-  g_textureLoc = glGetUniformLocation(g_programObj, "arrowTexture");
-  g_positionLoc = glGetAttribLocation(g_programObj, "a_position");
-  g_texCoordLoc = glGetAttribLocation(g_programObj, "a_texCoord");
-  g_colorLoc = glGetAttribLocation(g_programObj, "a_color");
-  g_MVPLoc = glGetUniformLocation(g_programObj, "a_MVP");
+  g_textureLoc = ProgramUniform(g_program, "s_texture");
+  g_attribLocs[ATTRIB_POSITION] = ProgramAttrib(g_program, "a_position");
+  g_attribLocs[ATTRIB_TEXCOORD] = ProgramAttrib(g_program, "a_texCoord");
+  g_attribLocs[ATTRIB_COLOR] = ProgramAttrib(g_program, "a_color");
+  g_MVPLoc = ProgramUniform(g_program, "a_MVP");
+}
+
+
+/**
+ * Report the size of the mesh's buffer as the driver measured it at upload,
+ * against what the full precision float layout would have taken.  The
+ * vertex fetch of each frame is an estimate: every vertex is fetched at
+ * least once per draw.
+ */
+void ReportVertexBandwidth(const Mesh* mesh) {
+  int float_size = mesh->num_vertices * (int) sizeof(Vertex);
+  int estimated_fetch = mesh->num_vertices * mesh->layout->stride;
+  PostMessage("vertex format '%s': %d bytes/vertex, uploaded %d bytes "
+              "(float layout would be %d bytes, %d%%), estimated fetch "
+              ">= %d bytes/frame\n",
+              mesh->layout->name, mesh->layout->stride, mesh->upload_bytes,
+              float_size, mesh->upload_bytes * 100 / float_size,
+              estimated_fetch);
 }
 
 
@@ -286,7 +327,7 @@ void Render( void )
   glEnable(GL_DEPTH_TEST);
 
   //set what program to use
-  glUseProgram( g_programObj );
+  glUseProgram( g_program->id );
   glActiveTexture ( GL_TEXTURE0 );
   glBindTexture ( GL_TEXTURE_2D,g_textureID );
   glUniform1i ( g_textureLoc, 0 );
@@ -305,148 +346,59 @@ void Render( void )
   multiply_matrix(mpv, trs, mpv);
   glUniformMatrix4fv(g_MVPLoc, 1, GL_FALSE, (GLfloat*) mpv);
 
-  //define the attributes of the vertex
-  glBindBuffer(GL_ARRAY_BUFFER, g_vboID);
-  glVertexAttribPointer(g_positionLoc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,loc));
-  glEnableVertexAttribArray(g_positionLoc);
-  glVertexAttribPointer(g_texCoordLoc, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,tu));
-  glEnableVertexAttribArray(g_texCoordLoc);
-  glVertexAttribPointer(g_colorLoc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,color));
-  glEnableVertexAttribArray(g_colorLoc);
+  //define the attributes of the vertex from the mesh layout
+  glBindBuffer(GL_ARRAY_BUFFER, g_cubeMesh.vbo);
+  SetupVertexAttribs(g_cubeMesh.layout, g_attribLocs);
 
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ibID);
   glDrawElements ( GL_TRIANGLES, 36, GL_UNSIGNED_BYTE ,0 );
 }
 
 
-typedef void (*OpenCB)(void *dataPtr);
-struct OpenRequest {
-  PP_Resource loader_;
-  PP_Resource request_;
-  char* buf_;
-  void* data_;
-  int64_t size_;
-  int64_t avail_;
-  OpenCB cb_;
-};
-
-
-void FreeRequest(OpenRequest* req) {
-  if (req) {
-    ppb_core_interface->ReleaseResource(req->request_);
-    ppb_core_interface->ReleaseResource(req->loader_);
-    free(req);
-  }
-}
-
-
-static void URLPartialRead(void* user_data, int mode) {
-  OpenRequest* req = (OpenRequest *) user_data;
-  int64_t total;
-  int32_t cnt;
-
-  if (mode < 0) {
-    free(req->buf_);
-    req->cb_(NULL);
-    FreeRequest(req);
-    return;
-  }
-
-  req->avail_ += mode;
-  total = req->size_ - req->avail_;
-
-  cnt = (total > LONG_MAX) ? LONG_MAX : (int32_t) total;
-  // If we still have more to do, re-issue the read.
-  if (cnt > 0) {
-    int32_t bytes = ppb_urlloader_interface->ReadResponseBody(req->loader_,
-        (void *) &req->buf_[req->avail_], cnt,
-        PP_MakeCompletionCallback(URLPartialRead, req));
-
-    // If the reissue completes immediately, then process it.
-    if (bytes != PP_OK_COMPLETIONPENDING) {
-      URLPartialRead(user_data, bytes);
-    }
-    return;
-  }
-
-  // Nothing left, so signal complete.
-  req->cb_(req);
-  FreeRequest(req);
-  printf("Loaded\n");
-}
-
-
-static void URLOpened(void* user_data, int mode) {
-  OpenRequest* req = (OpenRequest *) user_data;
-
-  int64_t cur, total;
-  int32_t cnt;
-  ppb_urlloader_interface->GetDownloadProgress(req->loader_, &cur, &total);
-
-  // If we can't preallocate the buffer because the size is unknown, then
-  // fail the load.
-  if (total == -1) {
-    req->cb_(NULL);
-    FreeRequest(req);
+/**
+ * Completion callback for each asset: keep the buffer in the global that
+ * |user_data| points at.
+ */
+static void AssetLoaded(void* user_data, const char* url, char* data,
+                        size_t size) {
+  if (!data) {
+    PostMessage("Failed to load asset: %s\n", url);
     return;
   }
-
-  // Otherwise allocate a buffer with enough space for a terminating
-  // NUL in case we need one.
-  cnt = (total > LONG_MAX) ? LONG_MAX : (int32_t) total;
-  req->buf_ = (char *) malloc(cnt + 1);
-  req->buf_[cnt] = 0;
-  req->size_ = cnt;
-  int32_t bytes = ppb_urlloader_interface->ReadResponseBody(req->loader_, req->buf_, cnt,
-      PP_MakeCompletionCallback(URLPartialRead, req));
-
-  // Usually we are pending.
-  if (bytes == PP_OK_COMPLETIONPENDING) return;
-
-  // But if we did complete the read, then dispatch the handler.
-  URLPartialRead(req, bytes);
+  *(char**) user_data = data;
 }
 
-void LoadURL(PP_Instance inst, const char *url, OpenCB cb, void *data) {
-  OpenRequest* req = (OpenRequest*) malloc(sizeof(OpenRequest));
-  memset(req, 0, sizeof(OpenRequest));
 
-  req->loader_ = ppb_urlloader_interface->Create(inst);
-  req->request_ = ppb_urlrequestinfo_interface->Create(inst);
-  req->cb_ = cb;
-  req->data_ = data;
-
-  if (!req->loader_ || !req->request_) {
-    cb(NULL);
-    FreeRequest(req);
+/**
+ * Completion callback for the KTX texture: hand it to the uploader, which
+ * takes ownership of the buffer and uploads it from MainLoop.
+ */
+static void TextureLoaded(void* user_data, const char* url, char* data,
+                          size_t size) {
+  if (!data) {
+    PostMessage("Failed to load texture: %s\n", url);
     return;
   }
-
-  ppb_urlrequestinfo_interface->SetProperty(req->request_,
-      PP_URLREQUESTPROPERTY_URL, CStrToVar(url));
-  ppb_urlrequestinfo_interface->SetProperty(req->request_,
-      PP_URLREQUESTPROPERTY_METHOD, CStrToVar("GET"));
-  ppb_urlrequestinfo_interface->SetProperty(req->request_,
-      PP_URLREQUESTPROPERTY_RECORDDOWNLOADPROGRESS, PP_MakeBool(PP_TRUE));
-
-  int val = ppb_urlloader_interface->Open(req->loader_, req->request_,
-      PP_MakeCompletionCallback(URLOpened, req));
-
-  if (val != PP_OK_COMPLETIONPENDING) {
-    cb(NULL);
-    free(req);
+  glSetCurrentContextPPAPI(g_context);
+  const char* error = NULL;
+  g_TextureUploader = new TextureUploader;
+  if (!g_TextureUploader->Begin(data, size, &error)) {
+    PostMessage("Failed to use texture %s: %s\n", url, error);
+    delete g_TextureUploader;
+    g_TextureUploader = NULL;
   }
 }
 
-void Loaded(void* data) {
-  OpenRequest *req = (OpenRequest *) data;
-  if (req && req->buf_) {
-    char **pptr = (char **) req->data_;
-    *pptr = req->buf_;
-    g_LoadCnt++;
+
+/**
+ * Called once all the assets needed to draw are in.  Rendering starts as
+ * soon as both this and the graphics context are ready.
+ */
+static void AssetsReady(void* user_data, bool success) {
+  if (!success)
     return;
-  }
-  PostMessage("Failed to load asset.\n");
+  g_AssetsReady = true;
+  StartRendering();
 }
 
 
@@ -477,10 +429,27 @@ static PP_Bool Instance_DidCreate(PP_Instance instance,
                                   const char* argn[],
                                   const char* argv[]) {
   g_instance = instance;
-  LoadURL(instance, "hello.raw", Loaded, &g_TextureData);
-  LoadURL(instance, "vertex_shader_es2.vert", Loaded, &g_VShaderData);
-  LoadURL(instance, "fragment_shader_es2.frag", Loaded, &g_FShaderData);
+  for (uint32_t i = 0; i < argc; i++) {
+    if (strcmp(argn[i], "vertex_format") == 0 &&
+        !ParseVertexFormat(argv[i], &g_vertexFormat)) {
+      PostMessage("Unknown vertex_format: %s\n", argv[i]);
+    }
+  }
   g_quadVertices = BuildCube();
+
+  // Fetch all assets in parallel; rendering starts from AssetsReady.  The
+  // texture is added from InitGL once the context exists.
+  g_AssetIO = new PepperAssetIO(instance, ppb_core_interface,
+                                ppb_urlloader_interface,
+                                ppb_urlrequestinfo_interface,
+                                ppb_urlresponseinfo_interface,
+                                ppb_var_interface);
+  g_AssetLoader = new AssetLoader(g_AssetIO);
+  g_AssetLoader->Add("vertex_shader_es2.vert", AssetLoaded, &g_VShaderData,
+                     true);
+  g_AssetLoader->Add("fragment_shader_es2.frag", AssetLoaded, &g_FShaderData,
+                     true);
+  g_AssetLoader->Start(AssetsReady, NULL);
   return PP_TRUE;
 }
 
@@ -493,9 +462,17 @@ static PP_Bool Instance_DidCreate(PP_Instance instance,
  *     module.
  */
 static void Instance_DidDestroy(PP_Instance instance) {
-  delete[] g_TextureData;
-  delete[] g_VShaderData;
-  delete[] g_FShaderData;
+  if (g_programCache) {
+    glSetCurrentContextPPAPI(g_context);
+    delete g_TextureUploader;
+    g_TextureUploader = NULL;
+    delete g_programCache;
+    g_programCache = NULL;
+  }
+  delete g_AssetLoader;
+  delete g_AssetIO;
+  free(g_VShaderData);
+  free(g_FShaderData);
   delete[] g_quadVertices;
 }
 
@@ -515,7 +492,7 @@ static void Instance_DidChangeView(PP_Instance instance,
                                    PP_Resource view_resource) {
   if (g_context == 0) {
     InitGL();
-    MainLoop(NULL, 0);
+    StartRendering();
   }
 }
 
@@ -575,6 +552,8 @@ PP_EXPORT int32_t PPP_InitializeModule(PP_Module a_module_id,
       (PPB_URLLoader*)(get_browser(PPB_URLLOADER_INTERFACE));
   ppb_urlrequestinfo_interface =
       (PPB_URLRequestInfo*)(get_browser(PPB_URLREQUESTINFO_INTERFACE));
+  ppb_urlresponseinfo_interface =
+      (PPB_URLResponseInfo*)(get_browser(PPB_URLRESPONSEINFO_INTERFACE));
   ppb_g3d_interface = (PPB_Graphics3D*)get_browser(PPB_GRAPHICS_3D_INTERFACE);
   if (!glInitializePPAPI(get_browser))
     return PP_ERROR_FAILED;
@@ -0,0 +1,219 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file asset_loader_test.cc
+ * Tests for the streaming asset loader, run on top of PosixAssetIO.
+ * Build and run with 'make test' in this directory (no SDK needed).
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "../asset_io_posix.h"
+#include "../asset_loader.h"
+
+static int s_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      s_failures++;                                                   \
+    }                                                                 \
+  } while (0)
+
+/// Announces streams as longer than they are, like a connection that drops
+/// before the whole response has arrived.
+class TruncatingAssetIO : public PosixAssetIO {
+ public:
+  explicit TruncatingAssetIO(const char* root) : PosixAssetIO(root) {}
+
+  virtual int64_t GetLength(void* stream) {
+    return PosixAssetIO::GetLength(stream) + 10;
+  }
+};
+
+struct Result {
+  Result() : calls(0), loaded(false) {}
+
+  int calls;
+  bool loaded;
+  std::string data;
+};
+
+struct Ready {
+  Ready() : calls(0), success(false) {}
+
+  int calls;
+  bool success;
+};
+
+
+static void AssetDone(void* user_data, const char* url, char* data,
+                      size_t size) {
+  Result* result = (Result*) user_data;
+  result->calls++;
+  result->loaded = data != NULL;
+  if (data) {
+    CHECK(data[size] == 0);
+    result->data.assign(data, size);
+    free(data);
+  }
+}
+
+
+static void AssetsReady(void* user_data, bool success) {
+  Ready* ready = (Ready*) user_data;
+  ready->calls++;
+  ready->success = success;
+}
+
+
+static void WriteAsset(const std::string& root, const char* name,
+                       const std::string& content) {
+  std::string path = root + "/" + name;
+  FILE* file = fopen(path.c_str(), "wb");
+  fwrite(content.data(), 1, content.size(), file);
+  fclose(file);
+}
+
+
+/// Load |small.txt| and |large.bin| from |io|, with or without their
+/// lengths.  large.bin is bigger than the loader's read chunk, so that an
+/// unknown length makes it grow its buffer.
+static void TestLoad(const std::string& root, bool hide_length,
+                     const std::string& large) {
+  PosixAssetIO io(root.c_str());
+  io.set_hide_length(hide_length);
+  AssetLoader loader(&io);
+  Result small_result;
+  Result large_result;
+  Ready ready;
+  loader.Add("small.txt", AssetDone, &small_result, true);
+  loader.Add("large.bin", AssetDone, &large_result, true);
+  loader.Start(AssetsReady, &ready);
+
+  CHECK(ready.calls == 1);
+  CHECK(ready.success);
+  CHECK(loader.pending() == 0);
+  CHECK(small_result.calls == 1);
+  CHECK(small_result.loaded);
+  CHECK(small_result.data == "hello");
+  CHECK(large_result.calls == 1);
+  CHECK(large_result.loaded);
+  CHECK(large_result.data == large);
+}
+
+
+static void TestMissingAsset(const std::string& root) {
+  PosixAssetIO io(root.c_str());
+  AssetLoader loader(&io);
+  Result missing_result;
+  Result optional_result;
+  Result small_result;
+  Ready ready;
+  loader.Add("missing.txt", AssetDone, &missing_result, true);
+  loader.Add("missing_too.txt", AssetDone, &optional_result, false);
+  loader.Add("small.txt", AssetDone, &small_result, true);
+  loader.Start(AssetsReady, &ready);
+
+  CHECK(missing_result.calls == 1);
+  CHECK(!missing_result.loaded);
+  CHECK(optional_result.calls == 1);
+  CHECK(!optional_result.loaded);
+  CHECK(small_result.loaded);
+  CHECK(ready.calls == 1);
+  CHECK(!ready.success);
+}
+
+
+static void TestOptionalFailure(const std::string& root) {
+  PosixAssetIO io(root.c_str());
+  AssetLoader loader(&io);
+  Result optional_result;
+  Result small_result;
+  Ready ready;
+  loader.Add("missing.txt", AssetDone, &optional_result, false);
+  loader.Add("small.txt", AssetDone, &small_result, true);
+  loader.Start(AssetsReady, &ready);
+
+  CHECK(!optional_result.loaded);
+  CHECK(ready.calls == 1);
+  CHECK(ready.success);
+}
+
+
+static void TestTruncatedAsset(const std::string& root) {
+  TruncatingAssetIO io(root.c_str());
+  AssetLoader loader(&io);
+  Result result;
+  Ready ready;
+  loader.Add("small.txt", AssetDone, &result, true);
+  loader.Start(AssetsReady, &ready);
+
+  CHECK(result.calls == 1);
+  CHECK(!result.loaded);
+  CHECK(ready.calls == 1);
+  CHECK(!ready.success);
+}
+
+
+static void TestAddAfterStart(const std::string& root) {
+  PosixAssetIO io(root.c_str());
+  AssetLoader loader(&io);
+  Ready ready;
+  loader.Start(AssetsReady, &ready);
+  CHECK(ready.calls == 1);
+  CHECK(ready.success);
+
+  // Late assets are optional, so a failure does not reach |ready|.
+  Result missing_result;
+  Result small_result;
+  loader.Add("missing.txt", AssetDone, &missing_result, true);
+  loader.Add("small.txt", AssetDone, &small_result, true);
+  CHECK(!missing_result.loaded);
+  CHECK(small_result.data == "hello");
+  CHECK(ready.calls == 1);
+  CHECK(loader.pending() == 0);
+}
+
+
+int main(int argc, char* argv[]) {
+  char root[] = "/tmp/asset_loader_test.XXXXXX";
+  if (!mkdtemp(root)) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  std::string large;
+  for (int i = 0; i < 200 * 1024; i++)
+    large += (char) (i * 7);
+  WriteAsset(root, "small.txt", "hello");
+  WriteAsset(root, "large.bin", large);
+
+  TestLoad(root, false, large);
+  TestLoad(root, true, large);
+  TestMissingAsset(root);
+  TestOptionalFailure(root);
+  TestTruncatedAsset(root);
+  TestAddAfterStart(root);
+
+  unlink((std::string(root) + "/small.txt").c_str());
+  unlink((std::string(root) + "/large.bin").c_str());
+  rmdir(root);
+
+  if (s_failures) {
+    fprintf(stderr, "%d check(s) failed\n", s_failures);
+    return 1;
+  }
+  printf("asset_loader_test: all tests passed\n");
+  return 0;
+}
@@ -0,0 +1,111 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file gl_counters.cc
+ * ld --wrap shims counting the GL calls made by the example.  Add a line to
+ * GL_COUNTED_FUNCTIONS to count another entry point.
+ */
+
+//-----------------------------------------------------------------------------
+#include <GLES2/gl2.h>
+
+#include "gl_counters.h"
+
+// X(return type, name, parameters, arguments).  Start each entry on its own
+// line: the Makefile greps for "X(type, name," to build the --wrap flags.
+#define GL_COUNTED_FUNCTIONS(X) \
+  X(void, glActiveTexture, (GLenum texture), (texture)) \
+  X(void, glAttachShader, (GLuint program, GLuint shader), (program, shader)) \
+  X(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+  X(void, glBindTexture, (GLenum target, GLuint texture), (target, texture)) \
+  X(void, glBufferData, (GLenum target, GLsizeiptr size, const void* data, \
+    GLenum usage), (target, size, data, usage)) \
+  X(void, glClear, (GLbitfield mask), (mask)) \
+  X(void, glClearColor, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), \
+    (r, g, b, a)) \
+  X(void, glClearDepthf, (GLfloat depth), (depth)) \
+  X(void, glCompileShader, (GLuint shader), (shader)) \
+  X(void, glCompressedTexImage2D, (GLenum target, GLint level, \
+    GLenum internalformat, GLsizei width, GLsizei height, GLint border, \
+    GLsizei size, const void* data), (target, level, internalformat, width, \
+    height, border, size, data)) \
+  X(GLuint, glCreateProgram, (void), ()) \
+  X(GLuint, glCreateShader, (GLenum type), (type)) \
+  X(void, glDisableVertexAttribArray, (GLuint index), (index)) \
+  X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), \
+    (mode, first, count)) \
+  X(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, \
+    const void* indices), (mode, count, type, indices)) \
+  X(void, glEnable, (GLenum cap), (cap)) \
+  X(void, glEnableVertexAttribArray, (GLuint index), (index)) \
+  X(void, glGenerateMipmap, (GLenum target), (target)) \
+  X(GLint, glGetAttribLocation, (GLuint program, const GLchar* name), \
+    (program, name)) \
+  X(void, glGetProgramiv, (GLuint program, GLenum pname, GLint* params), \
+    (program, pname, params)) \
+  X(void, glGetShaderiv, (GLuint shader, GLenum pname, GLint* params), \
+    (shader, pname, params)) \
+  X(GLint, glGetUniformLocation, (GLuint program, const GLchar* name), \
+    (program, name)) \
+  X(void, glLinkProgram, (GLuint program), (program)) \
+  X(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, \
+    GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, \
+    const void* pixels), (target, level, internalformat, width, height, \
+    border, format, type, pixels)) \
+  X(void, glTexParameteri, (GLenum target, GLenum pname, GLint param), \
+    (target, pname, param)) \
+  X(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, \
+    GLint yoffset, GLsizei width, GLsizei height, GLenum format, \
+    GLenum type, const void* pixels), (target, level, xoffset, yoffset, \
+    width, height, format, type, pixels)) \
+  X(void, glUniform1i, (GLint location, GLint v0), (location, v0)) \
+  X(void, glUniformMatrix4fv, (GLint location, GLsizei count, \
+    GLboolean transpose, const GLfloat* value), \
+    (location, count, transpose, value)) \
+  X(void, glUseProgram, (GLuint program), (program)) \
+  X(void, glVertexAttribPointer, (GLuint index, GLint size, GLenum type, \
+    GLboolean normalized, GLsizei stride, const void* pointer), \
+    (index, size, type, normalized, stride, pointer)) \
+  X(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), \
+    (x, y, width, height))
+
+enum {
+#define GL_COUNTER_ENUM(ret, name, params, args) GL_COUNTER_##name,
+  GL_COUNTED_FUNCTIONS(GL_COUNTER_ENUM)
+#undef GL_COUNTER_ENUM
+  GL_COUNTER_COUNT
+};
+
+static unsigned long s_counts[GL_COUNTER_COUNT];
+
+static const char* const s_names[GL_COUNTER_COUNT] = {
+#define GL_COUNTER_NAME(ret, name, params, args) #name,
+  GL_COUNTED_FUNCTIONS(GL_COUNTER_NAME)
+#undef GL_COUNTER_NAME
+};
+
+#define GL_COUNTER_WRAP(ret, name, params, args) \
+  extern "C" ret __real_##name params; \
+  extern "C" ret __wrap_##name params { \
+    s_counts[GL_COUNTER_##name]++; \
+    return __real_##name args; \
+  }
+GL_COUNTED_FUNCTIONS(GL_COUNTER_WRAP)
+#undef GL_COUNTER_WRAP
+
+
+int GLCounterCount(void) {
+  return GL_COUNTER_COUNT;
+}
+
+
+const char* GLCounterName(int index) {
+  return s_names[index];
+}
+
+
+unsigned long GLCounterValue(int index) {
+  return s_counts[index];
+}
@@ -0,0 +1,24 @@
+#ifndef EXAMPLES_HELLO_WORLD_GLES_HOST_GL_COUNTERS_H
+#define EXAMPLES_HELLO_WORLD_GLES_HOST_GL_COUNTERS_H
+
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file gl_counters.h
+ * Per-function GL call counters.  The counted functions are wrapped at link
+ * time (ld --wrap), so the module code is unchanged; the Makefile extracts
+ * the list of --wrap flags from gl_counters.cc.
+ */
+
+//-----------------------------------------------------------------------------
+
+/// Number of counted GL entry points.
+int GLCounterCount(void);
+const char* GLCounterName(int index);
+
+/// Calls made to entry point |index| since startup.
+unsigned long GLCounterValue(int index);
+
+#endif  // EXAMPLES_HELLO_WORLD_GLES_HOST_GL_COUNTERS_H
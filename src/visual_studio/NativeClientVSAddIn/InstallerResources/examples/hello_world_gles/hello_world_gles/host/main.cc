@@ -0,0 +1,169 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file main.cc
+ * Runs the hello_world_gles module as a Linux program for a fixed number of
+ * frames and reports frame times and GL call counts.
+ *
+ *   hello_world_gles_host [--frames=N] [--root=DIR] [--program-binaries]
+ *                         [name=value ...]
+ *
+ * name=value pairs are passed to the module as <embed> attributes, e.g.
+ * vertex_format=half.  Assets are read from DIR (default ".").
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <EGL/egl.h>
+
+#include "ppapi/c/pp_errors.h"
+#include "ppapi/c/ppp.h"
+#include "ppapi/c/ppp_instance.h"
+
+#include "../shader_cache.h"
+#include "gl_counters.h"
+#include "ppapi_host.h"
+
+// Defined by hello_world.cc.
+extern const ProgramBinaryFuncs* g_programBinaryFuncs;
+
+static std::vector<double> s_frameEnds;
+static std::vector<unsigned long> s_firstFrameCounts;
+
+
+static void FrameDone(int frame, double seconds) {
+  s_frameEnds.push_back(seconds);
+  // Everything up to and including the first frame is start-up cost
+  // (compiles, uploads); later frames are the steady state.
+  if (frame == 1) {
+    for (int i = 0; i < GLCounterCount(); i++)
+      s_firstFrameCounts.push_back(GLCounterValue(i));
+  }
+}
+
+
+static void ReportFrameTimes(void) {
+  int frames = (int) s_frameEnds.size();
+  printf("\n%d frames in %.3f s\n", frames,
+         frames ? s_frameEnds[frames - 1] : 0.0);
+  if (frames < 2)
+    return;
+
+  std::vector<double> times;
+  for (int i = 1; i < frames; i++)
+    times.push_back((s_frameEnds[i] - s_frameEnds[i - 1]) * 1000.0);
+  std::sort(times.begin(), times.end());
+  double total = 0;
+  for (size_t i = 0; i < times.size(); i++)
+    total += times[i];
+  printf("first frame  %8.3f ms (from start of message loop)\n",
+         s_frameEnds[0] * 1000.0);
+  printf("frame time   mean %.3f  min %.3f  median %.3f  p95 %.3f  "
+         "max %.3f ms\n", total / times.size(), times[0],
+         times[times.size() / 2], times[times.size() * 95 / 100],
+         times[times.size() - 1]);
+}
+
+
+static void ReportGLCalls(void) {
+  int frames = (int) s_frameEnds.size();
+  if (s_firstFrameCounts.empty())
+    return;
+  printf("\n%-28s %10s %12s\n", "GL function", "start-up", "per frame");
+  unsigned long startup_total = 0;
+  double frame_total = 0;
+  for (int i = 0; i < GLCounterCount(); i++) {
+    unsigned long startup = s_firstFrameCounts[i];
+    unsigned long later = GLCounterValue(i) - startup;
+    double per_frame = frames > 1 ? (double) later / (frames - 1) : 0.0;
+    startup_total += startup;
+    frame_total += per_frame;
+    if (startup || later)
+      printf("%-28s %10lu %12.2f\n", GLCounterName(i), startup, per_frame);
+  }
+  printf("%-28s %10lu %12.2f\n", "total", startup_total, frame_total);
+}
+
+
+static void SetupProgramBinaries(void) {
+  static ProgramBinaryFuncs funcs;
+  funcs.GetProgramBinary =
+      (void (*)(GLuint, GLsizei, GLsizei*, GLenum*, void*))
+          eglGetProcAddress("glGetProgramBinaryOES");
+  funcs.ProgramBinary =
+      (void (*)(GLuint, GLenum, const void*, GLint))
+          eglGetProcAddress("glProgramBinaryOES");
+  g_programBinaryFuncs = &funcs;
+}
+
+
+int main(int argc, char* argv[]) {
+  int frames = 300;
+  const char* root = ".";
+  std::vector<const char*> argn;
+  std::vector<const char*> argv_values;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--frames=", 9) == 0) {
+      frames = atoi(arg + 9);
+    } else if (strncmp(arg, "--root=", 7) == 0) {
+      root = arg + 7;
+    } else if (strcmp(arg, "--program-binaries") == 0) {
+      SetupProgramBinaries();
+    } else if (strchr(arg, '=') && arg[0] != '-') {
+      // argv strings are writable and live for the whole run.
+      char* eq = strchr(argv[i], '=');
+      *eq = 0;
+      argn.push_back(argv[i]);
+      argv_values.push_back(eq + 1);
+    } else {
+      fprintf(stderr, "usage: %s [--frames=N] [--root=DIR] "
+              "[--program-binaries] [name=value ...]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (frames < 1) {
+    fprintf(stderr, "--frames must be at least 1\n");
+    return 1;
+  }
+
+  if (!HostInitialize(root))
+    return 1;
+  if (PPP_InitializeModule(1, HostGetInterface) != PP_OK) {
+    fprintf(stderr, "PPP_InitializeModule failed\n");
+    return 1;
+  }
+  const PPP_Instance* instance_interface =
+      (const PPP_Instance*) PPP_GetInterface(PPP_INSTANCE_INTERFACE);
+  if (!instance_interface) {
+    fprintf(stderr, "module does not implement %s\n", PPP_INSTANCE_INTERFACE);
+    return 1;
+  }
+
+  const PP_Instance instance = 1;
+  argn.push_back(NULL);
+  argv_values.push_back(NULL);
+  HostSetFrameLimit(frames, FrameDone);
+  if (instance_interface->DidCreate(instance, argn.size() - 1, &argn[0],
+                                    &argv_values[0])) {
+    // No view resource: the example does not look at it.
+    instance_interface->DidChangeView(instance, 0);
+    HostRunMessageLoop();
+  }
+  instance_interface->DidDestroy(instance);
+  PPP_ShutdownModule();
+
+  ReportFrameTimes();
+  ReportGLCalls();
+  HostShutdown();
+  return (int) s_frameEnds.size() == frames ? 0 : 1;
+}
@@ -0,0 +1,769 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file ppapi_host.cc
+ * PPB interface stand-ins on top of EGL and POSIX file I/O.  Only the parts
+ * of each interface the example uses do real work; the rest fail cleanly.
+ */
+
+//-----------------------------------------------------------------------------
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include "ppapi/c/pp_completion_callback.h"
+#include "ppapi/c/pp_errors.h"
+#include "ppapi/c/pp_graphics_3d.h"
+#include "ppapi/c/pp_var.h"
+#include "ppapi/c/ppb_core.h"
+#include "ppapi/c/ppb_graphics_3d.h"
+#include "ppapi/c/ppb_instance.h"
+#include "ppapi/c/ppb_messaging.h"
+#include "ppapi/c/ppb_url_loader.h"
+#include "ppapi/c/ppb_url_request_info.h"
+#include "ppapi/c/ppb_url_response_info.h"
+#include "ppapi/c/ppb_var.h"
+#include "ppapi/lib/gl/gles2/gl2ext_ppapi.h"
+
+#include "ppapi_host.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+//-----------------------------------------------------------------------------
+// Resources
+//-----------------------------------------------------------------------------
+
+class Resource {
+ public:
+  Resource() : refs_(1) {}
+  virtual ~Resource() {}
+  int refs_;
+};
+
+class URLRequest : public Resource {
+ public:
+  URLRequest() : record_progress_(false) {}
+  std::string url_;
+  bool record_progress_;
+};
+
+class URLResponse : public Resource {
+ public:
+  std::string url_;
+  int32_t status_;
+};
+
+class URLLoader : public Resource {
+ public:
+  URLLoader()
+    : fd_(-1), length_(-1), received_(0), record_progress_(false),
+      response_(0) {}
+  virtual ~URLLoader();
+  int fd_;
+  int64_t length_;
+  int64_t received_;
+  bool record_progress_;
+  PP_Resource response_;
+};
+
+class Graphics3D : public Resource {
+ public:
+  Graphics3D() : surface_(EGL_NO_SURFACE), context_(EGL_NO_CONTEXT) {}
+  virtual ~Graphics3D();
+  EGLSurface surface_;
+  EGLContext context_;
+};
+
+static std::map<PP_Resource, Resource*> s_resources;
+static PP_Resource s_nextResource = 1;
+
+static EGLDisplay s_display = EGL_NO_DISPLAY;
+static std::string s_assetRoot;
+
+static int s_frameLimit = 0;
+static int s_frames = 0;
+static double s_loopStart = 0;
+static HostFrameCallback s_frameCallback = NULL;
+static bool s_quit = false;
+
+
+static PP_Resource AddResource(Resource* resource) {
+  PP_Resource id = s_nextResource++;
+  s_resources[id] = resource;
+  return id;
+}
+
+
+template <class T>
+static T* GetResource(PP_Resource id) {
+  std::map<PP_Resource, Resource*>::iterator it = s_resources.find(id);
+  return it == s_resources.end() ? NULL : dynamic_cast<T*>(it->second);
+}
+
+
+static void Core_AddRefResource(PP_Resource id) {
+  Resource* resource = GetResource<Resource>(id);
+  if (resource)
+    resource->refs_++;
+}
+
+
+static void Core_ReleaseResource(PP_Resource id) {
+  Resource* resource = GetResource<Resource>(id);
+  if (resource && --resource->refs_ == 0) {
+    s_resources.erase(id);
+    delete resource;
+  }
+}
+
+
+URLLoader::~URLLoader() {
+  if (fd_ >= 0)
+    close(fd_);
+  Core_ReleaseResource(response_);
+}
+
+
+Graphics3D::~Graphics3D() {
+  if (eglGetCurrentContext() == context_)
+    eglMakeCurrent(s_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (context_ != EGL_NO_CONTEXT)
+    eglDestroyContext(s_display, context_);
+  if (surface_ != EGL_NO_SURFACE)
+    eglDestroySurface(s_display, surface_);
+}
+
+//-----------------------------------------------------------------------------
+// PPB_Core and the message loop
+//-----------------------------------------------------------------------------
+
+struct Task {
+  struct PP_CompletionCallback callback;
+  int32_t result;
+};
+
+// Keyed by due time; equal keys keep insertion order, so callbacks posted
+// with no delay run first-in first-out like on the real main thread.
+static std::multimap<double, Task> s_tasks;
+
+
+static PP_TimeTicks Core_GetTimeTicks(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static PP_Time Core_GetTime(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void Core_CallOnMainThread(int32_t delay_in_milliseconds,
+                                  struct PP_CompletionCallback callback,
+                                  int32_t result) {
+  Task task = { callback, result };
+  double due = Core_GetTimeTicks() + delay_in_milliseconds / 1000.0;
+  s_tasks.insert(std::make_pair(due, task));
+}
+
+
+static PP_Bool Core_IsMainThread(void) {
+  return PP_TRUE;
+}
+
+
+// Complete an operation asynchronously, as the browser would.  Blocking
+// callbacks are not supported off a background thread, so report that.
+static int32_t CompleteLater(struct PP_CompletionCallback callback,
+                             int32_t result) {
+  if (!callback.func)
+    return PP_ERROR_BLOCKS_MAIN_THREAD;
+  Core_CallOnMainThread(0, callback, result);
+  return PP_OK_COMPLETIONPENDING;
+}
+
+
+void HostRunMessageLoop(void) {
+  s_loopStart = Core_GetTimeTicks();
+  while (!s_quit && !s_tasks.empty()) {
+    std::multimap<double, Task>::iterator it = s_tasks.begin();
+    double wait = it->first - Core_GetTimeTicks();
+    if (wait > 0)
+      usleep((useconds_t) (wait * 1e6));
+    Task task = it->second;
+    s_tasks.erase(it);
+    PP_RunCompletionCallback(&task.callback, task.result);
+  }
+}
+
+
+void HostSetFrameLimit(int frames, HostFrameCallback callback) {
+  s_frameLimit = frames;
+  s_frameCallback = callback;
+}
+
+//-----------------------------------------------------------------------------
+// PPB_Var and PPB_Messaging
+//-----------------------------------------------------------------------------
+
+struct StringVar {
+  std::string value;
+  int refs;
+};
+
+static std::map<int64_t, StringVar> s_strings;
+static int64_t s_nextString = 1;
+
+
+static void Var_AddRef(struct PP_Var var) {
+  if (var.type == PP_VARTYPE_STRING)
+    s_strings[var.value.as_id].refs++;
+}
+
+
+static void Var_Release(struct PP_Var var) {
+  if (var.type != PP_VARTYPE_STRING)
+    return;
+  std::map<int64_t, StringVar>::iterator it = s_strings.find(var.value.as_id);
+  if (it != s_strings.end() && --it->second.refs == 0)
+    s_strings.erase(it);
+}
+
+
+static struct PP_Var Var_VarFromUtf8(const char* data, uint32_t len) {
+  struct PP_Var var = PP_MakeUndefined();
+  var.type = PP_VARTYPE_STRING;
+  var.value.as_id = s_nextString++;
+  StringVar& str = s_strings[var.value.as_id];
+  str.value.assign(data, len);
+  str.refs = 1;
+  return var;
+}
+
+
+static const char* Var_VarToUtf8(struct PP_Var var, uint32_t* len) {
+  std::map<int64_t, StringVar>::iterator it = s_strings.end();
+  if (var.type == PP_VARTYPE_STRING)
+    it = s_strings.find(var.value.as_id);
+  if (it == s_strings.end()) {
+    *len = 0;
+    return NULL;
+  }
+  *len = it->second.value.size();
+  return it->second.value.data();
+}
+
+
+static void Messaging_PostMessage(PP_Instance instance, struct PP_Var message) {
+  uint32_t len = 0;
+  const char* str = Var_VarToUtf8(message, &len);
+  if (str)
+    printf("%.*s", (int) len, str);
+}
+
+//-----------------------------------------------------------------------------
+// PPB_URLRequestInfo, PPB_URLLoader and PPB_URLResponseInfo
+//-----------------------------------------------------------------------------
+
+static PP_Resource RequestInfo_Create(PP_Instance instance) {
+  return AddResource(new URLRequest);
+}
+
+
+static PP_Bool RequestInfo_IsURLRequestInfo(PP_Resource resource) {
+  return GetResource<URLRequest>(resource) ? PP_TRUE : PP_FALSE;
+}
+
+
+static PP_Bool RequestInfo_SetProperty(PP_Resource resource,
+                                       PP_URLRequestProperty property,
+                                       struct PP_Var value) {
+  URLRequest* request = GetResource<URLRequest>(resource);
+  if (!request)
+    return PP_FALSE;
+  uint32_t len = 0;
+  const char* str;
+  switch (property) {
+    case PP_URLREQUESTPROPERTY_URL:
+      str = Var_VarToUtf8(value, &len);
+      if (!str)
+        return PP_FALSE;
+      request->url_.assign(str, len);
+      return PP_TRUE;
+    case PP_URLREQUESTPROPERTY_METHOD:
+      // Only GET makes sense for local files.
+      str = Var_VarToUtf8(value, &len);
+      return str && std::string(str, len) == "GET" ? PP_TRUE : PP_FALSE;
+    case PP_URLREQUESTPROPERTY_RECORDDOWNLOADPROGRESS:
+      request->record_progress_ = value.type == PP_VARTYPE_BOOL &&
+                                  value.value.as_bool;
+      return PP_TRUE;
+    default:
+      return PP_FALSE;
+  }
+}
+
+
+static PP_Bool RequestInfo_AppendDataToBody(PP_Resource request,
+                                            const void* data, uint32_t len) {
+  return PP_FALSE;
+}
+
+
+static PP_Bool RequestInfo_AppendFileToBody(PP_Resource request,
+                                            PP_Resource file_ref,
+                                            int64_t start_offset,
+                                            int64_t number_of_bytes,
+                                            PP_Time expected_last_modified) {
+  return PP_FALSE;
+}
+
+
+static PP_Resource URLLoader_Create(PP_Instance instance) {
+  return AddResource(new URLLoader);
+}
+
+
+static PP_Bool URLLoader_IsURLLoader(PP_Resource resource) {
+  return GetResource<URLLoader>(resource) ? PP_TRUE : PP_FALSE;
+}
+
+
+static int32_t URLLoader_Open(PP_Resource loader_id, PP_Resource request_id,
+                              struct PP_CompletionCallback callback) {
+  URLLoader* loader = GetResource<URLLoader>(loader_id);
+  URLRequest* request = GetResource<URLRequest>(request_id);
+  if (!loader || !request)
+    return PP_ERROR_BADRESOURCE;
+  if (loader->response_)
+    return PP_ERROR_INPROGRESS;
+
+  // Like HTTP, a missing file still opens; the failure is in the status.
+  std::string path = s_assetRoot + "/" + request->url_;
+  loader->fd_ = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (loader->fd_ >= 0 && fstat(loader->fd_, &st) == 0)
+    loader->length_ = st.st_size;
+  loader->record_progress_ = request->record_progress_;
+
+  URLResponse* response = new URLResponse;
+  response->url_ = request->url_;
+  response->status_ = loader->fd_ >= 0 ? 200 : 404;
+  loader->response_ = AddResource(response);
+  return CompleteLater(callback, PP_OK);
+}
+
+
+static int32_t URLLoader_FollowRedirect(PP_Resource loader,
+                                        struct PP_CompletionCallback callback) {
+  return PP_ERROR_NOTSUPPORTED;
+}
+
+
+static PP_Bool URLLoader_GetUploadProgress(PP_Resource loader,
+                                           int64_t* bytes_sent,
+                                           int64_t* total_bytes_to_be_sent) {
+  *bytes_sent = 0;
+  *total_bytes_to_be_sent = 0;
+  return PP_FALSE;
+}
+
+
+static PP_Bool URLLoader_GetDownloadProgress(
+    PP_Resource loader_id,
+    int64_t* bytes_received,
+    int64_t* total_bytes_to_be_received) {
+  URLLoader* loader = GetResource<URLLoader>(loader_id);
+  if (!loader || !loader->record_progress_) {
+    *bytes_received = 0;
+    *total_bytes_to_be_received = -1;
+    return PP_FALSE;
+  }
+  *bytes_received = loader->received_;
+  *total_bytes_to_be_received = loader->length_;
+  return PP_TRUE;
+}
+
+
+static PP_Resource URLLoader_GetResponseInfo(PP_Resource loader_id) {
+  URLLoader* loader = GetResource<URLLoader>(loader_id);
+  if (!loader || !loader->response_)
+    return 0;
+  Core_AddRefResource(loader->response_);
+  return loader->response_;
+}
+
+
+static int32_t URLLoader_ReadResponseBody(
+    PP_Resource loader_id,
+    void* buffer,
+    int32_t bytes_to_read,
+    struct PP_CompletionCallback callback) {
+  URLLoader* loader = GetResource<URLLoader>(loader_id);
+  if (!loader)
+    return PP_ERROR_BADRESOURCE;
+  if (loader->fd_ < 0)
+    return CompleteLater(callback, PP_ERROR_FAILED);
+
+  // The data lands in the buffer now; only the notification is deferred.
+  ssize_t result = read(loader->fd_, buffer, bytes_to_read);
+  if (result < 0)
+    return CompleteLater(callback, PP_ERROR_FAILED);
+  loader->received_ += result;
+  return CompleteLater(callback, (int32_t) result);
+}
+
+
+static int32_t URLLoader_FinishStreamingToFile(
+    PP_Resource loader,
+    struct PP_CompletionCallback callback) {
+  return PP_ERROR_NOTSUPPORTED;
+}
+
+
+static void URLLoader_Close(PP_Resource loader_id) {
+  URLLoader* loader = GetResource<URLLoader>(loader_id);
+  if (loader && loader->fd_ >= 0) {
+    close(loader->fd_);
+    loader->fd_ = -1;
+  }
+}
+
+
+static PP_Bool ResponseInfo_IsURLResponseInfo(PP_Resource resource) {
+  return GetResource<URLResponse>(resource) ? PP_TRUE : PP_FALSE;
+}
+
+
+static struct PP_Var ResponseInfo_GetProperty(
+    PP_Resource resource,
+    PP_URLResponseProperty property) {
+  URLResponse* response = GetResource<URLResponse>(resource);
+  if (!response)
+    return PP_MakeUndefined();
+  switch (property) {
+    case PP_URLRESPONSEPROPERTY_URL:
+      return Var_VarFromUtf8(response->url_.data(), response->url_.size());
+    case PP_URLRESPONSEPROPERTY_STATUSCODE:
+      return PP_MakeInt32(response->status_);
+    default:
+      return PP_MakeUndefined();
+  }
+}
+
+
+static PP_Resource ResponseInfo_GetBodyAsFileRef(PP_Resource response) {
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+// PPB_Graphics3D and PPB_Instance
+//-----------------------------------------------------------------------------
+
+static int32_t Graphics3D_GetAttribMaxValue(PP_Resource instance,
+                                            int32_t attribute,
+                                            int32_t* value) {
+  return PP_ERROR_NOTSUPPORTED;
+}
+
+
+static PP_Resource Graphics3D_Create(PP_Instance instance,
+                                     PP_Resource share_context,
+                                     const int32_t attrib_list[]) {
+  EGLint config_attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 0,
+    EGL_DEPTH_SIZE, 0,
+    EGL_STENCIL_SIZE, 0,
+    EGL_SAMPLES, 0,
+    EGL_SAMPLE_BUFFERS, 0,
+    EGL_NONE
+  };
+  EGLint surface_attribs[] = {
+    EGL_WIDTH, 0,
+    EGL_HEIGHT, 0,
+    EGL_NONE
+  };
+
+  // The PP_GRAPHICS3DATTRIB_* values match their EGL counterparts.
+  for (const int32_t* attrib = attrib_list;
+       attrib && *attrib != PP_GRAPHICS3DATTRIB_NONE; attrib += 2) {
+    EGLint* list = config_attribs;
+    if (attrib[0] == PP_GRAPHICS3DATTRIB_WIDTH ||
+        attrib[0] == PP_GRAPHICS3DATTRIB_HEIGHT) {
+      list = surface_attribs;
+    }
+    for (; *list != EGL_NONE; list += 2) {
+      if (list[0] == attrib[0])
+        list[1] = attrib[1];
+    }
+  }
+
+  EGLConfig config;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(s_display, config_attribs, &config, 1, &num_configs) ||
+      num_configs == 0) {
+    fprintf(stderr, "eglChooseConfig found no matching config\n");
+    return 0;
+  }
+
+  EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+  Graphics3D* share = GetResource<Graphics3D>(share_context);
+  Graphics3D* graphics = new Graphics3D;
+  graphics->surface_ = eglCreatePbufferSurface(s_display, config,
+                                               surface_attribs);
+  graphics->context_ = eglCreateContext(
+      s_display, config, share ? share->context_ : EGL_NO_CONTEXT,
+      context_attribs);
+  if (graphics->surface_ == EGL_NO_SURFACE ||
+      graphics->context_ == EGL_NO_CONTEXT) {
+    fprintf(stderr, "failed to create EGL pbuffer context: 0x%x\n",
+            eglGetError());
+    delete graphics;
+    return 0;
+  }
+  return AddResource(graphics);
+}
+
+
+static PP_Bool Graphics3D_IsGraphics3D(PP_Resource resource) {
+  return GetResource<Graphics3D>(resource) ? PP_TRUE : PP_FALSE;
+}
+
+
+static int32_t Graphics3D_GetAttribs(PP_Resource context,
+                                     int32_t attrib_list[]) {
+  return PP_ERROR_NOTSUPPORTED;
+}
+
+
+static int32_t Graphics3D_SetAttribs(PP_Resource context,
+                                     const int32_t attrib_list[]) {
+  return PP_ERROR_NOTSUPPORTED;
+}
+
+
+static int32_t Graphics3D_GetError(PP_Resource context) {
+  return PP_OK;
+}
+
+
+static int32_t Graphics3D_ResizeBuffers(PP_Resource context, int32_t width,
+                                        int32_t height) {
+  return PP_ERROR_NOTSUPPORTED;
+}
+
+
+static int32_t Graphics3D_SwapBuffers(PP_Resource context,
+                                      struct PP_CompletionCallback callback) {
+  Graphics3D* graphics = GetResource<Graphics3D>(context);
+  if (!graphics)
+    return PP_ERROR_BADRESOURCE;
+
+  // Wait for the GPU so frame times cover the whole frame, not just the
+  // time taken to queue commands.
+  glFinish();
+  eglSwapBuffers(s_display, graphics->surface_);
+  s_frames++;
+  if (s_frameCallback)
+    s_frameCallback(s_frames, Core_GetTimeTicks() - s_loopStart);
+  if (s_frameLimit && s_frames >= s_frameLimit) {
+    // Never run the callback; the message loop stops here.
+    s_quit = true;
+    return PP_OK_COMPLETIONPENDING;
+  }
+  return CompleteLater(callback, PP_OK);
+}
+
+
+static PP_Bool Instance_BindGraphics(PP_Instance instance,
+                                     PP_Resource device) {
+  return GetResource<Graphics3D>(device) ? PP_TRUE : PP_FALSE;
+}
+
+
+static PP_Bool Instance_IsFullFrame(PP_Instance instance) {
+  return PP_FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// Interface lookup and ppapi_gles2 replacements
+//-----------------------------------------------------------------------------
+
+const void* HostGetInterface(const char* interface_name) {
+  // Members are assigned by name so the tables stay correct whichever
+  // revision of each interface the SDK headers describe.
+  static PPB_Core core;
+  static PPB_Instance instance;
+  static PPB_Messaging messaging;
+  static PPB_Var var;
+  static PPB_URLRequestInfo request_info;
+  static PPB_URLLoader url_loader;
+  static PPB_URLResponseInfo response_info;
+  static PPB_Graphics3D graphics_3d;
+  static bool initialized = false;
+  if (!initialized) {
+    initialized = true;
+    core.AddRefResource = Core_AddRefResource;
+    core.ReleaseResource = Core_ReleaseResource;
+    core.GetTime = Core_GetTime;
+    core.GetTimeTicks = Core_GetTimeTicks;
+    core.CallOnMainThread = Core_CallOnMainThread;
+    core.IsMainThread = Core_IsMainThread;
+
+    instance.BindGraphics = Instance_BindGraphics;
+    instance.IsFullFrame = Instance_IsFullFrame;
+
+    messaging.PostMessage = Messaging_PostMessage;
+
+    var.AddRef = Var_AddRef;
+    var.Release = Var_Release;
+    var.VarFromUtf8 = Var_VarFromUtf8;
+    var.VarToUtf8 = Var_VarToUtf8;
+
+    request_info.Create = RequestInfo_Create;
+    request_info.IsURLRequestInfo = RequestInfo_IsURLRequestInfo;
+    request_info.SetProperty = RequestInfo_SetProperty;
+    request_info.AppendDataToBody = RequestInfo_AppendDataToBody;
+    request_info.AppendFileToBody = RequestInfo_AppendFileToBody;
+
+    url_loader.Create = URLLoader_Create;
+    url_loader.IsURLLoader = URLLoader_IsURLLoader;
+    url_loader.Open = URLLoader_Open;
+    url_loader.FollowRedirect = URLLoader_FollowRedirect;
+    url_loader.GetUploadProgress = URLLoader_GetUploadProgress;
+    url_loader.GetDownloadProgress = URLLoader_GetDownloadProgress;
+    url_loader.GetResponseInfo = URLLoader_GetResponseInfo;
+    url_loader.ReadResponseBody = URLLoader_ReadResponseBody;
+    url_loader.FinishStreamingToFile = URLLoader_FinishStreamingToFile;
+    url_loader.Close = URLLoader_Close;
+
+    response_info.IsURLResponseInfo = ResponseInfo_IsURLResponseInfo;
+    response_info.GetProperty = ResponseInfo_GetProperty;
+    response_info.GetBodyAsFileRef = ResponseInfo_GetBodyAsFileRef;
+
+    graphics_3d.GetAttribMaxValue = Graphics3D_GetAttribMaxValue;
+    graphics_3d.Create = Graphics3D_Create;
+    graphics_3d.IsGraphics3D = Graphics3D_IsGraphics3D;
+    graphics_3d.GetAttribs = Graphics3D_GetAttribs;
+    graphics_3d.SetAttribs = Graphics3D_SetAttribs;
+    graphics_3d.GetError = Graphics3D_GetError;
+    graphics_3d.ResizeBuffers = Graphics3D_ResizeBuffers;
+    graphics_3d.SwapBuffers = Graphics3D_SwapBuffers;
+  }
+
+  if (strcmp(interface_name, PPB_CORE_INTERFACE) == 0)
+    return &core;
+  if (strcmp(interface_name, PPB_INSTANCE_INTERFACE) == 0)
+    return &instance;
+  if (strcmp(interface_name, PPB_MESSAGING_INTERFACE) == 0)
+    return &messaging;
+  if (strcmp(interface_name, PPB_VAR_INTERFACE) == 0)
+    return &var;
+  if (strcmp(interface_name, PPB_URLREQUESTINFO_INTERFACE) == 0)
+    return &request_info;
+  if (strcmp(interface_name, PPB_URLLOADER_INTERFACE) == 0)
+    return &url_loader;
+  if (strcmp(interface_name, PPB_URLRESPONSEINFO_INTERFACE) == 0)
+    return &response_info;
+  if (strcmp(interface_name, PPB_GRAPHICS_3D_INTERFACE) == 0)
+    return &graphics_3d;
+  return NULL;
+}
+
+
+// In a NaCl build these come from ppapi_gles2 and route GL calls through
+// PPB_OpenGLES2.  Here GL is called directly, so they only switch contexts.
+GLboolean GL_APIENTRY glInitializePPAPI(PPB_GetInterface get_browser) {
+  return GL_TRUE;
+}
+
+
+GLboolean GL_APIENTRY glTerminatePPAPI(void) {
+  return GL_TRUE;
+}
+
+
+void GL_APIENTRY glSetCurrentContextPPAPI(PP_Resource context) {
+  Graphics3D* graphics = GetResource<Graphics3D>(context);
+  if (graphics) {
+    eglMakeCurrent(s_display, graphics->surface_, graphics->surface_,
+                   graphics->context_);
+  } else {
+    eglMakeCurrent(s_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+}
+
+
+PP_Resource GL_APIENTRY glGetCurrentContextPPAPI(void) {
+  EGLContext current = eglGetCurrentContext();
+  std::map<PP_Resource, Resource*>::iterator it;
+  for (it = s_resources.begin(); it != s_resources.end(); ++it) {
+    Graphics3D* graphics = dynamic_cast<Graphics3D*>(it->second);
+    if (graphics && graphics->context_ == current)
+      return it->first;
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Setup
+//-----------------------------------------------------------------------------
+
+bool HostInitialize(const char* asset_root) {
+  s_assetRoot = asset_root;
+
+  // Prefer a surfaceless display so no X server is needed, falling back to
+  // the default display.
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+          eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (get_platform_display) {
+    s_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                     EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (s_display == EGL_NO_DISPLAY || !eglInitialize(s_display, NULL, NULL)) {
+    s_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (s_display == EGL_NO_DISPLAY || !eglInitialize(s_display, NULL, NULL)) {
+      fprintf(stderr, "failed to initialize EGL: 0x%x\n", eglGetError());
+      return false;
+    }
+  }
+  return eglBindAPI(EGL_OPENGL_ES_API) == EGL_TRUE;
+}
+
+
+void HostShutdown(void) {
+  eglMakeCurrent(s_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  while (!s_resources.empty()) {
+    std::map<PP_Resource, Resource*>::iterator it = s_resources.begin();
+    Resource* resource = it->second;
+    s_resources.erase(it);
+    delete resource;
+  }
+  s_tasks.clear();
+  eglTerminate(s_display);
+  s_display = EGL_NO_DISPLAY;
+}
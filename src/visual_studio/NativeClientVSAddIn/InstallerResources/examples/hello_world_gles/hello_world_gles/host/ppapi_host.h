@@ -0,0 +1,38 @@
+#ifndef EXAMPLES_HELLO_WORLD_GLES_HOST_PPAPI_HOST_H
+#define EXAMPLES_HELLO_WORLD_GLES_HOST_PPAPI_HOST_H
+
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file ppapi_host.h
+ * Minimal stand-in for the browser side of the PPB interfaces used by the
+ * example, so that the module can run as a plain Linux program.  Graphics3D
+ * is backed by an offscreen EGL pbuffer, URLLoader by local files, and
+ * completion callbacks by a single threaded message loop.
+ */
+
+//-----------------------------------------------------------------------------
+#include "ppapi/c/pp_instance.h"
+#include "ppapi/c/pp_stdint.h"
+
+/// Called after every SwapBuffers with the number of frames presented so far
+/// and the time since the message loop started.
+typedef void (*HostFrameCallback)(int frame, double seconds);
+
+/// Set up EGL.  URLs are resolved relative to |asset_root|.
+bool HostInitialize(const char* asset_root);
+void HostShutdown(void);
+
+/// The PPB_GetInterface function handed to PPP_InitializeModule.
+const void* HostGetInterface(const char* interface_name);
+
+/// Stop the message loop once |frames| frames have been presented.
+void HostSetFrameLimit(int frames, HostFrameCallback callback);
+
+/// Run queued completion callbacks until the frame limit is reached or there
+/// is nothing left to do (e.g. because the module failed to start).
+void HostRunMessageLoop(void);
+
+#endif  // EXAMPLES_HELLO_WORLD_GLES_HOST_PPAPI_HOST_H
@@ -0,0 +1,345 @@
+#!/usr/bin/env python
+# Copyright (c) 2013 The Chromium Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Convert a PNG image into a KTX texture with a full mip chain.
+
+The output holds either plain 8-bit RGB/RGBA levels or ETC1 compressed
+levels (--etc1).  Mip levels are built with a 2x2 box filter.  Only the
+standard library is used so the tool runs anywhere the SDK does.
+
+Usage: png_to_ktx.py [--etc1] [--no-mipmaps] input.png output.ktx
+"""
+
+import optparse
+import struct
+import sys
+import zlib
+
+PNG_SIGNATURE = b'\x89PNG\r\n\x1a\n'
+KTX_IDENTIFIER = b'\xabKTX 11\xbb\r\n\x1a\n'
+
+GL_UNSIGNED_BYTE = 0x1401
+GL_RGB = 0x1907
+GL_RGBA = 0x1908
+GL_ETC1_RGB8_OES = 0x8D64
+
+# ETC1 modifier tables; each entry is (small, large), the full table being
+# (small, large, -small, -large) indexed by the 2-bit pixel code.
+ETC1_TABLES = [(2, 8), (5, 17), (9, 29), (13, 42),
+               (18, 60), (24, 80), (33, 106), (47, 183)]
+
+
+class Error(Exception):
+  pass
+
+
+class Image(object):
+  """Tightly packed 8-bit pixels, top row first."""
+
+  def __init__(self, width, height, channels, pixels):
+    self.width = width
+    self.height = height
+    self.channels = channels
+    self.pixels = pixels
+
+  def Pixel(self, x, y):
+    x = min(x, self.width - 1)
+    y = min(y, self.height - 1)
+    offset = (y * self.width + x) * self.channels
+    return self.pixels[offset:offset + self.channels]
+
+
+def _Paeth(a, b, c):
+  p = a + b - c
+  pa = abs(p - a)
+  pb = abs(p - b)
+  pc = abs(p - c)
+  if pa <= pb and pa <= pc:
+    return a
+  if pb <= pc:
+    return b
+  return c
+
+
+def ReadPNG(filename):
+  """Decode an 8-bit, non-interlaced PNG into an RGB or RGBA Image."""
+  with open(filename, 'rb') as f:
+    data = f.read()
+  if data[:8] != PNG_SIGNATURE:
+    raise Error('%s: not a PNG file' % filename)
+
+  pos = 8
+  idat = []
+  palette = None
+  transparency = None
+  header = None
+  while pos < len(data):
+    length, chunk_type = struct.unpack('>I4s', data[pos:pos + 8])
+    body = data[pos + 8:pos + 8 + length]
+    pos += 12 + length
+    if chunk_type == b'IHDR':
+      header = struct.unpack('>IIBBBBB', body)
+    elif chunk_type == b'PLTE':
+      palette = bytearray(body)
+    elif chunk_type == b'tRNS':
+      transparency = bytearray(body)
+    elif chunk_type == b'IDAT':
+      idat.append(body)
+    elif chunk_type == b'IEND':
+      break
+
+  if not header:
+    raise Error('%s: missing IHDR' % filename)
+  width, height, depth, color_type, _, _, interlace = header
+  if depth != 8 or interlace:
+    raise Error('%s: only 8-bit non-interlaced PNGs are supported' % filename)
+  bpp = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(color_type)
+  if bpp is None:
+    raise Error('%s: unsupported color type %d' % (filename, color_type))
+
+  raw = bytearray(zlib.decompress(b''.join(idat)))
+  stride = width * bpp
+  rows = []
+  prev = bytearray(stride)
+  pos = 0
+  for _ in range(height):
+    filter_type = raw[pos]
+    row = raw[pos + 1:pos + 1 + stride]
+    pos += 1 + stride
+    for i in range(stride):
+      a = row[i - bpp] if i >= bpp else 0
+      b = prev[i]
+      if filter_type == 1:
+        row[i] = (row[i] + a) & 0xff
+      elif filter_type == 2:
+        row[i] = (row[i] + b) & 0xff
+      elif filter_type == 3:
+        row[i] = (row[i] + ((a + b) >> 1)) & 0xff
+      elif filter_type == 4:
+        c = prev[i - bpp] if i >= bpp else 0
+        row[i] = (row[i] + _Paeth(a, b, c)) & 0xff
+      elif filter_type != 0:
+        raise Error('%s: bad filter type %d' % (filename, filter_type))
+    rows.append(row)
+    prev = row
+
+  has_alpha = color_type in (4, 6) or transparency is not None
+  channels = 4 if has_alpha else 3
+  pixels = bytearray()
+  for row in rows:
+    for x in range(width):
+      p = row[x * bpp:(x + 1) * bpp]
+      if color_type == 0:
+        rgba = [p[0], p[0], p[0], 255]
+        if transparency and p[0] == transparency[1]:
+          rgba[3] = 0
+      elif color_type == 2:
+        rgba = [p[0], p[1], p[2], 255]
+        if transparency and bytearray(p) == transparency[1::2]:
+          rgba[3] = 0
+      elif color_type == 3:
+        rgba = list(palette[p[0] * 3:p[0] * 3 + 3]) + [255]
+        if transparency and p[0] < len(transparency):
+          rgba[3] = transparency[p[0]]
+      elif color_type == 4:
+        rgba = [p[0], p[0], p[0], p[1]]
+      else:
+        rgba = list(p)
+      pixels.extend(rgba[:channels])
+  return Image(width, height, channels, pixels)
+
+
+def Downsample(image):
+  """Return the next mip level using a 2x2 box filter."""
+  width = max(1, image.width // 2)
+  height = max(1, image.height // 2)
+  pixels = bytearray()
+  for y in range(height):
+    for x in range(width):
+      quad = [image.Pixel(x * 2 + dx, y * 2 + dy)
+              for dy in (0, 1) for dx in (0, 1)]
+      for c in range(image.channels):
+        pixels.append((sum(p[c] for p in quad) + 2) // 4)
+  return Image(width, height, image.channels, pixels)
+
+
+def BuildMipChain(image):
+  levels = [image]
+  while image.width > 1 or image.height > 1:
+    image = Downsample(image)
+    levels.append(image)
+  return levels
+
+
+def EncodeUncompressed(image):
+  """Level data with every row padded to 4 bytes, as KTX requires."""
+  row_size = image.width * image.channels
+  padding = b'\0' * ((4 - row_size % 4) % 4)
+  out = bytearray()
+  for y in range(image.height):
+    start = y * row_size
+    out.extend(image.pixels[start:start + row_size])
+    out.extend(padding)
+  return bytes(out)
+
+
+def _Clamp(value):
+  return max(0, min(255, value))
+
+
+def _Expand4(value):
+  return (value << 4) | value
+
+
+def _Expand5(value):
+  return (value << 3) | (value >> 2)
+
+
+def _SubblockError(pixels, base):
+  """Best table for |pixels| around |base|: (error, table, codes)."""
+  best = None
+  for table_index, (small, large) in enumerate(ETC1_TABLES):
+    modifiers = (small, large, -small, -large)
+    error = 0
+    codes = []
+    for pixel in pixels:
+      best_code = 0
+      best_error = None
+      for code, modifier in enumerate(modifiers):
+        e = 0
+        for c in range(3):
+          d = _Clamp(base[c] + modifier) - pixel[c]
+          e += d * d
+        if best_error is None or e < best_error:
+          best_error = e
+          best_code = code
+      error += best_error
+      codes.append(best_code)
+    if best is None or error < best[0]:
+      best = (error, table_index, codes)
+  return best
+
+
+def _Average(pixels):
+  return [sum(p[c] for p in pixels) / float(len(pixels)) for c in range(3)]
+
+
+def EncodeEtc1Block(block):
+  """Encode 16 RGB pixels (indexed [y][x]) as one 8-byte ETC1 block."""
+  best = None
+  for flip in (0, 1):
+    if flip:
+      coords = ([(x, y) for y in (0, 1) for x in range(4)],
+                [(x, y) for y in (2, 3) for x in range(4)])
+    else:
+      coords = ([(x, y) for x in (0, 1) for y in range(4)],
+                [(x, y) for x in (2, 3) for y in range(4)])
+    subblocks = [[block[y][x] for x, y in sub] for sub in coords]
+    averages = [_Average(sub) for sub in subblocks]
+
+    candidates = []
+    # Individual mode: two independent 4-bit colors.
+    colors4 = [[int(round(a / 17.0)) for a in avg] for avg in averages]
+    candidates.append((0, colors4, [[_Expand4(c) for c in color]
+                                    for color in colors4]))
+    # Differential mode: 5-bit base plus a 3-bit signed delta.
+    colors5 = [[int(round(a * 31 / 255.0)) for a in avg] for avg in averages]
+    deltas = [colors5[1][c] - colors5[0][c] for c in range(3)]
+    if all(-4 <= d <= 3 for d in deltas):
+      candidates.append((1, colors5, [[_Expand5(c) for c in color]
+                                      for color in colors5]))
+
+    for diff, quantized, bases in candidates:
+      results = [_SubblockError(subblocks[i], bases[i]) for i in (0, 1)]
+      error = results[0][0] + results[1][0]
+      if best is None or error < best[0]:
+        best = (error, flip, diff, quantized, coords, results)
+
+  _, flip, diff, quantized, coords, results = best
+  high = 0
+  for c in range(3):
+    shift = 8 + (2 - c) * 8
+    if diff:
+      delta = (quantized[1][c] - quantized[0][c]) & 7
+      high |= ((quantized[0][c] << 3) | delta) << shift
+    else:
+      high |= ((quantized[0][c] << 4) | quantized[1][c]) << shift
+  high |= results[0][1] << 5
+  high |= results[1][1] << 2
+  high |= diff << 1
+  high |= flip
+
+  low = 0
+  for sub in (0, 1):
+    for (x, y), code in zip(coords[sub], results[sub][2]):
+      index = x * 4 + y
+      low |= (code >> 1) << (16 + index)
+      low |= (code & 1) << index
+  return struct.pack('>II', high, low)
+
+
+def EncodeEtc1(image):
+  out = bytearray()
+  for by in range(0, image.height, 4):
+    for bx in range(0, image.width, 4):
+      block = [[image.Pixel(bx + x, by + y)[:3] for x in range(4)]
+               for y in range(4)]
+      out.extend(EncodeEtc1Block(block))
+  return bytes(out)
+
+
+def WriteKTX(filename, levels, etc1, base_only):
+  base = levels[0]
+  if etc1:
+    gl_type, type_size, gl_format = 0, 1, 0
+    internal_format, base_format = GL_ETC1_RGB8_OES, GL_RGB
+  else:
+    gl_type, type_size = GL_UNSIGNED_BYTE, 1
+    gl_format = GL_RGBA if base.channels == 4 else GL_RGB
+    internal_format = base_format = gl_format
+
+  header = struct.pack('<13I', 0x04030201, gl_type, type_size, gl_format,
+                       internal_format, base_format, base.width, base.height,
+                       0, 0, 1, 0 if base_only else len(levels), 0)
+  with open(filename, 'wb') as f:
+    f.write(KTX_IDENTIFIER)
+    f.write(header)
+    for level in levels:
+      data = EncodeEtc1(level) if etc1 else EncodeUncompressed(level)
+      f.write(struct.pack('<I', len(data)))
+      f.write(data)
+      f.write(b'\0' * ((4 - len(data) % 4) % 4))
+
+
+def main(args):
+  parser = optparse.OptionParser(usage='%prog [options] input.png output.ktx')
+  parser.add_option('--etc1', action='store_true',
+                    help='store ETC1 compressed levels (alpha is dropped)')
+  parser.add_option('--no-mipmaps', action='store_true',
+                    help='store the base level only and let the loader '
+                    'generate the rest with glGenerateMipmap')
+  options, args = parser.parse_args(args)
+  if len(args) != 2:
+    parser.error('expected an input and an output file')
+
+  try:
+    image = ReadPNG(args[0])
+  except Error as e:
+    sys.stderr.write('%s\n' % e)
+    return 1
+
+  if image.width & (image.width - 1) or image.height & (image.height - 1):
+    sys.stderr.write('warning: %s is not a power of two; GLES 2.0 cannot '
+                     'mipmap it\n' % args[0])
+  if options.etc1 and image.channels == 4:
+    sys.stderr.write('warning: ETC1 has no alpha channel; alpha dropped\n')
+
+  levels = [image] if options.no_mipmaps else BuildMipChain(image)
+  WriteKTX(args[1], levels, options.etc1, options.no_mipmaps)
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,308 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file shader_cache.cc
+ * Shader/program cache with compile and link validation.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "shader_cache.h"
+
+struct CachedLocation {
+  char* name;
+  bool uniform;
+  GLint location;
+  CachedLocation* next;
+};
+
+struct ProgramCache::Shader {
+  GLenum type;
+  unsigned int hash;
+  char* source;
+  GLuint id;
+  Shader* next;
+};
+
+/// Program binaries are kept for the lifetime of the module so that later
+/// contexts (e.g. further instances of the example) can skip compilation
+/// entirely.
+struct ProgramBinary {
+  unsigned int hash;
+  char* vertex_source;
+  char* fragment_source;
+  GLenum format;
+  GLsizei length;
+  void* data;
+  ProgramBinary* next;
+};
+
+static ProgramBinary* s_binaries = NULL;
+
+// FNV-1a.  Cheap to compute; used to skip most source comparisons, not to
+// identify sources on its own.
+static unsigned int HashString(const char* str, unsigned int hash) {
+  for (; *str; str++) {
+    hash ^= (unsigned char) *str;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static const unsigned int kHashSeed = 2166136261u;
+
+
+static bool SameSources(const char* vertex_a, const char* fragment_a,
+                        const char* vertex_b, const char* fragment_b) {
+  return strcmp(vertex_a, vertex_b) == 0 &&
+         strcmp(fragment_a, fragment_b) == 0;
+}
+
+
+static GLint LookupLocation(Program* program, const char* name,
+                            bool uniform) {
+  CachedLocation* loc;
+  for (loc = program->locations; loc; loc = loc->next) {
+    if (loc->uniform == uniform && strcmp(loc->name, name) == 0)
+      return loc->location;
+  }
+
+  loc = new CachedLocation;
+  loc->name = strdup(name);
+  loc->uniform = uniform;
+  if (uniform)
+    loc->location = glGetUniformLocation(program->id, name);
+  else
+    loc->location = glGetAttribLocation(program->id, name);
+  loc->next = program->locations;
+  program->locations = loc;
+
+  if (loc->location < 0 && program->log) {
+    program->log("program %08x has no active %s '%s'\n", program->hash,
+                 uniform ? "uniform" : "attribute", name);
+  }
+  return loc->location;
+}
+
+
+GLint ProgramUniform(Program* program, const char* name) {
+  return LookupLocation(program, name, true);
+}
+
+
+GLint ProgramAttrib(Program* program, const char* name) {
+  return LookupLocation(program, name, false);
+}
+
+
+ProgramCache::ProgramCache(ShaderLogFunc log)
+  : log_(log),
+    binary_funcs_(NULL),
+    shaders_(NULL),
+    programs_(NULL),
+    hits_(0),
+    shader_compiles_(0),
+    program_links_(0),
+    binary_loads_(0) {
+}
+
+
+ProgramCache::~ProgramCache() {
+  while (programs_) {
+    Program* program = programs_;
+    programs_ = program->next;
+    while (program->locations) {
+      CachedLocation* loc = program->locations;
+      program->locations = loc->next;
+      free(loc->name);
+      delete loc;
+    }
+    glDeleteProgram(program->id);
+    free(program->vertex_source);
+    free(program->fragment_source);
+    delete program;
+  }
+  while (shaders_) {
+    Shader* shader = shaders_;
+    shaders_ = shader->next;
+    glDeleteShader(shader->id);
+    free(shader->source);
+    delete shader;
+  }
+}
+
+
+void ProgramCache::SetBinaryFuncs(const ProgramBinaryFuncs* funcs) {
+  binary_funcs_ = NULL;
+  if (!funcs || !funcs->GetProgramBinary || !funcs->ProgramBinary)
+    return;
+  const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+  if (extensions && strstr(extensions, "GL_OES_get_program_binary"))
+    binary_funcs_ = funcs;
+}
+
+
+GLuint ProgramCache::GetShader(GLenum type, const char* source) {
+  unsigned int hash = HashString(source, kHashSeed);
+  for (Shader* shader = shaders_; shader; shader = shader->next) {
+    if (shader->type == type && shader->hash == hash &&
+        strcmp(shader->source, source) == 0)
+      return shader->id;
+  }
+
+  GLuint id = glCreateShader(type);
+  glShaderSource(id, 1, &source, NULL);
+  glCompileShader(id);
+  shader_compiles_++;
+
+  GLint status = GL_FALSE;
+  glGetShaderiv(id, GL_COMPILE_STATUS, &status);
+  if (!status) {
+    GLint log_length = 0;
+    glGetShaderiv(id, GL_INFO_LOG_LENGTH, &log_length);
+    char* info = (char*) malloc(log_length + 1);
+    info[0] = 0;
+    if (log_length)
+      glGetShaderInfoLog(id, log_length + 1, NULL, info);
+    if (log_) {
+      log_("failed to compile %s shader %08x:\n%s\n",
+           type == GL_VERTEX_SHADER ? "vertex" : "fragment", hash, info);
+    }
+    free(info);
+    glDeleteShader(id);
+    return 0;
+  }
+
+  Shader* shader = new Shader;
+  shader->type = type;
+  shader->hash = hash;
+  shader->source = strdup(source);
+  shader->id = id;
+  shader->next = shaders_;
+  shaders_ = shader;
+  return id;
+}
+
+
+bool ProgramCache::CheckLink(GLuint program, bool quiet) {
+  GLint status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status)
+    return true;
+  if (quiet || !log_)
+    return false;
+
+  GLint log_length = 0;
+  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
+  char* info = (char*) malloc(log_length + 1);
+  info[0] = 0;
+  if (log_length)
+    glGetProgramInfoLog(program, log_length + 1, NULL, info);
+  log_("failed to link program:\n%s\n", info);
+  free(info);
+  return false;
+}
+
+
+bool ProgramCache::LoadBinary(GLuint program, unsigned int hash,
+                              const char* vertex_source,
+                              const char* fragment_source) {
+  if (!binary_funcs_)
+    return false;
+  for (ProgramBinary* binary = s_binaries; binary; binary = binary->next) {
+    if (binary->hash != hash ||
+        !SameSources(binary->vertex_source, binary->fragment_source,
+                     vertex_source, fragment_source))
+      continue;
+    binary_funcs_->ProgramBinary(program, binary->format, binary->data,
+                                 binary->length);
+    // The driver is free to reject binaries (e.g. after an update) in which
+    // case we quietly fall back to compiling from source.
+    if (!CheckLink(program, true))
+      return false;
+    binary_loads_++;
+    return true;
+  }
+  return false;
+}
+
+
+void ProgramCache::SaveBinary(GLuint program, unsigned int hash,
+                              const char* vertex_source,
+                              const char* fragment_source) {
+  if (!binary_funcs_)
+    return;
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+  if (length <= 0)
+    return;
+
+  ProgramBinary* binary = new ProgramBinary;
+  binary->hash = hash;
+  binary->vertex_source = strdup(vertex_source);
+  binary->fragment_source = strdup(fragment_source);
+  binary->data = malloc(length);
+  binary_funcs_->GetProgramBinary(program, length, &binary->length,
+                                  &binary->format, binary->data);
+  binary->next = s_binaries;
+  s_binaries = binary;
+}
+
+
+Program* ProgramCache::GetProgram(const char* vertex_source,
+                                  const char* fragment_source) {
+  unsigned int hash = HashString(vertex_source, kHashSeed);
+  hash = HashString(fragment_source, hash * 16777619u);
+
+  for (Program* program = programs_; program; program = program->next) {
+    if (program->hash == hash &&
+        SameSources(program->vertex_source, program->fragment_source,
+                    vertex_source, fragment_source)) {
+      hits_++;
+      return program;
+    }
+  }
+
+  GLuint id = glCreateProgram();
+  if (!LoadBinary(id, hash, vertex_source, fragment_source)) {
+    GLuint vertex_shader = GetShader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment_shader = GetShader(GL_FRAGMENT_SHADER, fragment_source);
+    if (!vertex_shader || !fragment_shader) {
+      glDeleteProgram(id);
+      return NULL;
+    }
+
+    glAttachShader(id, vertex_shader);
+    glAttachShader(id, fragment_shader);
+    glLinkProgram(id);
+    program_links_++;
+    if (!CheckLink(id, false)) {
+      glDeleteProgram(id);
+      return NULL;
+    }
+    SaveBinary(id, hash, vertex_source, fragment_source);
+  }
+
+  Program* program = new Program;
+  program->id = id;
+  program->hash = hash;
+  program->vertex_source = strdup(vertex_source);
+  program->fragment_source = strdup(fragment_source);
+  program->locations = NULL;
+  program->log = log_;
+  program->next = programs_;
+  programs_ = program;
+  return program;
+}
+
+
+void ProgramCache::ReportStats() {
+  if (log_) {
+    log_("program cache: %d hits, %d shader compiles, %d links, "
+         "%d binary loads%s\n", hits_, shader_compiles_, program_links_,
+         binary_loads_, binary_funcs_ ? "" : " (program binaries disabled)");
+  }
+}
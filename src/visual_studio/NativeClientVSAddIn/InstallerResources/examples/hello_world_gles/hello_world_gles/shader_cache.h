@@ -0,0 +1,93 @@
+#ifndef EXAMPLES_HELLO_WORLD_GLES_SHADER_CACHE_H
+#define EXAMPLES_HELLO_WORLD_GLES_SHADER_CACHE_H
+
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file shader_cache.h
+ * Per-context cache of compiled shaders and linked programs, keyed by the
+ * shader source.  A hash of the source is compared first; the source itself
+ * is kept and compared on a hash match, so colliding sources never share an
+ * entry.
+ */
+
+//-----------------------------------------------------------------------------
+#include <GLES2/gl2.h>
+
+#ifndef GL_PROGRAM_BINARY_LENGTH_OES
+#define GL_PROGRAM_BINARY_LENGTH_OES 0x8741
+#endif
+
+typedef void (*ShaderLogFunc)(const char* fmt, ...);
+
+/// Entry points for GL_OES_get_program_binary.  The Pepper GLES2 interface
+/// does not expose these, so they are only used when the embedder supplies
+/// them (for example from eglGetProcAddress on a desktop host).
+struct ProgramBinaryFuncs {
+  void (*GetProgramBinary)(GLuint program, GLsizei buf_size, GLsizei* length,
+                           GLenum* binary_format, void* binary);
+  void (*ProgramBinary)(GLuint program, GLenum binary_format,
+                        const void* binary, GLint length);
+};
+
+struct CachedLocation;
+
+/// A linked program owned by a ProgramCache.  Uniform and attribute
+/// locations are queried from GL once and remembered.
+struct Program {
+  GLuint id;
+  unsigned int hash;
+  char* vertex_source;
+  char* fragment_source;
+  CachedLocation* locations;
+  ShaderLogFunc log;
+  Program* next;
+};
+
+/// Returns the location of a uniform or attribute, querying GL only the
+/// first time each name is asked for.  Missing names are logged once.
+GLint ProgramUniform(Program* program, const char* name);
+GLint ProgramAttrib(Program* program, const char* name);
+
+class ProgramCache {
+ public:
+  /// |log| receives compile and link errors along with the driver's info log.
+  explicit ProgramCache(ShaderLogFunc log);
+
+  /// Deletes all shaders and programs.  The owning context must be current.
+  ~ProgramCache();
+
+  /// Enable program binaries if |funcs| is non-NULL and the context
+  /// advertises GL_OES_get_program_binary.
+  void SetBinaryFuncs(const ProgramBinaryFuncs* funcs);
+
+  /// Return the program built from the given sources, compiling and linking
+  /// it on first use.  Returns NULL (after logging) if the build fails.
+  Program* GetProgram(const char* vertex_source, const char* fragment_source);
+
+  /// Log hit, compile and binary load counts.
+  void ReportStats();
+
+ private:
+  struct Shader;
+
+  GLuint GetShader(GLenum type, const char* source);
+  bool LoadBinary(GLuint program, unsigned int hash,
+                  const char* vertex_source, const char* fragment_source);
+  void SaveBinary(GLuint program, unsigned int hash,
+                  const char* vertex_source, const char* fragment_source);
+  bool CheckLink(GLuint program, bool quiet);
+
+  ShaderLogFunc log_;
+  const ProgramBinaryFuncs* binary_funcs_;
+  Shader* shaders_;
+  Program* programs_;
+  int hits_;
+  int shader_compiles_;
+  int program_links_;
+  int binary_loads_;
+};
+
+#endif  // EXAMPLES_HELLO_WORLD_GLES_SHADER_CACHE_H
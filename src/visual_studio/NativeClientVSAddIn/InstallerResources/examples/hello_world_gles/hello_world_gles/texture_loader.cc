@@ -0,0 +1,286 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file texture_loader.cc
+ * KTX parsing and incremental texture upload.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "texture_loader.h"
+
+static const unsigned char kKtxIdentifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+// Header fields following the identifier, all 32-bit.
+enum KtxHeaderField {
+  KTX_ENDIANNESS,
+  KTX_GL_TYPE,
+  KTX_GL_TYPE_SIZE,
+  KTX_GL_FORMAT,
+  KTX_GL_INTERNAL_FORMAT,
+  KTX_GL_BASE_INTERNAL_FORMAT,
+  KTX_PIXEL_WIDTH,
+  KTX_PIXEL_HEIGHT,
+  KTX_PIXEL_DEPTH,
+  KTX_NUM_ARRAY_ELEMENTS,
+  KTX_NUM_FACES,
+  KTX_NUM_MIPMAP_LEVELS,
+  KTX_BYTES_OF_KEY_VALUE_DATA,
+  KTX_HEADER_FIELDS
+};
+
+static const size_t kKtxHeaderSize = sizeof(kKtxIdentifier) +
+                                     KTX_HEADER_FIELDS * 4;
+
+static unsigned int ReadUint32(const char* ptr, bool swap) {
+  unsigned int value;
+  memcpy(&value, ptr, 4);
+  if (swap) {
+    value = (value >> 24) | ((value >> 8) & 0xff00) |
+            ((value << 8) & 0xff0000) | (value << 24);
+  }
+  return value;
+}
+
+
+// Largest width or height accepted, so that level sizes fit in 32 bits.
+static const unsigned int kKtxMaxDimension = 8192;
+
+static int BytesPerPixel(GLenum format) {
+  switch (format) {
+    case GL_RGBA: return 4;
+    case GL_RGB: return 3;
+    case GL_LUMINANCE_ALPHA: return 2;
+    case GL_LUMINANCE:
+    case GL_ALPHA: return 1;
+  }
+  return 0;
+}
+
+
+// Bytes a level of |width| x |height| must hold, or 0 if the format is
+// not one the uploader handles (TextureUploader::Start rejects those).
+static size_t ExpectedLevelSize(const KtxTexture& texture, GLsizei width,
+                                GLsizei height) {
+  if (texture.type == 0) {
+    if (texture.internal_format != GL_ETC1_RGB8_OES)
+      return 0;
+    // 8 bytes per 4x4 block.
+    return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * 8;
+  }
+  // Rows are padded to 4 bytes.
+  size_t stride = (width * BytesPerPixel(texture.format) + 3) & ~3;
+  return stride * height;
+}
+
+
+bool ParseKtx(const char* data, size_t size, KtxTexture* texture,
+              const char** error) {
+  if (size < kKtxHeaderSize ||
+      memcmp(data, kKtxIdentifier, sizeof(kKtxIdentifier)) != 0) {
+    *error = "not a KTX file";
+    return false;
+  }
+
+  const char* fields = data + sizeof(kKtxIdentifier);
+  bool swap = ReadUint32(fields, false) != 0x04030201;
+  unsigned int header[KTX_HEADER_FIELDS];
+  for (int i = 0; i < KTX_HEADER_FIELDS; i++)
+    header[i] = ReadUint32(fields + i * 4, swap);
+
+  if (header[KTX_ENDIANNESS] != 0x04030201) {
+    *error = "bad KTX endianness marker";
+    return false;
+  }
+  if (header[KTX_PIXEL_DEPTH] > 1 || header[KTX_NUM_ARRAY_ELEMENTS] > 0 ||
+      header[KTX_NUM_FACES] != 1) {
+    *error = "only 2D KTX textures are supported";
+    return false;
+  }
+  if (header[KTX_GL_TYPE] != 0 && header[KTX_GL_TYPE] != GL_UNSIGNED_BYTE) {
+    *error = "only GL_UNSIGNED_BYTE or compressed KTX data is supported";
+    return false;
+  }
+
+  memset(texture, 0, sizeof(KtxTexture));
+  texture->type = header[KTX_GL_TYPE];
+  texture->format = header[KTX_GL_FORMAT];
+  texture->internal_format = header[KTX_GL_INTERNAL_FORMAT];
+  if (header[KTX_PIXEL_WIDTH] == 0 || header[KTX_PIXEL_HEIGHT] == 0 ||
+      header[KTX_PIXEL_WIDTH] > kKtxMaxDimension ||
+      header[KTX_PIXEL_HEIGHT] > kKtxMaxDimension) {
+    *error = "bad KTX texture size";
+    return false;
+  }
+  texture->width = header[KTX_PIXEL_WIDTH];
+  texture->height = header[KTX_PIXEL_HEIGHT];
+  texture->num_levels = header[KTX_NUM_MIPMAP_LEVELS];
+  if (texture->num_levels == 0) {
+    texture->num_levels = 1;
+    texture->generate_mipmaps = true;
+  }
+  if (texture->num_levels > KTX_MAX_LEVELS) {
+    *error = "too many mip levels";
+    return false;
+  }
+
+  // Bounds are checked as "n > size - offset" with offset <= size, which
+  // cannot wrap around the way "offset + n > size" can with 32-bit size_t.
+  if (header[KTX_BYTES_OF_KEY_VALUE_DATA] > size - kKtxHeaderSize) {
+    *error = "truncated KTX file";
+    return false;
+  }
+  size_t offset = kKtxHeaderSize + header[KTX_BYTES_OF_KEY_VALUE_DATA];
+  for (int i = 0; i < texture->num_levels; i++) {
+    if (offset > size || size - offset < 4) {
+      *error = "truncated KTX file";
+      return false;
+    }
+    unsigned int level_size = ReadUint32(data + offset, swap);
+    offset += 4;
+    if (level_size > size - offset) {
+      *error = "truncated KTX file";
+      return false;
+    }
+    KtxLevel& level = texture->levels[i];
+    level.width = texture->width >> i ? texture->width >> i : 1;
+    level.height = texture->height >> i ? texture->height >> i : 1;
+    size_t expected = ExpectedLevelSize(*texture, level.width, level.height);
+    if (expected != 0 && level_size != expected) {
+      *error = "KTX level size does not match its dimensions";
+      return false;
+    }
+    level.size = level_size;
+    level.data = data + offset;
+    offset += level_size;
+    // Each level is padded to a multiple of four bytes.
+    offset = (offset + 3) & ~(size_t) 3;
+  }
+  return true;
+}
+
+
+bool Etc1Supported(void) {
+  const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+  return extensions &&
+      strstr(extensions, "GL_OES_compressed_ETC1_RGB8_texture") != NULL;
+}
+
+
+TextureUploader::TextureUploader()
+  : data_(NULL),
+    texture_(0),
+    level_(0),
+    rows_done_(0),
+    complete_(false) {
+  memset(&ktx_, 0, sizeof(ktx_));
+}
+
+
+TextureUploader::~TextureUploader() {
+  if (texture_)
+    glDeleteTextures(1, &texture_);
+  free(data_);
+}
+
+
+bool TextureUploader::Begin(char* data, size_t size, const char** error) {
+  data_ = data;
+  if (!ParseKtx(data, size, &ktx_, error))
+    return false;
+
+  if (ktx_.type == 0) {
+    if (ktx_.internal_format != GL_ETC1_RGB8_OES) {
+      *error = "unsupported compressed format";
+      return false;
+    }
+    if (!Etc1Supported()) {
+      *error = "ETC1 textures are not supported by this context";
+      return false;
+    }
+  } else if (!BytesPerPixel(ktx_.format)) {
+    *error = "unsupported pixel format";
+    return false;
+  }
+
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  ktx_.num_levels > 1 || ktx_.generate_mipmaps ?
+                      GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+  // Smallest level first: the cheap levels are in before the big one.
+  level_ = ktx_.num_levels - 1;
+  rows_done_ = 0;
+  return true;
+}
+
+
+bool TextureUploader::UploadRows(const KtxLevel& level, size_t budget,
+                                 size_t* uploaded) {
+  // KTX rows are padded to 4 bytes, which matches the default
+  // GL_UNPACK_ALIGNMENT.
+  GLsizei stride = (level.width * BytesPerPixel(ktx_.format) + 3) & ~3;
+  if (rows_done_ == 0) {
+    glTexImage2D(GL_TEXTURE_2D, level_, ktx_.internal_format, level.width,
+                 level.height, 0, ktx_.format, ktx_.type, NULL);
+  }
+
+  GLsizei rows = (GLsizei)(budget / stride);
+  if (rows < 1)
+    rows = 1;
+  if (rows > level.height - rows_done_)
+    rows = level.height - rows_done_;
+
+  glTexSubImage2D(GL_TEXTURE_2D, level_, 0, rows_done_, level.width, rows,
+                  ktx_.format, ktx_.type, level.data + rows_done_ * stride);
+  rows_done_ += rows;
+  *uploaded = rows * stride;
+  return rows_done_ == level.height;
+}
+
+
+bool TextureUploader::Step(size_t budget) {
+  if (complete_ || !texture_)
+    return complete_;
+
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  size_t used = 0;
+  while (level_ >= 0 && used < budget) {
+    const KtxLevel& level = ktx_.levels[level_];
+    if (ktx_.type == 0) {
+      // Compressed levels cannot be split: ETC1 has no sub-image upload.
+      glCompressedTexImage2D(GL_TEXTURE_2D, level_, ktx_.internal_format,
+                             level.width, level.height, 0, level.size,
+                             level.data);
+      used += level.size;
+    } else {
+      size_t uploaded = 0;
+      bool level_done = UploadRows(level, budget - used, &uploaded);
+      used += uploaded;
+      if (!level_done)
+        break;
+    }
+    level_--;
+    rows_done_ = 0;
+  }
+
+  if (level_ < 0)
+    Finish();
+  return complete_;
+}
+
+
+void TextureUploader::Finish() {
+  if (ktx_.generate_mipmaps)
+    glGenerateMipmap(GL_TEXTURE_2D);
+  complete_ = true;
+  free(data_);
+  data_ = NULL;
+}
@@ -0,0 +1,83 @@
+#ifndef EXAMPLES_HELLO_WORLD_GLES_TEXTURE_LOADER_H
+#define EXAMPLES_HELLO_WORLD_GLES_TEXTURE_LOADER_H
+
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file texture_loader.h
+ * Loading of KTX texture containers with precomputed mip chains, either as
+ * plain 8-bit pixels or ETC1 compressed blocks.  Files are produced offline
+ * by png_to_ktx.py.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stddef.h>
+#include <GLES2/gl2.h>
+
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+#define KTX_MAX_LEVELS 16
+
+struct KtxLevel {
+  GLsizei width;
+  GLsizei height;
+  GLsizei size;
+  const char* data;
+};
+
+struct KtxTexture {
+  GLenum type;            // 0 for compressed formats
+  GLenum format;          // 0 for compressed formats
+  GLenum internal_format;
+  GLsizei width;
+  GLsizei height;
+  bool generate_mipmaps;  // the file holds only the base level
+  int num_levels;
+  KtxLevel levels[KTX_MAX_LEVELS];
+};
+
+/// Parse the KTX file in |data|.  Level pointers refer into |data|, which
+/// must outlive |texture|.  On failure |*error| describes the problem.
+bool ParseKtx(const char* data, size_t size, KtxTexture* texture,
+              const char** error);
+
+/// Returns true if the current context has GL_OES_compressed_ETC1_RGB8_texture.
+bool Etc1Supported(void);
+
+/// Uploads a KTX texture incrementally, a bounded number of bytes per call,
+/// so that large textures do not stall a single frame.  Levels are uploaded
+/// smallest first.  The texture must not be sampled until complete().
+class TextureUploader {
+ public:
+  TextureUploader();
+  ~TextureUploader();
+
+  /// Takes ownership of |data| (a malloc'ed KTX file) and creates the
+  /// texture object.  Returns false and sets |*error| if the file cannot be
+  /// used with the current context.
+  bool Begin(char* data, size_t size, const char** error);
+
+  /// Upload at most roughly |budget| bytes (always at least one row or one
+  /// compressed level).  Returns true once the texture is complete.
+  bool Step(size_t budget);
+
+  bool complete() const { return complete_; }
+  GLuint texture() const { return texture_; }
+
+ private:
+  bool UploadRows(const KtxLevel& level, size_t budget, size_t* uploaded);
+  void Finish();
+
+  char* data_;
+  KtxTexture ktx_;
+  GLuint texture_;
+  int level_;            // level currently being uploaded
+  GLsizei rows_done_;    // rows of |level_| already uploaded
+  bool complete_;
+};
+
+#endif  // EXAMPLES_HELLO_WORLD_GLES_TEXTURE_LOADER_H
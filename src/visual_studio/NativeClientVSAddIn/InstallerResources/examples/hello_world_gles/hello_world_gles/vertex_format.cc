@@ -0,0 +1,175 @@
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file vertex_format.cc
+ * Vertex layout tables, packing and attribute setup.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "vertex_format.h"
+
+static const VertexLayout s_layouts[] = {
+  { "float", sizeof(Vertex), 3, {
+      { ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, loc) },
+      { ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tu) },
+      { ATTRIB_COLOR, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, color) },
+    }
+  },
+  { "packed", sizeof(PackedVertex), 3, {
+      { ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, offsetof(PackedVertex, loc) },
+      { ATTRIB_TEXCOORD, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, tex) },
+      { ATTRIB_COLOR, 3, GL_UNSIGNED_BYTE, GL_TRUE,
+        offsetof(PackedVertex, color) },
+    }
+  },
+  { "half", sizeof(PackedHalfVertex), 3, {
+      { ATTRIB_POSITION, 4, GL_HALF_FLOAT_OES, GL_FALSE,
+        offsetof(PackedHalfVertex, loc) },
+      { ATTRIB_TEXCOORD, 2, GL_SHORT, GL_TRUE,
+        offsetof(PackedHalfVertex, tex) },
+      { ATTRIB_COLOR, 3, GL_UNSIGNED_BYTE, GL_TRUE,
+        offsetof(PackedHalfVertex, color) },
+    }
+  },
+};
+
+
+const VertexLayout* GetVertexLayout(VertexFormat format) {
+  return &s_layouts[format];
+}
+
+
+bool ParseVertexFormat(const char* name, VertexFormat* format) {
+  for (int i = 0; i < (int)(sizeof(s_layouts) / sizeof(s_layouts[0])); i++) {
+    if (strcmp(name, s_layouts[i].name) == 0) {
+      *format = (VertexFormat) i;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool HalfFloatVerticesSupported(void) {
+  const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+  return extensions && strstr(extensions, "GL_OES_vertex_half_float") != NULL;
+}
+
+
+GLushort FloatToHalf(float value) {
+  union { float f; unsigned int u; } bits;
+  bits.f = value;
+  unsigned int sign = (bits.u >> 16) & 0x8000;
+  int exponent = (int)((bits.u >> 23) & 0xff) - 127 + 15;
+  unsigned int mantissa = bits.u & 0x7fffff;
+
+  if (((bits.u >> 23) & 0xff) == 0xff)  // Inf or NaN
+    return (GLushort)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  if (exponent >= 31)  // Too large, clamp to Inf
+    return (GLushort)(sign | 0x7c00);
+  if (exponent <= 0) {
+    // Denormal (or zero) in half precision.
+    if (exponent < -10)
+      return (GLushort) sign;
+    mantissa |= 0x800000;
+    unsigned int shift = 14 - exponent;
+    unsigned int half = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1)
+      half++;
+    return (GLushort)(sign | half);
+  }
+
+  unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+  // Round to nearest; a carry into the exponent is the correct result.
+  if (mantissa & 0x1000)
+    half++;
+  return (GLushort) half;
+}
+
+
+static GLshort PackSNorm16(float value) {
+  if (value > 1.0f) value = 1.0f;
+  if (value < -1.0f) value = -1.0f;
+  return (GLshort)(value * 32767.0f + (value >= 0 ? 0.5f : -0.5f));
+}
+
+
+static GLubyte PackUNorm8(float value) {
+  if (value > 1.0f) value = 1.0f;
+  if (value < 0.0f) value = 0.0f;
+  return (GLubyte)(value * 255.0f + 0.5f);
+}
+
+
+void PackVertices(const VertexLayout* layout, const Vertex* src, int count,
+                  void* dest) {
+  if (layout == GetVertexLayout(VERTEX_FORMAT_FLOAT)) {
+    memcpy(dest, src, count * sizeof(Vertex));
+    return;
+  }
+
+  bool half = layout == GetVertexLayout(VERTEX_FORMAT_PACKED_HALF);
+  char* out = (char*) dest;
+  for (int i = 0; i < count; i++, out += layout->stride) {
+    GLshort* tex;
+    GLubyte* color;
+    if (half) {
+      PackedHalfVertex* v = (PackedHalfVertex*) out;
+      for (int j = 0; j < 3; j++)
+        v->loc[j] = FloatToHalf(src[i].loc[j]);
+      v->loc[3] = FloatToHalf(1.0f);
+      tex = v->tex;
+      color = v->color;
+    } else {
+      PackedVertex* v = (PackedVertex*) out;
+      memcpy(v->loc, src[i].loc, sizeof(v->loc));
+      tex = v->tex;
+      color = v->color;
+    }
+    tex[0] = PackSNorm16(src[i].tu);
+    tex[1] = PackSNorm16(src[i].tv);
+    for (int j = 0; j < 3; j++)
+      color[j] = PackUNorm8(src[i].color[j]);
+    color[3] = 0xff;
+  }
+}
+
+
+Mesh CreateMesh(VertexFormat format, const Vertex* src, int count) {
+  if (format == VERTEX_FORMAT_PACKED_HALF && !HalfFloatVerticesSupported())
+    format = VERTEX_FORMAT_PACKED;
+
+  Mesh mesh;
+  mesh.layout = GetVertexLayout(format);
+  mesh.num_vertices = count;
+
+  size_t size = count * mesh.layout->stride;
+  void* data = malloc(size);
+  PackVertices(mesh.layout, src, count, data);
+
+  glGenBuffers(1, &mesh.vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+  glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+  free(data);
+  mesh.upload_bytes = 0;
+  glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &mesh.upload_bytes);
+  return mesh;
+}
+
+
+void SetupVertexAttribs(const VertexLayout* layout,
+                        const GLint locations[ATTRIB_COUNT]) {
+  for (int i = 0; i < layout->num_attribs; i++) {
+    const VertexAttrib& attrib = layout->attribs[i];
+    GLint loc = locations[attrib.slot];
+    if (loc < 0)
+      continue;
+    glVertexAttribPointer(loc, attrib.size, attrib.type, attrib.normalized,
+                          layout->stride, (void*) attrib.offset);
+    glEnableVertexAttribArray(loc);
+  }
+}
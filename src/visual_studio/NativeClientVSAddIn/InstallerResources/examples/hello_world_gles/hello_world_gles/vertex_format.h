@@ -0,0 +1,111 @@
+#ifndef EXAMPLES_HELLO_WORLD_GLES_VERTEX_FORMAT_H
+#define EXAMPLES_HELLO_WORLD_GLES_VERTEX_FORMAT_H
+
+/* Copyright (c) 2013 The Chromium Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/** @file vertex_format.h
+ * Describes vertex layouts as data so that attribute setup can be generated
+ * from a table rather than written out by hand for each vertex struct.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stddef.h>
+#include <GLES2/gl2.h>
+
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
+
+/// Full precision vertex: 32 bytes.  This is the layout meshes are built in;
+/// the other formats are packed from it.
+struct Vertex {
+  float tu, tv;
+  float color[3];
+  float loc[3];
+};
+
+/// Float positions with 16-bit normalized texcoords and normalized unsigned
+/// byte colors: 20 bytes.
+struct PackedVertex {
+  GLfloat loc[3];
+  GLshort tex[2];
+  GLubyte color[4];
+};
+
+/// As PackedVertex but with half-float positions (w is always 1.0): 16 bytes.
+/// Requires GL_OES_vertex_half_float.
+struct PackedHalfVertex {
+  GLushort loc[4];
+  GLshort tex[2];
+  GLubyte color[4];
+};
+
+enum VertexFormat {
+  VERTEX_FORMAT_FLOAT,
+  VERTEX_FORMAT_PACKED,
+  VERTEX_FORMAT_PACKED_HALF,
+};
+
+/// The attributes a layout can provide, in the order that the program's
+/// attribute locations are passed to SetupVertexAttribs.
+enum VertexAttribSlot {
+  ATTRIB_POSITION,
+  ATTRIB_TEXCOORD,
+  ATTRIB_COLOR,
+  ATTRIB_COUNT
+};
+
+struct VertexAttrib {
+  VertexAttribSlot slot;
+  GLint size;
+  GLenum type;
+  GLboolean normalized;
+  size_t offset;
+};
+
+struct VertexLayout {
+  const char* name;
+  GLsizei stride;
+  int num_attribs;
+  VertexAttrib attribs[ATTRIB_COUNT];
+};
+
+/// A vertex buffer together with the layout of the data it holds.  Each mesh
+/// picks its own layout so compact and full precision meshes can be mixed.
+struct Mesh {
+  const VertexLayout* layout;
+  GLuint vbo;
+  GLsizei num_vertices;
+  /// Bytes handed to glBufferData for |vbo|, as the driver reports them.
+  GLint upload_bytes;
+};
+
+const VertexLayout* GetVertexLayout(VertexFormat format);
+
+/// Parse a format name ("float", "packed" or "half").  Returns false if the
+/// name is not recognised.
+bool ParseVertexFormat(const char* name, VertexFormat* format);
+
+/// Returns true if the current context can source half-float attributes.
+bool HalfFloatVerticesSupported(void);
+
+GLushort FloatToHalf(float value);
+
+/// Convert |count| full precision vertices into |layout| at |dest|, which
+/// must have room for count * layout->stride bytes.
+void PackVertices(const VertexLayout* layout, const Vertex* src, int count,
+                  void* dest);
+
+/// Upload |count| vertices into a new buffer using |format|.  Falls back to
+/// VERTEX_FORMAT_PACKED if half floats are requested but not supported.
+Mesh CreateMesh(VertexFormat format, const Vertex* src, int count);
+
+/// Enable and point the attribute arrays described by the mesh layout at the
+/// currently bound array buffer.  |locations| is indexed by VertexAttribSlot.
+void SetupVertexAttribs(const VertexLayout* layout,
+                        const GLint locations[ATTRIB_COUNT]);
+
+#endif  // EXAMPLES_HELLO_WORLD_GLES_VERTEX_FORMAT_H
@@ -161,10 +161,36 @@ namespace NaCl.Build.CPPTasks
             return GenerateCommandLineForSource(source) + " " + source.GetMetadata("FullPath").ToUpperInvariant();
         }
 
+        protected override bool SourcesRemoved()
+        {
+            // A source dropped from the project may still be compiled into
+            // the unity object of another one, so let compiler_wrapper.py
+            // rebuild that batch even if nothing is out of date.
+            if (!MultiProcessorCompilation || ProcessorNumber == 1)
+                return false;
+
+            IDictionary<string, string> commandLines = GenerateCommandLinesFromTlog();
+            foreach (ITaskItem source in Sources)
+            {
+                commandLines.Remove(FileTracker.FormatRootingMarker(source));
+            }
+            return commandLines.Count > 0;
+        }
+
         protected override void OutputCommandTLog(ITaskItem[] compiledSources)
         {
             IDictionary<string, string> commandLines = GenerateCommandLinesFromTlog();
 
+            // Forget sources that are no longer in the project.
+            IDictionary<string, string> previous = commandLines;
+            commandLines = new Dictionary<string, string>(StringComparer.OrdinalIgnoreCase);
+            foreach (ITaskItem source in Sources)
+            {
+                string rmSource = FileTracker.FormatRootingMarker(source);
+                if (previous.ContainsKey(rmSource))
+                    commandLines[rmSource] = previous[rmSource];
+            }
+
             //
             if (compiledSources != null)
             {
@@ -303,52 +329,84 @@ namespace NaCl.Build.CPPTasks
         {
             int returnCode = 0;
 
-            // Compute sources that can be compiled together.
+            // Compute sources that can be compiled together.  The up to date
+            // sources of each group are passed too: the wrapper may have
+            // compiled them into a unity object with out of date ones, and
+            // then has to compile them again (see compiler_wrapper.py).
             Dictionary<string, List<ITaskItem>> srcGroups =
                     new Dictionary<string, List<ITaskItem>>();
+            Dictionary<string, List<ITaskItem>> upToDateGroups =
+                    new Dictionary<string, List<ITaskItem>>();
+            List<ITaskItem> outOfDate = new List<ITaskItem>(CompileSourceList);
 
-            foreach (ITaskItem sourceItem in CompileSourceList)
+            foreach (ITaskItem sourceItem in Sources)
             {
                 string commandLine = GenerateCommandLineForSource(sourceItem);
-                if (srcGroups.ContainsKey(commandLine))
+                if (!srcGroups.ContainsKey(commandLine))
+                {
+                    srcGroups.Add(commandLine, new List<ITaskItem>());
+                    upToDateGroups.Add(commandLine, new List<ITaskItem>());
+                }
+
+                if (outOfDate.Contains(sourceItem))
                 {
                     srcGroups[commandLine].Add(sourceItem);
                 }
                 else
                 {
-                    srcGroups.Add(commandLine, new List<ITaskItem> {sourceItem});
+                    upToDateGroups[commandLine].Add(sourceItem);
                 }
             }
 
             string pythonScript = Path.GetDirectoryName(Path.GetDirectoryName(PropertiesFile));
             pythonScript = Path.Combine(pythonScript, "compiler_wrapper.py");
 
-            foreach (KeyValuePair<string, List<ITaskItem>> entry in srcGroups)
+            // Write every group to a manifest so that the wrapper can
+            // schedule all sources on one pool rather than running the
+            // groups one after the other.
+            string manifest = Path.GetTempFileName();
+            try
             {
-                string commandLine = entry.Key;
-                string cmd = "\"" + pathToTool + "\" " + commandLine + " --";
-                List<ITaskItem> sources = entry.Value;
-
-                foreach (ITaskItem sourceItem in sources)
+                using (StreamWriter writer = new StreamWriter(manifest, false, new UTF8Encoding(false)))
                 {
-                    cmd += " ";
-                    cmd += GCCUtilities.ConvertPathWindowsToPosix(sourceItem.ToString());
-                }
+                    foreach (KeyValuePair<string, List<ITaskItem>> entry in srcGroups)
+                    {
+                        string commandLine = entry.Key;
+                        string cmd = "\"" + pathToTool + "\" " + commandLine + " --";
+                        List<ITaskItem> sources = entry.Value;
 
-                try
-                {
-                    // compile this group of sources
-                    returnCode = base.ExecuteTool("python", cmd, "\"" + pythonScript + "\"");
-                }
-                catch (Exception e)
-                {
-                    Log.LogMessage("compiler exception: {0}", e);
-                    returnCode = base.ExitCode;
+                        foreach (ITaskItem sourceItem in sources)
+                        {
+                            cmd += " ";
+                            cmd += GCCUtilities.ConvertPathWindowsToPosix(sourceItem.ToString());
+                        }
+
+                        List<ITaskItem> upToDate = upToDateGroups[commandLine];
+                        if (upToDate.Count > 0)
+                        {
+                            cmd += " --up-to-date";
+                            foreach (ITaskItem sourceItem in upToDate)
+                            {
+                                cmd += " ";
+                                cmd += GCCUtilities.ConvertPathWindowsToPosix(sourceItem.ToString());
+                            }
+                        }
+                        writer.WriteLine(cmd);
+                    }
                 }
 
-                //abort if an error was encountered
-                if (returnCode != 0)
-                    break;
+                // compile all groups of sources
+                string args = "--manifest " + GCCUtilities.ConvertPathWindowsToPosix(manifest);
+                returnCode = base.ExecuteTool("python", args, "\"" + pythonScript + "\"");
+            }
+            catch (Exception e)
+            {
+                Log.LogMessage("compiler exception: {0}", e);
+                returnCode = base.ExitCode;
+            }
+            finally
+            {
+                File.Delete(manifest);
             }
 
             Log.LogMessage(MessageImportance.Low, "compiler returned: {0}", returnCode);
@@ -331,6 +331,13 @@ namespace NaCl.Build.CPPTasks
             return outOfDateSources;
         }
 
+        // Whether the tool has to run when sources were removed from the
+        // project, even if none is out of date.
+        protected virtual bool SourcesRemoved()
+        {
+            return false;
+        }
+
         protected void CalcSourcesToBuild()
         {
             //check if full recompile is required otherwise perform incremental
@@ -356,7 +363,7 @@ namespace NaCl.Build.CPPTasks
 
             //merge out of date lists
             CompileSourceList = MergeOutOfDateSources(outOfDateSourcesFromTracking, outOfDateSourcesFromCommandLine);
-            if (CompileSourceList.Length == 0)
+            if (CompileSourceList.Length == 0 && !SourcesRemoved())
             {
                 SkippedExecution = true;
                 return;